@@ -1,5 +1,11 @@
 enable_testing ()
 
 add_test(NAME t_websocket_loop         COMMAND websocket-loop)
+add_test(NAME t_http_parser_fuzz       COMMAND fuzz-http-parser)
+add_test(NAME t_monitor_mix            COMMAND check-monitor-mix)
+add_test(NAME t_encoder_resume         COMMAND check-encoder-resume)
+add_test(NAME t_time_scaler            COMMAND check-time-scaler)
+add_test(NAME t_ws_server_soak         COMMAND soak-ws-server)
+add_test(NAME t_audio_mix              COMMAND check-audio-mix)
 
 add_custom_target(check COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --timeout 10 -R '^t_')
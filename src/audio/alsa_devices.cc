@@ -350,7 +350,8 @@ void AudioPair::loopback( ChannelPair& capture_output, const ChannelPair& playba
   }
   */
 
-  microphone_.copy_all_available_samples_to( headphone_, capture_output, playback_input, statistics_.sample_stats );
+  microphone_.copy_all_available_samples_to(
+    headphone_, capture_output, playback_input, monitor_, statistics_.sample_stats );
 }
 
 inline float sample_to_float( const int32_t sample )
@@ -375,44 +376,50 @@ inline int32_t float_to_sample( const float sample_f )
 void AudioInterface::copy_all_available_samples_to( AudioInterface& other,
                                                     ChannelPair& capture_output,
                                                     const ChannelPair& playback_input,
+                                                    MonitorMix& monitor,
                                                     AudioStatistics::SampleStats& stats )
 {
   unsigned int avail_remaining = avail();
 
+  array<float, MonitorMix::MAX_BLOCK> ch1, ch2, monitor1, monitor2;
+
   while ( avail_remaining ) {
-    Buffer read_buf { *this, avail_remaining };
+    Buffer read_buf { *this, min( avail_remaining, MonitorMix::MAX_BLOCK ) };
     Buffer write_buf { other, read_buf.frame_count() };
 
     const unsigned int num_frames = write_buf.frame_count();
 
     for ( unsigned int i = 0; i < num_frames; i++ ) {
-      const float ch1_sample = sample_to_float( read_buf.sample( false, i ) );
-      const float ch2_sample = sample_to_float( read_buf.sample( true, i ) );
+      ch1[i] = sample_to_float( read_buf.sample( false, i ) );
+      ch2[i] = sample_to_float( read_buf.sample( true, i ) );
 
       /* capture into output buffer */
-      capture_output.safe_set( cursor_, { ch1_sample, ch2_sample } );
+      capture_output.safe_set( cursor_ + i, { ch1[i], ch2[i] } );
 
       /* track statistics */
       stats.samples_counted++;
       stats.ssa_ch1 += stats.max_ch1_amplitude * stats.max_ch1_amplitude;
       stats.ssa_ch2 += stats.max_ch2_amplitude * stats.max_ch2_amplitude;
-      stats.max_ch1_amplitude = max( stats.max_ch1_amplitude, abs( ch1_sample ) );
-      stats.max_ch2_amplitude = max( stats.max_ch2_amplitude, abs( ch2_sample ) );
-
-      /* play from input buffer + captured sample */
-      const auto playback_sample = playback_input.safe_get( cursor_ );
+      stats.max_ch1_amplitude = max( stats.max_ch1_amplitude, abs( ch1[i] ) );
+      stats.max_ch2_amplitude = max( stats.max_ch2_amplitude, abs( ch2[i] ) );
+    }
 
-      write_buf.sample( false, i )
-        = float_to_sample( ch1_sample * config_.ch1_loopback_gain[0] + ch2_sample * config_.ch2_loopback_gain[0]
-                           + playback_sample.first );
+    /* mix the captured block into the performer's own monitor */
+    monitor.process( { ch1.data(), num_frames },
+                     { ch2.data(), num_frames },
+                     { monitor1.data(), num_frames },
+                     { monitor2.data(), num_frames } );
 
-      write_buf.sample( true, i )
-        = float_to_sample( ch1_sample * config_.ch1_loopback_gain[1] + ch2_sample * config_.ch2_loopback_gain[1]
-                           + playback_sample.second );
+    /* play from input buffer + monitor */
+    for ( unsigned int i = 0; i < num_frames; i++ ) {
+      const auto playback_sample = playback_input.safe_get( cursor_ + i );
 
-      cursor_++;
+      write_buf.sample( false, i ) = float_to_sample( monitor1[i] + playback_sample.first );
+      write_buf.sample( true, i ) = float_to_sample( monitor2[i] + playback_sample.second );
     }
 
+    cursor_ += num_frames;
+
     unsigned int amount_to_write = num_frames;
 
     if ( other.delay() + amount_to_write > config_.skip_threshold and num_frames > 0 ) {
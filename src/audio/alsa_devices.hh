@@ -9,6 +9,7 @@
 
 #include "audio_buffer.hh"
 #include "file_descriptor.hh"
+#include "monitor_mix.hh"
 
 class ALSADevices
 {
@@ -99,9 +100,6 @@ public:
 
     unsigned int start_threshold { 24 };
     unsigned int skip_threshold { 64 };
-
-    std::array<float, 2> ch1_loopback_gain { 2.0, 2.0 };
-    std::array<float, 2> ch2_loopback_gain { 2.0, 2.0 };
   };
 
 private:
@@ -122,6 +120,7 @@ public:
   void copy_all_available_samples_to( AudioInterface& other,
                                       ChannelPair& capture_output,
                                       const ChannelPair& playback_input,
+                                      MonitorMix& monitor,
                                       AudioStatistics::SampleStats& stats );
 
   const Configuration& config() const { return config_; }
@@ -151,6 +150,8 @@ class AudioPair
   AudioInterface::Configuration config_ {};
   PCMFD fd_ { microphone_.fd() };
 
+  MonitorMix monitor_ {};
+
   AudioStatistics statistics_ {};
 
 public:
@@ -159,6 +160,9 @@ public:
   const AudioInterface::Configuration& config() const { return config_; }
   void set_config( const AudioInterface::Configuration& config );
 
+  MonitorMix& monitor() { return monitor_; }
+  const MonitorMix& monitor() const { return monitor_; }
+
   void initialize()
   {
     microphone_.initialize();
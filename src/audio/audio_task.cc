@@ -86,19 +86,20 @@ void AudioDeviceTask::summary( ostream& out ) const
   if ( device_.statistics().empty_wakeups ) {
     out << " empty=" << device_.statistics().empty_wakeups << "/" << device_.statistics().total_wakeups << "!";
   }
-  out << " loopback gains=" << device_.config().ch1_loopback_gain[0] << ":" << device_.config().ch1_loopback_gain[1]
-      << ":" << device_.config().ch2_loopback_gain[0] << ":" << device_.config().ch2_loopback_gain[1];
+  device_.monitor().summary( out );
 }
 
+/* sets both monitor channels, keeping their pan and effects */
 void AudioDeviceTask::set_loopback_gain( const float gain )
 {
-  auto config = device_.config();
-  config.ch1_loopback_gain = { gain, gain };
-  config.ch2_loopback_gain = { gain, gain };
-  device_.set_config( config );
+  for ( uint8_t ch = 0; ch < 2; ch++ ) {
+    auto strip = monitor().strip( ch );
+    strip.gain = gain;
+    monitor().set_strip( ch, strip );
+  }
 }
 
 float AudioDeviceTask::loopback_gain() const
 {
-  return device_.config().ch1_loopback_gain.at( 0 );
+  return monitor().strip( 0 ).gain;
 }
@@ -18,7 +18,11 @@ class AudioDeviceTask : public Summarizable
 public:
   AudioDeviceTask( const std::string_view interface_name, EventLoop& loop );
   void summary( std::ostream& out ) const override;
-  void reset_summary() override { device_.reset_statistics(); }
+  void reset_summary() override
+  {
+    device_.reset_statistics();
+    device_.monitor().reset_summary();
+  }
 
   AudioPair& device() { return device_; }
   ChannelPair& capture() { return capture_; }
@@ -30,6 +34,9 @@ public:
 
   size_t cursor() const { return device().cursor(); }
 
+  MonitorMix& monitor() { return device_.monitor(); }
+  const MonitorMix& monitor() const { return device_.monitor(); }
+
   void set_loopback_gain( const float gain );
   float loopback_gain() const;
 };
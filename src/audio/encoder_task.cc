@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+
 #include "encoder_task.hh"
 
 using namespace std;
@@ -79,11 +82,40 @@ OpusEncoderProcess::TrackedEncoder::TrackedEncoder( const int bit_rate,
                                                     const int channel_count )
   : channel_count_( channel_count )
   , enc_( bit_rate, sample_rate, channel_count_, OPUS_APPLICATION_RESTRICTED_LOWDELAY )
-{}
+  , bit_rate_( bit_rate )
+{
+  enc_.set_dtx( true );
+}
 
 void OpusEncoderProcess::TrackedEncoder::reset( const int bit_rate, const int sample_rate )
 {
   enc_ = { bit_rate, sample_rate, channel_count_, OPUS_APPLICATION_RESTRICTED_LOWDELAY };
+  enc_.set_dtx( true );
+  bit_rate_ = bit_rate;
+  zero_samples_ = 0;
+  resuming_ = false;
+  if ( complexity_.has_value() ) {
+    enc_.set_complexity( complexity_.value() );
+  }
+  if ( expected_loss_percent_ ) {
+    enc_.set_expected_loss( expected_loss_percent_ );
+  }
+}
+
+void OpusEncoderProcess::TrackedEncoder::set_expected_loss( const int loss_percent )
+{
+  measured_loss_percent_ = loss_percent;
+  apply_expected_loss();
+}
+
+void OpusEncoderProcess::TrackedEncoder::apply_expected_loss()
+{
+  /* with frames that can't carry FEC, asking for it would only take bits from the audio */
+  const int loss_percent = can_carry_fec() ? measured_loss_percent_ : 0;
+  if ( loss_percent != expected_loss_percent_ ) {
+    enc_.set_expected_loss( loss_percent );
+    expected_loss_percent_ = loss_percent;
+  }
 }
 
 size_t OpusEncoderProcess::min_encode_cursor() const
@@ -97,7 +129,7 @@ size_t OpusEncoderProcess::min_encode_cursor() const
 
 bool OpusEncoderProcess::TrackedEncoder::can_encode_frame( const size_t source_cursor ) const
 {
-  return ( source_cursor >= cursor() + opus_frame::NUM_SAMPLES ) and ( not output_.has_value() );
+  return ( source_cursor >= cursor() + frame_samples_ ) and ( not output_.has_value() );
 }
 
 void OpusEncoderProcess::TrackedEncoder::encode_one_frame( const AudioChannel& channel )
@@ -107,8 +139,16 @@ void OpusEncoderProcess::TrackedEncoder::encode_one_frame( const AudioChannel& c
   }
 
   output_.emplace();
-  enc_.encode( channel.region( cursor(), opus_frame::NUM_SAMPLES ), output_.value() );
-  num_pushed_++;
+  const span_view<float> samples = channel.region( cursor(), frame_samples_ );
+  if ( not send_dtx( samples, samples ) ) {
+    enc_.encode( samples, output_.value() );
+  }
+  cursor_ += frame_samples_;
+
+  if ( resuming_ ) {
+    enc_.set_prediction( true );
+    resuming_ = false;
+  }
 }
 
 void OpusEncoderProcess::TrackedEncoder::encode_one_frame( const AudioChannel& ch1, const AudioChannel& ch2 )
@@ -118,10 +158,67 @@ void OpusEncoderProcess::TrackedEncoder::encode_one_frame( const AudioChannel& c
   }
 
   output_.emplace();
-  enc_.encode_stereo( ch1.region( cursor(), opus_frame::NUM_SAMPLES ),
-                      ch2.region( cursor(), opus_frame::NUM_SAMPLES ),
-                      output_.value() );
-  num_pushed_++;
+  const span_view<float> ch1_samples = ch1.region( cursor(), frame_samples_ );
+  const span_view<float> ch2_samples = ch2.region( cursor(), frame_samples_ );
+  if ( not send_dtx( ch1_samples, ch2_samples ) ) {
+    enc_.encode_stereo( ch1_samples, ch2_samples, output_.value() );
+  }
+  cursor_ += frame_samples_;
+
+  if ( resuming_ ) {
+    enc_.set_prediction( true );
+    resuming_ = false;
+  }
+}
+
+bool OpusEncoderProcess::TrackedEncoder::send_dtx( const span_view<float> ch1, const span_view<float> ch2 )
+{
+  const auto is_zero = []( const float x ) { return x == 0; };
+  if ( all_of( ch1.begin(), ch1.end(), is_zero ) and all_of( ch2.begin(), ch2.end(), is_zero ) ) {
+    zero_samples_ += ch1.size();
+  } else {
+    zero_samples_ = 0;
+  }
+
+  if ( zero_samples_ > DTX_HANGOVER_SAMPLES and enc_.encode_silence( output_.value() ) ) {
+    dtx_frames_++;
+    return true;
+  }
+
+  return false;
+}
+
+void OpusEncoderProcess::TrackedEncoder::skip_one_frame()
+{
+  if ( output_.has_value() ) {
+    throw runtime_error( "internal error: skip_one_frame called but output already has value" );
+  }
+
+  cursor_ += frame_samples_;
+}
+
+void OpusEncoderProcess::TrackedEncoder::resume( const span_view<float> ch1, const span_view<float> ch2 )
+{
+  if ( ch1.size() != ch2.size() or ch1.size() % frame_samples_ ) {
+    throw runtime_error( "resume: priming audio is not a whole number of frames" );
+  }
+
+  /* encode the audio just before the cursor, as the encoder that stood in did, so the MDCT overlap and the pitch
+     prefilter start from the right history (the output is dropped) */
+  enc_.reset_state();
+  opus_frame discarded;
+  for ( size_t offset = 0; offset < ch1.size(); offset += frame_samples_ ) {
+    if ( channel_count_ == 1 ) {
+      enc_.encode( ch1.substr( offset, frame_samples_ ), discarded );
+    } else {
+      enc_.encode_stereo( ch1.substr( offset, frame_samples_ ), ch2.substr( offset, frame_samples_ ), discarded );
+    }
+  }
+
+  /* the decoder's energy prediction and postfilter followed the other encoder: code the next frame without them */
+  enc_.set_prediction( false );
+  resuming_ = true;
+  zero_samples_ = 0;
 }
 
 void OpusEncoderProcess::reset( const int bit_rate1, const int sample_rate )
@@ -148,6 +245,25 @@ void OpusEncoderProcess::encode_one_frame( const AudioChannel& ch1, const AudioC
   }
 }
 
+void OpusEncoderProcess::skip_one_frame()
+{
+  enc1_.skip_one_frame();
+  if ( enc2_.has_value() ) {
+    enc2_->skip_one_frame();
+  }
+  num_popped_++;
+}
+
+void OpusEncoderProcess::resume( const span_view<float> ch1, const span_view<float> ch2 )
+{
+  if ( enc2_.has_value() ) {
+    enc1_.resume( ch1, ch1 );
+    enc2_->resume( ch2, ch2 );
+  } else {
+    enc1_.resume( ch1, ch2 );
+  }
+}
+
 AudioFrame OpusEncoderProcess::front( const uint32_t frame_index ) const
 {
   AudioFrame ret;
@@ -159,3 +275,92 @@ AudioFrame OpusEncoderProcess::front( const uint32_t frame_index ) const
   }
   return ret;
 }
+
+void OpusEncoderProcess::TrackedEncoder::set_bit_rate( const int bit_rate )
+{
+  if ( bit_rate != bit_rate_ ) {
+    enc_.set_bit_rate( bit_rate );
+    bit_rate_ = bit_rate;
+  }
+}
+
+void OpusEncoderProcess::TrackedEncoder::set_complexity( const int complexity )
+{
+  if ( complexity_ != complexity ) {
+    enc_.set_complexity( complexity );
+    complexity_ = complexity;
+  }
+}
+
+void OpusEncoderProcess::TrackedEncoder::set_frame_samples( const size_t frame_samples, const size_t cursor )
+{
+  if ( not opus_frame::valid_num_samples( frame_samples ) ) {
+    throw runtime_error( "invalid Opus frame duration: " + to_string( frame_samples ) + " samples" );
+  }
+
+  frame_samples_ = frame_samples;
+  output_.reset();
+  cursor_ = cursor;
+  apply_expected_loss();
+}
+
+void OpusEncoderProcess::set_bit_rate( const int bit_rate )
+{
+  enc1_.set_bit_rate( bit_rate );
+  if ( enc2_.has_value() ) {
+    enc2_->set_bit_rate( bit_rate );
+  }
+}
+
+void OpusEncoderProcess::set_complexity( const int complexity )
+{
+  enc1_.set_complexity( complexity );
+  if ( enc2_.has_value() ) {
+    enc2_->set_complexity( complexity );
+  }
+}
+
+void OpusEncoderProcess::set_frame_samples( const size_t frame_samples )
+{
+  /* restart both channels from the same sample */
+  const size_t cursor = enc2_.has_value() ? max( enc1_.cursor(), enc2_->cursor() ) : enc1_.cursor();
+
+  enc1_.set_frame_samples( frame_samples, cursor );
+  if ( enc2_.has_value() ) {
+    enc2_->set_frame_samples( frame_samples, cursor );
+  }
+}
+
+void OpusEncoderProcess::set_expected_loss( const int loss_percent )
+{
+  enc1_.set_expected_loss( loss_percent );
+  if ( enc2_.has_value() ) {
+    enc2_->set_expected_loss( loss_percent );
+  }
+}
+
+void OpusEncoderProcess::adapt_to_loss( const unsigned int packet_transmissions, const unsigned int packet_losses )
+{
+  if ( packet_transmissions < loss_window_transmissions_ ) {
+    /* new connection: start counting again */
+    loss_window_transmissions_ = packet_transmissions;
+    loss_window_losses_ = packet_losses;
+    return;
+  }
+
+  const unsigned int sent = packet_transmissions - loss_window_transmissions_;
+  if ( sent < LOSS_WINDOW_PACKETS ) {
+    return;
+  }
+
+  const int lost = max( 0, int( packet_losses ) - int( loss_window_losses_ ) );
+  const int measured_percent = min( MAX_EXPECTED_LOSS_PERCENT, int( ceil( 100.0 * lost / sent ) ) );
+
+  /* back off gradually, so bursty loss doesn't switch the FEC on and off every window */
+  const int loss_percent = max( measured_percent, enc1_.measured_loss_percent() / 2 );
+
+  set_expected_loss( loss_percent );
+
+  loss_window_transmissions_ = packet_transmissions;
+  loss_window_losses_ = packet_losses;
+}
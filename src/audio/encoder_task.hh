@@ -13,7 +13,23 @@ class OpusEncoderProcess
     int channel_count_;
     OpusEncoder enc_;
     std::optional<opus_frame> output_ {};
-    size_t num_pushed_ {};
+    size_t cursor_ {};
+    size_t frame_samples_ { opus_frame::NUM_SAMPLES };
+    int bit_rate_;
+    std::optional<int> complexity_ {}; /* library default until set */
+    int measured_loss_percent_ {};
+    int expected_loss_percent_ {}; /* what the encoder's FEC is sized for: 0 if its frames can't carry any */
+
+    /* after this long of all-zero input (the same 200 ms libopus waits), send DTX frames without encoding */
+    static constexpr size_t DTX_HANGOVER_SAMPLES = 9600;
+    size_t zero_samples_ {};
+    unsigned int dtx_frames_ {};
+
+    /* the next frame is the first after a resume() */
+    bool resuming_ {};
+
+    bool send_dtx( const span_view<float> ch1, const span_view<float> ch2 );
+    void apply_expected_loss();
 
   public:
     TrackedEncoder( const int bit_rate, const int sample_rate, const int channel_count );
@@ -21,16 +37,35 @@ class OpusEncoderProcess
     bool can_encode_frame( const size_t source_cursor ) const;
     void encode_one_frame( const AudioChannel& channel );
     void encode_one_frame( const AudioChannel& ch1, const AudioChannel& ch2 );
-    size_t cursor() const { return num_pushed_ * opus_frame::NUM_SAMPLES; }
+    void skip_one_frame();
+    void resume( const span_view<float> ch1, const span_view<float> ch2 );
+    size_t cursor() const { return cursor_; }
+    int expected_loss_percent() const { return expected_loss_percent_; }
+    int measured_loss_percent() const { return measured_loss_percent_; }
+    bool can_carry_fec() const { return enc_.can_carry_fec( frame_samples_ ); }
 
     std::optional<opus_frame>& output() { return output_; }
     const std::optional<opus_frame>& output() const { return output_; }
 
     void reset( const int bit_rate, const int sample_rate );
+    void set_expected_loss( const int loss_percent );
+    void set_bit_rate( const int bit_rate );
+    void set_complexity( const int complexity );
+    void set_frame_samples( const size_t frame_samples, const size_t cursor );
+
+    size_t frame_samples() const { return frame_samples_; }
+    int bit_rate() const { return bit_rate_; }
+    std::optional<int> complexity() const { return complexity_; }
+    unsigned int dtx_frames() const { return dtx_frames_; }
   };
 
   size_t num_popped_ {};
 
+  /* packet counters at the start of the current loss-measurement window */
+  static constexpr unsigned int LOSS_WINDOW_PACKETS = 400; /* about 1 s */
+  static constexpr int MAX_EXPECTED_LOSS_PERCENT = 25;
+  unsigned int loss_window_transmissions_ {}, loss_window_losses_ {};
+
 protected:
   TrackedEncoder enc1_;
   std::optional<TrackedEncoder> enc2_;
@@ -51,6 +86,35 @@ public:
   AudioFrame front( const uint32_t frame_index ) const;
 
   void encode_one_frame( const AudioChannel& ch1, const AudioChannel& ch2 );
+
+  /* moves past a frame that was sent from elsewhere, without encoding it */
+  void skip_one_frame();
+
+  /* after skipping, restarts the encoders from the audio just before their cursor (whole frames), so the
+     receiver's decoder, which was following another encoder, doesn't click when this one takes over again */
+  void resume( const span_view<float> ch1, const span_view<float> ch2 );
+
+  bool separate_channels() const { return enc2_.has_value(); }
+
+  /* sizes the in-band FEC to the packet loss measured by the sender over the last window (the FEC stays off while
+     the frames can't carry any: see OpusEncoder::can_carry_fec) */
+  void adapt_to_loss( const unsigned int packet_transmissions, const unsigned int packet_losses );
+  void set_expected_loss( const int loss_percent );
+  int expected_loss_percent() const { return enc1_.expected_loss_percent(); }
+  int measured_loss_percent() const { return enc1_.measured_loss_percent(); }
+  bool can_carry_fec() const { return enc1_.can_carry_fec(); }
+
+  /* per encoder (each channel gets this much when they are encoded separately) */
+  void set_bit_rate( const int bit_rate );
+  void set_complexity( const int complexity );
+
+  /* Opus frame duration from the next frame on (any frame encoded but not yet popped is dropped) */
+  void set_frame_samples( const size_t frame_samples );
+  size_t frame_samples() const { return enc1_.frame_samples(); }
+
+  int bit_rate() const { return enc1_.bit_rate(); }
+  std::optional<int> complexity() const { return enc1_.complexity(); }
+  unsigned int dtx_frames() const { return enc1_.dtx_frames(); }
 };
 
 template<class AudioSource>
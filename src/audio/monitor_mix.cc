@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "monitor_mix.hh"
+
+using namespace std;
+
+static constexpr float SAMPLE_RATE = 48000;
+static constexpr float LOW_SHELF_HZ = 200, HIGH_SHELF_HZ = 4000;
+static constexpr float ATTACK_SECONDS = 0.001, RELEASE_SECONDS = 0.1;
+
+/* shelving filters from the Audio EQ Cookbook (shelf slope 1) */
+void MonitorMix::Biquad::set_shelf( const bool high, const float freq, const float db )
+{
+  const float A = pow( 10.0f, db / 40 );
+  const float w0 = 2 * M_PI * freq / SAMPLE_RATE;
+  const float cosw = cos( w0 ), two_sqrt_A_alpha = sqrt( A ) * sin( w0 ) * sqrt( 2.0f );
+  const float sign = high ? -1 : 1;
+
+  const float a0 = ( A + 1 ) + sign * ( A - 1 ) * cosw + two_sqrt_A_alpha;
+  b0 = A * ( ( A + 1 ) - sign * ( A - 1 ) * cosw + two_sqrt_A_alpha ) / a0;
+  b1 = sign * 2 * A * ( ( A - 1 ) - sign * ( A + 1 ) * cosw ) / a0;
+  b2 = A * ( ( A + 1 ) - sign * ( A - 1 ) * cosw - two_sqrt_A_alpha ) / a0;
+  a1 = -sign * 2 * ( ( A - 1 ) + sign * ( A + 1 ) * cosw ) / a0;
+  a2 = ( ( A + 1 ) + sign * ( A - 1 ) * cosw - two_sqrt_A_alpha ) / a0;
+}
+
+void MonitorMix::Biquad::process( span<float> samples )
+{
+  for ( auto& x : samples ) {
+    const float y = b0 * x + z1;
+    z1 = b1 * x - a1 * y + z2;
+    z2 = b2 * x - a2 * y;
+    x = y;
+  }
+}
+
+void MonitorMix::set_strip( const uint8_t channel, const Strip& settings )
+{
+  StripState& strip = strips_.at( channel );
+
+  strip.settings = settings;
+  strip.settings.pan = clamp( settings.pan, -1.0f, 1.0f );
+  strip.settings.ratio = max( settings.ratio, 1.0f );
+
+  strip.left_gain = strip.settings.gain * min( 1.0f, 1 - strip.settings.pan );
+  strip.right_gain = strip.settings.gain * min( 1.0f, 1 + strip.settings.pan );
+
+  const bool eq_enabled = strip.settings.low_shelf_db != 0 or strip.settings.high_shelf_db != 0;
+  if ( not eq_enabled ) {
+    strip.low_shelf = {};
+    strip.high_shelf = {};
+  } else {
+    /* keep the filter state, so changing the EQ mid-stream doesn't click */
+    strip.low_shelf.set_shelf( false, LOW_SHELF_HZ, strip.settings.low_shelf_db );
+    strip.high_shelf.set_shelf( true, HIGH_SHELF_HZ, strip.settings.high_shelf_db );
+  }
+  strip.eq_enabled = eq_enabled;
+}
+
+void MonitorMix::process_strip( StripState& strip,
+                                const span_view<float> input,
+                                span<float> out1,
+                                span<float> out2 )
+{
+  const size_t len = input.size();
+  array<float, MAX_BLOCK> scratch;
+  span<float> x { scratch.data(), len };
+  x.copy( input );
+
+  if ( strip.eq_enabled ) {
+    strip.low_shelf.process( x );
+    strip.high_shelf.process( x );
+  }
+
+  if ( strip.settings.ratio > 1 ) {
+    /* feed-forward, no lookahead: the gain is computed once per block from its peak and ramped across the next */
+    float peak = 0;
+    for ( size_t i = 0; i < len; i++ ) {
+      peak = max( peak, abs( x[i] ) );
+    }
+
+    const float level_db = 20 * log10( max( peak, 0.00001f ) );
+    const float target_db
+      = min( 0.0f, ( strip.settings.threshold_db - level_db ) * ( 1 - 1 / strip.settings.ratio ) );
+    const float time_constant = target_db < strip.reduction_db ? ATTACK_SECONDS : RELEASE_SECONDS;
+    const float decay = exp( -( len / SAMPLE_RATE ) / time_constant );
+    strip.reduction_db = target_db + ( strip.reduction_db - target_db ) * decay;
+    strip.max_reduction_db = min( strip.max_reduction_db, strip.reduction_db );
+  } else {
+    /* bypassed: whatever reduction was left when the compressor was switched off is ramped out across this block */
+    strip.reduction_db = 0;
+  }
+
+  const float start = strip.compressor_gain, end = pow( 10.0f, strip.reduction_db / 20 );
+  if ( start != 1 or end != 1 ) {
+    const float step = ( end - start ) / len;
+    for ( size_t i = 0; i < len; i++ ) {
+      x[i] *= start + step * ( i + 1 );
+    }
+  }
+  strip.compressor_gain = end;
+
+  const float left = strip.left_gain, right = strip.right_gain;
+  for ( size_t i = 0; i < len; i++ ) {
+    out1[i] += left * x[i];
+    out2[i] += right * x[i];
+  }
+}
+
+void MonitorMix::process( const span_view<float> ch1,
+                          const span_view<float> ch2,
+                          span<float> out1,
+                          span<float> out2 )
+{
+  const size_t len = ch1.size();
+  if ( len > MAX_BLOCK or ch2.size() != len or out1.size() != len or out2.size() != len ) {
+    throw runtime_error( "MonitorMix::process: invalid block length" );
+  }
+
+  fill( out1.begin(), out1.end(), 0 );
+  fill( out2.begin(), out2.end(), 0 );
+
+  process_strip( strips_[0], ch1, out1, out2 );
+  process_strip( strips_[1], ch2, out1, out2 );
+}
+
+void MonitorMix::summary( ostream& out ) const
+{
+  out << " monitor=";
+  for ( uint8_t ch = 0; ch < 2; ch++ ) {
+    const StripState& strip = strips_[ch];
+    out << ( ch ? "," : "" ) << strip.settings.gain;
+    if ( strip.settings.pan != 0 ) {
+      out << "@" << strip.settings.pan;
+    }
+    if ( strip.eq_enabled ) {
+      out << " eq=" << strip.settings.low_shelf_db << "/" << strip.settings.high_shelf_db;
+    }
+    if ( strip.settings.ratio > 1 ) {
+      out << " comp<=" << strip.max_reduction_db;
+    }
+  }
+}
+
+void MonitorMix::reset_summary()
+{
+  for ( auto& strip : strips_ ) {
+    strip.max_reduction_db = strip.reduction_db;
+  }
+}
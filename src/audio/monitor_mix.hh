@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+#include "spans.hh"
+
+/* the performer's own monitor: mixes the captured channels straight into the headphone output in the same ALSA
+   wakeup that captured them, so they hear themselves without waiting for the network (or for the server's mix) */
+class MonitorMix
+{
+public:
+  /* longest block processed at once (more than the default ALSA buffer, so a catch-up stays in one block) */
+  static constexpr unsigned int MAX_BLOCK = 256;
+
+  struct Strip
+  {
+    float gain { 2.0 };
+    float pan {}; /* -1 (left only) to +1 (right only); centered plays at full gain on both sides */
+
+    /* effects slot: shelving EQ (0 dB = bypassed) and a compressor (ratio 1 = bypassed) */
+    float low_shelf_db {}, high_shelf_db {};
+    float threshold_db {}, ratio { 1 };
+  };
+
+private:
+  /* transposed direct form II */
+  struct Biquad
+  {
+    float b0 { 1 }, b1 {}, b2 {}, a1 {}, a2 {};
+    float z1 {}, z2 {};
+
+    void set_shelf( const bool high, const float freq, const float db );
+    void process( span<float> samples );
+  };
+
+  struct StripState
+  {
+    Strip settings {};
+    float left_gain { 2.0 }, right_gain { 2.0 };
+    bool eq_enabled {};
+    Biquad low_shelf {}, high_shelf {};
+
+    float reduction_db {}, compressor_gain { 1.0 };
+    float max_reduction_db {};
+  };
+
+  std::array<StripState, 2> strips_ {};
+
+  void process_strip( StripState& strip, const span_view<float> input, span<float> out1, span<float> out2 );
+
+public:
+  const Strip& strip( const uint8_t channel ) const { return strips_.at( channel ).settings; }
+  void set_strip( const uint8_t channel, const Strip& settings );
+
+  /* mixes a block of captured samples (ch1, ch2) into the monitor output (out1, out2); adds no delay */
+  void process( const span_view<float> ch1, const span_view<float> ch2, span<float> out1, span<float> out2 );
+
+  void summary( std::ostream& out ) const;
+  void reset_summary();
+};
@@ -21,6 +21,7 @@ void OpusEncoder::encoder_deleter::operator()( OpusEncoder* x ) const
 
 OpusEncoder::OpusEncoder( const int bit_rate, const int sample_rate, const int channels, const int application )
   : channels_( channels )
+  , application_( application )
 {
   int out;
 
@@ -53,13 +54,61 @@ OpusEncoder::OpusEncoder( const int bit_rate, const int sample_rate, const int c
   */
 }
 
+void OpusEncoder::set_expected_loss( const int loss_percent )
+{
+  opus_check( opus_encoder_ctl( encoder_.get(), OPUS_SET_INBAND_FEC( loss_percent > 0 ) ) );
+  opus_check( opus_encoder_ctl( encoder_.get(), OPUS_SET_PACKET_LOSS_PERC( loss_percent ) ) );
+}
+
+bool OpusEncoder::can_carry_fec( const size_t frame_samples ) const
+{
+  return application_ != OPUS_APPLICATION_RESTRICTED_LOWDELAY and frame_samples >= opus_frame::MAX_SAMPLES;
+}
+
+void OpusEncoder::set_bit_rate( const int bit_rate )
+{
+  opus_check( opus_encoder_ctl( encoder_.get(), OPUS_SET_BITRATE( bit_rate ) ) );
+}
+
+void OpusEncoder::set_complexity( const int complexity )
+{
+  opus_check( opus_encoder_ctl( encoder_.get(), OPUS_SET_COMPLEXITY( complexity ) ) );
+}
+
+void OpusEncoder::set_dtx( const bool enabled )
+{
+  opus_check( opus_encoder_ctl( encoder_.get(), OPUS_SET_DTX( enabled ) ) );
+}
+
+void OpusEncoder::reset_state()
+{
+  opus_check( opus_encoder_ctl( encoder_.get(), OPUS_RESET_STATE ) );
+  last_toc_.reset();
+}
+
+void OpusEncoder::set_prediction( const bool enabled )
+{
+  opus_check( opus_encoder_ctl( encoder_.get(), OPUS_SET_PREDICTION_DISABLED( not enabled ) ) );
+}
+
+bool OpusEncoder::encode_silence( opus_frame& encoded_output ) const
+{
+  if ( not last_toc_.has_value() ) {
+    return false;
+  }
+
+  encoded_output.resize( 1 );
+  encoded_output.mutable_unsigned_data_ptr()[0] = last_toc_.value();
+  return true;
+}
+
 void OpusEncoder::encode( const span_view<float> samples, opus_frame& encoded_output )
 {
   if ( channels_ != 1 ) {
     throw runtime_error( "can't encode mono when channels != 1" );
   }
 
-  if ( samples.size() != opus_frame::NUM_SAMPLES ) {
+  if ( not opus_frame::valid_num_samples( samples.size() ) ) {
     throw runtime_error( "encode: wrong number of samples" );
   }
 
@@ -68,6 +117,7 @@ void OpusEncoder::encode( const span_view<float> samples, opus_frame& encoded_ou
                                                         samples.size(),
                                                         encoded_output.mutable_unsigned_data_ptr(),
                                                         encoded_output.capacity() ) ) );
+  last_toc_ = encoded_output.unsigned_data_ptr()[0];
 }
 
 template<class OpusFrameType>
@@ -79,21 +129,22 @@ void OpusEncoder::encode_stereo( const span_view<float> ch1,
     throw runtime_error( "can't encode stereo when channels != 2" );
   }
 
-  array<pair<float, float>, OpusFrameType::NUM_SAMPLES> interleave_buffer;
+  array<pair<float, float>, opus_frame::MAX_SAMPLES> interleave_buffer;
 
-  if ( ch1.size() != OpusFrameType::NUM_SAMPLES or ch2.size() != OpusFrameType::NUM_SAMPLES ) {
+  if ( ch1.size() != ch2.size() or not opus_frame::valid_num_samples( ch1.size() ) ) {
     throw runtime_error( "encode_stereo: wrong number of samples" );
   }
 
-  for ( unsigned int i = 0; i < OpusFrameType::NUM_SAMPLES; i++ ) {
+  for ( unsigned int i = 0; i < ch1.size(); i++ ) {
     interleave_buffer[i] = { ch1[i], ch2[i] };
   }
 
   encoded_output.resize( opus_check( opus_encode_float( encoder_.get(),
                                                         &interleave_buffer[0].first,
-                                                        OpusFrameType::NUM_SAMPLES,
+                                                        ch1.size(),
                                                         encoded_output.mutable_unsigned_data_ptr(),
                                                         encoded_output.capacity() ) ) );
+  last_toc_ = encoded_output.unsigned_data_ptr()[0];
 }
 
 template void OpusEncoder::encode_stereo( const span_view<float>, const span_view<float>, opus_frame& );
@@ -119,7 +170,7 @@ void OpusDecoder::decode( const opus_frame& encoded_input, span<float> samples )
     throw runtime_error( "can't decode mono when channels != 1" );
   }
 
-  if ( samples.size() != opus_frame::NUM_SAMPLES ) {
+  if ( not opus_frame::valid_num_samples( samples.size() ) ) {
     throw runtime_error( "decode: wrong number of samples" );
   }
 
@@ -130,7 +181,7 @@ void OpusDecoder::decode( const opus_frame& encoded_input, span<float> samples )
                                                                 samples.size(),
                                                                 0 ) );
 
-  if ( samples_written != opus_frame::NUM_SAMPLES ) {
+  if ( samples_written != samples.size() ) {
     throw runtime_error( "invalid count from opus_decode_float: " + to_string( samples_written ) );
   }
 }
@@ -141,9 +192,9 @@ void OpusDecoder::decode_stereo( const opus_frame& encoded_input, span<float> ch
     throw runtime_error( "can't decode stereo when channels != 2" );
   }
 
-  array<pair<float, float>, opus_frame::NUM_SAMPLES> interleave_buffer;
+  array<pair<float, float>, opus_frame::MAX_SAMPLES> interleave_buffer;
 
-  if ( ch1.size() != opus_frame::NUM_SAMPLES or ch2.size() != opus_frame::NUM_SAMPLES ) {
+  if ( ch1.size() != ch2.size() or not opus_frame::valid_num_samples( ch1.size() ) ) {
     throw runtime_error( "decode_stereo: wrong number of samples" );
   }
 
@@ -151,14 +202,14 @@ void OpusDecoder::decode_stereo( const opus_frame& encoded_input, span<float> ch
                                                                 encoded_input.unsigned_data_ptr(),
                                                                 encoded_input.length(),
                                                                 &interleave_buffer[0].first,
-                                                                interleave_buffer.size(),
+                                                                ch1.size(),
                                                                 0 ) );
 
-  if ( samples_written != opus_frame::NUM_SAMPLES ) {
+  if ( samples_written != ch1.size() ) {
     throw runtime_error( "invalid count from opus_decode_float: " + to_string( samples_written ) );
   }
 
-  for ( unsigned int i = 0; i < opus_frame::NUM_SAMPLES; i++ ) {
+  for ( unsigned int i = 0; i < ch1.size(); i++ ) {
     tie( ch1[i], ch2[i] ) = interleave_buffer[i];
   }
 }
@@ -169,10 +220,14 @@ void OpusDecoder::decode_missing( span<float> samples )
     throw runtime_error( "can't decode_missing mono when channels != 1" );
   }
 
+  if ( not opus_frame::valid_num_samples( samples.size() ) ) {
+    throw runtime_error( "decode_missing: wrong number of samples" );
+  }
+
   const size_t samples_written
     = opus_check( opus_decode_float( decoder_.get(), nullptr, 0, samples.mutable_data(), samples.size(), 0 ) );
 
-  if ( samples_written != opus_frame::NUM_SAMPLES ) {
+  if ( samples_written != samples.size() ) {
     throw runtime_error( "invalid count from opus_decode_float: " + to_string( samples_written ) );
   }
 }
@@ -183,20 +238,70 @@ void OpusDecoder::decode_missing_stereo( span<float> ch1, span<float> ch2 )
     throw runtime_error( "can't decode_missing stereo when channels != 1" );
   }
 
-  array<pair<float, float>, opus_frame::NUM_SAMPLES> interleave_buffer;
+  array<pair<float, float>, opus_frame::MAX_SAMPLES> interleave_buffer;
 
-  if ( ch1.size() != opus_frame::NUM_SAMPLES or ch2.size() != opus_frame::NUM_SAMPLES ) {
+  if ( ch1.size() != ch2.size() or not opus_frame::valid_num_samples( ch1.size() ) ) {
     throw runtime_error( "decode_missing_stereo: wrong number of samples" );
   }
 
   const size_t samples_written = opus_check(
-    opus_decode_float( decoder_.get(), nullptr, 0, &interleave_buffer[0].first, interleave_buffer.size(), 0 ) );
+    opus_decode_float( decoder_.get(), nullptr, 0, &interleave_buffer[0].first, ch1.size(), 0 ) );
+
+  if ( samples_written != ch1.size() ) {
+    throw runtime_error( "invalid count from opus_decode_float: " + to_string( samples_written ) );
+  }
+
+  for ( unsigned int i = 0; i < ch1.size(); i++ ) {
+    tie( ch1[i], ch2[i] ) = interleave_buffer[i];
+  }
+}
+
+void OpusDecoder::decode_fec( const opus_frame& next_input, span<float> samples )
+{
+  if ( channels_ != 1 ) {
+    throw runtime_error( "can't decode_fec mono when channels != 1" );
+  }
+
+  if ( not opus_frame::valid_num_samples( samples.size() ) ) {
+    throw runtime_error( "decode_fec: wrong number of samples" );
+  }
+
+  const size_t samples_written = opus_check( opus_decode_float( decoder_.get(),
+                                                                next_input.unsigned_data_ptr(),
+                                                                next_input.length(),
+                                                                samples.mutable_data(),
+                                                                samples.size(),
+                                                                1 ) );
+
+  if ( samples_written != samples.size() ) {
+    throw runtime_error( "invalid count from opus_decode_float: " + to_string( samples_written ) );
+  }
+}
+
+void OpusDecoder::decode_fec_stereo( const opus_frame& next_input, span<float> ch1, span<float> ch2 )
+{
+  if ( channels_ != 2 ) {
+    throw runtime_error( "can't decode_fec stereo when channels != 2" );
+  }
+
+  array<pair<float, float>, opus_frame::MAX_SAMPLES> interleave_buffer;
+
+  if ( ch1.size() != ch2.size() or not opus_frame::valid_num_samples( ch1.size() ) ) {
+    throw runtime_error( "decode_fec_stereo: wrong number of samples" );
+  }
+
+  const size_t samples_written = opus_check( opus_decode_float( decoder_.get(),
+                                                                next_input.unsigned_data_ptr(),
+                                                                next_input.length(),
+                                                                &interleave_buffer[0].first,
+                                                                ch1.size(),
+                                                                1 ) );
 
-  if ( samples_written != opus_frame::NUM_SAMPLES ) {
+  if ( samples_written != ch1.size() ) {
     throw runtime_error( "invalid count from opus_decode_float: " + to_string( samples_written ) );
   }
 
-  for ( unsigned int i = 0; i < opus_frame::NUM_SAMPLES; i++ ) {
+  for ( unsigned int i = 0; i < ch1.size(); i++ ) {
     tie( ch1[i], ch2[i] ) = interleave_buffer[i];
   }
 }
@@ -1,17 +1,31 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <opus/opus.h>
 
 #include "stackbuffer.hh"
 
-class opus_frame : public StackBuffer<0, uint8_t, 60>
+/* an Opus frame of 2.5, 5 or 10 ms (negotiated per session; room for 96 kbit/s at 10 ms) */
+class opus_frame : public StackBuffer<0, uint8_t, 120>
 {
 public:
-  static constexpr unsigned int NUM_SAMPLES = 120; /* 2.5 ms at 48 kHz */
+  static constexpr unsigned int NUM_SAMPLES = 120; /* 2.5 ms at 48 kHz: the shortest frame, and the server tick */
+  static constexpr unsigned int MAX_SAMPLES = 480; /* 10 ms */
+
+  static constexpr bool valid_num_samples( const size_t num_samples )
+  {
+    return num_samples == NUM_SAMPLES or num_samples == 2 * NUM_SAMPLES or num_samples == 4 * NUM_SAMPLES;
+  }
+
+  /* could this packet carry in-band FEC for the one before it? (only SILK and hybrid packets do) */
+  bool may_carry_fec() const { return length() > 0 and ( unsigned_data_ptr()[0] >> 3 ) < 16; }
+
+  /* a DTX packet (no payload beyond the TOC byte): the decoder just conceals */
+  bool is_dtx() const { return length() <= 2; }
 };
 
-static_assert( sizeof( opus_frame ) == 61 );
+static_assert( sizeof( opus_frame ) == 121 );
 
 class big_opus_frame : public StackBuffer<0, uint8_t, 240>
 {
@@ -28,9 +42,33 @@ class OpusEncoder
 
   std::unique_ptr<OpusEncoder, encoder_deleter> encoder_ {};
   uint8_t channels_;
+  int application_;
+  std::optional<uint8_t> last_toc_ {};
 
 public:
   OpusEncoder( const int bit_rate, const int sample_rate, const int channels, const int application );
+
+  /* embed in-band FEC sized for this much packet loss (0 turns it off) */
+  void set_expected_loss( const int loss_percent );
+
+  /* can frames of this duration carry in-band FEC at all? only SILK and hybrid packets do, which need 10 ms frames
+     and which RESTRICTED_LOWDELAY never makes (it is CELT only) */
+  bool can_carry_fec( const size_t frame_samples ) const;
+
+  void set_bit_rate( const int bit_rate );
+  void set_complexity( const int complexity ); /* 0 (cheapest) to 10 */
+  void set_dtx( const bool enabled );
+
+  /* forget the audio encoded so far (keeps the settings) */
+  void reset_state();
+
+  /* when disabled, frames are coded without reference to the ones before them (no energy prediction or pitch
+     prefilter), so they decode the same whatever the decoder last saw */
+  void set_prediction( const bool enabled );
+
+  /* a DTX packet in the current configuration, without running the encoder (false if nothing encoded yet) */
+  bool encode_silence( opus_frame& encoded_output ) const;
+
   void encode( const span_view<float> samples, opus_frame& encoded_output );
 
   template<class OpusFrameType>
@@ -53,4 +91,8 @@ public:
   void decode_stereo( const opus_frame& encoded_input, span<float> ch1, span<float> ch2 );
   void decode_missing( span<float> samples );
   void decode_missing_stereo( span<float> ch1, span<float> ch2 );
+
+  /* reconstruct a missing frame from the in-band FEC in the frame after it (plain PLC if there is none) */
+  void decode_fec( const opus_frame& next_input, span<float> samples );
+  void decode_fec_stereo( const opus_frame& next_input, span<float> ch1, span<float> ch2 );
 };
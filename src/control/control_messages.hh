@@ -225,3 +225,34 @@ struct atomic_scene_update : public control_message<7>
     p.object( insertions );
   }
 };
+
+struct set_monitor : public control_message<8>
+{
+  uint8_t channel {};
+  float gain {}, pan {};
+  float low_shelf_db {}, high_shelf_db {};
+  float threshold_db {}, ratio {};
+
+  static constexpr uint32_t serialized_length() { return sizeof( channel ) + 6 * sizeof( float ); }
+
+  void serialize( Serializer& s ) const
+  {
+    s.integer( channel );
+    s.floating( gain );
+    s.floating( pan );
+    s.floating( low_shelf_db );
+    s.floating( high_shelf_db );
+    s.floating( threshold_db );
+    s.floating( ratio );
+  }
+  void parse( Parser& p )
+  {
+    p.integer( channel );
+    p.floating( gain );
+    p.floating( pan );
+    p.floating( low_shelf_db );
+    p.floating( high_shelf_db );
+    p.floating( threshold_db );
+    p.floating( ratio );
+  }
+};
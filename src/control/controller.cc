@@ -44,6 +44,21 @@ ClientController::ClientController( shared_ptr<NetworkClient> client,
         }
         audio_device_->set_loopback_gain( my_gain.gain1 );
       } break;
+
+      case set_monitor::id: {
+        set_monitor my_monitor;
+        parser.object( my_monitor );
+        if ( parser.error() or my_monitor.channel > 1 ) {
+          return;
+        }
+        audio_device_->monitor().set_strip( my_monitor.channel,
+                                            { my_monitor.gain,
+                                              my_monitor.pan,
+                                              my_monitor.low_shelf_db,
+                                              my_monitor.high_shelf_db,
+                                              my_monitor.threshold_db,
+                                              my_monitor.ratio } );
+      } break;
     }
   } );
 }
@@ -184,9 +184,9 @@ void VideoDisplay::draw( RasterYUV422& image )
     throw runtime_error( "inconsistent raster dimensions." );
   }
 
-  Y_.load( image.Y(), GL_TEXTURE0 );
-  Cb_.load( image.Cb(), GL_TEXTURE1 );
-  Cr_.load( image. Cr(), GL_TEXTURE2 );
+  Y_.load( image.Y(), GL_TEXTURE0, image.Y_stride() );
+  Cb_.load( image.Cb(), GL_TEXTURE1, image.chroma_stride() );
+  Cr_.load( image.Cr(), GL_TEXTURE2, image.chroma_stride() );
   repaint();
 }
 
@@ -196,9 +196,9 @@ void VideoDisplay::draw( RasterYUV420& image )
     throw runtime_error( "inconsistent raster dimensions." );
   }
 
-  Y_.load( image.Y(), GL_TEXTURE0 );
-  Cb_.load( image.Cb(), GL_TEXTURE1 );
-  Cr_.load( image. Cr(), GL_TEXTURE2 );
+  Y_.load( image.Y(), GL_TEXTURE0, image.Y_stride() );
+  Cb_.load( image.Cb(), GL_TEXTURE1, image.chroma_stride() );
+  Cr_.load( image.Cr(), GL_TEXTURE2, image.chroma_stride() );
   repaint();
 }
 
@@ -127,11 +127,11 @@ void Texture::bind( const GLenum texture_unit ) const
   glTexParameteri( GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 }
 
-void Texture::load( const vector<uint8_t>& raster, const GLenum texture_unit )
+void Texture::load( const span_view<uint8_t> raster, const GLenum texture_unit, const unsigned int row_length )
 {
   bind( texture_unit );
 
-  glPixelStorei( GL_UNPACK_ROW_LENGTH, width_ );
+  glPixelStorei( GL_UNPACK_ROW_LENGTH, row_length );
   glTexImage2D( GL_TEXTURE_RECTANGLE, 0, GL_RGBA8, width_, height_, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr );
   glTexSubImage2D(
     GL_TEXTURE_RECTANGLE_ARB, 0, 0, 0, width_, height_, GL_LUMINANCE, GL_UNSIGNED_BYTE, &( raster.at( 0 ) ) );
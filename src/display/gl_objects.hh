@@ -35,6 +35,8 @@
 #include <string>
 #include <vector>
 
+#include "spans.hh"
+
 class GLFWContext
 {
   static void error_callback( const int, const char* const description );
@@ -156,7 +158,7 @@ public:
   ~Texture() { glDeleteTextures( 1, &num_ ); }
 
   void bind( const GLenum texture_unit ) const;
-  void load( const std::vector<uint8_t>& raster, const GLenum texture_unit );
+  void load( const span_view<uint8_t> raster, const GLenum texture_unit, const unsigned int row_length );
   unsigned int width() const { return width_; }
   unsigned int height() const { return height_; }
 
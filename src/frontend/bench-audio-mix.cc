@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "audioboard.hh"
+#include "timer.hh"
+
+using namespace std;
+
+/* each tick's mix-minus for every client on a board (each client owning two channels, all channels audible),
+   made two ways: the per-channel loop Client::mix_and_encode used to run, and AudioBoard::stage_block plus
+   mix_into per client; reports CPU per tick for each and the largest difference between their samples */
+
+static constexpr uint64_t TICKS = 20000;
+
+/* the loop Client::mix_and_encode ran before the board staged its blocks */
+static void old_mix_minus( const AudioBoard& board,
+                           const uint64_t block,
+                           span<float> ch1_target,
+                           span<float> ch2_target,
+                           const uint8_t ch1_num,
+                           const uint8_t ch2_num )
+{
+  for ( uint8_t channel_i = 0; channel_i < board.num_channels(); channel_i++ ) {
+    if ( channel_i == ch1_num or channel_i == ch2_num
+         or not board.audible( channel_i, block, opus_frame::NUM_SAMPLES ) ) {
+      continue;
+    }
+
+    const span_view<float> other_channel = board.channel( channel_i ).region( block, opus_frame::NUM_SAMPLES );
+
+    const auto [gain_into_1, gain_into_2] = board.gain( channel_i );
+    for ( uint8_t sample_i = 0; sample_i < opus_frame::NUM_SAMPLES; sample_i++ ) {
+      const float value = other_channel[sample_i];
+      const float orig_1 = ch1_target[sample_i];
+      const float orig_2 = ch2_target[sample_i];
+
+      ch1_target[sample_i] = orig_1 + gain_into_1 * value;
+      ch2_target[sample_i] = orig_2 + gain_into_2 * value;
+    }
+  }
+}
+
+static void measure( const uint8_t num_channels )
+{
+  const uint8_t num_clients = num_channels / 2;
+
+  AudioBoard board { "board", num_channels };
+  for ( uint8_t channel = 0; channel < num_channels; channel++ ) {
+    board.set_gain( channel, 0.5 + 0.1 * channel, 1.5 - 0.05 * channel );
+  }
+
+  ChannelPair old_mix { 8192 }, new_mix { 8192 };
+  double old_seconds = 0, new_seconds = 0;
+  float max_difference = 0;
+
+  for ( uint64_t block = 0; block < TICKS * opus_frame::NUM_SAMPLES; block += opus_frame::NUM_SAMPLES ) {
+    for ( uint8_t channel = 0; channel < num_channels; channel++ ) {
+      for ( uint64_t i = block; i < block + opus_frame::NUM_SAMPLES; i++ ) {
+        board.channel( channel ).at( i ) = 0.5 * sin( 0.001 * i * ( channel + 1 ) );
+      }
+    }
+
+    const uint64_t new_start = Timer::timestamp_ns();
+    board.stage_block( block );
+    for ( uint8_t client = 0; client < num_clients; client++ ) {
+      span<float> ch1_target = new_mix.ch1().region( block, opus_frame::NUM_SAMPLES );
+      span<float> ch2_target = new_mix.ch2().region( block, opus_frame::NUM_SAMPLES );
+      fill( ch1_target.begin(), ch1_target.end(), 0 );
+      fill( ch2_target.begin(), ch2_target.end(), 0 );
+      board.mix_into( block, ch1_target, ch2_target, 2 * client, 2 * client + 1 );
+    }
+    new_seconds += ( Timer::timestamp_ns() - new_start ) / BILLION;
+
+    const uint64_t old_start = Timer::timestamp_ns();
+    for ( uint8_t client = 0; client < num_clients; client++ ) {
+      span<float> ch1_target = old_mix.ch1().region( block, opus_frame::NUM_SAMPLES );
+      span<float> ch2_target = old_mix.ch2().region( block, opus_frame::NUM_SAMPLES );
+      fill( ch1_target.begin(), ch1_target.end(), 0 );
+      fill( ch2_target.begin(), ch2_target.end(), 0 );
+      old_mix_minus( board, block, ch1_target, ch2_target, 2 * client, 2 * client + 1 );
+    }
+    old_seconds += ( Timer::timestamp_ns() - old_start ) / BILLION;
+
+    /* the last client's mix is what's left in both */
+    for ( uint64_t i = block; i < block + opus_frame::NUM_SAMPLES; i++ ) {
+      max_difference = max( { max_difference,
+                              abs( old_mix.ch1().at( i ) - new_mix.ch1().at( i ) ),
+                              abs( old_mix.ch2().at( i ) - new_mix.ch2().at( i ) ) } );
+    }
+
+    old_mix.pop_before( block );
+    new_mix.pop_before( block );
+    board.pop_samples_until( block + opus_frame::NUM_SAMPLES > 960 ? block + opus_frame::NUM_SAMPLES - 960 : 0 );
+  }
+
+  cout << setw( 3 ) << int( num_channels ) << " channels, " << setw( 2 ) << int( num_clients ) << " clients: "
+       << fixed << setprecision( 2 ) << setw( 6 ) << old_seconds * 1e6 / TICKS << " -> " << setw( 5 )
+       << new_seconds * 1e6 / TICKS << " us/tick (" << setprecision( 1 ) << old_seconds / new_seconds
+       << "x), largest difference " << scientific << setprecision( 1 ) << max_difference << defaultfloat << "\n";
+}
+
+void program_body()
+{
+  for ( const uint8_t num_channels : { 8, 16, 32, 64 } ) {
+    measure( num_channels );
+  }
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << "\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc != 1 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
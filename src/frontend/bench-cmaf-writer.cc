@@ -0,0 +1,205 @@
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "cmaf_writer.hh"
+#include "mp4writer.hh"
+#include "rendition.hh"
+#include "timer.hh"
+
+using namespace std;
+
+/* the camera server's two fragmenters over the same recorded stream: CMAFWriter and libavformat (MP4Writer),
+   each writing one fragment per access unit; reports the time per frame and the bytes each spends on boxes
+   (everything but the mdat payloads), for the init segment and per frame */
+
+static uint8_t nal_type( const string_view stream, const size_t payload )
+{
+  return payload < stream.size() ? stream[payload] & 0x1f : 0;
+}
+
+/* splits an Annex B stream into access units, each starting with a four-byte start code like the encoder's
+   output (as in bench-segment-cache) */
+static vector<string> access_units( const string_view stream )
+{
+  vector<string> ret;
+  string current;
+  bool current_has_slice = false;
+
+  size_t pos = stream.find( string_view( "\0\0\1", 3 ) );
+  while ( pos != string_view::npos ) {
+    const size_t payload = pos + 3;
+    const size_t next = stream.find( string_view( "\0\0\1", 3 ), payload );
+
+    size_t end = next == string_view::npos ? stream.size() : next;
+    while ( end > payload and stream[end - 1] == 0 ) {
+      end--;
+    }
+
+    const uint8_t type = nal_type( stream, payload );
+    const bool slice = type == 1 or type == 5;
+    const bool first_slice = slice and payload + 1 < stream.size() and ( stream[payload + 1] & 0x80 );
+    if ( ( type == 9 or type == 7 or first_slice ) and current_has_slice ) {
+      ret.push_back( move( current ) );
+      current.clear();
+      current_has_slice = false;
+    }
+
+    current.append( string_view( "\0\0\0\1", 4 ) );
+    current.append( stream.substr( payload, end - payload ) );
+    current_has_slice |= slice;
+
+    pos = next;
+  }
+
+  if ( current_has_slice ) {
+    ret.push_back( move( current ) );
+  }
+  return ret;
+}
+
+struct Overhead
+{
+  size_t init {};          /* boxes before the first moof (ftyp + moov) */
+  size_t idr {}, frame {}; /* box bytes in fragments starting with an IDR, and in the rest */
+  size_t idrs {}, frames {};
+  size_t payload {}; /* mdat payloads */
+};
+
+static uint32_t read_u32( const string_view s, const size_t pos )
+{
+  const auto* p = reinterpret_cast<const uint8_t*>( s.data() + pos );
+  return ( uint32_t( p[0] ) << 24 ) | ( uint32_t( p[1] ) << 16 ) | ( uint32_t( p[2] ) << 8 ) | uint32_t( p[3] );
+}
+
+/* walks the top-level boxes of one access unit's output */
+static void count_boxes( const string_view output, const bool idr, Overhead& overhead )
+{
+  bool fragment = false;
+  size_t boxes = 0;
+  for ( size_t pos = 0; pos < output.size(); ) {
+    const size_t size = pos + 8 <= output.size() ? read_u32( output, pos ) : 0;
+    if ( size < 8 or pos + size > output.size() ) {
+      throw runtime_error( "malformed box at offset " + to_string( pos ) );
+    }
+
+    const string_view type = output.substr( pos + 4, 4 );
+    fragment |= type == "moof";
+    if ( type == "mdat" ) {
+      overhead.payload += size - 8;
+      boxes += 8;
+    } else if ( fragment ) {
+      boxes += size;
+    } else {
+      overhead.init += size;
+    }
+    pos += size;
+  }
+
+  if ( not fragment ) {
+    throw runtime_error( "no fragment for an access unit" );
+  }
+  ( idr ? overhead.idr : overhead.frame ) += boxes;
+  ( idr ? overhead.idrs : overhead.frames )++;
+}
+
+/* muxes the whole stream; returns seconds spent in the writer */
+template<class Writer>
+static double run( const vector<string>& stream, Overhead& overhead )
+{
+  const auto& rendition = camera_renditions.at( 0 );
+  Writer writer { rendition.fps, rendition.width, rendition.height };
+
+  double seconds = 0;
+  for ( uint32_t frame_no = 0; frame_no < stream.size(); frame_no++ ) {
+    const string& access_unit = stream[frame_no];
+    const uint64_t start = Timer::timestamp_ns();
+    if constexpr ( is_same_v<Writer, MP4Writer> ) {
+      writer.write( access_unit, frame_no, frame_no );
+    } else {
+      writer.write( access_unit, frame_no );
+    }
+    seconds += ( Timer::timestamp_ns() - start ) / BILLION;
+
+    count_boxes( writer.output().readable_region(), MP4Writer::is_idr( access_unit ), overhead );
+    writer.output().pop( writer.output().readable_region().size() );
+  }
+
+  if constexpr ( is_same_v<Writer, CMAFWriter> ) {
+    overhead.init += writer.init_segment().size(); /* handed out separately, not in the output */
+  }
+  return seconds;
+}
+
+template<class Writer>
+static void measure( const string_view name, const vector<string>& stream, const size_t stream_bytes )
+{
+  Overhead warm_up;
+  run<Writer>( stream, warm_up );
+
+  Overhead overhead;
+  const double seconds = run<Writer>( stream, overhead );
+
+  cout << name << ": " << fixed << setprecision( 2 ) << seconds * 1e6 / stream.size() << " us/frame\n";
+  cout << "   init segment: " << overhead.init << " bytes\n";
+  cout << "   boxes: " << setprecision( 1 ) << double( overhead.idr ) / max( size_t( 1 ), overhead.idrs )
+       << " bytes per IDR fragment, " << double( overhead.frame ) / max( size_t( 1 ), overhead.frames )
+       << " per other fragment (" << setprecision( 3 ) << 100.0 * ( overhead.idr + overhead.frame ) / stream_bytes
+       << "% of the stream)\n";
+  cout << "   mdat payload: " << overhead.payload << " bytes\n";
+}
+
+void program_body( const string& filename )
+{
+  ifstream file { filename, ios::binary };
+  if ( not file ) {
+    throw runtime_error( "can't open " + filename );
+  }
+  stringstream contents;
+  contents << file.rdbuf();
+
+  const vector<string> stream = access_units( contents.str() );
+  if ( stream.empty() or not MP4Writer::is_idr( stream.front() ) ) {
+    throw runtime_error( filename + ": expected an H.264 stream starting with an IDR (SPS first)" );
+  }
+
+  size_t stream_bytes = 0;
+  for ( const auto& access_unit : stream ) {
+    stream_bytes += access_unit.size();
+  }
+  cout << filename << ": " << stream.size() << " access units, " << stream_bytes << " bytes\n";
+
+  measure<MP4Writer>( "libavformat", stream, stream_bytes );
+  measure<CMAFWriter>( "CMAFWriter", stream, stream_bytes );
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " STREAM.h264\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc != 2 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body( argv[1] );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
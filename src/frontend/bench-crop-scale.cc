@@ -0,0 +1,113 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "crop.hh"
+#include "crop_scale.hh"
+#include "scale.hh"
+#include "timer.hh"
+
+using namespace std;
+
+/* frames per second through the camera client's "scale frame" step: the old Cropper (painting the margins into
+   the camera raster) followed by Scaler, vs. CropScaler in one pass, for a crop alone (no swscale) and for a
+   crop with a zoom */
+
+struct Window
+{
+  uint16_t x, y, width, height;
+};
+
+static void fill( RasterYUV422& raster )
+{
+  for ( uint16_t row = 0; row < raster.height(); row++ ) {
+    for ( uint16_t col = 0; col < raster.width(); col++ ) {
+      raster.Y( col, row ) = row * 3 + col;
+    }
+    for ( uint16_t col = 0; col < raster.chroma_width(); col++ ) {
+      raster.Cb( col, row ) = row + col * 2;
+      raster.Cr( col, row ) = row * 2 - col;
+    }
+  }
+}
+
+static size_t checksum( const RasterYUV420& raster )
+{
+  size_t ret = 0;
+  for ( uint16_t row = 0; row < raster.height(); row++ ) {
+    for ( uint16_t col = 0; col < raster.width(); col++ ) {
+      ret = ret * 31 + raster.Y( col, row );
+    }
+  }
+  return ret;
+}
+
+template<class Function>
+static void measure( const string_view name, const unsigned int iterations, Function&& function )
+{
+  const uint64_t start = Timer::timestamp_ns();
+  for ( unsigned int i = 0; i < iterations; i++ ) {
+    function();
+  }
+  const double seconds = ( Timer::timestamp_ns() - start ) / BILLION;
+
+  cout << setw( 28 ) << name << ": " << fixed << setprecision( 0 ) << iterations / seconds << " frames/s ("
+       << setprecision( 2 ) << seconds * 1e6 / iterations << " us each)\n";
+}
+
+void program_body( const unsigned int iterations )
+{
+  RasterYUV422 source { 1280, 720 };
+  fill( source );
+  RasterYUV420 output { 1280, 720 };
+
+  for ( const auto& [label, window] : { pair { "crop", Window { 0, 0, 1280, 720 } },
+                                        pair { "crop + zoom", Window { 160, 90, 960, 540 } } } ) {
+    Cropper cropper;
+    Scaler scaler;
+    cropper.setup( 100, 60, 40, 20 );
+    scaler.setup( window.x, window.y, window.width, window.height );
+
+    /* the old path painted into the camera's raster, so it works on a copy here */
+    RasterYUV422 camera_raster = source;
+    measure( string( label ) + ": Cropper + Scaler", iterations, [&] {
+      cropper.crop( camera_raster );
+      scaler.scale( camera_raster, output );
+    } );
+    const size_t old_checksum = checksum( output );
+
+    CropScaler crop_scaler;
+    crop_scaler.setup_crop( 100, 60, 40, 20 );
+    crop_scaler.setup_zoom( window.x, window.y, window.width, window.height );
+    measure( string( label ) + ": CropScaler", iterations, [&] { crop_scaler.process( source, output ); } );
+
+    cout << setw( 28 ) << "" << "  (luma " << ( checksum( output ) == old_checksum ? "matches" : "differs" )
+         << ")\n";
+  }
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " [iterations]\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc > 2 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body( argc == 2 ? stoul( argv[1] ) : 1000 );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,213 @@
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "crypto.hh"
+#include "cursor.hh"
+#include "networkclient.hh"
+#include "receiver.hh"
+#include "sender.hh"
+
+using namespace std;
+
+/* what each Opus frame duration costs: header bytes per packet and per second (one fresh frame and one SACK,
+   encrypted, plus IPv4 and UDP) at a few bit rates; and, running a session end to end (OpusEncoderProcess ->
+   NetworkSender -> encrypted bytes -> NetworkReceiver -> Cursor with its default lag -> OpusDecoderProcess), the
+   delay from a tone burst's onset in the capture to its onset in the playback, with no network delay or loss */
+
+static constexpr size_t UDP_IP_HEADER_BYTES = 28;
+static constexpr uint64_t STREAM_LENGTH = 48000 * 20;
+static constexpr uint64_t BURST_PERIOD = 9600; /* 200 ms */
+static constexpr uint64_t BURST_LENGTH = 2400;
+static constexpr float ONSET_THRESHOLD = 0.1;
+
+/* a 1 kHz burst every 200 ms, with silence between */
+static float capture_sample( const uint64_t i )
+{
+  return i % BURST_PERIOD < BURST_LENGTH ? 0.5 * sin( 2 * M_PI * 1000 * i / 48000.0 ) : 0;
+}
+
+static size_t wire_length( CryptoSession& crypto, const Packet<AudioFrame>& pack )
+{
+  Plaintext plaintext;
+  Serializer s { plaintext.mutable_buffer() };
+  pack.serialize( s );
+  plaintext.resize( s.bytes_written() );
+
+  const char node_id = 0;
+  Ciphertext ciphertext;
+  crypto.encrypt( { &node_id, 1 }, plaintext, ciphertext );
+  return ciphertext.length() + UDP_IP_HEADER_BYTES; /* the ciphertext carries the nonce and node ID */
+}
+
+static void measure_overhead( const uint16_t frame_samples )
+{
+  const Base64Key key;
+  CryptoSession crypto { key, key };
+
+  for ( const int bit_rate : { 96000, 64000, 32000 } ) {
+    AudioFrame frame;
+    frame.frame1.resize( bit_rate / 8 * frame_samples / 48000 );
+
+    Packet<AudioFrame> pack;
+    pack.sender_section.frames.push_back( frame );
+    pack.receiver_section.packets_received.push_back( 1 );
+
+    const size_t wire = wire_length( crypto, pack );
+    const size_t overhead = wire - frame.frame1.length();
+    const double packets_per_second = 48000.0 / frame_samples;
+    cout << "   " << setw( 2 ) << bit_rate / 1000 << " kbit/s: " << setw( 3 ) << wire << " bytes/packet, "
+         << fixed << setprecision( 0 ) << packets_per_second << " packets/s, overhead " << setprecision( 1 )
+         << setw( 5 ) << overhead * 8 * packets_per_second / 1000 << " kbit/s (" << setprecision( 0 )
+         << 100.0 * overhead / wire << "% of the wire)\n";
+  }
+}
+
+static void measure_latency( const uint16_t frame_samples )
+{
+  const Base64Key uplink, downlink;
+  CryptoSession sender_crypto { uplink, downlink }, receiver_crypto { downlink, uplink };
+
+  OpusEncoderProcess encoder { 96000, 48000 };
+  encoder.set_frame_samples( frame_samples );
+  NetworkSender<AudioFrame> sender;
+
+  NetworkReceiver<AudioFrame> receiver;
+  Cursor cursor { 960, 120, 1920, frame_samples }; /* as NetworkClient::NetworkSession */
+  OpusDecoderProcess decoder { false };
+  const auto stretcher = TimeScaler::make( TimeScaler::Kind::WSOLA, true );
+
+  ChannelPair capture { 8192 }, playback { 8192 };
+  size_t packets = 0, wire_bytes = 0, decode_cursor = 0;
+  vector<int64_t> delays;
+  optional<uint64_t> burst_out;
+
+  for ( uint64_t block = 0; block < STREAM_LENGTH; block += opus_frame::NUM_SAMPLES ) {
+    for ( uint64_t i = block; i < block + opus_frame::NUM_SAMPLES; i++ ) {
+      capture.safe_set( i, { capture_sample( i ), capture_sample( i ) } );
+    }
+
+    /* the sender's side, as NetworkClient::NetworkSession::transmit_frame */
+    while ( encoder.min_encode_cursor() + frame_samples <= block + opus_frame::NUM_SAMPLES ) {
+      encoder.encode_one_frame( capture.ch1(), capture.ch2() );
+      capture.pop_before( encoder.min_encode_cursor() );
+      sender.push_frame( encoder );
+
+      Packet<AudioFrame> pack;
+      sender.set_sender_section( pack.sender_section );
+      receiver.set_receiver_section( pack.receiver_section );
+
+      Plaintext plaintext;
+      Serializer s { plaintext.mutable_buffer() };
+      pack.serialize( s );
+      plaintext.resize( s.bytes_written() );
+
+      const char node_id = 0;
+      Ciphertext ciphertext;
+      sender_crypto.encrypt( { &node_id, 1 }, plaintext, ciphertext );
+      packets++;
+      wire_bytes += ciphertext.length() + UDP_IP_HEADER_BYTES;
+
+      /* the receiver's side, acking at once */
+      Plaintext received;
+      if ( not receiver_crypto.decrypt( ciphertext, { &node_id, 1 }, received ) ) {
+        throw runtime_error( "decryption failed" );
+      }
+      Parser p { received };
+      const Packet<AudioFrame> parsed { p };
+      if ( p.error() ) {
+        throw runtime_error( "parse error" );
+      }
+      receiver.receive_sender_section( parsed.sender_section );
+
+      Packet<AudioFrame> ack;
+      receiver.set_receiver_section( ack.receiver_section );
+      sender.receive_receiver_section( ack.receiver_section );
+    }
+
+    /* playback of the next block, as NetworkClient::NetworkSession::decode */
+    decode_cursor += opus_frame::NUM_SAMPLES;
+    const size_t frontier_sample_index = receiver.unreceived_beyond_this_frame_index() * frame_samples;
+    cursor.setup( decode_cursor, frontier_sample_index );
+    if ( cursor.initialized() ) {
+      cursor.sample_into(
+        receiver.frames(), frontier_sample_index, decoder, *stretcher, decode_cursor, playback.ch1(), playback.ch2() );
+    }
+    receiver.pop_frames(
+      min( cursor.ok_to_pop( receiver.frames() ), receiver.next_frame_needed() - receiver.frames().range_begin() ) );
+
+    /* the first loud sample played of each burst, against the burst's start in the capture */
+    for ( uint64_t i = decode_cursor - opus_frame::NUM_SAMPLES; i < decode_cursor; i++ ) {
+      if ( abs( playback.ch1().at( i ) ) < ONSET_THRESHOLD ) {
+        continue;
+      }
+      const uint64_t burst_in = i / BURST_PERIOD * BURST_PERIOD;
+      if ( i > STREAM_LENGTH / 4 and burst_out != burst_in ) {
+        delays.push_back( int64_t( i ) - int64_t( burst_in ) );
+      }
+      burst_out = burst_in;
+    }
+    playback.pop_before( decode_cursor - opus_frame::NUM_SAMPLES );
+  }
+
+  if ( delays.empty() ) {
+    throw runtime_error( "no bursts came out" );
+  }
+  int64_t min_delay = delays.front(), max_delay = delays.front(), sum = 0;
+  for ( const auto delay : delays ) {
+    min_delay = min( min_delay, delay );
+    max_delay = max( max_delay, delay );
+    sum += delay;
+  }
+
+  cout << "   session: " << packets << " packets, " << fixed << setprecision( 1 ) << double( wire_bytes ) / packets
+       << " bytes each on the wire; onset delay " << setprecision( 0 ) << double( sum ) / delays.size()
+       << " samples (" << setprecision( 1 ) << double( sum ) / delays.size() / 48 << " ms, range " << min_delay
+       << "-" << max_delay << ") over " << delays.size() << " bursts; " << cursor.stats().resets
+       << " cursor resets\n";
+}
+
+void program_body( const vector<uint16_t>& frame_durations )
+{
+  for ( const auto frame_samples : frame_durations ) {
+    cout << fixed << setprecision( 1 ) << frame_samples / 48.0 << " ms frames:\n";
+    measure_overhead( frame_samples );
+    measure_latency( frame_samples );
+  }
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " [--frame-ms 2.5|5|10]...\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    vector<uint16_t> frame_durations;
+    for ( int i = 1; i < argc; i += 2 ) {
+      if ( string_view( argv[i] ) != "--frame-ms" or i + 1 >= argc ) {
+        usage( argv[0] );
+        return EXIT_FAILURE;
+      }
+      frame_durations.push_back( NetworkClient::frame_samples_from_ms( argv[i + 1] ) );
+    }
+
+    if ( frame_durations.empty() ) {
+      frame_durations = { 120, 240, 480 };
+    }
+
+    program_body( frame_durations );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
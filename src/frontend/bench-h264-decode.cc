@@ -0,0 +1,130 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "h264_decoder.hh"
+#include "h264_encoder.hh"
+#include "timer.hh"
+
+using namespace std;
+
+/* frames per second through H264Decoder on a 1080p stream (coded as 1920x1088 and cropped): the copying decode()
+   vs. the zero-copy one, with one decoding thread and with slice threads */
+
+static constexpr uint16_t WIDTH = 1920, HEIGHT = 1080;
+
+static void fill( RasterYUV420& raster, const unsigned int frame_no )
+{
+  for ( uint16_t row = 0; row < raster.height(); row++ ) {
+    for ( uint16_t col = 0; col < raster.width(); col++ ) {
+      raster.Y( col, row ) = row + col * 2 + frame_no * 3;
+    }
+  }
+  for ( uint16_t row = 0; row < raster.chroma_height(); row++ ) {
+    for ( uint16_t col = 0; col < raster.chroma_width(); col++ ) {
+      raster.Cb( col, row ) = 128 + ( ( col + frame_no ) & 15 );
+      raster.Cr( col, row ) = 128 - ( ( row + frame_no ) & 15 );
+    }
+  }
+}
+
+/* the stream a camera client would send, one string per encoded frame (with slices, as the video client
+   encodes) */
+static vector<string> record( const unsigned int frames )
+{
+  H264Encoder encoder { WIDTH, HEIGHT, 60, "fast", "zerolatency" };
+  RasterYUV420 raster { WIDTH, HEIGHT };
+
+  vector<string> ret;
+  for ( unsigned int i = 0; i < frames; i++ ) {
+    fill( raster, i );
+    encoder.encode( raster );
+    if ( encoder.has_nal() ) {
+      ret.emplace_back( encoder.nal().NAL );
+      encoder.reset_nal();
+    }
+  }
+  return ret;
+}
+
+template<class Function>
+static void measure( const string_view name, const size_t frames, Function&& function )
+{
+  const uint64_t start = Timer::timestamp_ns();
+  function();
+  const double seconds = ( Timer::timestamp_ns() - start ) / BILLION;
+
+  cout << setw( 28 ) << name << ": " << fixed << setprecision( 0 ) << frames / seconds << " frames/s ("
+       << setprecision( 2 ) << seconds * 1e6 / frames << " us each)\n";
+}
+
+void program_body( const unsigned int frames, const unsigned int threads )
+{
+  const vector<string> stream = record( frames );
+  if ( stream.empty() ) {
+    throw runtime_error( "encoder produced no frames" );
+  }
+
+  for ( const unsigned int thread_count : { 1U, threads } ) {
+    const string suffix = " (" + to_string( thread_count ) + " thread" + ( thread_count > 1 ? "s)" : ")" );
+
+    H264Decoder copying { thread_count };
+    RasterYUV420 output { WIDTH, HEIGHT };
+    unsigned int pictures = 0;
+    measure( "copy" + suffix, stream.size(), [&] {
+      for ( const auto& nal : stream ) {
+        pictures += copying.decode( string_view( nal ), output );
+      }
+    } );
+
+    H264Decoder zero_copy { thread_count };
+    shared_ptr<RasterYUV420> last;
+    unsigned int zero_copy_pictures = 0;
+    measure( "zero-copy" + suffix, stream.size(), [&] {
+      for ( const auto& nal : stream ) {
+        auto picture = zero_copy.decode( string_view( nal ) );
+        if ( picture ) {
+          last = move( picture );
+          zero_copy_pictures++;
+        }
+      }
+    } );
+
+    if ( not last or last->width() != WIDTH or last->height() != HEIGHT ) {
+      throw runtime_error( "zero-copy picture is "
+                           + ( last ? to_string( last->width() ) + "x" + to_string( last->height() ) : "missing" )
+                           + ", not " + to_string( WIDTH ) + "x" + to_string( HEIGHT ) );
+    }
+
+    cout << setw( 28 ) << "" << "  (" << pictures << " and " << zero_copy_pictures << " pictures of "
+         << stream.size() << ", " << last->width() << "x" << last->height() << ")\n";
+  }
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " [frames] [threads]\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc > 3 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body( argc >= 2 ? stoul( argv[1] ) : 600, argc == 3 ? stoul( argv[2] ) : 4 );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "http_reader.hh"
+#include "ring_buffer.hh"
+#include "timer.hh"
+#include "ws_server.hh"
+
+using namespace std;
+
+/* handshakes per second: parsing a browser's WebSocket upgrade request with HTTPRequestReader (copies every
+   field into strings) vs. HTTPRequestParser (in place), and the whole WebSocketServer::do_handshake (parse,
+   SHA-1 accept key, 101 response) */
+
+static constexpr string_view handshake
+  = "GET /camera HTTP/1.1\r\n"
+    "Host: stagecast.example:8400\r\n"
+    "Connection: Upgrade\r\n"
+    "Pragma: no-cache\r\n"
+    "Cache-Control: no-cache\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "Chrome/120.0 Safari/537.36\r\n"
+    "Upgrade: websocket\r\n"
+    "Origin: https://stagecast.example\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n"
+    "\r\n";
+
+template<class Function>
+static void measure( const string_view name, const unsigned int iterations, Function&& function )
+{
+  const uint64_t start = Timer::timestamp_ns();
+  for ( unsigned int i = 0; i < iterations; i++ ) {
+    function();
+  }
+  const double seconds = ( Timer::timestamp_ns() - start ) / BILLION;
+
+  cout << setw( 24 ) << name << ": " << fixed << setprecision( 2 ) << iterations / seconds / 1e6 << " M/s ("
+       << setprecision( 0 ) << seconds * 1e9 / iterations << " ns each)\n";
+}
+
+void program_body( const unsigned int iterations )
+{
+  size_t checksum = 0;
+
+  measure( "HTTPRequestReader", iterations, [&] {
+    HTTPRequestReader reader { {}, {} };
+    reader.read( handshake );
+    if ( not reader.finished() ) {
+      throw runtime_error( "HTTPRequestReader did not finish" );
+    }
+    checksum += reader.release().headers.sec_websocket_key.size();
+  } );
+
+  measure( "HTTPRequestParser", iterations, [&] {
+    HTTPRequestParser parser;
+    if ( not parser.parse( handshake ) ) {
+      throw runtime_error( "HTTPRequestParser did not finish" );
+    }
+    checksum += parser.header( handshake, "Sec-WebSocket-Key" ).value().size();
+  } );
+
+  RingBuffer in { 65536 }, out { 65536 };
+  measure( "do_handshake", iterations, [&] {
+    WebSocketServer server { "https://stagecast.example" };
+    in.push_from_const_str( handshake );
+    server.do_handshake( in, out );
+    if ( not server.handshake_complete() ) {
+      throw runtime_error( "handshake failed" );
+    }
+    checksum += out.readable_region().size();
+    out.pop( out.readable_region().size() );
+  } );
+
+  cout << "(checksum " << checksum << ")\n";
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " [iterations]\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc > 2 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body( argc == 2 ? stoul( argv[1] ) : 1000000 );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rendition.hh"
+#include "segment_cache.hh"
+#include "timer.hh"
+
+using namespace std;
+
+/* CPU per viewer of the camera server's fan-out: a recorded stream is muxed once into a SegmentCache, and each
+   viewer copies every new fragment out of it (as Viewer::send_video does), half of them with a rewritten
+   decode time (as after a skipped frame) */
+
+static uint8_t nal_type( const string_view stream, const size_t payload )
+{
+  return payload < stream.size() ? stream[payload] & 0x1f : 0;
+}
+
+/* splits an Annex B stream into access units, each starting with a four-byte start code like the encoder's
+   output: a new one begins at an access unit delimiter or SPS, or at a slice that starts a picture
+   (first_mb_in_slice == 0) once the current one has a slice */
+static vector<string> access_units( const string_view stream )
+{
+  vector<string> ret;
+  string current;
+  bool current_has_slice = false;
+
+  size_t pos = stream.find( string_view( "\0\0\1", 3 ) );
+  while ( pos != string_view::npos ) {
+    const size_t payload = pos + 3;
+    const size_t next = stream.find( string_view( "\0\0\1", 3 ), payload );
+
+    /* without the next start code's leading zero (a NAL never ends in a zero byte) */
+    size_t end = next == string_view::npos ? stream.size() : next;
+    while ( end > payload and stream[end - 1] == 0 ) {
+      end--;
+    }
+
+    const uint8_t type = nal_type( stream, payload );
+    const bool slice = type == 1 or type == 5;
+    const bool first_slice = slice and payload + 1 < stream.size() and ( stream[payload + 1] & 0x80 );
+    if ( ( type == 9 or type == 7 or first_slice ) and current_has_slice ) {
+      ret.push_back( move( current ) );
+      current.clear();
+      current_has_slice = false;
+    }
+
+    current.append( string_view( "\0\0\0\1", 4 ) );
+    current.append( stream.substr( payload, end - payload ) );
+    current_has_slice |= slice;
+
+    pos = next;
+  }
+
+  if ( current_has_slice ) {
+    ret.push_back( move( current ) );
+  }
+  return ret;
+}
+
+struct Reader
+{
+  uint64_t next_index {};
+  string outbound {};
+  uint64_t bytes {};
+};
+
+/* pushes the stream through a new cache, each NAL followed by every viewer reading what's new; returns seconds */
+static double run( const vector<string>& stream, const SegmentCache::Muxer muxer, const unsigned int viewers )
+{
+  const auto& rendition = camera_renditions.at( 0 );
+  SegmentCache cache { rendition.fps, rendition.width, rendition.height, muxer };
+  vector<Reader> readers( viewers );
+
+  const uint64_t start = Timer::timestamp_ns();
+  for ( const auto& nal : stream ) {
+    cache.push_NAL( nal );
+
+    for ( size_t viewer = 0; viewer < readers.size(); viewer++ ) {
+      Reader& reader = readers[viewer];
+      reader.next_index = max( reader.next_index, cache.first_index() );
+      for ( ; reader.next_index < cache.end_index(); reader.next_index++ ) {
+        const auto& segment = *cache.at( reader.next_index );
+        const uint64_t time_offset = ( viewer % 2 and reader.next_index > 0 ) ? cache.frame_duration() : 0;
+        if ( reader.outbound.size() < segment.data.size() ) {
+          reader.outbound.resize( segment.data.size() );
+        }
+        segment.copy_out( 0, segment.data.size(), time_offset, reader.outbound.data() );
+        reader.bytes += segment.data.size();
+      }
+    }
+  }
+  const double seconds = ( Timer::timestamp_ns() - start ) / BILLION;
+
+  for ( const auto& reader : readers ) {
+    if ( reader.bytes != readers.front().bytes ) {
+      throw runtime_error( "viewers read different amounts of video" );
+    }
+  }
+
+  return seconds;
+}
+
+void program_body( const string& filename, const vector<SegmentCache::Muxer>& muxers )
+{
+  ifstream file { filename, ios::binary };
+  if ( not file ) {
+    throw runtime_error( "can't open " + filename );
+  }
+  stringstream contents;
+  contents << file.rdbuf();
+
+  const vector<string> stream = access_units( contents.str() );
+  if ( stream.empty() or not MP4Writer::is_idr( stream.front() ) ) {
+    throw runtime_error( filename + ": expected an H.264 stream starting with an IDR (SPS first)" );
+  }
+  cout << filename << ": " << stream.size() << " access units\n";
+
+  for ( const auto muxer : muxers ) {
+    run( stream, muxer, 0 ); /* warm up */
+    const double mux_seconds = run( stream, muxer, 0 );
+    cout << ( muxer == SegmentCache::Muxer::CMAF ? "CMAFWriter" : "libavformat" ) << ": mux " << fixed
+         << setprecision( 2 ) << mux_seconds * 1e6 / stream.size() << " us/frame\n";
+
+    for ( const unsigned int viewers : { 1, 10, 100, 1000 } ) {
+      const double seconds = run( stream, muxer, viewers );
+      const double per_viewer = max( 0.0, seconds - mux_seconds ) / viewers / stream.size();
+      cout << setw( 14 ) << viewers << " viewers: " << setprecision( 2 ) << seconds * 1e6 / stream.size()
+           << " us/frame, " << setprecision( 3 ) << per_viewer * 1e6 << " us/frame per viewer\n";
+    }
+  }
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " STREAM.h264 [libav|cmaf]\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc != 2 and argc != 3 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    vector<SegmentCache::Muxer> muxers { SegmentCache::Muxer::LibAV, SegmentCache::Muxer::CMAF };
+    if ( argc == 3 ) {
+      const string muxer = argv[2];
+      if ( muxer == "libav" ) {
+        muxers = { SegmentCache::Muxer::LibAV };
+      } else if ( muxer == "cmaf" ) {
+        muxers = { SegmentCache::Muxer::CMAF };
+      } else {
+        usage( argv[0] );
+        return EXIT_FAILURE;
+      }
+    }
+
+    program_body( argv[1], muxers );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
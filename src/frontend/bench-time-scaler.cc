@@ -0,0 +1,145 @@
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "time_scaler.hh"
+#include "timer.hh"
+#include "wavwriter.hh"
+
+using namespace std;
+
+/* each TimeScaler as a feed runs it (120-sample blocks, as Cursor does at 2.5 ms): the delay it adds (an impulse
+   in, the first output at its peak) and CPU per block at ratios 1, 0.95 and 1.05; with a directory, also writes
+   a listening vector per scaler and ratio (a 110 Hz voice-like tone) */
+
+static constexpr size_t BLOCK = 120;
+static constexpr size_t STREAM_LENGTH = 48000 * 10;
+
+struct Scaler
+{
+  string_view name, filename;
+  TimeScaler::Kind kind;
+  bool short_window;
+};
+
+static const Scaler scalers[] = { { "RubberBand (short)", "rubberband-short", TimeScaler::Kind::RubberBand, true },
+                                  { "RubberBand (long)", "rubberband-long", TimeScaler::Kind::RubberBand, false },
+                                  { "WSOLA (short)", "wsola-short", TimeScaler::Kind::WSOLA, true },
+                                  { "WSOLA (long)", "wsola-long", TimeScaler::Kind::WSOLA, false } };
+
+/* runs the stream through a new scaler; returns the output and the seconds spent in the scaler */
+static pair<vector<float>, double> run( const Scaler& scaler, const double ratio, const vector<float>& in )
+{
+  const auto stretcher = TimeScaler::make( scaler.kind, scaler.short_window );
+  stretcher->set_time_ratio( ratio );
+
+  vector<float> out, block1( 8192 ), block2( 8192 );
+  out.reserve( in.size() * 1.1 );
+
+  double seconds = 0;
+  for ( size_t start = 0; start + BLOCK <= in.size(); start += BLOCK ) {
+    const uint64_t begin = Timer::timestamp_ns();
+    stretcher->process( { in.data() + start, BLOCK }, { in.data() + start, BLOCK } );
+    const size_t count = stretcher->retrieve( { block1.data(), block1.size() }, { block2.data(), block2.size() } );
+    seconds += ( Timer::timestamp_ns() - begin ) / BILLION;
+
+    out.insert( out.end(), block1.begin(), block1.begin() + count );
+  }
+
+  return { move( out ), seconds };
+}
+
+/* input samples that follow an impulse into the scaler before the block carrying its peak comes out */
+static size_t measured_latency( const Scaler& scaler )
+{
+  const auto stretcher = TimeScaler::make( scaler.kind, scaler.short_window );
+  vector<float> impulse( 48000 ), block1( 8192 ), block2( 8192 );
+  const size_t at = 1000;
+  impulse.at( at ) = 1;
+
+  float peak = 0;
+  size_t peak_pushed = 0;
+  for ( size_t start = 0; start + BLOCK <= impulse.size(); start += BLOCK ) {
+    stretcher->process( { impulse.data() + start, BLOCK }, { impulse.data() + start, BLOCK } );
+    const size_t count = stretcher->retrieve( { block1.data(), block1.size() }, { block2.data(), block2.size() } );
+    for ( size_t i = 0; i < count; i++ ) {
+      if ( abs( block1[i] ) > peak ) {
+        peak = abs( block1[i] );
+        peak_pushed = start + BLOCK;
+      }
+    }
+  }
+
+  if ( peak == 0 ) {
+    throw runtime_error( string( scaler.name ) + ": impulse never came out" );
+  }
+  return peak_pushed - at - 1;
+}
+
+static void write_vector( const string& filename, const vector<float>& samples )
+{
+  ChannelPair buffer { ( samples.size() / 4096 + 1 ) * 4096 }; /* whole pages */
+  for ( size_t i = 0; i < samples.size(); i++ ) {
+    buffer.safe_set( i, { samples[i], samples[i] } );
+  }
+  WavWriter { filename, 48000 }.write( buffer, samples.size() );
+}
+
+void program_body( const optional<string>& directory )
+{
+  vector<float> in( STREAM_LENGTH );
+  for ( size_t i = 0; i < STREAM_LENGTH; i++ ) {
+    for ( unsigned int k = 1; k <= 10; k++ ) {
+      in[i] += 0.3 / k * sin( 2 * M_PI * 110 * k * i / 48000.0 + k );
+    }
+  }
+
+  for ( const auto& scaler : scalers ) {
+    cout << scaler.name << ": latency() " << TimeScaler::make( scaler.kind, scaler.short_window )->latency()
+         << " samples, impulse out " << measured_latency( scaler ) << " samples later\n";
+
+    for ( const double ratio : { 1.0, 0.95, 1.05 } ) {
+      run( scaler, ratio, in ); /* warm up */
+      const auto [out, seconds] = run( scaler, ratio, in );
+      cout << "   ratio " << fixed << setprecision( 2 ) << ratio << ": " << setprecision( 2 )
+           << seconds * 1e6 / ( in.size() / BLOCK ) << " us/block, output/input " << setprecision( 4 )
+           << double( out.size() ) / in.size() << "\n";
+
+      if ( directory.has_value() ) {
+        write_vector( directory.value() + "/" + string( scaler.filename ) + "-" + to_string( ratio ).substr( 0, 4 )
+                        + ".wav",
+                      out );
+      }
+    }
+  }
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " [directory for listening vectors]\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc > 2 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body( argc == 2 ? optional<string>( argv[1] ) : nullopt );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
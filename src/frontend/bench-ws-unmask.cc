@@ -0,0 +1,137 @@
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "ring_buffer.hh"
+#include "timer.hh"
+#include "ws_frame.hh"
+#include "ws_server.hh"
+
+using namespace std;
+
+/* MB/s unmasking a viewer's (masked) binary frame, from 100 B to 1 MB: the byte-at-a-time loop, the wide
+   apply_websocket_mask, and the whole WebSocketEndpoint read of a frame that is unmasked in place in the ring
+   buffer (including pushing the frame into it, as the TLS read does) vs. copied out by WebSocketFrameReader */
+
+static const array<uint8_t, 4> key { 0x37, 0xfa, 0x21, 0x3d };
+
+static void unmask_bytewise( char* data, const size_t len )
+{
+  for ( size_t i = 0; i < len; i++ ) {
+    data[i] ^= key[i % 4];
+  }
+}
+
+template<class Function>
+static void measure( const string_view name,
+                     const size_t bytes,
+                     const unsigned int iterations,
+                     Function&& function )
+{
+  const uint64_t start = Timer::timestamp_ns();
+  for ( unsigned int i = 0; i < iterations; i++ ) {
+    function();
+  }
+  const double seconds = ( Timer::timestamp_ns() - start ) / BILLION;
+
+  cout << setw( 24 ) << name << ": " << fixed << setprecision( 0 ) << bytes * double( iterations ) / seconds / 1e6
+       << " MB/s (" << setprecision( 2 ) << seconds * 1e6 / iterations << " us each)\n";
+}
+
+/* a masked, unfragmented binary frame carrying `payload` */
+static string masked_frame( const string& payload )
+{
+  string ret( WebSocketFrame::header_length( payload.size(), true ) + payload.size(), 0 );
+  Serializer s { { ret.data(), ret.size() } };
+  WebSocketFrame::serialize_header( s, true, WebSocketFrame::opcode_t::Binary, payload.size(), key );
+  const size_t header_length = s.bytes_written();
+  memcpy( ret.data() + header_length, payload.data(), payload.size() );
+  apply_websocket_mask( ret.data() + header_length, payload.size(), key );
+  return ret;
+}
+
+void program_body( const size_t total_bytes )
+{
+  RingBuffer in { 4 * 1048576 }, out { 65536 };
+  size_t checksum = 0;
+
+  for ( const size_t size : { 100, 1000, 10000, 100000, 1000000 } ) {
+    const unsigned int iterations = max( size_t( 1 ), total_bytes / size );
+    cout << size << " bytes:\n";
+
+    string payload( size, 0 );
+    for ( size_t i = 0; i < size; i++ ) {
+      payload[i] = char( i * 7 + 3 );
+    }
+    const string frame = masked_frame( payload );
+
+    string buffer = payload;
+    measure( "bytewise", size, iterations, [&] { unmask_bytewise( buffer.data(), buffer.size() ); } );
+    measure( "apply_websocket_mask", size, iterations, [&] {
+      apply_websocket_mask( buffer.data(), buffer.size(), key );
+    } );
+    checksum += buffer[size / 2];
+
+    /* both paths start from the frame pushed into the connection's input buffer, as the TLS read leaves it */
+    WebSocketEndpoint endpoint;
+    const auto in_place = [&]( const bool check ) {
+      in.push_from_const_str( frame );
+      while ( endpoint.wants_read( in ) and not endpoint.ready() ) {
+        endpoint.read( in, out );
+      }
+      if ( check and endpoint.message() != payload ) {
+        throw runtime_error( "endpoint: wrong payload" );
+      }
+      checksum += endpoint.message()[size / 2];
+      endpoint.pop_message();
+    };
+    in_place( true );
+    measure( "endpoint (in place)", size, iterations, [&] { in_place( false ); } );
+    endpoint.read( in, out ); /* pops the last frame */
+
+    WebSocketFrame target;
+    const auto copied = [&]( const bool check ) {
+      in.push_from_const_str( frame );
+      WebSocketFrameReader reader { move( target ) };
+      while ( not reader.finished() and not in.readable_region().empty() ) {
+        in.pop( reader.read( in.readable_region() ) );
+      }
+      target = reader.release();
+      if ( check and target.payload != payload ) {
+        throw runtime_error( "WebSocketFrameReader: wrong payload" );
+      }
+      checksum += target.payload[size / 2];
+    };
+    copied( true );
+    measure( "WebSocketFrameReader", size, iterations, [&] { copied( false ); } );
+  }
+
+  cout << "(checksum " << checksum << ")\n";
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " [total bytes per measurement]\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc > 2 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body( argc == 2 ? stoul( argv[1] ) : 256 * 1048576 );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "audioboard.hh"
+
+using namespace std;
+
+/* checks AudioBoard::mix_into's fast path (the staged block, full mix minus the excluded rows) against its
+   per-channel loop: every mix-minus agrees to within the rounding of the different order of adds, and is all
+   zeros when nobody else is audible (which the encoder needs to see to send DTX); gated, muted and excluded
+   channels are left out of both; and a gain change after staging takes effect */
+
+static constexpr uint8_t NUM_CHANNELS = 16;
+static constexpr uint64_t TICKS = 400; /* 1 s */
+static constexpr uint8_t NONE = AudioBoard::NO_CHANNEL;
+
+/* 0-5 and 12-15 voices, 6-7 silent, 8-9 noise below the gate, 10 muted, 11 silent after 0.5 s */
+static float sample( const uint8_t channel, const uint64_t i )
+{
+  if ( channel == 6 or channel == 7 or ( channel == 11 and i >= 24000 ) ) {
+    return 0;
+  }
+  if ( channel == 8 or channel == 9 ) {
+    return 0.0005 * sin( 0.37 * i * ( channel - 7 ) );
+  }
+  return 0.4 * sin( 2 * M_PI * ( 110 + 30 * channel ) * i / 48000.0 ) + 0.1 * sin( 0.9 * i + channel );
+}
+
+struct Mix
+{
+  array<float, opus_frame::NUM_SAMPLES> ch1 {}, ch2 {};
+};
+
+static Mix mix( const AudioBoard& board, const uint64_t block, const pair<uint8_t, uint8_t> exclude )
+{
+  Mix ret;
+  board.mix_into( block, { ret.ch1.data(), ret.ch1.size() }, { ret.ch2.data(), ret.ch2.size() }, exclude.first,
+                  exclude.second );
+  return ret;
+}
+
+/* how far apart two orders of adding up the same channels can round */
+static float tolerance( const AudioBoard& board, const uint64_t i )
+{
+  float sum = 0;
+  for ( uint8_t channel = 0; channel < board.num_channels(); channel++ ) {
+    const auto [gain1, gain2] = board.gain( channel );
+    sum += ( abs( gain1 ) + abs( gain2 ) ) * abs( sample( channel, i ) );
+  }
+  return ( board.num_channels() + 2 ) * FLT_EPSILON * sum;
+}
+
+static void compare( const AudioBoard& board,
+                     const uint64_t block,
+                     const pair<uint8_t, uint8_t> exclude,
+                     const Mix& fast,
+                     const Mix& slow,
+                     const bool exact )
+{
+  for ( size_t i = 0; i < opus_frame::NUM_SAMPLES; i++ ) {
+    const float allowed = exact ? 0 : tolerance( board, block + i );
+    if ( abs( fast.ch1[i] - slow.ch1[i] ) > allowed or abs( fast.ch2[i] - slow.ch2[i] ) > allowed ) {
+      throw runtime_error( "mix without channels " + to_string( exclude.first ) + " and "
+                           + to_string( exclude.second ) + " differs at sample " + to_string( block + i ) + ": "
+                           + to_string( fast.ch1[i] ) + " (staged) vs. " + to_string( slow.ch1[i] ) );
+    }
+  }
+}
+
+/* runs the board for a second, mixing every tick both ways for each set of excluded channels */
+static unsigned int check_board( AudioBoard& board, const vector<pair<uint8_t, uint8_t>>& exclusions )
+{
+  unsigned int checks = 0;
+  for ( uint64_t block = 0; block < TICKS * opus_frame::NUM_SAMPLES; block += opus_frame::NUM_SAMPLES ) {
+    for ( uint8_t channel = 0; channel < board.num_channels(); channel++ ) {
+      for ( uint64_t i = block; i < block + opus_frame::NUM_SAMPLES; i++ ) {
+        board.channel( channel ).at( i ) = sample( channel, i );
+      }
+    }
+
+    board.stage_block( block );
+    vector<Mix> fast;
+    for ( const auto& exclude : exclusions ) {
+      fast.push_back( mix( board, block, exclude ) );
+    }
+
+    /* setting a gain (even to what it was) drops the staged block, so these take the per-channel loop */
+    board.set_gain( 0, board.gain( 0 ).first, board.gain( 0 ).second );
+    for ( size_t e = 0; e < exclusions.size(); e++ ) {
+      const auto [exclude1, exclude2] = exclusions[e];
+      bool others_audible = false;
+      for ( uint8_t channel = 0; channel < board.num_channels(); channel++ ) {
+        others_audible |= channel != exclude1 and channel != exclude2
+                          and board.audible( channel, block, opus_frame::NUM_SAMPLES );
+      }
+
+      compare( board, block, exclusions[e], fast[e], mix( board, block, exclusions[e] ), not others_audible );
+      checks++;
+    }
+
+    board.pop_samples_until( block + opus_frame::NUM_SAMPLES > 960 ? block + opus_frame::NUM_SAMPLES - 960 : 0 );
+  }
+  return checks;
+}
+
+static void check_gain_change()
+{
+  AudioBoard board { "board", 2 };
+  for ( uint64_t i = 0; i < opus_frame::NUM_SAMPLES; i++ ) {
+    board.channel( 0 ).at( i ) = 0.25;
+  }
+  board.stage_block( 0 );
+  board.set_gain( 0, 0.5, 1.0 );
+
+  const Mix after = mix( board, 0, { NONE, NONE } );
+  if ( after.ch1.front() != 0.125f or after.ch2.back() != 0.25f ) {
+    throw runtime_error( "gain change after staging was lost" );
+  }
+}
+
+void program_body()
+{
+  AudioBoard board { "board", NUM_CHANNELS };
+  for ( uint8_t channel = 0; channel < NUM_CHANNELS; channel++ ) {
+    board.set_gain( channel, 0.5 + 0.1 * channel, 1.5 - 0.05 * channel );
+  }
+  board.set_gain( 10, 0, 0 );
+
+  /* the shared full mix, clients with voices, silent, muted and gated channels, and one with a single channel */
+  unsigned int checks = check_board(
+    board, { { NONE, NONE }, { 0, 1 }, { 4, 5 }, { 6, 7 }, { 8, 9 }, { 10, 11 }, { 14, 15 }, { 3, NONE } } );
+
+  /* a quiet board: everything but channels 0 and 1 muted */
+  AudioBoard quiet { "quiet", NUM_CHANNELS };
+  for ( uint8_t channel = 2; channel < NUM_CHANNELS; channel++ ) {
+    quiet.set_gain( channel, 0, 0 );
+  }
+  checks += check_board( quiet, { { NONE, NONE }, { 0, 1 }, { 0, NONE }, { 2, 3 } } );
+
+  check_gain_change();
+  checks++;
+
+  cout << checks << " checks passed\n";
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << "\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc != 1 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,236 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "audioboard.hh"
+#include "shared_mix.hh"
+
+using namespace std;
+
+/* checks a listen-only client's return from its board's shared mix to its own encoder, run tick by tick as the
+   server does (with another listener keeping the shared mix going): while the client codes its own mix-minus,
+   its frames are the shared mix's, byte for byte; and on the first frame back after shared ones, its encoder
+   has been reset, primed with the 10 ms of mix-minus before it and codes that frame without prediction, so it
+   and the next frame are exactly what a fresh encoder makes of that audio */
+
+static constexpr int BIT_RATE = 96000;
+static constexpr uint8_t CLIENT_CH1 = 0, CLIENT_CH2 = 1; /* silent: the client is listen-only */
+
+static constexpr size_t SHARED_BEGIN = 40; /* frames */
+static constexpr size_t SHARED_END = 64;
+static constexpr size_t RUN_LENGTH = 96;
+
+static string describe( const bool separate_channels, const size_t frame_samples )
+{
+  return string( separate_channels ? "separate channels" : "stereo" ) + ", " + to_string( frame_samples )
+         + "-sample frames";
+}
+
+static bool same( const AudioFrame& a, const AudioFrame& b )
+{
+  return a.frame1.as_string_view() == b.frame1.as_string_view()
+         and a.frame2.as_string_view() == b.frame2.as_string_view();
+}
+
+static OpusEncoderProcess make_encoder( const bool separate_channels, const size_t frame_samples )
+{
+  OpusEncoderProcess ret = separate_channels ? OpusEncoderProcess { BIT_RATE, BIT_RATE, 48000 }
+                                             : OpusEncoderProcess { BIT_RATE, 48000 };
+  ret.set_frame_samples( frame_samples );
+  return ret;
+}
+
+/* two voices of harmonics on the other channels, with a slow swell */
+static pair<float, float> voices( const uint64_t i )
+{
+  float ch2 = 0, ch3 = 0;
+  for ( unsigned int k = 1; k <= 8; k++ ) {
+    ch2 += 0.1 / k * sin( 2 * M_PI * 147 * k * i / 48000.0 + k );
+    ch3 += 0.1 / k * sin( 2 * M_PI * 196 * k * i / 48000.0 + 2 * k );
+  }
+  const float swell = 0.6 + 0.4 * sin( 2 * M_PI * 1.5 * i / 48000.0 );
+  return { ch2 * swell, ch3 * swell };
+}
+
+/* a new encoder primed with the 10 ms of `mix` before the rejoin, coding the two frames after it (the first
+   without prediction): what the client's encoder should amount to after resume() */
+static vector<AudioFrame> fresh_rejoin( const ChannelPair& mix,
+                                        const uint64_t rejoin_sample,
+                                        const bool separate_channels,
+                                        const size_t frame_samples )
+{
+  const auto make = [&]( const int channels ) {
+    OpusEncoder ret { BIT_RATE, 48000, channels, OPUS_APPLICATION_RESTRICTED_LOWDELAY };
+    ret.set_dtx( true );
+    return ret;
+  };
+  OpusEncoder enc1 = make( separate_channels ? 1 : 2 ), enc2 = make( 1 );
+
+  const auto encode = [&]( const uint64_t start, AudioFrame& out ) {
+    const span_view<float> ch1 = mix.ch1().region( start, frame_samples );
+    const span_view<float> ch2 = mix.ch2().region( start, frame_samples );
+    if ( separate_channels ) {
+      enc1.encode( ch1, out.frame1 );
+      enc2.encode( ch2, out.frame2 );
+    } else {
+      enc1.encode_stereo( ch1, ch2, out.frame1 );
+    }
+  };
+
+  AudioFrame discarded;
+  for ( uint64_t start = rejoin_sample - opus_frame::MAX_SAMPLES; start < rejoin_sample; start += frame_samples ) {
+    encode( start, discarded );
+  }
+
+  vector<AudioFrame> ret( 2 );
+  enc1.set_prediction( false );
+  enc2.set_prediction( false );
+  encode( rejoin_sample, ret.at( 0 ) );
+  enc1.set_prediction( true );
+  enc2.set_prediction( true );
+  encode( rejoin_sample + frame_samples, ret.at( 1 ) );
+  return ret;
+}
+
+static void check_rejoin( const bool separate_channels, const size_t frame_samples )
+{
+  AudioBoard board { "board", 4 };
+  SharedMix shared_mix { board, separate_channels, BIT_RATE, frame_samples };
+
+  /* the client's side, as in Client::mix_and_encode (and one that never resumes, to show the check can tell) */
+  OpusEncoderProcess client = make_encoder( separate_channels, frame_samples );
+  OpusEncoderProcess stale = make_encoder( separate_channels, frame_samples );
+  ChannelPair mixed_audio { 8192 };
+  uint64_t mix_cursor = 0;
+  bool sent_shared_frame = false;
+
+  /* everything the client's mix-minus held, for the fresh encoder */
+  ChannelPair mix_history { 65536 };
+
+  vector<AudioFrame> shared_frames, client_frames, stale_frames;
+
+  for ( uint64_t block = 0; client_frames.size() < RUN_LENGTH; block += opus_frame::NUM_SAMPLES ) {
+    for ( uint64_t i = block; i < block + opus_frame::NUM_SAMPLES; i++ ) {
+      const auto [ch2, ch3] = voices( i );
+      board.channel( CLIENT_CH1 ).at( i ) = 0;
+      board.channel( CLIENT_CH2 ).at( i ) = 0;
+      board.channel( 2 ).at( i ) = ch2;
+      board.channel( 3 ).at( i ) = ch3;
+    }
+    board.stage_block( block );
+    const uint64_t cursor_sample = block + opus_frame::NUM_SAMPLES;
+
+    while ( mix_cursor + frame_samples <= cursor_sample ) {
+      {
+        span<float> history1 = mix_history.ch1().region( mix_cursor, frame_samples );
+        span<float> history2 = mix_history.ch2().region( mix_cursor, frame_samples );
+        board.mix_into( mix_cursor, history1, history2, CLIENT_CH1, CLIENT_CH2 );
+      }
+
+      /* the other listener */
+      AudioFrame shared_frame;
+      if ( not shared_mix.frame( mix_cursor, 0, shared_frame ) ) {
+        throw runtime_error( "no shared frame" );
+      }
+      shared_frames.push_back( shared_frame );
+
+      const size_t frame = client_frames.size();
+      if ( frame >= SHARED_BEGIN and frame < SHARED_END ) {
+        client.skip_one_frame();
+        stale.skip_one_frame();
+        client_frames.push_back( shared_frame );
+        stale_frames.push_back( shared_frame );
+        sent_shared_frame = true;
+        mix_cursor += frame_samples;
+        continue;
+      }
+
+      if ( sent_shared_frame ) {
+        array<float, opus_frame::MAX_SAMPLES> prime1 {}, prime2 {};
+        board.mix_into( mix_cursor - opus_frame::MAX_SAMPLES,
+                        { prime1.data(), prime1.size() },
+                        { prime2.data(), prime2.size() },
+                        CLIENT_CH1,
+                        CLIENT_CH2 );
+        client.resume( { prime1.data(), prime1.size() }, { prime2.data(), prime2.size() } );
+        sent_shared_frame = false;
+      }
+
+      span<float> ch1_target = mixed_audio.ch1().region( mix_cursor, frame_samples );
+      span<float> ch2_target = mixed_audio.ch2().region( mix_cursor, frame_samples );
+      board.mix_into( mix_cursor, ch1_target, ch2_target, CLIENT_CH1, CLIENT_CH2 );
+      mix_cursor += frame_samples;
+
+      for ( auto [encoder, frames] : { pair { &client, &client_frames }, pair { &stale, &stale_frames } } ) {
+        encoder->encode_one_frame( mixed_audio.ch1(), mixed_audio.ch2() );
+        frames->push_back( encoder->front( frame ) );
+        encoder->pop_frame();
+      }
+    }
+    mixed_audio.pop_before( min( client.min_encode_cursor(), stale.min_encode_cursor() ) );
+
+    board.pop_samples_until( cursor_sample > 960 ? cursor_sample - 960 : 0 );
+  }
+
+  for ( size_t frame = 0; frame < SHARED_BEGIN; frame++ ) {
+    if ( not same( client_frames[frame], shared_frames[frame] ) ) {
+      throw runtime_error( describe( separate_channels, frame_samples ) + ": frame " + to_string( frame )
+                           + " differs from the shared mix's" );
+    }
+  }
+
+  const vector<AudioFrame> fresh
+    = fresh_rejoin( mix_history, SHARED_END * frame_samples, separate_channels, frame_samples );
+  for ( size_t i = 0; i < fresh.size(); i++ ) {
+    if ( not same( client_frames.at( SHARED_END + i ), fresh[i] ) ) {
+      throw runtime_error( describe( separate_channels, frame_samples ) + ": frame " + to_string( i )
+                           + " after the rejoin isn't a fresh, primed encoder's" );
+    }
+  }
+
+  if ( same( stale_frames.at( SHARED_END ), fresh.front() ) ) {
+    throw runtime_error( describe( separate_channels, frame_samples )
+                         + ": an encoder that never resumed passes too" );
+  }
+}
+
+void program_body()
+{
+  unsigned int checks = 0;
+  for ( const bool separate_channels : { false, true } ) {
+    for ( const size_t frame_samples : { 120, 240, 480 } ) {
+      check_rejoin( separate_channels, frame_samples );
+      checks++;
+    }
+  }
+
+  cout << checks << " checks passed\n";
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << "\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc != 1 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
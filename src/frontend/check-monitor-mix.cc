@@ -0,0 +1,179 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "monitor_mix.hh"
+
+using namespace std;
+
+/* checks MonitorMix: an impulse comes out in the same sample it went in (at any block size, with the effects on
+   or off), the default strips play exactly what the old fixed 2.0 loopback gains did, and switching the
+   compressor off ramps its gain back instead of stepping it */
+
+static constexpr size_t STREAM_LENGTH = 4800;
+
+static const MonitorMix::Strip effects_on { 1.5, -0.3, 6, -4, -30, 4 };
+
+/* runs ch1/ch2 through a MonitorMix in blocks of the given size */
+static void run( MonitorMix& monitor,
+                 const vector<float>& ch1,
+                 const vector<float>& ch2,
+                 const size_t block_size,
+                 vector<float>& out1,
+                 vector<float>& out2 )
+{
+  out1.assign( ch1.size(), 0 );
+  out2.assign( ch2.size(), 0 );
+  for ( size_t start = 0; start < ch1.size(); start += block_size ) {
+    const size_t len = min( block_size, ch1.size() - start );
+    monitor.process( { ch1.data() + start, len },
+                     { ch2.data() + start, len },
+                     { out1.data() + start, len },
+                     { out2.data() + start, len } );
+  }
+}
+
+static void check_impulse( const size_t block_size, const bool effects, const uint8_t channel, const size_t at )
+{
+  MonitorMix monitor;
+  if ( effects ) {
+    monitor.set_strip( 0, effects_on );
+    monitor.set_strip( 1, effects_on );
+  }
+
+  vector<float> ch1( STREAM_LENGTH ), ch2( STREAM_LENGTH ), out1, out2;
+  ( channel ? ch2 : ch1 ).at( at ) = 0.5;
+  run( monitor, ch1, ch2, block_size, out1, out2 );
+
+  for ( size_t i = 0; i < at; i++ ) {
+    if ( out1[i] != 0 or out2[i] != 0 ) {
+      throw runtime_error( "output before the impulse at block size " + to_string( block_size ) );
+    }
+  }
+
+  if ( out1[at] == 0 or out2[at] == 0 ) {
+    throw runtime_error( "impulse delayed at block size " + to_string( block_size )
+                         + ( effects ? " with effects" : "" ) + " (input sample " + to_string( at ) + ")" );
+  }
+}
+
+/* with the effects off, the block size mustn't matter at all */
+static void check_block_independence( const vector<float>& ch1, const vector<float>& ch2 )
+{
+  vector<float> reference1, reference2;
+  MonitorMix reference;
+  run( reference, ch1, ch2, 1, reference1, reference2 );
+
+  for ( const size_t block_size : { 6, 12, 192 } ) {
+    MonitorMix monitor;
+    vector<float> out1, out2;
+    run( monitor, ch1, ch2, block_size, out1, out2 );
+    if ( out1 != reference1 or out2 != reference2 ) {
+      throw runtime_error( "output depends on the block size (" + to_string( block_size ) + ")" );
+    }
+  }
+}
+
+/* the loopback before MonitorMix: ch1 and ch2, each at gain 2.0, into both sides */
+static void check_default_matches_old_loopback( const vector<float>& ch1, const vector<float>& ch2 )
+{
+  MonitorMix monitor;
+  vector<float> out1, out2;
+  run( monitor, ch1, ch2, 192, out1, out2 );
+
+  for ( size_t i = 0; i < ch1.size(); i++ ) {
+    const float old_sample = ch1[i] * 2.0f + ch2[i] * 2.0f;
+    if ( out1[i] != old_sample or out2[i] != old_sample ) {
+      throw runtime_error( "default strips differ from the old loopback gains at sample " + to_string( i ) );
+    }
+  }
+}
+
+static void check_compressor_release( const size_t block_size )
+{
+  MonitorMix monitor;
+  MonitorMix::Strip compressed;
+  compressed.threshold_db = -30;
+  compressed.ratio = 8;
+  monitor.set_strip( 0, compressed );
+
+  vector<float> ch1( STREAM_LENGTH, 0.5 ), ch2( STREAM_LENGTH ), out1, out2;
+  run( monitor, ch1, ch2, block_size, out1, out2 );
+  const float compressed_level = out1.back();
+
+  monitor.set_strip( 0, {} );
+  vector<float> after1, after2;
+  run( monitor, ch1, ch2, block_size, after1, after2 );
+
+  /* from the compressed level to unity gain in one block, by even steps */
+  const float full_level = 2.0f * 0.5f;
+  const float max_step = ( full_level - compressed_level ) / block_size * 1.01f;
+  float previous = compressed_level;
+  for ( size_t i = 0; i < block_size; i++ ) {
+    if ( abs( after1[i] - previous ) > max_step ) {
+      throw runtime_error( "compressor gain stepped when switched off, at block size " + to_string( block_size ) );
+    }
+    previous = after1[i];
+  }
+
+  if ( abs( after1[block_size - 1] - full_level ) > 1e-6 or after1.back() != full_level ) {
+    throw runtime_error( "compressor gain not back to unity after one block" );
+  }
+}
+
+void program_body()
+{
+  vector<float> ch1( STREAM_LENGTH ), ch2( STREAM_LENGTH );
+  for ( size_t i = 0; i < STREAM_LENGTH; i++ ) {
+    ch1[i] = 0.3 * sin( i * 0.05 ) + 0.1 * sin( i * 1.7 );
+    ch2[i] = 0.2 * sin( i * 0.013 + 1 ) - 0.15 * cos( i * 0.9 );
+  }
+
+  unsigned int checks = 0;
+  for ( const size_t block_size : { 6, 12, 192 } ) {
+    for ( const bool effects : { false, true } ) {
+      for ( const uint8_t channel : { 0, 1 } ) {
+        for ( const size_t at : { size_t( 0 ), block_size - 1, block_size, 1000 + block_size / 2 } ) {
+          check_impulse( block_size, effects, channel, at );
+          checks++;
+        }
+      }
+    }
+    check_compressor_release( block_size );
+    checks++;
+  }
+
+  check_block_independence( ch1, ch2 );
+  check_default_matches_old_loopback( ch1, ch2 );
+  checks += 2;
+
+  cout << checks << " checks passed\n";
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << "\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc != 1 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "time_scaler.hh"
+
+using namespace std;
+
+/* checks WSOLAScaler at each block size Cursor uses (2.5, 5 and 10 ms): at a ratio of 1 the output is the input
+   exactly, held back by no more than latency(); at 0.95 and 1.05 the output is that much shorter or longer; and
+   the cross-fades never leave the input's range */
+
+static constexpr size_t STREAM_LENGTH = 48000 * 10;
+
+/* runs the stream through a new scaler at a fixed ratio, in blocks of the given size */
+static vector<float> run( const bool short_window, const double ratio, const vector<float>& in, const size_t block )
+{
+  WSOLAScaler scaler { short_window };
+  scaler.set_time_ratio( ratio );
+
+  vector<float> out1, out2, block1( 2 * block + 4 * 240 ), block2( block1.size() );
+  for ( size_t start = 0; start + block <= in.size(); start += block ) {
+    scaler.process( { in.data() + start, block }, { in.data() + start, block } );
+    const size_t count = scaler.retrieve( { block1.data(), block1.size() }, { block2.data(), block2.size() } );
+    if ( scaler.available() != 0 ) {
+      throw runtime_error( "more output than one block can produce" );
+    }
+    out1.insert( out1.end(), block1.begin(), block1.begin() + count );
+    out2.insert( out2.end(), block2.begin(), block2.begin() + count );
+  }
+
+  if ( out1 != out2 ) {
+    throw runtime_error( "channels with the same input differ" );
+  }
+  return out1;
+}
+
+static string describe( const bool short_window, const double ratio, const size_t block )
+{
+  return string( short_window ? "short" : "long" ) + " window, ratio " + to_string( ratio ) + ", block "
+         + to_string( block );
+}
+
+static void check_passthrough( const bool short_window, const vector<float>& in, const size_t block )
+{
+  const vector<float> out = run( short_window, 1.0, in, block );
+  const size_t held_back = in.size() / block * block - out.size();
+  if ( held_back > WSOLAScaler { short_window }.latency() ) {
+    throw runtime_error( describe( short_window, 1.0, block ) + ": " + to_string( held_back )
+                         + " samples held back" );
+  }
+
+  for ( size_t i = 0; i < out.size(); i++ ) {
+    if ( out[i] != in[i] ) {
+      throw runtime_error( describe( short_window, 1.0, block ) + ": sample " + to_string( i ) + " changed" );
+    }
+  }
+}
+
+static void check_stretch( const bool short_window,
+                           const double ratio,
+                           const vector<float>& in,
+                           const size_t block )
+{
+  const vector<float> out = run( short_window, ratio, in, block );
+
+  const double length_ratio = double( out.size() ) / in.size();
+  if ( abs( length_ratio - ratio ) > 0.002 ) {
+    throw runtime_error( describe( short_window, ratio, block ) + ": output/input length "
+                         + to_string( length_ratio ) );
+  }
+
+  float peak = 0;
+  for ( const float x : in ) {
+    peak = max( peak, abs( x ) );
+  }
+  for ( const float y : out ) {
+    if ( not isfinite( y ) or abs( y ) > peak ) {
+      throw runtime_error( describe( short_window, ratio, block ) + ": output sample out of range" );
+    }
+  }
+}
+
+void program_body()
+{
+  /* 110 Hz with harmonics (a voice-like pitch period), plus a little noise */
+  vector<float> in( STREAM_LENGTH );
+  unsigned int seed = 1;
+  for ( size_t i = 0; i < STREAM_LENGTH; i++ ) {
+    for ( unsigned int k = 1; k <= 10; k++ ) {
+      in[i] += 0.3 / k * sin( 2 * M_PI * 110 * k * i / 48000.0 + k );
+    }
+    seed = seed * 1103515245 + 12345;
+    in[i] += 0.01 * ( ( ( seed >> 16 ) & 0x7fff ) / 32768.0 - 0.5 );
+  }
+
+  unsigned int checks = 0;
+  for ( const bool short_window : { true, false } ) {
+    for ( const size_t block : { 120, 240, 480 } ) {
+      check_passthrough( short_window, in, block );
+      check_stretch( short_window, 0.95, in, block );
+      check_stretch( short_window, 1.05, in, block );
+      checks += 3;
+    }
+  }
+
+  cout << checks << " checks passed\n";
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << "\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc != 1 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,222 @@
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "http_reader.hh"
+
+using namespace std;
+
+/* checks HTTPRequestParser on mutated WebSocket handshakes: parsing a request as it trickles in must give the
+   same result as parsing it whole, and unmutated requests must parse the same as with HTTPRequestReader.
+   Build with -fsanitize=address,undefined to catch out-of-bounds reads, or pass "-" to check one input from
+   stdin (for an external fuzzer). */
+
+static const vector<string> seeds
+  = { "GET /chat HTTP/1.1\r\nHost: stagecast.example\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nOrigin: https://stagecast.example\r\n"
+      "Sec-WebSocket-Version: 13\r\n\r\n",
+      "\r\nGET / HTTP/1.1\r\nupgrade:websocket\r\nsec-websocket-key:   x3JJHMbDL1EzLkh9GBhXDw==  \r\n\r\n",
+      "POST /control HTTP/1.1\r\nHost: a\r\nContent-Length: 11\r\n\r\nhello world",
+      "GET / HTTP/1.0\r\nContent-Length: 0\r\nContent-Length: 0\r\n\r\n" };
+
+/* everything the parser reports about an input, or the error it threw */
+struct Outcome
+{
+  bool finished {};
+  string error {};
+  vector<string> fields {};
+
+  bool operator==( const Outcome& other ) const
+  {
+    return finished == other.finished and error == other.error and fields == other.fields;
+  }
+};
+
+static Outcome describe( const HTTPRequestParser& parser, const string_view buffer )
+{
+  Outcome ret;
+  ret.finished = true;
+  ret.fields = { string( parser.method( buffer ) ),
+                 string( parser.request_target( buffer ) ),
+                 string( parser.http_version( buffer ) ),
+                 string( parser.body( buffer ) ) };
+  for ( size_t i = 0; i < parser.header_count(); i++ ) {
+    ret.fields.emplace_back( parser.header( i ).name.in( buffer ) );
+    ret.fields.emplace_back( parser.header( i ).value.in( buffer ) );
+  }
+  return ret;
+}
+
+/* feeds the input in chunks of the given sizes (the last chunk takes the rest), as a socket would */
+static Outcome parse_in_chunks( const string_view input, const vector<size_t>& chunk_sizes )
+{
+  HTTPRequestParser parser;
+  size_t available = 0;
+  try {
+    for ( size_t i = 0; available < input.size(); i++ ) {
+      available = i < chunk_sizes.size() ? min( input.size(), available + chunk_sizes[i] ) : input.size();
+      if ( parser.parse( input.substr( 0, available ) ) ) {
+        return describe( parser, input );
+      }
+    }
+  } catch ( const exception& e ) {
+    return { false, e.what(), {} };
+  }
+  return {};
+}
+
+static string escape( const string_view s )
+{
+  string ret;
+  for ( const char c : s ) {
+    if ( c == '\r' ) {
+      ret += "\\r";
+    } else if ( c == '\n' ) {
+      ret += "\\n";
+    } else if ( isprint( static_cast<unsigned char>( c ) ) ) {
+      ret += c;
+    } else {
+      ret += "\\x" + to_string( static_cast<uint8_t>( c ) );
+    }
+  }
+  return ret;
+}
+
+static void check( const string_view input, default_random_engine& prng )
+{
+  const Outcome whole = parse_in_chunks( input, {} );
+
+  uniform_int_distribution<size_t> chunk_size { 1, 16 };
+  vector<size_t> chunk_sizes( input.size() );
+  generate( chunk_sizes.begin(), chunk_sizes.end(), [&] { return chunk_size( prng ); } );
+
+  if ( not( parse_in_chunks( input, chunk_sizes ) == whole ) ) {
+    throw runtime_error( "parsing in chunks disagrees with parsing whole: \"" + escape( input ) + "\"" );
+  }
+}
+
+/* the request fields HTTPRequestReader also reports must match */
+static void check_against_reader( const string_view input )
+{
+  HTTPRequestParser parser;
+  if ( not parser.parse( input ) ) {
+    throw runtime_error( "seed request did not parse: \"" + escape( input ) + "\"" );
+  }
+
+  HTTPRequestReader reader { {}, {} };
+  string_view remaining = input;
+  while ( not reader.finished() and not remaining.empty() ) {
+    remaining.remove_prefix( reader.read( remaining ) );
+  }
+  const HTTPRequest request = reader.release();
+
+  if ( request.method != parser.method( input ) or request.request_target != parser.request_target( input )
+       or request.http_version != parser.http_version( input ) or request.body != parser.body( input )
+       or request.headers.upgrade != parser.header( input, "Upgrade" ).value_or( "" )
+       or request.headers.sec_websocket_key != parser.header( input, "Sec-WebSocket-Key" ).value_or( "" ) ) {
+    throw runtime_error( "HTTPRequestParser disagrees with HTTPRequestReader: \"" + escape( input ) + "\"" );
+  }
+}
+
+static string mutate( string input, default_random_engine& prng )
+{
+  static constexpr string_view interesting[] = { "\r\n", "\n", "\r", ":", " ", "\t", "\r\n\r\n",
+                                                 "Content-Length: 5\r\n", "Transfer-Encoding: chunked\r\n" };
+
+  const auto position = [&] { return uniform_int_distribution<size_t> { 0, input.size() }( prng ); };
+
+  const unsigned int mutation_count = uniform_int_distribution<unsigned int> { 1, 4 }( prng );
+  for ( unsigned int i = 0; i < mutation_count; i++ ) {
+    switch ( uniform_int_distribution<int> { 0, 5 }( prng ) ) {
+      case 0: /* flip a byte */
+        if ( not input.empty() ) {
+          input[position() % input.size()] = uniform_int_distribution<int> { 0, 255 }( prng );
+        }
+        break;
+      case 1: /* delete a range */
+      {
+        const size_t start = position();
+        input.erase( start, uniform_int_distribution<size_t> { 1, 8 }( prng ) );
+      } break;
+      case 2: /* insert an interesting token */
+        input.insert( position(),
+                      interesting[uniform_int_distribution<size_t> { 0, size( interesting ) - 1 }( prng )] );
+        break;
+      case 3: /* duplicate a range */
+      {
+        const size_t start = position();
+        input.insert( position(), input.substr( start, uniform_int_distribution<size_t> { 1, 64 }( prng ) ) );
+      } break;
+      case 4: /* truncate */
+        input.resize( position() );
+        break;
+      case 5: /* make the head long */
+        input.insert( position(), string( uniform_int_distribution<size_t> { 1, 9000 }( prng ), 'a' ) );
+        break;
+    }
+  }
+
+  return input;
+}
+
+void program_body( const unsigned int iterations, const bool from_stdin )
+{
+  default_random_engine prng { 20261018 };
+
+  if ( from_stdin ) {
+    const string input { istreambuf_iterator<char>( cin ), istreambuf_iterator<char>() };
+    check( input, prng );
+    return;
+  }
+
+  for ( const auto& seed : seeds ) {
+    /* the older reader doesn't skip empty lines before the request line */
+    if ( seed.substr( 0, 2 ) != "\r\n" ) {
+      check_against_reader( seed );
+    }
+    check( seed, prng );
+  }
+
+  unsigned int finished = 0, rejected = 0;
+  for ( unsigned int i = 0; i < iterations; i++ ) {
+    const string input = mutate( seeds[i % seeds.size()], prng );
+    check( input, prng );
+
+    const Outcome outcome = parse_in_chunks( input, {} );
+    finished += outcome.finished;
+    rejected += not outcome.error.empty();
+  }
+
+  cout << iterations << " mutated requests: " << finished << " parsed, " << rejected << " rejected, "
+       << iterations - finished - rejected << " incomplete\n";
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " [iterations | -]\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc > 2 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    const bool from_stdin = argc == 2 and string_view( argv[1] ) == "-";
+    program_body( ( argc == 2 and not from_stdin ) ? stoul( argv[1] ) : 20000, from_stdin );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
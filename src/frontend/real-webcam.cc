@@ -40,7 +40,7 @@ void usage( const char* argv0 )
 {
   cerr
     << "Usage: " << argv0
-    << " [-d, --device CAMERA] [-p, --pixfmt PIXEL_FORMAT] [-f, --fullscreen]"
+    << " [-d, --device CAMERA] [-p, --pixfmt PIXEL_FORMAT] [-u, --userptr] [-f, --fullscreen]"
     << endl;
 }
 
@@ -53,18 +53,20 @@ int main( int argc, char* argv[] )
 
   /* camera settings */
   string camera_device = "/dev/video0";
-  string pixel_format = "NV12";
+  string pixel_format = "MJPG";
+  bool userptr = false;
   bool fullscreen = false;
 
   const option command_line_options[]
     = { { "device", required_argument, nullptr, 'd' },
         { "pixfmt", required_argument, nullptr, 'p' },
+        { "userptr", no_argument, nullptr, 'u' },
         { "fullscreen", no_argument, nullptr, 'f' },
         { 0, 0, 0, 0 } };
 
   while ( true ) {
     const int opt
-      = getopt_long( argc, argv, "d:p:f", command_line_options, nullptr );
+      = getopt_long( argc, argv, "d:p:uf", command_line_options, nullptr );
 
     if ( opt == -1 ) {
       break;
@@ -77,6 +79,9 @@ int main( int argc, char* argv[] )
       case 'p':
         pixel_format = optarg;
         break;
+      case 'u':
+        userptr = true;
+        break;
       case 'f':
         fullscreen = true;
         break;
@@ -87,24 +92,38 @@ int main( int argc, char* argv[] )
     }
   }
 
-  Camera camera {1280, 720, camera_device };
+  if ( pixel_format.size() != 4 ) {
+    usage( argv[0] );
+    return EXIT_FAILURE;
+  }
+
+  /* e.g. MJPG, YUYV, NV12, YU12 (the last one works with --userptr, and with the vivid driver) */
+  const uint32_t fourcc = v4l2_fourcc( pixel_format[0], pixel_format[1], pixel_format[2], pixel_format[3] );
+
+  Camera camera { 1280, 720, camera_device, fourcc, userptr ? V4L2_MEMORY_USERPTR : V4L2_MEMORY_MMAP };
   VideoDisplay display { 1280, 720, fullscreen };
   (void) fullscreen;
 
   RasterYUV422 camera_raster { 1280, 720 };
-  RasterYUV422 trash_raster { 1280, 720 };
+  RasterYUV420 camera_raster_420 { 1280, 720 };
   auto loop = make_shared<EventLoop>();
 
   int i = 0;
 
   loop->add_rule( "read camera frame", camera.fd(), Direction::In, [&] {
-    // if ( i <= 60 ) {
-    //   camera.get_next_frame( camera_raster );
-    // } else {
-    //   camera.get_next_frame( trash_raster );
-    // }
-    camera.get_next_frame( camera_raster );
-    display.draw( camera_raster );
+    if ( userptr ) {
+      RasterYUV420* frame = camera.acquire_frame();
+      if ( frame ) {
+        display.draw( *frame );
+      }
+      camera.release_frame();
+    } else if ( fourcc == V4L2_PIX_FMT_MJPEG ) {
+      camera.get_next_frame( camera_raster );
+      display.draw( camera_raster );
+    } else {
+      camera.get_next_frame( camera_raster_420 );
+      display.draw( camera_raster_420 );
+    }
   } );
 
   StatsPrinterTask stats_printer { loop };
@@ -0,0 +1,313 @@
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "eventloop.hh"
+#include "secure_socket.hh"
+#include "timer.hh"
+#include "ws_server_host.hh"
+
+using namespace std;
+
+/* soak test for WebSocketServerHost: thousands of local TLS WebSocket clients connect at once, upgrade, and each
+   gets its message echoed; then they all hang up, and the host must be back to no connections (twice, so the
+   second round runs on recycled slots and buffers) */
+
+static constexpr string_view origin = "https://stagecast.test";
+static constexpr uint64_t ROUND_TIMEOUT_NS = 60'000'000'000;
+
+/* a throwaway self-signed certificate for "localhost": PEM of the certificate and of its key */
+static pair<string, string> make_certificate()
+{
+  EVP_PKEY* key = EVP_EC_gen( "P-256" );
+  X509* cert = X509_new();
+  if ( not key or not cert ) {
+    OpenSSL::throw_error( "make_certificate" );
+  }
+
+  ASN1_INTEGER_set( X509_get_serialNumber( cert ), 1 );
+  X509_gmtime_adj( X509_getm_notBefore( cert ), -60 );
+  X509_gmtime_adj( X509_getm_notAfter( cert ), 3600 );
+  X509_set_pubkey( cert, key );
+
+  X509_NAME* name = X509_get_subject_name( cert );
+  X509_NAME_add_entry_by_txt(
+    name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>( "localhost" ), -1, -1, 0 );
+  X509_set_issuer_name( cert, name );
+
+  X509_EXTENSION* san = X509V3_EXT_conf_nid( nullptr, nullptr, NID_subject_alt_name, "DNS:localhost" );
+  if ( not san or not X509_add_ext( cert, san, -1 ) or not X509_sign( cert, key, EVP_sha256() ) ) {
+    OpenSSL::throw_error( "make_certificate" );
+  }
+  X509_EXTENSION_free( san );
+
+  const auto to_pem = [&]( const bool is_key ) {
+    BIO* bio = BIO_new( BIO_s_mem() );
+    if ( is_key ? not PEM_write_bio_PrivateKey( bio, key, nullptr, nullptr, 0, nullptr, nullptr )
+                : not PEM_write_bio_X509( bio, cert ) ) {
+      OpenSSL::throw_error( "PEM_write" );
+    }
+    char* data;
+    const long len = BIO_get_mem_data( bio, &data );
+    string ret { data, size_t( len ) };
+    BIO_free( bio );
+    return ret;
+  };
+
+  pair<string, string> ret { to_pem( false ), to_pem( true ) };
+  X509_free( cert );
+  EVP_PKEY_free( key );
+  return ret;
+}
+
+/* SSLServerContext reads its certificate and key from files */
+static string write_temporary( const string_view contents )
+{
+  char filename[] = "/tmp/soak-ws-server.XXXXXX";
+  FileDescriptor fd { CheckSystemCall( "mkstemp", mkstemp( filename ) ) };
+  if ( fd.write( contents ) != contents.size() ) {
+    throw runtime_error( "short write to " + string( filename ) );
+  }
+  return filename;
+}
+
+class Echo : public WebSocketServerHost::Handler
+{
+public:
+  void on_message( WebSocketServerHost::Connection& connection, const string_view message ) override
+  {
+    if ( connection.can_send( message.size() ) ) {
+      connection.send_frame( message );
+    }
+  }
+
+  void on_writable( WebSocketServerHost::Connection& ) override {}
+};
+
+class Client
+{
+  SSLSession session_;
+  WebSocketEndpoint endpoint_ {};
+  string expected_;
+  bool upgraded_ {}, echoed_ {};
+
+public:
+  Client( SSLClientContext& context, const uint16_t port, const size_t id )
+    : session_( context.make_SSL_handle(),
+                [&] {
+                  TCPSocket sock;
+                  sock.connect( { "127.0.0.1", port } );
+                  sock.set_blocking( false );
+                  return sock;
+                }(),
+                "localhost" )
+    , expected_( "soak " + to_string( id ) )
+  {
+    session_.outbound_plaintext().push_from_const_str( "GET /soak HTTP/1.1\r\n"
+                                                       "Host: localhost\r\n"
+                                                       "Upgrade: websocket\r\n"
+                                                       "Connection: Upgrade\r\n"
+                                                       "Origin: "
+                                                       + string( origin )
+                                                       + "\r\n"
+                                                         "Sec-WebSocket-Version: 13\r\n"
+                                                         "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n" );
+  }
+
+  bool echoed() const { return echoed_; }
+
+  void poll()
+  {
+    if ( session_.want_write() ) {
+      session_.do_write();
+    }
+    if ( session_.want_read() ) {
+      session_.do_read();
+    }
+
+    RingBuffer& in = session_.inbound_plaintext();
+    if ( not upgraded_ ) {
+      const size_t end = in.readable_region().find( "\r\n\r\n" );
+      if ( end == string_view::npos ) {
+        return;
+      }
+      if ( in.readable_region().substr( 0, 12 ) != "HTTP/1.1 101" ) {
+        throw runtime_error( "upgrade refused: " + string( in.readable_region().substr( 0, end ) ) );
+      }
+      in.pop( end + 4 );
+      upgraded_ = true;
+
+      WebSocketFrame frame;
+      frame.fin = true;
+      frame.opcode = WebSocketFrame::opcode_t::Binary;
+      frame.masking_key = { { 1, 2, 3, 4 } };
+      frame.payload = expected_;
+      string serialized;
+      frame.serialize( serialized );
+      session_.outbound_plaintext().push_from_const_str( serialized );
+    }
+
+    while ( endpoint_.wants_read( in ) and not echoed_ ) {
+      endpoint_.read( in, session_.outbound_plaintext() );
+      if ( endpoint_.ready() ) {
+        if ( endpoint_.message() != expected_ ) {
+          throw runtime_error( "wrong echo: " + string( endpoint_.message() ) );
+        }
+        echoed_ = true;
+        endpoint_.pop_message();
+      }
+    }
+  }
+};
+
+/* the clients' side of a round, on its own thread: connect, wait for every echo, hang up when told to */
+static void run_clients( const uint16_t port,
+                         const string& cert_pem,
+                         const size_t count,
+                         atomic<size_t>& echoed,
+                         atomic<bool>& hang_up,
+                         string& error )
+{
+  try {
+    SSLClientContext context;
+    context.trust_certificate( cert_pem );
+
+    vector<unique_ptr<Client>> clients;
+    for ( size_t i = 0; i < count; i++ ) {
+      clients.push_back( make_unique<Client>( context, port, i ) );
+    }
+
+    const uint64_t deadline = Timer::timestamp_ns() + ROUND_TIMEOUT_NS;
+    while ( echoed < count and Timer::timestamp_ns() < deadline ) {
+      size_t done = 0;
+      for ( auto& client : clients ) {
+        if ( not client->echoed() ) {
+          client->poll();
+        }
+        done += client->echoed();
+      }
+      echoed = done;
+    }
+
+    while ( not hang_up ) {
+      this_thread::yield();
+    }
+  } catch ( const exception& e ) {
+    error = e.what();
+    echoed = count + 1; /* wakes the server side */
+  }
+}
+
+static void soak_round( EventLoop& loop,
+                        WebSocketServerHost& host,
+                        const uint16_t port,
+                        const string& cert_pem,
+                        const size_t count )
+{
+  atomic<size_t> echoed { 0 };
+  atomic<bool> hang_up { false };
+  string error;
+  thread clients( [&] { run_clients( port, cert_pem, count, echoed, hang_up, error ); } );
+
+  const uint64_t start = Timer::timestamp_ns();
+  const auto wait_for = [&]( const auto& condition ) {
+    while ( not condition() and Timer::timestamp_ns() < start + ROUND_TIMEOUT_NS ) {
+      loop.wait_next_event( 10 );
+    }
+  };
+
+  wait_for( [&] { return echoed >= count; } );
+  const size_t connected = host.connection_count();
+  const size_t echoes = echoed;
+  const double echo_seconds = ( Timer::timestamp_ns() - start ) / BILLION;
+
+  hang_up = true;
+  clients.join();
+  wait_for( [&] { return host.connection_count() == 0; } );
+
+  if ( not error.empty() ) {
+    throw runtime_error( "client: " + error );
+  }
+  if ( echoes != count or connected != count ) {
+    throw runtime_error( to_string( echoes ) + " of " + to_string( count ) + " clients echoed, "
+                         + to_string( connected ) + " connected" );
+  }
+  if ( host.connection_count() != 0 ) {
+    throw runtime_error( to_string( host.connection_count() ) + " connections left after the clients hung up" );
+  }
+
+  cout << count << " connections upgraded and echoed in " << fixed << setprecision( 2 ) << echo_seconds
+       << " s, all closed\n";
+}
+
+void program_body( size_t count )
+{
+  /* six descriptors per connection: a socket and two ring buffers on each side */
+  rlimit limit;
+  CheckSystemCall( "getrlimit", getrlimit( RLIMIT_NOFILE, &limit ) );
+  limit.rlim_cur = limit.rlim_max;
+  CheckSystemCall( "setrlimit", setrlimit( RLIMIT_NOFILE, &limit ) );
+  if ( count * 6 + 64 > limit.rlim_cur ) {
+    count = ( limit.rlim_cur - 64 ) / 6;
+    cout << "file descriptor limit " << limit.rlim_cur << ": " << count << " connections\n";
+  }
+
+  const auto [cert_pem, key_pem] = make_certificate();
+  const string cert_file = write_temporary( cert_pem ), key_file = write_temporary( key_pem );
+  SSLServerContext server_context { cert_file, key_file };
+  CheckSystemCall( "unlink", unlink( cert_file.c_str() ) );
+  CheckSystemCall( "unlink", unlink( key_file.c_str() ) );
+
+  TCPSocket listen_socket;
+  listen_socket.set_reuseaddr();
+  listen_socket.bind( { "127.0.0.1", 0 } );
+  listen_socket.listen( 4096 );
+  const uint16_t port = listen_socket.local_address().port();
+
+  EventLoop loop;
+  WebSocketServerHost::Config config;
+  config.origin = origin;
+  config.max_connections = count;
+  WebSocketServerHost host { loop, server_context, move( listen_socket ), config, []( auto& ) {
+                              return make_unique<Echo>();
+                            } };
+
+  soak_round( loop, host, port, cert_pem, count );
+  soak_round( loop, host, port, cert_pem, count );
+  host.summary( cout );
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " [connections]\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    if ( argc > 2 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body( argc == 2 ? stoul( argv[1] ) : 2000 );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -10,13 +10,12 @@
 #include "address.hh"
 #include "camera.hh"
 #include "connection.hh"
-#include "crop.hh"
+#include "crop_scale.hh"
 #include "crypto.hh"
 #include "eventloop.hh"
 #include "exception.hh"
 #include "h264_encoder.hh"
 #include "keys.hh"
-#include "scale.hh"
 #include "socket.hh"
 #include "stats_printer.hh"
 #include "timer.hh"
@@ -33,11 +32,10 @@ void program_body( const string& device, const string& host, const string& servi
 
   Camera camera { 1280, 720, "/dev/"s + device };
 
-  RasterYUV422 camera_raster { 1280, 720 };
+  auto decode_pool = make_shared<MJPEGDecodePool>( 1280, 720 );
   RasterYUV420 output_raster { 1280, 720 };
   H264Encoder encoder { 1280, 720, 60, "fast", "zerolatency" };
-  Scaler scaler;
-  Cropper cropper;
+  CropScaler crop_scaler;
 
   /* read key */
   ReadOnlyFile keyfile { key_filename };
@@ -57,29 +55,29 @@ void program_body( const string& device, const string& host, const string& servi
 
   auto client = make_shared<VideoClient>( stagecast_server, key, video_source, *loop );
 
-  unsigned int frames_fetched_ {}, frames_scaled_ {}, frames_encoded_ {};
-  loop->add_rule( "read camera frame", camera.fd(), Direction::In, [&] {
-    camera.get_next_frame( camera_raster );
-    frames_fetched_++;
-  } );
+  unsigned int frames_scaled_ {}, frames_encoded_ {};
+  loop->add_rule( "read camera frame", camera.fd(), Direction::In, [&] { camera.get_next_frame( *decode_pool ); } );
+
+  loop->add_rule( "JPEG decoded", decode_pool->fd(), Direction::In, [&] { decode_pool->clear_ready(); } );
 
   loop->add_rule(
     "scale frame",
     [&] {
       if ( client->has_control() ) {
-        cropper.setup( client->control().crop_left,
-                       client->control().crop_right,
-                       client->control().crop_top,
-                       client->control().crop_bottom );
-        scaler.setup( client->control().x, client->control().y, client->control().width, client->control().height );
+        crop_scaler.setup_crop( client->control().crop_left,
+                                client->control().crop_right,
+                                client->control().crop_top,
+                                client->control().crop_bottom );
+        crop_scaler.setup_zoom(
+          client->control().x, client->control().y, client->control().width, client->control().height );
         client->pop_control();
       }
 
-      cropper.crop( camera_raster );
-      scaler.scale( camera_raster, output_raster );
+      crop_scaler.process( decode_pool->front(), output_raster );
+      decode_pool->pop();
       frames_scaled_++;
     },
-    [&] { return frames_fetched_ > frames_scaled_; } );
+    [&] { return decode_pool->has_frame(); } );
 
   loop->add_rule(
     "encode",
@@ -95,6 +93,7 @@ void program_body( const string& device, const string& host, const string& servi
   StatsPrinterTask stats_printer { loop };
   stats_printer.add( client );
   stats_printer.add( video_source );
+  stats_printer.add( decode_pool );
 
   while ( loop->wait_next_event( video_source->wait_time_ms( Timer::timestamp_ns() ) )
           != EventLoop::Result::Exit ) {
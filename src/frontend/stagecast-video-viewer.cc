@@ -0,0 +1,138 @@
+#include <cstdlib>
+#include <iostream>
+
+#include <getopt.h>
+
+#include "address.hh"
+#include "datagram_client.hh"
+#include "eventloop.hh"
+#include "exception.hh"
+#include "h264_decoder.hh"
+#include "keys.hh"
+#include "stats_printer.hh"
+#include "timer.hh"
+
+using namespace std;
+
+/* decodes what the datagram viewer receives, to check the feed end to end */
+class DecodeStats : public Summarizable
+{
+  H264Decoder decoder_ {};
+
+  struct Statistics
+  {
+    unsigned int NALs_decoded, pictures;
+    Timer::Record decode_time {};
+  } stats_ {};
+
+public:
+  void decode( const string_view nal )
+  {
+    const uint64_t start = Timer::timestamp_ns();
+    if ( decoder_.decode( { reinterpret_cast<const uint8_t*>( nal.data() ), nal.size() } ) ) {
+      stats_.pictures++;
+    }
+    stats_.NALs_decoded++;
+    stats_.decode_time.log( Timer::timestamp_ns() - start );
+  }
+
+  void summary( ostream& out ) const override
+  {
+    out << "Decoded " << stats_.NALs_decoded << " NALs, " << stats_.pictures << " pictures";
+    if ( stats_.decode_time.count ) {
+      out << ", mean decode time " << stats_.decode_time.total_ns / stats_.decode_time.count / 1000 << " us";
+    }
+    out << "\n";
+  }
+
+  void reset_summary() override { stats_ = {}; }
+};
+
+void program_body( const string& host,
+                   const string& service,
+                   const string& key_filename,
+                   const uint64_t max_delay_ms,
+                   const float simulated_loss )
+{
+  ios::sync_with_stdio( false );
+
+  /* read key */
+  ReadOnlyFile keyfile { key_filename };
+  Parser p { keyfile };
+  LongLivedKey key { p };
+
+  cerr << "Starting viewer as " << key.name() << ".\n";
+
+  auto loop = make_shared<EventLoop>();
+
+  auto decoder = make_shared<DecodeStats>();
+
+  auto client = make_shared<DatagramViewerClient>(
+    Address { host, service },
+    key,
+    *loop,
+    [&]( const string_view nal ) { decoder->decode( nal ); },
+    max_delay_ms * 1'000'000,
+    simulated_loss );
+
+  StatsPrinterTask stats_printer { loop };
+  stats_printer.add( client );
+  stats_printer.add( decoder );
+
+  while ( loop->wait_next_event( client->wait_time_ms( Timer::timestamp_ns() ) ) != EventLoop::Result::Exit ) {
+  }
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " [--max-delay MS] [--loss FRACTION] host service keyfile\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    uint64_t max_delay_ms = 100;
+    float simulated_loss = 0;
+
+    const option command_line_options[] = { { "max-delay", required_argument, nullptr, 'm' },
+                                             { "loss", required_argument, nullptr, 'l' },
+                                             { 0, 0, 0, 0 } };
+
+    while ( true ) {
+      const int opt = getopt_long( argc, argv, "m:l:", command_line_options, nullptr );
+
+      if ( opt == -1 ) {
+        break;
+      }
+
+      switch ( opt ) {
+        case 'm':
+          max_delay_ms = stoul( optarg );
+          break;
+        case 'l':
+          simulated_loss = stof( optarg );
+          break;
+        default:
+          usage( argv[0] );
+          return EXIT_FAILURE;
+      }
+    }
+
+    if ( argc - optind != 3 ) {
+      usage( argv[0] );
+      return EXIT_FAILURE;
+    }
+
+    program_body( argv[optind], argv[optind + 1], argv[optind + 2], max_delay_ms, simulated_loss );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    global_timer().summary( cerr );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -1,19 +1,27 @@
 #include <cstdlib>
 #include <iostream>
 
+#include <atomic>
 #include <csignal>
+#include <getopt.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
 
 #include "control_messages.hh"
+#include "datagram_server.hh"
 #include "eventloop.hh"
 #include "ewma.hh"
 #include "keys.hh"
 #include "mmap.hh"
-#include "mp4writer.hh"
+#include "rendition.hh"
 #include "secure_socket.hh"
+#include "segment_cache.hh"
 #include "socket.hh"
+#include "spsc_queue.hh"
 #include "stackbuffer.hh"
 #include "stats_printer.hh"
-#include "ws_server.hh"
+#include "ws_server_host.hh"
 
 using namespace std;
 using namespace std::chrono;
@@ -52,57 +60,54 @@ void split_on_char( const string_view str, const char ch_to_find, vector<string_
   ret.emplace_back( str.substr( field_start ) );
 }
 
-struct EventCategories
+/* one rung of the simulcast ladder, muxed once for all viewers */
+struct Rendition
 {
-  size_t close, SSL_read, SSL_write, ws_handshake, ws_receive, ws_send;
-
-  EventCategories( EventLoop& loop )
-    : close( loop.add_category( "close" ) )
-    , SSL_read( loop.add_category( "SSL_read" ) )
-    , SSL_write( loop.add_category( "SSL_write" ) )
-    , ws_handshake( loop.add_category( "WebSocket handshake" ) )
-    , ws_receive( loop.add_category( "WebSocket receive" ) )
-    , ws_send( loop.add_category( "WebSocket send" ) )
-  {}
+  string name;
+  shared_ptr<SegmentCache> segments;
 };
 
-class ClientConnection
+/* the latest JSON update from the video server; each viewer sends it once there's room */
+struct UpdateFeed
 {
-  shared_ptr<vector<string>> camera_names_;
-  SSLSession ssl_session_;
-  WebSocketServer ws_server_;
-  MP4Writer muxer_ { 60, 1280, 720 };
-  WebSocketFrame ws_frame_;
+  string json {};
+  uint64_t sequence {};
+};
 
-  uint32_t video_frame_count_ {};
+using Connection = WebSocketServerHost::Connection;
 
-  vector<EventLoop::RuleHandle> rules_;
+/* one viewer's state: which rendition it gets and where it is in that stream */
+class Viewer : public WebSocketServerHost::Handler
+{
+  Connection& connection_;
+  shared_ptr<vector<string>> camera_names_;
+  shared_ptr<const UpdateFeed> updates_;
+  uint64_t updates_sent_ {};
 
-  bool good_ = true;
-  string error_text_ {};
+  /* which rendition this viewer gets; switches happen at the target's next IDR */
+  shared_ptr<const vector<Rendition>> ladder_;
+  size_t rung_ {}, target_rung_ {};
+  uint64_t switch_from_index_ {};
+  uint64_t last_switch_ns_ {};
+  float mean_queue_ = 0.0;
 
-  shared_ptr<bool> cull_needed_;
+  SegmentCache& segments() { return *ladder_->at( rung_ ).segments; }
 
-  unsigned int controls_sent_ {};
+  /* read position in the current rendition's fMP4 stream */
+  shared_ptr<const SegmentCache::Segment> current_segment_ {};
+  size_t segment_pos_ {};
+  shared_ptr<const SegmentCache::Segment> init_sent_ {};
+  uint64_t next_index_ {};
 
-public:
-  void cull( const string_view s )
-  {
-    *cull_needed_ = true;
-    good_ = false;
+  /* this viewer's timeline = shared timeline - time_offset_ (grows with each skipped frame or resync) */
+  uint64_t time_offset_ {}, next_time_ {};
+  bool resync_ {};
 
-    if ( not error_text_.empty() ) {
-      error_text_ += " + "sv;
-    }
-    error_text_ += s;
+  /* unsent video beyond this is stale: skip ahead to the latest IDR */
+  static constexpr uint64_t MAX_BACKLOG_BYTES = 524288;
 
-    for ( auto& rule : rules_ ) {
-      rule.cancel();
-    }
-    rules_.clear();
-  }
+  unsigned int controls_sent_ {};
 
-private:
   float mean_buffer_ = 0.0;
   float last_buffer_ = 0.0;
   vector<string_view> fields_ {};
@@ -156,201 +161,369 @@ private:
   unsigned int frames_since_idr_ {};
   unsigned int idrs_since_skip_ {};
 
-public:
-  const TCPSocket& socket() const { return ssl_session_.socket(); }
+  static constexpr uint64_t MIN_SWITCH_INTERVAL_NS = 2'000'000'000, UP_SWITCH_INTERVAL_NS = 8'000'000'000;
+
+  void request_switch( const size_t rung, const string_view reason )
+  {
+    cerr << connection_.socket().peer_address().to_string() << ": " << ladder_->at( rung_ ).name << " -> "
+         << ladder_->at( rung ).name << " (" << reason << ", queue=" << mean_queue_ << "s, buffer=" << last_buffer_
+         << "s, outbound=" << connection_.outbound_bytes() << ")\n";
 
-  bool good() const { return good_; }
+    target_rung_ = rung;
+    switch_from_index_ = ladder_->at( rung ).segments->end_index();
+    last_switch_ns_ = Timer::timestamp_ns();
+  }
 
-  void push_NAL( const string_view s )
+  /* called on each buffer report from the player (every 50 ms) */
+  void choose_rendition()
   {
-    if ( MP4Writer::is_idr( s ) ) {
-      frames_since_idr_ = 0;
-      skipping_ = false;
-      idrs_since_skip_++;
-    } else {
-      frames_since_idr_++;
+    if ( target_rung_ != rung_ ) {
+      return; /* still waiting for an IDR */
     }
 
-    if ( skipping_ and frames_since_idr_ >= 119 ) {
-      idrs_since_skip_ = 0;
-    } else {
-      muxer_.write( s, video_frame_count_, video_frame_count_ );
-      video_frame_count_++;
+    /* video this viewer hasn't been sent yet, in seconds */
+    const float queue = float( segments().end_index() - min( next_index_, segments().end_index() ) )
+                        / segments().frame_rate();
+    ewma_update( mean_queue_, queue, 0.1 );
+
+    const size_t outbound = connection_.outbound_bytes();
+    const size_t outbound_capacity = connection_.outbound_quota();
+    const uint64_t since_switch = Timer::timestamp_ns() - last_switch_ns_;
+
+    if ( since_switch < MIN_SWITCH_INTERVAL_NS ) {
+      return;
     }
+
+    if ( rung_ + 1 < ladder_->size() ) {
+      if ( mean_queue_ > 0.25 ) {
+        request_switch( rung_ + 1, "backlog" );
+        return;
+      }
+
+      if ( last_buffer_ < 0.02 and outbound > outbound_capacity / 2 ) {
+        request_switch( rung_ + 1, "player starved" );
+        return;
+      }
     }
 
-    void push_update( const string_view str )
-    {
-      if ( ws_server_.handshake_complete()
-           and ssl_session_.outbound_plaintext().writable_region().size()
-                 > str.size() + 1 + WebSocketFrame::max_overhead() ) {
+    if ( rung_ > 0 and since_switch > UP_SWITCH_INTERVAL_NS and mean_queue_ < 0.05
+         and outbound < outbound_capacity / 4 and mean_buffer_ < 0.3 ) {
+      request_switch( rung_ - 1, "headroom" );
+    }
+  }
 
-        ws_frame_.payload.resize( 1 + str.size() );
-        ws_frame_.payload.at( 0 ) = 3;
-        memcpy( ws_frame_.payload.data() + 1, str.data(), str.size() );
+  /* move to the target rendition once it has an IDR we haven't passed: its init segment, then that IDR */
+  bool try_switch()
+  {
+    SegmentCache& target = *ladder_->at( target_rung_ ).segments;
+    if ( not target.init() ) {
+      return false;
+    }
 
-        Serializer s { ssl_session_.outbound_plaintext().writable_region() };
-        s.object( ws_frame_ );
-        ssl_session_.outbound_plaintext().push( s.bytes_written() );
+    for ( uint64_t index = max( switch_from_index_, target.first_index() ); index < target.end_index(); index++ ) {
+      if ( target.at( index )->idr ) {
+        cerr << connection_.socket().peer_address().to_string() << ": switched to " << ladder_->at( target_rung_ ).name
+             << "\n";
+
+        rung_ = target_rung_;
+        current_segment_ = init_sent_ = target.init();
+        segment_pos_ = 0;
+        next_index_ = index;
+        resync_ = true;
+        return true;
       }
     }
 
-    bool can_send( const size_t len ) const
-    {
-      return ssl_session_.outbound_plaintext().writable_region().size() >= len;
+    switch_from_index_ = target.end_index();
+    return false;
+  }
+
+  /* make sure current_segment_ holds something to send; false if this viewer is caught up */
+  bool next_segment()
+  {
+    if ( current_segment_ ) {
+      return true;
     }
 
-    ClientConnection( const EventCategories& categories,
-                      const shared_ptr<vector<string>>& camera_names,
-                      SSLContext& context,
-                      TCPSocket& listening_socket,
-                      const string& origin,
-                      EventLoop& loop,
-                      shared_ptr<bool> cull_needed )
-      : camera_names_( camera_names )
-      , ssl_session_( context.make_SSL_handle(),
-                      [&] {
-                        auto sock = listening_socket.accept();
-                        sock.set_blocking( false );
-                        sock.set_tcp_nodelay( true );
-                        return sock;
-                      }() )
-      , ws_server_( origin )
-      , ws_frame_()
-      , rules_()
-      , cull_needed_( cull_needed )
-    {
-      cerr << "New connection from " << ssl_session_.socket().peer_address().to_string() << "\n";
-
-      rules_.reserve( 10 );
-
-      rules_.push_back( loop.add_rule(
-        categories.close,
-        [this] { cull( "WebSocket closure or error" ); },
-        [this] {
-          return good() and ws_server_.should_close_connection()
-                 and ssl_session_.outbound_plaintext().readable_region().empty();
-        } ) );
-
-      rules_.push_back( loop.add_rule(
-        categories.SSL_read,
-        ssl_session_.socket(),
-        Direction::In,
-        [this] {
-          try {
-            ssl_session_.do_read();
-          } catch ( const exception& e ) {
-            cull( e.what() );
-          }
-        },
-        [this] { return good() and ssl_session_.want_read(); },
-        [this] { cull( "socket closed" ); } ) );
-
-      rules_.push_back( loop.add_rule(
-        categories.SSL_write,
-        ssl_session_.socket(),
-        Direction::Out,
-        [this] {
-          try {
-            ssl_session_.do_write();
-          } catch ( const exception& e ) {
-            cull( e.what() );
-          }
-        },
-        [this] { return good() and ssl_session_.want_write(); },
-        [this] { cull( "socket closed" ); } ) );
-
-      rules_.push_back( loop.add_rule(
-        categories.ws_handshake,
-        [this] { ws_server_.do_handshake( ssl_session_.inbound_plaintext(), ssl_session_.outbound_plaintext() ); },
-        [this] {
-          return good() and ( not ssl_session_.inbound_plaintext().readable_region().empty() )
-                 and ( not ws_server_.handshake_complete() );
-        } ) );
-
-      ws_frame_.fin = true;
-      ws_frame_.opcode = WebSocketFrame::opcode_t::Binary;
-
-      rules_.push_back( loop.add_rule(
-        categories.ws_send,
-        [this] {
-          ws_frame_.payload.resize( min( muxer_.output().readable_region().size() + 1,
-                                         ssl_session_.outbound_plaintext().writable_region().size()
-                                           - WebSocketFrame::max_overhead() - 1 ) );
-          ws_frame_.payload.at( 0 ) = 0;
-          memcpy(
-            ws_frame_.payload.data() + 1, muxer_.output().readable_region().data(), ws_frame_.payload.size() - 1 );
-
-          muxer_.output().pop( ws_frame_.payload.size() - 1 );
-
-          Serializer s { ssl_session_.outbound_plaintext().writable_region() };
-          s.object( ws_frame_ );
-          ssl_session_.outbound_plaintext().push( s.bytes_written() );
-        },
-        [&] {
-          return ssl_session_.outbound_plaintext().writable_region().size()
-                   > size_t( 1 + WebSocketFrame::max_overhead() )
-                 and muxer_.output().readable_region().size() and ws_server_.handshake_complete();
-        } ) );
-
-      rules_.push_back( loop.add_rule(
-        categories.ws_send,
-        [this] {
-          ws_frame_.payload = " " + camera_names_->at( controls_sent_ );
-          ws_frame_.payload.at( 0 ) = 2;
-
-          Serializer s { ssl_session_.outbound_plaintext().writable_region() };
-          s.object( ws_frame_ );
-          ssl_session_.outbound_plaintext().push( s.bytes_written() );
-
-          controls_sent_++;
-        },
-        [&] {
-          return ws_server_.handshake_complete() and ( controls_sent_ < camera_names_->size() )
-                 and ssl_session_.outbound_plaintext().writable_region().size() > 100;
-        } ) );
-
-      rules_.push_back( loop.add_rule(
-        categories.ws_receive,
-        [this] {
-          ws_server_.endpoint().read( ssl_session_.inbound_plaintext(), ssl_session_.outbound_plaintext() );
-          if ( ws_server_.endpoint().ready() ) {
-            parse_message( ws_server_.endpoint().message() );
-
-            if ( last_buffer_ > 0.05 and mean_buffer_ > 0.05 and idrs_since_skip_ > 0 ) {
-              skipping_ = true;
-            }
-
-            //          cerr << skipping_ << " " << idrs_since_skip_ << " " << last_buffer_ << " " << mean_buffer_
-            //          <<
-            //          "\n";
-
-            ws_server_.endpoint().pop_message();
-          }
-        },
-        [this] { return good() and ssl_session_.inbound_plaintext().readable_region().size(); } ) );
+    if ( not init_sent_ ) {
+      if ( not segments().init() ) {
+        return false;
+      }
+
+      /* start with the file header, then join at the latest IDR */
+      current_segment_ = init_sent_ = segments().init();
+      segment_pos_ = 0;
+      next_index_ = segments().start_index();
+      next_time_ = segments().init_end_time();
+      resync_ = next_index_ != 0;
+      return true;
+    }
+
+    if ( target_rung_ != rung_ and try_switch() ) {
+      return true;
+    }
+
+    while ( next_index_ < segments().end_index() ) {
+      if ( next_index_ < segments().first_index()
+           or ( next_index_ < segments().start_index()
+                and segments().bytes_after( next_index_ ) > MAX_BACKLOG_BYTES ) ) {
+        /* fell behind the cache (or too far behind live): jump ahead to the latest IDR */
+        next_index_ = segments().start_index();
+        resync_ = true;
+        continue;
+      }
+
+      const auto& segment = segments().at( next_index_ );
+
+      if ( segment->init and segment->init != init_sent_ ) {
+        /* the stream's parameter sets changed: their init segment goes first */
+        current_segment_ = init_sent_ = segment->init;
+        segment_pos_ = 0;
+        return true;
+      }
+
+      next_index_++;
+
+      if ( segment->idr ) {
+        frames_since_idr_ = 0;
+        skipping_ = false;
+        idrs_since_skip_++;
+      } else {
+        frames_since_idr_++;
+      }
+
+      /* drop the last frame of a two-second GOP */
+      if ( skipping_ and frames_since_idr_ + 1 >= 2 * segments().frame_rate() ) {
+        idrs_since_skip_ = 0;
+        time_offset_ += segments().frame_duration();
+        continue;
+      }
+
+      if ( resync_ ) {
+        time_offset_ = segment->decode_time - next_time_;
+        resync_ = false;
+      }
+      next_time_ = segment->decode_time - time_offset_ + segments().frame_duration();
+
+      current_segment_ = segment;
+      segment_pos_ = 0;
+      return true;
+    }
+
+    return false;
+  }
+
+  void send_video( Connection& c )
+  {
+    while ( c.send_room() > 1 and next_segment() ) {
+      const size_t len = min( current_segment_->data.size() - segment_pos_, c.send_room() - 1 );
+
+      /* the only copy of the video bytes before TLS: shared segment => outbound buffer */
+      string_span payload = c.begin_frame( 1 + len );
+      payload.mutable_data()[0] = 0;
+      current_segment_->copy_out( segment_pos_, len, time_offset_, payload.mutable_data() + 1 );
+      c.end_frame();
+
+      segment_pos_ += len;
+      if ( segment_pos_ == current_segment_->data.size() ) {
+        current_segment_.reset();
+      }
+    }
+  }
+
+  void send_message( Connection& c, const uint8_t type, const string_view payload )
+  {
+    string_span frame = c.begin_frame( 1 + payload.size() );
+    frame.mutable_data()[0] = type;
+    memcpy( frame.mutable_data() + 1, payload.data(), payload.size() );
+    c.end_frame();
+  }
+
+public:
+  Viewer( Connection& connection,
+          const shared_ptr<vector<string>>& camera_names,
+          const shared_ptr<const vector<Rendition>>& ladder,
+          const shared_ptr<const UpdateFeed>& updates )
+    : connection_( connection )
+    , camera_names_( camera_names )
+    , updates_( updates )
+    , ladder_( ladder )
+  {
+    cerr << "New connection from " << connection_.socket().peer_address().to_string() << "\n";
+  }
+
+  void on_message( Connection&, const string_view message ) override
+  {
+    parse_message( message );
+    choose_rendition();
+
+    if ( last_buffer_ > 0.05 and mean_buffer_ > 0.05 and idrs_since_skip_ > 0 ) {
+      skipping_ = true;
+    }
+  }
+
+  void on_writable( Connection& c ) override
+  {
+    while ( controls_sent_ < camera_names_->size() ) {
+      const string& name = camera_names_->at( controls_sent_ );
+      if ( not c.can_send( 1 + name.size() ) ) {
+        return;
+      }
+      send_message( c, 2, name );
+      controls_sent_++;
+    }
+
+    if ( updates_sent_ < updates_->sequence and c.can_send( 1 + updates_->json.size() ) ) {
+      send_message( c, 3, updates_->json );
+      updates_sent_ = updates_->sequence;
+    }
+
+    send_video( c );
+  }
+};
+
+/* serves viewers with its own thread, EventLoop and listening socket (the kernel spreads connections across
+   workers with SO_REUSEPORT); muxed fragments and JSON updates arrive from the ingest thread through
+   lock-free queues, so each worker keeps a mirror of the segment caches */
+class ViewerWorker
+{
+  using SegmentQueue = SPSCQueue<shared_ptr<const SegmentCache::Segment>>;
+
+  vector<unique_ptr<SegmentQueue>> segments_in_ {};
+  SPSCQueue<shared_ptr<const string>> updates_in_ { 64 };
+
+  /* eventfd signalled by the ingest thread after queueing something */
+  FileDescriptor wakeup_;
+
+  /* ingest side: once a rung's queue overflows, skip that rung to its next IDR */
+  vector<char> dropping_ {};
+  unsigned int dropped_ {};
+
+  atomic<bool> stop_ { false };
+  thread thread_ {};
+
+  void wake()
+  {
+    /* not through FileDescriptor::write, which isn't thread-safe */
+    const uint64_t one = 1;
+    if ( ::write( wakeup_.fd_num(), &one, sizeof( one ) ) < 0 and errno != EAGAIN ) {
+      cerr << "ViewerWorker: eventfd write failed\n";
+    }
+  }
+
+  void run( TCPSocket&& listen_socket,
+            SSLContext& ssl_context,
+            const string& origin,
+            const shared_ptr<vector<string>>& names )
+  {
+    EventLoop loop;
+
+    auto ladder = make_shared<vector<Rendition>>();
+    for ( const auto& spec : camera_renditions ) {
+      ladder->push_back( { spec.name, make_shared<SegmentCache>( spec.fps ) } );
     }
 
-    ~ClientConnection()
-    {
-      if ( not error_text_.empty() ) {
-        cerr << "Client error: " << error_text_ << "\n";
+    auto updates = make_shared<UpdateFeed>();
+
+    WebSocketServerHost::Config config;
+    config.origin = origin;
+
+    WebSocketServerHost viewers {
+      loop, ssl_context, move( listen_socket ), config, [&]( Connection& connection ) {
+        return make_unique<Viewer>( connection, names, ladder, updates );
+      } };
+
+    loop.add_rule( "fan-out", wakeup_, Direction::In, [&] {
+      uint64_t count;
+      wakeup_.read( { reinterpret_cast<char*>( &count ), sizeof( count ) } );
+
+      shared_ptr<const SegmentCache::Segment> segment;
+      for ( size_t rung = 0; rung < ladder->size(); rung++ ) {
+        while ( segments_in_.at( rung )->pop( segment ) ) {
+          ladder->at( rung ).segments->add( segment );
+        }
       }
+
+      shared_ptr<const string> json;
+      while ( updates_in_.pop( json ) ) {
+        updates->json = *json;
+        updates->sequence++;
+      }
+
+      viewers.wake_all();
+    } );
+
+    while ( not stop_ and loop.wait_next_event( 500 ) != EventLoop::Result::Exit ) {
     }
+  }
 
-    SSLSession& session() { return ssl_session_; }
+public:
+  ViewerWorker( TCPSocket&& listen_socket,
+                SSLContext& ssl_context,
+                const string& origin,
+                const shared_ptr<vector<string>>& names )
+    : wakeup_( CheckSystemCall( "eventfd", eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) )
+  {
+    for ( size_t rung = 0; rung < camera_renditions.size(); rung++ ) {
+      segments_in_.push_back( make_unique<SegmentQueue>( 1024 ) );
+      dropping_.push_back( false );
+    }
 
-    ClientConnection( const ClientConnection& other ) noexcept = delete;
-    ClientConnection& operator=( const ClientConnection& other ) noexcept = delete;
+    thread_ = thread( [this, &ssl_context, origin, names, sock = move( listen_socket )]() mutable {
+      try {
+        run( move( sock ), ssl_context, origin, names );
+      } catch ( const exception& e ) {
+        cerr << "Viewer worker exception: " << e.what() << "\n";
+      }
+    } );
+  }
 
-    ClientConnection( ClientConnection && other ) noexcept = delete;
-    ClientConnection& operator=( ClientConnection&& other ) noexcept = delete;
-  };
+  ~ViewerWorker()
+  {
+    stop_ = true;
+    wake();
+    thread_.join();
+  }
+
+  /* called from the ingest thread */
+  void publish( const size_t rung, shared_ptr<const SegmentCache::Segment> segment )
+  {
+    char& dropping = dropping_.at( rung );
+    if ( dropping and not segment->idr ) {
+      dropped_++;
+      return;
+    }
+
+    if ( segments_in_.at( rung )->push( move( segment ) ) ) {
+      dropping = false;
+      wake();
+    } else {
+      if ( not dropping ) {
+        cerr << "Viewer worker fell behind on " << camera_renditions.at( rung ).name << ", skipping to next IDR\n";
+      }
+      dropping = true;
+      dropped_++;
+    }
+  }
+
+  void publish( shared_ptr<const string> json )
+  {
+    if ( updates_in_.push( move( json ) ) ) {
+      wake();
+    }
+  }
+
+  ViewerWorker( const ViewerWorker& other ) = delete;
+  ViewerWorker& operator=( const ViewerWorker& other ) = delete;
+};
 
 void program_body( const string origin,
                    const string cert_filename,
                    const string privkey_filename,
-                   const vector<string>& keyfiles )
+                   const vector<string>& keyfiles,
+                   const unsigned int num_workers,
+                   const SegmentCache::Muxer muxer,
+                   const vector<string>& datagram_keyfiles )
 {
   ios::sync_with_stdio( false );
 
@@ -367,67 +540,77 @@ void program_body( const string origin,
   }
 
   SSLServerContext ssl_context { cert_filename, privkey_filename };
-
-  /* receive new additions to stream */
-  UnixDatagramSocket stream_receiver;
-  stream_receiver.set_blocking( false );
-  stream_receiver.bind( Address::abstract_unix( "stagecast-camera-video" ) );
+  ssl_context.enable_kernel_tls();
+
+  /* receive new additions to stream (one socket per rendition) */
+  vector<UnixDatagramSocket> stream_receivers;
+  for ( size_t rung = 0; rung < camera_renditions.size(); rung++ ) {
+    stream_receivers.emplace_back();
+    stream_receivers.back().set_blocking( false );
+    stream_receivers.back().bind( Address::abstract_unix( camera_rendition_socket( rung ) ) );
+  }
 
   /* receive new metadata  */
   UnixDatagramSocket json_receiver;
   json_receiver.set_blocking( false );
   json_receiver.bind( Address::abstract_unix( "stagecast-server-video-json" ) );
 
-  /* start listening for HTTP connections */
-  TCPSocket web_listen_socket;
-  web_listen_socket.set_reuseaddr();
-  web_listen_socket.set_blocking( false );
-  web_listen_socket.set_tcp_nodelay( true );
-  web_listen_socket.bind( { "0", 8400 } );
-  web_listen_socket.listen();
-
-  struct ClientList : public Summarizable
-  {
-    list<ClientConnection> clients {};
-
-    virtual void summary( ostream& out ) const override
-    {
-      out << "Connections: ";
-      unsigned int i = 0;
-      auto it = clients.begin();
-      while ( it != clients.end() ) {
-        out << "   " << i << ":\t" << it->socket().peer_address().to_string() << "\n";
-        i++;
-        it++;
-      }
-    }
-  };
-  auto clients = make_shared<ClientList>();
+  /* start listening for HTTP connections: one socket per worker, all on the same port */
+  vector<unique_ptr<ViewerWorker>> workers;
+  for ( unsigned int i = 0; i < num_workers; i++ ) {
+    TCPSocket web_listen_socket;
+    web_listen_socket.set_reuseaddr();
+    web_listen_socket.set_reuseport();
+    web_listen_socket.set_blocking( false );
+    web_listen_socket.set_tcp_nodelay( true );
+    web_listen_socket.bind( { "0", 8400 } );
+    web_listen_socket.listen( 1024 );
+
+    workers.push_back( make_unique<ViewerWorker>( move( web_listen_socket ), ssl_context, origin, names ) );
+  }
 
   /* set up event loop */
   auto loop = make_shared<EventLoop>();
-  EventCategories categories { *loop };
 
-  auto cull_needed = make_shared<bool>( false );
+  /* one muxer per rendition; each fragment is muxed once and shared with every worker */
+  auto ladder = make_shared<vector<Rendition>>();
+  for ( const auto& spec : camera_renditions ) {
+    ladder->push_back( { spec.name, make_shared<SegmentCache>( spec.fps, spec.width, spec.height, muxer ) } );
+  }
+
+  /* viewers that take the top rendition as raw access units over UDP instead of fMP4 over TCP */
+  optional<DatagramViewerServer> datagram_viewers;
+  if ( not datagram_keyfiles.empty() ) {
+    datagram_viewers.emplace( Address { "0", 8401 }, *loop );
+    for ( const auto& filename : datagram_keyfiles ) {
+      ReadOnlyFile file { filename };
+      Parser p { file };
+      datagram_viewers->add_key( LongLivedKey { p } );
+    }
+  }
 
   StackBuffer<0, uint32_t, 1048576> buf;
 
-  loop->add_rule( "new video segment", stream_receiver, Direction::In, [&] {
-    buf.resize( stream_receiver.recv( buf.mutable_buffer() ) );
+  for ( size_t rung = 0; rung < ladder->size(); rung++ ) {
+    loop->add_rule( "new video segment", stream_receivers.at( rung ), Direction::In, [&, rung] {
+      buf.resize( stream_receivers.at( rung ).recv( buf.mutable_buffer() ) );
+
+      if ( rung == 0 and datagram_viewers.has_value() ) {
+        datagram_viewers->push_NAL( buf );
+      }
 
-    for ( auto& client : clients->clients ) {
       try {
-        client.push_NAL( buf );
+        const auto segment = ladder->at( rung ).segments->push_NAL( buf );
+        if ( segment ) {
+          for ( auto& worker : workers ) {
+            worker->publish( rung, segment );
+          }
+        }
       } catch ( const exception& e ) {
-        cerr << "Muxer exception: " << e.what() << "\n";
-        client.cull( "Muxer exception" );
+        cerr << "Muxer exception (" << ladder->at( rung ).name << "): " << e.what() << "\n";
       }
-    }
-  } );
-
-  loop->add_rule( "new TCP connection", web_listen_socket, Direction::In, [&] {
-    clients->clients.emplace_back( categories, names, ssl_context, web_listen_socket, origin, *loop, cull_needed );
-  } );
+    } );
+  }
 
   StackBuffer<0, uint32_t, 1048576> json_buf;
   loop->add_rule( "new update", json_receiver, Direction::In, [&] {
@@ -435,49 +618,84 @@ void program_body( const string origin,
     if ( json_buf.length() == 0 ) {
       return;
     }
-    for ( auto& client : clients->clients ) {
-      try {
-        client.push_update( json_buf );
-      } catch ( const exception& e ) {
-        client.cull( "JSON exception" );
-      }
+    const auto json = make_shared<const string>( string_view( json_buf ) );
+    for ( auto& worker : workers ) {
+      worker->publish( json );
     }
   } );
 
-  /* cull old connections */
-  loop->add_rule(
-    "cull connections",
-    [&] {
-      clients->clients.remove_if( []( const ClientConnection& x ) { return not x.good(); } );
-      *cull_needed = false;
-    },
-    [&cull_needed] { return *cull_needed; } );
-
   /*
   StatsPrinterTask stats_printer { loop };
-  stats_printer.add( clients );
+  for ( const auto& rendition : *ladder ) {
+    stats_printer.add( rendition.segments );
+  }
   */
 
-  while ( loop->wait_next_event( 500 ) != EventLoop::Result::Exit ) {
+  while ( true ) {
+    const uint64_t wait_ms
+      = datagram_viewers.has_value() ? min( uint64_t( 500 ), datagram_viewers->wait_time_ms( Timer::timestamp_ns() ) )
+                                     : 500;
+    if ( loop->wait_next_event( wait_ms ) == EventLoop::Result::Exit ) {
+      break;
+    }
   }
 }
 
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " [--workers N] [--cmaf] [--datagram keyfile]... origin certificate private_key keys...\n";
+}
+
 int main( int argc, char* argv[] )
 {
   try {
     if ( argc <= 0 ) {
       abort();
     }
-    if ( argc < 4 ) {
-      cerr << "Usage: " << argv[0] << " origin certificate private_key keys...\n";
+
+    unsigned int num_workers = 1;
+    SegmentCache::Muxer muxer = SegmentCache::Muxer::LibAV;
+    vector<string> datagram_keys;
+
+    const option command_line_options[] = { { "workers", required_argument, nullptr, 'w' },
+                                             { "cmaf", no_argument, nullptr, 'c' },
+                                             { "datagram", required_argument, nullptr, 'd' },
+                                             { 0, 0, 0, 0 } };
+
+    while ( true ) {
+      const int opt = getopt_long( argc, argv, "w:cd:", command_line_options, nullptr );
+
+      if ( opt == -1 ) {
+        break;
+      }
+
+      switch ( opt ) {
+        case 'w':
+          num_workers = stoul( optarg );
+          break;
+        case 'c':
+          muxer = SegmentCache::Muxer::CMAF;
+          break;
+        case 'd':
+          datagram_keys.push_back( optarg );
+          break;
+        default:
+          usage( argv[0] );
+          return EXIT_FAILURE;
+      }
+    }
+
+    if ( argc - optind < 3 or num_workers == 0 ) {
+      usage( argv[0] );
       return EXIT_FAILURE;
     }
+
     vector<string> keys;
-    for ( int i = 4; i < argc; i++ ) {
+    for ( int i = optind + 3; i < argc; i++ ) {
       keys.push_back( argv[i] );
     }
 
-    program_body( argv[1], argv[2], argv[3], keys );
+    program_body( argv[optind], argv[optind + 1], argv[optind + 2], keys, num_workers, muxer, datagram_keys );
   } catch ( const exception& e ) {
     cerr << "Exception: " << e.what() << "\n";
     return EXIT_FAILURE;
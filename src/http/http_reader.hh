@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cctype>
+#include <cstring>
 #include <iostream>
 #include <optional>
 #include <string>
@@ -486,3 +489,205 @@ public:
 
   State release_extra_state() { return header_reader_.release_extra_state(); }
 };
+
+/* incremental HTTP/1.1 request parser that copies nothing: it records where the request line, headers and
+   body sit in the caller's buffer. The buffer must start at the beginning of the request and still hold
+   everything passed to earlier calls (e.g. the readable region of a RingBuffer that isn't popped until the
+   request is finished); each call only scans the bytes that are new. */
+class HTTPRequestParser
+{
+public:
+  struct Span
+  {
+    uint16_t offset {}, length {};
+    std::string_view in( const std::string_view buffer ) const { return buffer.substr( offset, length ); }
+  };
+
+  struct Header
+  {
+    Span name {}, value {};
+  };
+
+  static constexpr size_t max_head_length = 8192;
+  static constexpr size_t max_headers = 32;
+  static constexpr size_t max_body_length = 65536;
+
+private:
+  Span method_ {}, request_target_ {}, http_version_ {};
+  std::array<Header, max_headers> headers_ {};
+  size_t header_count_ {};
+  std::optional<size_t> content_length_ {};
+
+  size_t line_start_ {}, scanned_ {}, head_length_ {};
+  bool request_line_finished_ {}, headers_finished_ {}, finished_ {};
+
+  static bool is_token_char( const char c )
+  {
+    static constexpr auto table = [] {
+      std::array<bool, 256> ret {};
+      for ( unsigned int ch = '!'; ch < 127; ch++ ) {
+        ret[ch] = true;
+      }
+      for ( const char* separator = "\"(),/:;<=>?@[\\]{}"; *separator; separator++ ) {
+        ret[static_cast<uint8_t>( *separator )] = false;
+      }
+      return ret;
+    }();
+
+    return table[static_cast<uint8_t>( c )];
+  }
+
+  static bool is_token( const std::string_view s )
+  {
+    return ( not s.empty() ) and std::all_of( s.begin(), s.end(), is_token_char );
+  }
+
+  static Span span( const size_t offset, const size_t length )
+  {
+    return { static_cast<uint16_t>( offset ), static_cast<uint16_t>( length ) };
+  }
+
+  void parse_request_line( const std::string_view line, const size_t offset )
+  {
+    const size_t first_space = line.find( ' ' );
+    const size_t second_space = line.find( ' ', first_space + 1 );
+    if ( first_space == std::string_view::npos or second_space == std::string_view::npos ) {
+      throw std::runtime_error( "HTTPRequestParser: malformed request line" );
+    }
+
+    const std::string_view method = line.substr( 0, first_space );
+    const std::string_view target = line.substr( first_space + 1, second_space - first_space - 1 );
+    const std::string_view version = line.substr( second_space + 1 );
+
+    if ( not is_token( method ) or target.empty() or version.substr( 0, 5 ) != "HTTP/"
+         or version.find( ' ' ) != std::string_view::npos ) {
+      throw std::runtime_error( "HTTPRequestParser: malformed request line" );
+    }
+
+    method_ = span( offset, method.size() );
+    request_target_ = span( offset + first_space + 1, target.size() );
+    http_version_ = span( offset + second_space + 1, version.size() );
+    request_line_finished_ = true;
+  }
+
+  void parse_header_line( const std::string_view line, const size_t offset )
+  {
+    const size_t colon = line.find( ':' );
+    if ( colon == std::string_view::npos or not is_token( line.substr( 0, colon ) ) ) {
+      throw std::runtime_error( "HTTPRequestParser: malformed header line" );
+    }
+
+    if ( header_count_ == max_headers ) {
+      throw std::runtime_error( "HTTPRequestParser: too many headers" );
+    }
+
+    size_t value_start = colon + 1, value_end = line.size();
+    while ( value_start < value_end and ( line[value_start] == ' ' or line[value_start] == '\t' ) ) {
+      value_start++;
+    }
+    while ( value_end > value_start and ( line[value_end - 1] == ' ' or line[value_end - 1] == '\t' ) ) {
+      value_end--;
+    }
+
+    const std::string_view name = line.substr( 0, colon );
+    const std::string_view value = line.substr( value_start, value_end - value_start );
+
+    if ( HTTPHeaderReader::header_equals( name, "Content-Length" ) ) {
+      if ( value.empty() or value.size() > 9
+           or not std::all_of( value.begin(), value.end(), []( const char c ) { return c >= '0' and c <= '9'; } ) ) {
+        throw std::runtime_error( "invalid Content-Length" );
+      }
+      size_t num = 0;
+      for ( const char c : value ) {
+        num = num * 10 + ( c - '0' );
+      }
+      if ( content_length_.has_value() and content_length_.value() != num ) {
+        throw std::runtime_error( "contradictory Content-Length headers" );
+      }
+      content_length_ = num;
+    } else if ( HTTPHeaderReader::header_equals( name, "Transfer-Encoding" ) ) {
+      throw std::runtime_error( "HTTPRequestParser: Transfer-Encoding not supported" );
+    }
+
+    headers_[header_count_++] = { span( offset, name.size() ), span( offset + value_start, value.size() ) };
+  }
+
+public:
+  /* returns whether the whole request (head and body) is in the buffer; throws if it is malformed */
+  bool parse( const std::string_view buffer )
+  {
+    while ( not headers_finished_ ) {
+      const size_t limit = std::min( buffer.size(), max_head_length );
+      const void* newline
+        = scanned_ < limit ? memchr( buffer.data() + scanned_, '\n', limit - scanned_ ) : nullptr;
+
+      if ( not newline ) {
+        if ( buffer.size() >= max_head_length ) {
+          throw std::runtime_error( "HTTPRequestParser: request head too long" );
+        }
+        scanned_ = limit;
+        return false;
+      }
+
+      const size_t end_of_line = static_cast<const char*>( newline ) - buffer.data();
+      if ( end_of_line == line_start_ or buffer[end_of_line - 1] != '\r' ) {
+        throw std::runtime_error( "HTTPRequestParser: line not terminated by CRLF" );
+      }
+
+      const std::string_view line = buffer.substr( line_start_, end_of_line - 1 - line_start_ );
+
+      if ( not request_line_finished_ ) {
+        /* empty lines before the request line are ignored (RFC 7230 section 3.5) */
+        if ( not line.empty() ) {
+          parse_request_line( line, line_start_ );
+        }
+      } else if ( line.empty() ) {
+        headers_finished_ = true;
+        head_length_ = end_of_line + 1;
+      } else if ( line.front() == ' ' or line.front() == '\t' ) {
+        throw std::runtime_error( "HTTPRequestParser: obsolete line folding not supported" );
+      } else {
+        parse_header_line( line, line_start_ );
+      }
+
+      line_start_ = scanned_ = end_of_line + 1;
+    }
+
+    if ( body_length() > max_body_length ) {
+      throw std::runtime_error( "HTTPRequestParser: body too long" );
+    }
+
+    finished_ = buffer.size() >= length();
+    return finished_;
+  }
+
+  bool finished() const { return finished_; }
+
+  /* bytes of the request, head and body (valid once finished) */
+  size_t length() const { return head_length_ + body_length(); }
+
+  /* a request without Content-Length has no body (Transfer-Encoding is refused) */
+  size_t body_length() const { return content_length_.value_or( 0 ); }
+
+  /* views into the buffer passed to parse() */
+  std::string_view method( const std::string_view buffer ) const { return method_.in( buffer ); }
+  std::string_view request_target( const std::string_view buffer ) const { return request_target_.in( buffer ); }
+  std::string_view http_version( const std::string_view buffer ) const { return http_version_.in( buffer ); }
+  std::string_view body( const std::string_view buffer ) const { return buffer.substr( head_length_, body_length() ); }
+
+  size_t header_count() const { return header_count_; }
+  const Header& header( const size_t index ) const { return headers_.at( index ); }
+
+  /* value of the first header with this name (case-insensitive) */
+  std::optional<std::string_view> header( const std::string_view buffer, const std::string_view name ) const
+  {
+    for ( size_t i = 0; i < header_count_; i++ ) {
+      if ( HTTPHeaderReader::header_equals( headers_[i].name.in( buffer ), name ) ) {
+        return headers_[i].value.in( buffer );
+      }
+    }
+    return {};
+  }
+
+  void reset() { *this = {}; }
+};
@@ -1,3 +1,9 @@
+#include <cerrno>
+#include <cstring>
+#include <linux/tls.h>
+#include <openssl/kdf.h>
+#include <unistd.h>
+
 #include "secure_socket.hh"
 #include "exception.hh"
 
@@ -79,6 +85,37 @@ SSLServerContext::SSLServerContext( const string& certificate_filename, const st
   }
 }
 
+/* NSS key log line: "<label> <client random> <secret>", hex-encoded */
+static void keylog_callback( const SSL* ssl, const char* line )
+{
+  string* secret = static_cast<string*>( SSL_get_app_data( ssl ) );
+  if ( not secret ) {
+    return;
+  }
+
+  const string_view wanted = SSL_is_server( ssl ) ? "SERVER_TRAFFIC_SECRET_0 " : "CLIENT_TRAFFIC_SECRET_0 ";
+  const string_view str { line };
+  if ( str.substr( 0, wanted.size() ) != wanted ) {
+    return;
+  }
+
+  const string_view hex = str.substr( str.rfind( ' ' ) + 1 );
+  secret->clear();
+  for ( size_t i = 0; i + 1 < hex.size(); i += 2 ) {
+    secret->push_back( char( stoi( string( hex.substr( i, 2 ) ), nullptr, 16 ) ) );
+  }
+}
+
+void SSLContext::enable_kernel_tls()
+{
+  SSL_CTX_set_keylog_callback( ctx_.get(), keylog_callback );
+
+  /* TLS 1.3 session tickets would be sent with the application keys, after the kernel takes over */
+  if ( not SSL_CTX_set_num_tickets( ctx_.get(), 0 ) ) {
+    OpenSSL::throw_error( "SSL_CTX_set_num_tickets" );
+  }
+}
+
 SSL_handle SSLContext::make_SSL_handle()
 {
   SSL_handle ssl { SSL_new( ctx_.get() ) };
@@ -226,6 +263,29 @@ void CertificateStore::add_certificate( Certificate& cert )
 SSLSession::SSLSession( SSL_handle&& ssl, TCPSocket&& sock, const string& server_hostname )
   : ssl_( move( ssl ) )
   , socket_( move( sock ) )
+{
+  setup( server_hostname );
+}
+
+SSLSession::SSLSession( SSL_handle&& ssl, TCPSocket&& sock, RingBuffer&& outbound, RingBuffer&& inbound )
+  : ssl_( move( ssl ) )
+  , socket_( move( sock ) )
+  , outbound_plaintext_( move( outbound ) )
+  , inbound_plaintext_( move( inbound ) )
+{
+  outbound_plaintext_.pop( outbound_plaintext_.bytes_stored() );
+  inbound_plaintext_.pop( inbound_plaintext_.bytes_stored() );
+  setup( {} );
+}
+
+pair<RingBuffer, RingBuffer> SSLSession::release_buffers()
+{
+  outbound_plaintext_.pop( outbound_plaintext_.bytes_stored() );
+  inbound_plaintext_.pop( inbound_plaintext_.bytes_stored() );
+  return { move( outbound_plaintext_ ), move( inbound_plaintext_ ) };
+}
+
+void SSLSession::setup( const string& server_hostname )
 {
   if ( not ssl_ ) {
     throw runtime_error( "SecureSocket: constructor must be passed valid SSL structure" );
@@ -234,6 +294,8 @@ SSLSession::SSLSession( SSL_handle&& ssl, TCPSocket&& sock, const string& server
   SSL_set0_rbio( ssl_.get(), socket_ );
   SSL_set0_wbio( ssl_.get(), socket_ );
 
+  SSL_set_app_data( ssl_.get(), tx_secret_.get() );
+
   if ( SSL_is_server( ssl_.get() ) ) {
     SSL_set_accept_state( ssl_.get() );
   } else {
@@ -251,6 +313,113 @@ SSLSession::SSLSession( SSL_handle&& ssl, TCPSocket&& sock, const string& server
   OpenSSL::check( "SSLSession constructor" );
 }
 
+/* TLS 1.3 HKDF-Expand-Label with an empty context (RFC 8446 section 7.1) */
+static string hkdf_expand_label( const EVP_MD* md, const string_view secret, const string_view label, const size_t length )
+{
+  const string full_label = "tls13 " + string( label );
+
+  string info;
+  info.push_back( char( length >> 8 ) );
+  info.push_back( char( length & 0xff ) );
+  info.push_back( char( full_label.size() ) );
+  info.append( full_label );
+  info.push_back( 0 );
+
+  struct EVP_PKEY_CTX_deleter
+  {
+    void operator()( EVP_PKEY_CTX* x ) const { EVP_PKEY_CTX_free( x ); }
+  };
+  unique_ptr<EVP_PKEY_CTX, EVP_PKEY_CTX_deleter> ctx { EVP_PKEY_CTX_new_id( EVP_PKEY_HKDF, nullptr ) };
+
+  if ( not ctx or EVP_PKEY_derive_init( ctx.get() ) <= 0
+       or EVP_PKEY_CTX_set_hkdf_mode( ctx.get(), EVP_PKEY_HKDEF_MODE_EXPAND_ONLY ) <= 0
+       or EVP_PKEY_CTX_set_hkdf_md( ctx.get(), md ) <= 0
+       or EVP_PKEY_CTX_set1_hkdf_key(
+            ctx.get(), reinterpret_cast<const unsigned char*>( secret.data() ), secret.size() )
+            <= 0
+       or EVP_PKEY_CTX_add1_hkdf_info(
+            ctx.get(), reinterpret_cast<const unsigned char*>( info.data() ), info.size() )
+            <= 0 ) {
+    OpenSSL::throw_error( "HKDF-Expand-Label setup" );
+  }
+
+  string output( length, 0 );
+  size_t output_length = length;
+  if ( EVP_PKEY_derive( ctx.get(), reinterpret_cast<unsigned char*>( output.data() ), &output_length ) <= 0
+       or output_length != length ) {
+    OpenSSL::throw_error( "HKDF-Expand-Label" );
+  }
+
+  return output;
+}
+
+/* build the <linux/tls.h> transmit parameters for an AES-GCM TLS 1.3 session */
+template<class CryptoInfo>
+static string kernel_crypto_info( const uint16_t cipher_type, const EVP_MD* md, const string_view secret )
+{
+  CryptoInfo info {};
+  info.info.version = TLS_1_3_VERSION;
+  info.info.cipher_type = cipher_type;
+
+  string key = hkdf_expand_label( md, secret, "key", sizeof( info.key ) );
+  string iv = hkdf_expand_label( md, secret, "iv", sizeof( info.salt ) + sizeof( info.iv ) );
+
+  memcpy( info.key, key.data(), sizeof( info.key ) );
+  memcpy( info.salt, iv.data(), sizeof( info.salt ) );
+  memcpy( info.iv, iv.data() + sizeof( info.salt ), sizeof( info.iv ) );
+  /* rec_seq stays zero: no application data has been sent yet */
+
+  string ret { reinterpret_cast<const char*>( &info ), sizeof( info ) };
+
+  OPENSSL_cleanse( key.data(), key.size() );
+  OPENSSL_cleanse( iv.data(), iv.size() );
+  OPENSSL_cleanse( &info, sizeof( info ) );
+
+  return ret;
+}
+
+void SSLSession::try_kernel_tls()
+{
+  if ( kernel_tls_attempted_ or not SSL_is_init_finished( ssl_.get() ) or SSL_want( ssl_.get() ) != SSL_NOTHING ) {
+    return;
+  }
+
+  kernel_tls_attempted_ = true;
+
+  /* the kernel starts its record sequence number at zero */
+  if ( tx_secret_->empty() or app_data_written_ or SSL_version( ssl_.get() ) != TLS1_3_VERSION ) {
+    return;
+  }
+
+  const SSL_CIPHER* const cipher = SSL_get_current_cipher( ssl_.get() );
+  const uint32_t cipher_id = cipher ? SSL_CIPHER_get_id( cipher ) : 0;
+
+  string crypto_info;
+  if ( cipher_id == TLS1_3_CK_AES_128_GCM_SHA256 ) {
+    crypto_info
+      = kernel_crypto_info<tls12_crypto_info_aes_gcm_128>( TLS_CIPHER_AES_GCM_128, EVP_sha256(), *tx_secret_ );
+  } else if ( cipher_id == TLS1_3_CK_AES_256_GCM_SHA384 ) {
+    crypto_info
+      = kernel_crypto_info<tls12_crypto_info_aes_gcm_256>( TLS_CIPHER_AES_GCM_256, EVP_sha384(), *tx_secret_ );
+  }
+
+  OPENSSL_cleanse( tx_secret_->data(), tx_secret_->size() );
+  tx_secret_->clear();
+
+  if ( crypto_info.empty() ) {
+    return; /* e.g. ChaCha20-Poly1305: stay in userspace */
+  }
+
+  try {
+    socket_.set_kernel_tls_tx( crypto_info );
+    kernel_tls_tx_ = true;
+  } catch ( const unix_error& ) {
+    /* no tls module or cipher support in this kernel: keep encrypting with OpenSSL */
+  }
+
+  OPENSSL_cleanse( crypto_info.data(), crypto_info.size() );
+}
+
 int SSLSession::get_error( const int return_value ) const
 {
   return SSL_get_error( ssl_.get(), return_value );
@@ -274,6 +443,7 @@ void SSLSession::do_read()
   auto target = inbound_plaintext_.writable_region();
 
   const auto read_count_before = socket_.read_count();
+  const auto write_count_before = socket_.write_count();
   const int bytes_read = SSL_read( ssl_.get(), target.mutable_data(), target.size() );
   const auto read_count_after = socket_.read_count();
 
@@ -281,6 +451,14 @@ void SSLSession::do_read()
     write_waiting_on_read_ = false;
   }
 
+  /* after the offload, a record OpenSSL writes by itself (a KeyUpdate reply, an alert) would reach the peer
+     framed by the kernel as application data, and nothing would clear read_waiting_on_write_: end the session */
+  if ( kernel_tls_tx_
+       and ( socket_.write_count() != write_count_before
+             or ( bytes_read <= 0 and get_error( bytes_read ) == SSL_ERROR_WANT_WRITE ) ) ) {
+    throw runtime_error( "SSL_read: OpenSSL needed to write after kernel TLS offload" );
+  }
+
   if ( bytes_read > 0 ) {
     inbound_plaintext_.push( bytes_read );
     return;
@@ -310,6 +488,24 @@ void SSLSession::do_write()
 {
   OpenSSL::check( "SSLSession::do_write()" );
 
+  try_kernel_tls();
+
+  if ( kernel_tls_tx_ ) {
+    /* the kernel frames and encrypts plaintext written to the socket; a full socket buffer (EAGAIN) leaves the
+       plaintext queued for the next writable event (FileDescriptor::write would throw on a 0-byte write) */
+    const string_view source = outbound_plaintext_.readable_region();
+    const ssize_t bytes_written = ::write( socket_.fd_num(), source.data(), source.size() );
+    if ( bytes_written < 0 ) {
+      if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+        return;
+      }
+      throw unix_error( "write (kernel TLS)" );
+    }
+    read_waiting_on_write_ = false;
+    outbound_plaintext_.pop( bytes_written );
+    return;
+  }
+
   const string_view source = outbound_plaintext_.readable_region();
 
   const auto write_count_before = socket_.write_count();
@@ -321,6 +517,7 @@ void SSLSession::do_write()
   }
 
   if ( bytes_written > 0 ) {
+    app_data_written_ = true;
     outbound_plaintext_.pop( bytes_written );
     return;
   }
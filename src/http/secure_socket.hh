@@ -89,6 +89,9 @@ protected:
 
 public:
   SSL_handle make_SSL_handle();
+
+  /* let sessions move record encryption into the kernel after the handshake (falls back if unavailable) */
+  void enable_kernel_tls();
 };
 
 class SSLClientContext : public SSLContext
@@ -150,8 +153,10 @@ public:
 /* SSL session */
 class SSLSession
 {
+public:
   static constexpr size_t storage_size = 65536;
 
+private:
   SSL_handle ssl_;
 
   TCPSocketBIO socket_;
@@ -165,9 +170,25 @@ class SSLSession
   bool write_waiting_on_read_ {};
   bool read_waiting_on_write_ {};
 
+  /* our TLS 1.3 application traffic secret, captured during the handshake if the context enables kTLS */
+  std::unique_ptr<std::string> tx_secret_ { std::make_unique<std::string>() };
+  bool app_data_written_ {};
+  bool kernel_tls_attempted_ {};
+  bool kernel_tls_tx_ {};
+
+  void try_kernel_tls();
+
+  void setup( const std::string& server_hostname );
+
 public:
   SSLSession( SSL_handle&& ssl, TCPSocket&& sock, const std::string& server_hostname = {} );
 
+  /* server session reusing plaintext buffers from an earlier session (see release_buffers) */
+  SSLSession( SSL_handle&& ssl, TCPSocket&& sock, RingBuffer&& outbound, RingBuffer&& inbound );
+
+  /* hand the plaintext buffers back (emptied) when the session is done, to save remapping them */
+  std::pair<RingBuffer, RingBuffer> release_buffers();
+
   RingBuffer& outbound_plaintext() { return outbound_plaintext_; }
   RingBuffer& inbound_plaintext() { return inbound_plaintext_; }
 
@@ -182,4 +203,10 @@ public:
 
   bool want_read() const;
   bool want_write() const;
+
+  /* peer has closed its side of the TLS session */
+  bool incoming_stream_terminated() const { return incoming_stream_terminated_; }
+
+  /* true once outgoing records are encrypted by the kernel */
+  bool kernel_tls() const { return kernel_tls_tx_; }
 };
@@ -1,3 +1,9 @@
+#if defined( __SSE2__ )
+#include <immintrin.h>
+#elif defined( __ARM_NEON )
+#include <arm_neon.h>
+#endif
+
 #include "ws_frame.hh"
 
 #include <array>
@@ -124,12 +130,116 @@ void WebSocketFrameReader::apply_mask()
   }
 
   /* remove masking */
-  for ( size_t i = 0; i < target_.payload.length(); i++ ) {
-    target_.payload[i] ^= ( *target_.masking_key )[i % 4];
+  apply_websocket_mask( target_.payload.data(), target_.payload.length(), target_.masking_key.value() );
+}
+
+void apply_websocket_mask( char* data, const size_t len, const array<uint8_t, 4>& key )
+{
+  /* the key repeats every 4 bytes, so every wide step below starts in phase */
+  uint64_t key64;
+  memcpy( &key64, key.data(), 4 );
+  memcpy( reinterpret_cast<char*>( &key64 ) + 4, key.data(), 4 );
+
+  size_t i = 0;
+
+#if defined( __SSE2__ )
+  const __m128i key128 = _mm_set1_epi64x( int64_t( key64 ) );
+  for ( ; i + 16 <= len; i += 16 ) {
+    __m128i* p = reinterpret_cast<__m128i*>( data + i );
+    _mm_storeu_si128( p, _mm_xor_si128( _mm_loadu_si128( p ), key128 ) );
+  }
+#elif defined( __ARM_NEON )
+  const uint8x16_t key128 = vreinterpretq_u8_u64( vdupq_n_u64( key64 ) );
+  for ( ; i + 16 <= len; i += 16 ) {
+    uint8_t* p = reinterpret_cast<uint8_t*>( data + i );
+    vst1q_u8( p, veorq_u8( vld1q_u8( p ), key128 ) );
+  }
+#endif
+
+  for ( ; i + 8 <= len; i += 8 ) {
+    uint64_t x;
+    memcpy( &x, data + i, 8 );
+    x ^= key64;
+    memcpy( data + i, &x, 8 );
+  }
+
+  for ( ; i < len; i++ ) {
+    data[i] ^= key[i % 4];
   }
 }
 
-void WebSocketFrame::serialize( Serializer& s ) const
+bool WebSocketFrameHeader::parse( const string_view input )
+{
+  incomplete = true;
+  if ( input.size() < 2 ) {
+    return false;
+  }
+
+  /* first octet: fin, RSV1-3, opcode */
+  const uint8_t b1 = input[0];
+  if ( b1 & 0b0111'0000 ) {
+    incomplete = false;
+    return false;
+  }
+
+  fin = b1 & 0b1000'0000;
+  opcode = WebSocketFrame::opcode_t( b1 & 0b0000'1111 );
+  if ( opcode > WebSocketFrame::opcode_t::Pong ) {
+    incomplete = false;
+    return false;
+  }
+
+  /* second octet: mask bit and payload_length sigil */
+  const uint8_t b2 = input[1];
+  const uint8_t payload_length_sigil = b2 & 0b0111'1111;
+  header_length = 2;
+  const size_t masking_key_length = ( b2 & 0b1000'0000 ) ? 4 : 0;
+  const size_t extended_length = payload_length_sigil < 126 ? 0 : payload_length_sigil == 126 ? 2 : 8;
+  if ( input.size() < header_length + extended_length + masking_key_length ) {
+    return false;
+  }
+  incomplete = false;
+
+  if ( payload_length_sigil < 126 ) {
+    payload_length = payload_length_sigil;
+  } else if ( payload_length_sigil == 126 ) {
+    Parser p { input.substr( header_length, sizeof( uint16_t ) ) };
+    uint16_t len16;
+    p.integer( len16 );
+    if ( p.error() or len16 < 126 ) {
+      p.clear_error();
+      return false;
+    }
+    payload_length = len16;
+    header_length += sizeof( uint16_t );
+  } else {
+    Parser p { input.substr( header_length, sizeof( uint64_t ) ) };
+    uint64_t len64;
+    p.integer( len64 );
+    if ( p.error() or len64 <= numeric_limits<uint16_t>::max()
+         or len64 > uint64_t( numeric_limits<int64_t>::max() ) ) {
+      p.clear_error();
+      return false;
+    }
+    payload_length = len64;
+    header_length += sizeof( uint64_t );
+  }
+
+  masking_key.reset();
+  if ( masking_key_length ) {
+    masking_key.emplace();
+    memcpy( masking_key->data(), input.data() + header_length, 4 );
+    header_length += 4;
+  }
+
+  return true;
+}
+
+void WebSocketFrame::serialize_header( Serializer& s,
+                                       const bool fin,
+                                       const opcode_t opcode,
+                                       const uint64_t payload_length,
+                                       const optional<array<uint8_t, 4>>& masking_key )
 {
   /* first octet: fin, RSV1-3 all zero, opcode */
   s.integer( uint8_t( ( fin << 7 ) | uint8_t( opcode ) ) );
@@ -137,17 +247,17 @@ void WebSocketFrame::serialize( Serializer& s ) const
   /* next: mask bit and payload_length */
   const uint8_t mask_bit = masking_key.has_value() << 7;
   uint8_t b2;
-  if ( payload.size() < 126 ) {
-    b2 = mask_bit | payload.size();
+  if ( payload_length < 126 ) {
+    b2 = mask_bit | payload_length;
     s.integer( b2 );
-  } else if ( payload.size() <= numeric_limits<uint16_t>::max() ) {
+  } else if ( payload_length <= numeric_limits<uint16_t>::max() ) {
     b2 = mask_bit | 126;
     s.integer( b2 );
-    s.integer( uint16_t( payload.size() ) );
-  } else if ( payload.size() <= uint64_t( numeric_limits<int64_t>::max() ) ) {
+    s.integer( uint16_t( payload_length ) );
+  } else if ( payload_length <= uint64_t( numeric_limits<int64_t>::max() ) ) {
     b2 = mask_bit | 127;
     s.integer( b2 );
-    s.integer( uint64_t( payload.size() ) );
+    s.integer( payload_length );
   } else {
     throw runtime_error( "invalid WebSocketFrame payload length" );
   }
@@ -157,6 +267,11 @@ void WebSocketFrame::serialize( Serializer& s ) const
     string_view array_sv { reinterpret_cast<const char*>( masking_key->data() ), masking_key->size() };
     s.string( array_sv );
   }
+}
+
+void WebSocketFrame::serialize( Serializer& s ) const
+{
+  serialize_header( s, fin, opcode, payload.size(), masking_key );
 
   /* serialize payload data (possibly masked) */
   if ( masking_key.has_value() ) {
@@ -180,28 +295,31 @@ void WebSocketFrame::serialize( string& out ) const
   }
 }
 
-uint32_t WebSocketFrame::serialized_length() const
+uint32_t WebSocketFrame::header_length( const uint64_t payload_length, const bool masked )
 {
   uint32_t ret = 2; /* first octet, mask bit, payload_length sigil */
-  if ( payload.size() < 126 ) {
+  if ( payload_length < 126 ) {
     /* do nothing */
-  } else if ( payload.size() <= numeric_limits<uint16_t>::max() ) {
+  } else if ( payload_length <= numeric_limits<uint16_t>::max() ) {
     ret += sizeof( uint16_t );
-  } else if ( payload.size() <= uint64_t( numeric_limits<int64_t>::max() ) ) {
+  } else if ( payload_length <= uint64_t( numeric_limits<int64_t>::max() ) ) {
     ret += sizeof( uint64_t );
   } else {
     throw runtime_error( "invalid WebSocketFrame payload length" );
   }
 
-  if ( masking_key.has_value() ) {
-    ret += sizeof( masking_key.value() );
+  if ( masked ) {
+    ret += sizeof( std::array<uint8_t, 4> );
   }
 
-  ret += payload.size();
-
   return ret;
 }
 
+uint32_t WebSocketFrame::serialized_length() const
+{
+  return header_length( payload.size(), masking_key.has_value() ) + payload.size();
+}
+
 void WebSocketFrame::clear()
 {
   fin = {};
@@ -28,6 +28,14 @@ struct WebSocketFrame
   void serialize( Serializer& s ) const;
   uint32_t serialized_length() const;
 
+  /* just the header, so a payload can be written after it in place */
+  static void serialize_header( Serializer& s,
+                                const bool fin,
+                                const opcode_t opcode,
+                                const uint64_t payload_length,
+                                const std::optional<std::array<uint8_t, 4>>& masking_key = {} );
+  static uint32_t header_length( const uint64_t payload_length, const bool masked = false );
+
   bool operator==( const WebSocketFrame& other ) const
   {
     return fin == other.fin and opcode == other.opcode and masking_key == other.masking_key
@@ -41,6 +49,25 @@ struct WebSocketFrame
   static constexpr uint8_t max_overhead() { return 14; }
 };
 
+/* XOR data with the repeating 4-byte masking key (vectorized where the CPU allows) */
+void apply_websocket_mask( char* data, const size_t len, const std::array<uint8_t, 4>& key );
+
+/* header of a frame that is already contiguous in memory, for parsing without copying */
+struct WebSocketFrameHeader
+{
+  bool fin {};
+  WebSocketFrame::opcode_t opcode {};
+  std::optional<std::array<uint8_t, 4>> masking_key {};
+  uint64_t payload_length {};
+  size_t header_length {};
+
+  /* set when parse() fails only because the input is too short so far */
+  bool incomplete {};
+
+  /* false if input doesn't hold a whole, valid header */
+  bool parse( const std::string_view input );
+};
+
 template<size_t target_length>
 class ArrayReader
 {
@@ -1,5 +1,7 @@
 #include "ws_server.hh"
 
+#include <cstring>
+
 #include <crypto++/base64.h>
 #include <crypto++/hex.h>
 #include <crypto++/sha.h>
@@ -11,6 +13,9 @@ void WebSocketEndpoint::pop_message()
 {
   message_.clear();
   message_in_progress_ = false;
+
+  /* the frame's bytes are released from the input buffer on the next read() */
+  in_place_message_.reset();
 }
 
 void WebSocketEndpoint::send_pong( RingBuffer& out )
@@ -40,11 +45,20 @@ void WebSocketEndpoint::send_close( RingBuffer& out )
 
 void WebSocketEndpoint::read( RingBuffer& in, RingBuffer& out )
 {
-  if ( should_close_connection() ) {
+  if ( in_place_bytes_to_pop_ and not in_place_message_.has_value() ) {
+    in.pop( in_place_bytes_to_pop_ );
+    in_place_bytes_to_pop_ = 0;
+  }
+
+  if ( should_close_connection() or in_place_message_.has_value() ) {
     return;
   }
 
   if ( not reader_.has_value() ) {
+    if ( read_in_place( in ) ) {
+      return;
+    }
+
     reader_.emplace( move( this_frame_ ) );
   }
 
@@ -111,69 +125,94 @@ void WebSocketEndpoint::read( RingBuffer& in, RingBuffer& out )
   }
 }
 
+bool WebSocketEndpoint::read_in_place( RingBuffer& in )
+{
+  string_span buffer = in.mutable_readable_region();
+  wait_until_pushed_ = 0;
+
+  WebSocketFrameHeader header;
+  if ( not header.parse( buffer ) ) {
+    if ( header.incomplete ) {
+      wait_until_pushed_ = in.bytes_pushed() + 1;
+      return true;
+    }
+    return false; /* the streaming reader will flag the error */
+  }
+
+  /* only a Text/Binary frame that is a whole message by itself; anything else is streamed */
+  const size_t frame_length = header.header_length + header.payload_length;
+  if ( message_in_progress_ or not header.fin
+       or ( header.opcode != WebSocketFrame::opcode_t::Text and header.opcode != WebSocketFrame::opcode_t::Binary )
+       or frame_length > in.capacity() ) {
+    return false;
+  }
+
+  /* the ring buffer is contiguous, so wait for the rest of the frame instead of copying it out piecemeal */
+  if ( buffer.size() < frame_length ) {
+    wait_until_pushed_ = in.bytes_popped() + frame_length;
+    return true;
+  }
+
+  string_span payload = buffer.substr( header.header_length, header.payload_length );
+  if ( header.masking_key.has_value() ) {
+    apply_websocket_mask( payload.mutable_data(), payload.size(), header.masking_key.value() );
+  }
+
+  in_place_message_ = payload;
+  in_place_bytes_to_pop_ = frame_length;
+  return true;
+}
+
 static constexpr char WS_MAGIC_STRING[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 
 void WebSocketServer::do_handshake( RingBuffer& in, RingBuffer& out )
 {
-  cerr << "do_handshake called\n";
-
   if ( handshake_complete() ) {
     throw runtime_error( "do_handshake: handshake is complete" );
   }
 
-  if ( not handshake_reader_.finished() ) {
-    in.pop( handshake_reader_.read( in.readable_region() ) );
-  }
-
-  if ( not handshake_reader_.finished() ) {
-    cerr << "still not finished\n";
+  /* the request stays in the input buffer (parsed in place) until it has been answered */
+  const string_view buffer = in.readable_region();
+  if ( not handshake_parser_.parse( buffer ) ) {
     return;
   }
 
-  const auto request = handshake_reader_.release();
+  const auto pop_request = [&] {
+    in.pop( handshake_parser_.length() );
+    handshake_parser_.reset();
+  };
 
-  if ( request.method != "GET" ) {
+  if ( handshake_parser_.method( buffer ) != "GET" ) {
     cerr << "not get\n";
+    pop_request();
     send_forbidden_response( out );
     return;
   }
 
-  if ( request.http_version != "HTTP/1.1" ) {
+  if ( handshake_parser_.http_version( buffer ) != "HTTP/1.1" ) {
     cerr << "not HTTP/1.1\n";
+    pop_request();
     send_forbidden_response( out );
     return;
   }
 
-  /*
-  if ( not request.headers.connection_upgrade ) {
-    cerr << "no connection upgrade\n";
-    send_forbidden_response( out );
-    return;
-  }
-  */
-
-  if ( not HTTPHeaderReader::header_equals( request.headers.upgrade, "websocket" ) ) {
-    cerr << "no upgrade websocket: header value is {" + request.headers.upgrade + "}\n";
+  const string_view upgrade = handshake_parser_.header( buffer, "Upgrade" ).value_or( string_view {} );
+  if ( not HTTPHeaderReader::header_equals( upgrade, "websocket" ) ) {
+    cerr << "no upgrade websocket: header value is {" << upgrade << "}\n";
+    pop_request();
     send_forbidden_response( out );
     return;
   }
 
-  if ( request.headers.sec_websocket_key.empty() ) {
+  const string_view key = handshake_parser_.header( buffer, "Sec-WebSocket-Key" ).value_or( string_view {} );
+  if ( key.empty() ) {
     cerr << "no key\n";
+    pop_request();
     send_forbidden_response( out );
     return;
   }
 
   /* ignore origin */
-  /*
-  if ( request.headers.origin != origin_ ) {
-    cerr << "bad origin (" + request.headers.origin + " vs. " + origin_ + "\n";
-    send_forbidden_response( out );
-    return;
-  }
-  */
-
-  cerr << "Sending happy response\n";
 
   /* make reply */
   HTTPResponse response;
@@ -184,13 +223,16 @@ void WebSocketServer::do_handshake( RingBuffer& in, RingBuffer& out )
   response.headers.upgrade = "websocket";
 
   CryptoPP::SHA1 sha1_function;
-  StringSource s(
-    request.headers.sec_websocket_key + WS_MAGIC_STRING,
-    true,
-    new HashFilter( sha1_function,
-                    new Base64Encoder( new StringSink( response.headers.sec_websocket_accept ), false ) ) );
+  sha1_function.Update( reinterpret_cast<const unsigned char*>( key.data() ), key.size() );
+  sha1_function.Update( reinterpret_cast<const unsigned char*>( WS_MAGIC_STRING ), strlen( WS_MAGIC_STRING ) );
+  unsigned char digest[CryptoPP::SHA1::DIGESTSIZE];
+  sha1_function.Final( digest );
+  StringSource s( digest,
+                  sizeof( digest ),
+                  true,
+                  new Base64Encoder( new StringSink( response.headers.sec_websocket_accept ), false ) );
 
-  HTTPResponse response_save = response;
+  pop_request();
 
   HTTPResponseWriter writer { move( response ) };
   writer.write_to( out );
@@ -199,13 +241,6 @@ void WebSocketServer::do_handshake( RingBuffer& in, RingBuffer& out )
     return;
   }
   handshake_complete_ = true;
-
-  cerr << "Here is the happy response:\n";
-
-  HTTPResponseWriter writer2 { move( response_save ) };
-  RingBuffer debug_out { 16384 };
-  writer2.write_to( debug_out );
-  cerr << debug_out.readable_region() << "\n\n";
 }
 
 void WebSocketServer::send_forbidden_response( RingBuffer& out )
@@ -15,6 +15,15 @@ class WebSocketEndpoint
   WebSocketFrame message_ {}, this_frame_ {};
   std::optional<WebSocketFrameReader> reader_ {};
 
+  /* a whole unfragmented data frame, unmasked in place in the input buffer */
+  std::optional<std::string_view> in_place_message_ {};
+  size_t in_place_bytes_to_pop_ {};
+
+  /* input.bytes_pushed() needed before a frame waiting to arrive whole can make progress */
+  size_t wait_until_pushed_ {};
+
+  bool read_in_place( RingBuffer& in );
+
   void send_pong( RingBuffer& out );
   void send_close( RingBuffer& out );
 
@@ -24,16 +33,24 @@ public:
   void read( RingBuffer& in, RingBuffer& out );
   bool should_close_connection() const { return error_ or closed_; }
 
+  /* whether read() can make progress on what's in the input buffer */
+  bool wants_read( const RingBuffer& in ) const
+  {
+    return ( not in.readable_region().empty() ) and in.bytes_pushed() >= wait_until_pushed_;
+  }
+
   void pop_message();
-  bool ready() const { return message_.fin; }
-  const std::string& message() const { return message_.payload; }
+  bool ready() const { return in_place_message_.has_value() or message_.fin; }
+
+  /* valid until pop_message() */
+  std::string_view message() const { return in_place_message_.value_or( message_.payload ); }
 };
 
 class WebSocketServer
 {
   std::string origin_ {};
 
-  HTTPRequestReader handshake_reader_ { {}, {} };
+  HTTPRequestParser handshake_parser_ {};
 
   bool error_ {};
   bool handshake_complete_ {};
@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <iostream>
+
+#include "ws_server_host.hh"
+
+using namespace std;
+
+WebSocketServerHost::Connection::Connection( SSL_handle&& ssl,
+                                             TCPSocket&& sock,
+                                             pair<RingBuffer, RingBuffer>&& buffers,
+                                             const Config& config,
+                                             const size_t slot )
+  : ssl_session_( move( ssl ), move( sock ), move( buffers.first ), move( buffers.second ) )
+  , ws_server_( config.origin )
+  , outbound_quota_( config.outbound_quota )
+  , slot_( slot )
+{}
+
+size_t WebSocketServerHost::Connection::send_room() const
+{
+  const RingBuffer& out = ssl_session_.outbound_plaintext();
+  if ( out.bytes_stored() >= outbound_quota_ ) {
+    return 0;
+  }
+
+  const size_t room = min( outbound_quota_ - out.bytes_stored(), out.writable_region().size() );
+  return room > WebSocketFrame::max_overhead() ? room - WebSocketFrame::max_overhead() : 0;
+}
+
+string_span WebSocketServerHost::Connection::begin_frame( const size_t payload_length )
+{
+  if ( pending_payload_ ) {
+    throw runtime_error( "begin_frame: previous frame not finished" );
+  }
+
+  if ( not can_send( payload_length ) ) {
+    throw runtime_error( "begin_frame: no room for frame" );
+  }
+
+  RingBuffer& out = ssl_session_.outbound_plaintext();
+  Serializer s { out.writable_region() };
+  WebSocketFrame::serialize_header( s, true, WebSocketFrame::opcode_t::Binary, payload_length );
+  out.push( s.bytes_written() );
+
+  pending_payload_ = payload_length;
+  return out.writable_region().substr( 0, payload_length );
+}
+
+void WebSocketServerHost::Connection::end_frame()
+{
+  ssl_session_.outbound_plaintext().push( pending_payload_ );
+  pending_payload_ = 0;
+}
+
+void WebSocketServerHost::Connection::send_frame( const string_view payload )
+{
+  begin_frame( payload.size() ).copy( payload );
+  end_frame();
+}
+
+void WebSocketServerHost::Connection::close( const string_view reason )
+{
+  if ( not error_text_.empty() ) {
+    error_text_ += " + "sv;
+  }
+  error_text_ += reason;
+
+  good_ = false;
+}
+
+WebSocketServerHost::WebSocketServerHost( EventLoop& loop,
+                                          SSLContext& ssl_context,
+                                          TCPSocket&& listen_socket,
+                                          const Config& config,
+                                          const HandlerFactory& make_handler )
+  : loop_( loop )
+  , ssl_context_( ssl_context )
+  , listen_socket_( move( listen_socket ) )
+  , config_( config )
+  , make_handler_( make_handler )
+{
+  listen_socket_.set_blocking( false );
+  socket_events_.reserve( 256 );
+
+  loop_.add_rule(
+    "new TCP connections",
+    listen_socket_,
+    Direction::In,
+    [this] { accept_batch(); },
+    [this] { return live_connections_ < config_.max_connections; } );
+
+  loop_.add_rule( "SSL read/write", sockets_, Direction::In, [this] { handle_socket_events(); } );
+
+  loop_.add_rule(
+    "WebSocket service", [this] { service(); }, [this] { return not ready_.empty(); } );
+}
+
+void WebSocketServerHost::accept_batch()
+{
+  for ( unsigned int i = 0; i < config_.accept_batch and live_connections_ < config_.max_connections; i++ ) {
+    optional<TCPSocket> sock = listen_socket_.try_accept();
+    if ( not sock.has_value() ) {
+      return;
+    }
+
+    try {
+      open( move( sock.value() ) );
+    } catch ( const exception& e ) {
+      cerr << "Could not set up connection: " << e.what() << "\n";
+    }
+  }
+}
+
+void WebSocketServerHost::open( TCPSocket&& sock )
+{
+  sock.set_tcp_nodelay( true );
+
+  size_t slot;
+  if ( free_slots_.empty() ) {
+    slot = slots_.size();
+    slots_.push_back( make_unique<optional<Connection>>() );
+  } else {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  }
+
+  pair<RingBuffer, RingBuffer> buffers = [&] {
+    if ( spare_buffers_.empty() ) {
+      return pair<RingBuffer, RingBuffer> { RingBuffer { SSLSession::storage_size },
+                                            RingBuffer { SSLSession::storage_size } };
+    }
+    auto ret = move( spare_buffers_.back() );
+    spare_buffers_.pop_back();
+    stats_.buffers_reused++;
+    return ret;
+  }();
+
+  optional<Connection>& storage = *slots_.at( slot );
+  try {
+    storage.emplace( ssl_context_.make_SSL_handle(), move( sock ), move( buffers ), config_, slot );
+    storage->handler_ = make_handler_( *storage );
+  } catch ( ... ) {
+    storage.reset();
+    free_slots_.push_back( slot );
+    throw;
+  }
+
+  Connection& connection = *storage;
+  live_connections_++;
+  stats_.accepted++;
+  stats_.peak_connections = max( stats_.peak_connections, live_connections_ );
+
+  sockets_.add( connection.socket(), 0, slot );
+  update_interest( connection );
+}
+
+void WebSocketServerHost::update_interest( Connection& connection )
+{
+  uint32_t events = 0;
+  if ( connection.good() ) {
+    events |= connection.ssl_session_.want_read() ? uint32_t( EPOLLIN ) : 0;
+    events |= connection.ssl_session_.want_write() ? uint32_t( EPOLLOUT ) : 0;
+  }
+
+  if ( events != connection.epoll_events_ ) {
+    sockets_.modify( connection.socket(), events, connection.slot_ );
+    connection.epoll_events_ = events;
+  }
+}
+
+void WebSocketServerHost::handle_socket_events()
+{
+  sockets_.wait( socket_events_ );
+  stats_.socket_events += socket_events_.size();
+
+  for ( const auto& event : socket_events_ ) {
+    optional<Connection>& storage = *slots_.at( event.data.u64 );
+    if ( not storage.has_value() or not storage->good() ) {
+      continue;
+    }
+
+    Connection& c = *storage;
+    SSLSession& session = c.ssl_session_;
+
+    try {
+      if ( ( event.events & ( EPOLLIN | EPOLLERR | EPOLLHUP ) ) and session.want_read() ) {
+        session.do_read();
+      }
+
+      if ( ( event.events & EPOLLOUT ) and session.want_write() ) {
+        session.do_write();
+      }
+
+      /* a peer that hangs up without a close_notify just looks like a read that would block to OpenSSL */
+      if ( session.incoming_stream_terminated() or c.socket().eof() ) {
+        c.close( "peer closed connection" );
+      } else if ( ( event.events & ( EPOLLERR | EPOLLHUP ) ) and not session.want_read() ) {
+        c.close( "socket closed" );
+      }
+    } catch ( const exception& e ) {
+      c.close( e.what() );
+    }
+
+    update_interest( c );
+    mark_ready( c );
+  }
+}
+
+void WebSocketServerHost::mark_ready( Connection& connection )
+{
+  if ( not connection.queued_ ) {
+    connection.queued_ = true;
+    ready_.push_back( connection.slot_ );
+  }
+}
+
+void WebSocketServerHost::wake_all()
+{
+  for ( auto& slot : slots_ ) {
+    if ( slot->has_value() ) {
+      mark_ready( slot->value() );
+    }
+  }
+}
+
+void WebSocketServerHost::service()
+{
+  const size_t slot = ready_.front();
+  ready_.pop_front();
+
+  optional<Connection>& storage = *slots_.at( slot );
+  if ( not storage.has_value() ) {
+    return;
+  }
+
+  Connection& c = *storage;
+  c.queued_ = false;
+  stats_.services++;
+
+  RingBuffer& inbound = c.ssl_session_.inbound_plaintext();
+  RingBuffer& outbound = c.ssl_session_.outbound_plaintext();
+
+  try {
+    if ( c.good() and not c.ws_server_.handshake_complete() and not inbound.readable_region().empty() ) {
+      c.ws_server_.do_handshake( inbound, outbound );
+    }
+
+    if ( c.ws_server_.handshake_complete() ) {
+      WebSocketEndpoint& endpoint = c.ws_server_.endpoint();
+      while ( c.good() and endpoint.wants_read( inbound ) ) {
+        endpoint.read( inbound, outbound );
+        if ( endpoint.ready() ) {
+          c.handler_->on_message( c, endpoint.message() );
+          endpoint.pop_message();
+        }
+      }
+
+      if ( c.good() and not c.ws_server_.should_close_connection() ) {
+        if ( c.send_room() > 0 ) {
+          c.handler_->on_writable( c );
+        } else {
+          stats_.quota_stalls++;
+        }
+      }
+    }
+  } catch ( const exception& e ) {
+    c.close( e.what() );
+  }
+
+  if ( c.good() and c.ws_server_.should_close_connection() and outbound.readable_region().empty() ) {
+    c.close( "WebSocket closure or error" );
+  }
+
+  if ( c.good() ) {
+    update_interest( c );
+  } else {
+    recycle( slot );
+  }
+}
+
+void WebSocketServerHost::recycle( const size_t slot )
+{
+  optional<Connection>& storage = *slots_.at( slot );
+  Connection& c = *storage;
+
+  if ( not c.error_text_.empty() ) {
+    cerr << "Client error: " << c.error_text_ << "\n";
+  }
+
+  c.handler_.reset();
+  sockets_.remove( c.socket() );
+
+  if ( spare_buffers_.size() < config_.max_spare_buffers ) {
+    spare_buffers_.push_back( c.ssl_session_.release_buffers() );
+  }
+
+  storage.reset();
+  free_slots_.push_back( slot );
+  live_connections_--;
+  stats_.closed++;
+}
+
+void WebSocketServerHost::summary( ostream& out ) const
+{
+  size_t kernel_tls = 0;
+  for ( const auto& slot : slots_ ) {
+    if ( slot->has_value() and slot->value().kernel_tls() ) {
+      kernel_tls++;
+    }
+  }
+
+  out << "Connections: " << live_connections_ << " (peak " << stats_.peak_connections << ", kTLS " << kernel_tls
+      << "), accepted=" << stats_.accepted << " closed=" << stats_.closed
+      << " buffers reused=" << stats_.buffers_reused << "\n";
+  out << "   socket events=" << stats_.socket_events << " services=" << stats_.services << " quota stalls=" << stats_.quota_stalls
+      << " ready=" << ready_.size() << "\n";
+}
+
+void WebSocketServerHost::reset_summary()
+{
+  stats_ = {};
+  stats_.peak_connections = live_connections_;
+}
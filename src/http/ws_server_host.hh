@@ -0,0 +1,151 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "epoll.hh"
+#include "eventloop.hh"
+#include "secure_socket.hh"
+#include "summarize.hh"
+#include "ws_server.hh"
+
+/* runs many TLS WebSocket connections on one EventLoop: connection slots and their buffers are reused,
+   the sockets share one epoll set (a single EventLoop rule), and only connections that something happened
+   to are visited, from a ready queue, instead of polling rules for every connection */
+class WebSocketServerHost : public Summarizable
+{
+public:
+  struct Config
+  {
+    std::string origin {};
+    size_t max_connections = 4096;
+
+    /* connections accepted per readiness event on the listening socket */
+    unsigned int accept_batch = 64;
+
+    /* most plaintext a connection may have queued before the application is asked for more */
+    size_t outbound_quota = 49152;
+
+    /* plaintext buffers kept from closed connections for new ones */
+    size_t max_spare_buffers = 256;
+  };
+
+  class Connection;
+
+  /* application side of one connection */
+  class Handler
+  {
+  public:
+    virtual void on_message( Connection& connection, const std::string_view message ) = 0;
+
+    /* called when the connection is serviced and has room to send (send until can_send() says no) */
+    virtual void on_writable( Connection& connection ) = 0;
+
+    virtual ~Handler() {}
+  };
+
+  using HandlerFactory = std::function<std::unique_ptr<Handler>( Connection& )>;
+
+  class Connection
+  {
+    friend class WebSocketServerHost;
+
+    SSLSession ssl_session_;
+    WebSocketServer ws_server_;
+    size_t outbound_quota_;
+    std::unique_ptr<Handler> handler_ {};
+    uint32_t epoll_events_ {};
+
+    size_t slot_;
+    bool queued_ {};
+    bool good_ = true;
+    std::string error_text_ {};
+
+    size_t pending_payload_ {};
+
+  public:
+    Connection( SSL_handle&& ssl,
+                TCPSocket&& sock,
+                std::pair<RingBuffer, RingBuffer>&& buffers,
+                const Config& config,
+                const size_t slot );
+
+    const TCPSocket& socket() const { return ssl_session_.socket(); }
+    bool kernel_tls() const { return ssl_session_.kernel_tls(); }
+    bool handshake_complete() const { return ws_server_.handshake_complete(); }
+    bool good() const { return good_; }
+
+    /* plaintext queued for this connection but not yet handed to TLS */
+    size_t outbound_bytes() const { return ssl_session_.outbound_plaintext().bytes_stored(); }
+    size_t outbound_quota() const { return outbound_quota_; }
+
+    /* largest payload that fits in one more frame under the quota (0 if none) */
+    size_t send_room() const;
+    bool can_send( const size_t payload_length ) const { return send_room() >= payload_length; }
+
+    /* writes a Binary frame header straight into the outbound buffer and returns where its payload goes;
+       fill in exactly payload_length bytes, then call end_frame() */
+    string_span begin_frame( const size_t payload_length );
+    void end_frame();
+
+    void send_frame( const std::string_view payload );
+
+    void close( const std::string_view reason );
+  };
+
+private:
+  EventLoop& loop_;
+  SSLContext& ssl_context_;
+  TCPSocket listen_socket_;
+  Config config_;
+  HandlerFactory make_handler_;
+
+  EpollSet sockets_ {};
+  std::vector<epoll_event> socket_events_ {};
+
+  /* a slot's storage outlives its connections; free slots are reused first */
+  std::vector<std::unique_ptr<std::optional<Connection>>> slots_ {};
+  std::vector<size_t> free_slots_ {};
+  size_t live_connections_ {};
+
+  /* plaintext buffers left by closed connections */
+  std::vector<std::pair<RingBuffer, RingBuffer>> spare_buffers_ {};
+
+  /* connections with something to do, each at most once */
+  std::deque<size_t> ready_ {};
+
+  struct Statistics
+  {
+    unsigned int accepted, closed, buffers_reused, socket_events, services, quota_stalls;
+    size_t peak_connections;
+  } stats_ {};
+
+  void accept_batch();
+  void open( TCPSocket&& sock );
+  void recycle( const size_t slot );
+
+  void handle_socket_events();
+  void update_interest( Connection& connection );
+  void mark_ready( Connection& connection );
+  void service();
+
+public:
+  WebSocketServerHost( EventLoop& loop,
+                       SSLContext& ssl_context,
+                       TCPSocket&& listen_socket,
+                       const Config& config,
+                       const HandlerFactory& make_handler );
+
+  /* visit every connection (e.g. after new data arrives for all of them) */
+  void wake_all();
+
+  size_t connection_count() const { return live_connections_; }
+
+  void summary( std::ostream& out ) const override;
+  void reset_summary() override;
+};
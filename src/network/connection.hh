@@ -41,8 +41,17 @@ public:
   const Address& destination() const { return destination_.value(); }
 
   void push_frame( SourceType& source ) { sender_.push_frame( source ); }
+
+  /* from anything else with front() and pop_frame(), e.g. a frame encoded once for several connections */
+  template<class OtherSourceType>
+  void push_frame( OtherSourceType& source )
+  {
+    sender_.push_frame( source );
+  }
+
   void summary( std::ostream& out ) const override;
 
+  bool has_new_frame() const { return sender_.has_new_frame(); }
   void send_packet( UDPSocket& socket );
   bool receive_packet( const Ciphertext& ciphertext, const Address& source );
   bool receive_packet( const Ciphertext& ciphertext );
@@ -51,6 +60,7 @@ public:
   uint32_t unreceived_beyond_this_frame_index() const { return receiver_.unreceived_beyond_this_frame_index(); }
   const PartialFrameStore<FrameType>& frames() const { return receiver_.frames(); }
   void pop_frames( const size_t num ) { receiver_.pop_frames( num ); }
+  void skip_to( const uint32_t frame_index ) { receiver_.skip_to( frame_index ); }
 
   uint8_t node_id() const { return node_id_; }
   uint8_t peer_id() const { return peer_id_; }
@@ -115,10 +115,21 @@ void KeyMessage::serialize( Serializer& s ) const
 {
   s.object( id );
   s.object( key_pair );
+  s.object( frame_samples );
 }
 
 void KeyMessage::parse( Parser& p )
 {
   p.object( id );
   p.object( key_pair );
+
+  /* a server from before frame durations were negotiated doesn't send one */
+  frame_samples = opus_frame::NUM_SAMPLES;
+  if ( not p.input().empty() ) {
+    p.object( frame_samples );
+  }
+
+  if ( not opus_frame::valid_num_samples( frame_samples ) ) {
+    p.set_error();
+  }
 }
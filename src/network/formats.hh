@@ -10,13 +10,11 @@
 
 struct AudioFrame
 {
-  uint32_t frame_index {}; // units of opus_frame::NUM_SAMPLES, about two months at 2^31 * 120 / 48 kHz
+  uint32_t frame_index {}; // units of the session's frame duration, at least two months at 2^31 * 2.5 ms
   bool separate_channels {};
 
   opus_frame frame1 {}, frame2 {};
 
-  size_t sample_index() const { return frame_index * opus_frame::NUM_SAMPLES; }
-
   uint8_t serialized_length() const;
   void serialize( Serializer& s ) const;
   void parse( Parser& p );
@@ -24,7 +22,7 @@ struct AudioFrame
   static constexpr uint8_t frames_per_packet = 8;
 };
 
-static_assert( sizeof( AudioFrame ) == 128 );
+static_assert( sizeof( AudioFrame ) == 248 );
 
 struct VideoChunk
 {
@@ -175,7 +173,15 @@ struct KeyMessage
   NetInteger<uint8_t> id {};
   KeyPair key_pair {};
 
-  constexpr uint32_t serialized_length() const { return id.serialized_length() + key_pair.serialized_length(); }
+  /* Opus frame duration for the session, in samples: the client asks for one in its key request (an empty
+     request means opus_frame::NUM_SAMPLES, and is what it sends for that, as older servers accept nothing else),
+     and the server's reply settles it (absent from older servers' replies, meaning the same) */
+  NetInteger<uint16_t> frame_samples { opus_frame::NUM_SAMPLES };
+
+  constexpr uint32_t serialized_length() const
+  {
+    return id.serialized_length() + key_pair.serialized_length() + frame_samples.serialized_length();
+  }
   void serialize( Serializer& s ) const;
   void parse( Parser& p );
 };
@@ -122,6 +122,9 @@ void NetworkReceiver<FrameType>::summary( ostream& out ) const
   if ( stats_.dropped ) {
     out << " dropped=" << stats_.dropped << "!";
   }
+  if ( stats_.skipped ) {
+    out << " skipped=" << stats_.skipped << "!";
+  }
 
   const uint32_t contiguous_count = next_frame_needed_ - frames_.range_begin();
   uint32_t other_count = 0;
@@ -167,4 +170,22 @@ void NetworkReceiver<FrameType>::pop_frames( const size_t num )
   stats_.popped += num;
 }
 
+template<class FrameType>
+void NetworkReceiver<FrameType>::skip_to( const uint32_t frame_index )
+{
+  if ( frame_index <= next_frame_needed_ ) {
+    return;
+  }
+
+  for ( uint32_t i = next_frame_needed_; i < frame_index; i++ ) {
+    if ( not frames_.has_value( i ) ) {
+      stats_.skipped++;
+    }
+  }
+
+  frames_.pop_before( frame_index );
+  next_frame_needed_ = frame_index;
+  advance_next_frame_needed();
+}
+
 template class NetworkReceiver<AudioFrame>;
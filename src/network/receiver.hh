@@ -39,7 +39,7 @@ class NetworkReceiver
 public:
   struct Statistics
   {
-    unsigned int already_acked, redundant, dropped, popped;
+    unsigned int already_acked, redundant, dropped, popped, skipped;
     std::optional<uint64_t> last_new_frame_received;
   };
 
@@ -58,6 +58,9 @@ public:
   const PartialFrameStore<FrameType>& frames() const { return frames_; }
   void pop_frames( const size_t num );
 
+  /* give up on frames before this index (e.g. too late to be useful), so they are no longer requested */
+  void skip_to( const uint32_t frame_index );
+
   uint32_t biggest_seqno_received() const { return biggest_seqno_received_.value(); }
 
   const Statistics& stats() const { return stats_; }
@@ -102,6 +102,7 @@ void NetworkSender<FrameType>::set_sender_section( typename Packet<FrameType>::S
     }
 
     /* now, attempt to fill up the other slots for frames in the packet */
+    uint32_t frame_bytes = p.frames.serialized_length();
     span<FrameStatus> statuses
       = frame_status_.region( frame_status_.range_begin(), next_frame_index_ - frame_status_.range_begin() );
     const span_view<FrameType> frames
@@ -110,6 +111,11 @@ void NetworkSender<FrameType>::set_sender_section( typename Packet<FrameType>::S
       auto& status = statuses[i];
 
       if ( status.needs_send() ) {
+        frame_bytes += frames[i].serialized_length();
+        if ( frame_bytes > max_frame_bytes ) {
+          break;
+        }
+
         p.frames.push_back( frames[i] );
         status.in_flight = true;
 
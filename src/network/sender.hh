@@ -17,11 +17,15 @@ class NetworkSender
     bool needs_send() const { return outstanding and not in_flight; }
   };
 
-  EndlessBuffer<FrameType> frames_ { 8192 }; // 20.48 seconds
+  EndlessBuffer<FrameType> frames_ { 8192 }; // 20.48 seconds of 2.5 ms frames
   EndlessBuffer<FrameStatus> frame_status_ { 8192 };
   uint32_t next_frame_index_ {};
 
-  constexpr static uint8_t reorder_window = 2; /* 2 packets, about 5 ms */
+  constexpr static uint8_t reorder_window = 2; /* 2 packets, 5 to 20 ms depending on the frame duration */
+
+  /* bytes of frames per packet (longer frames mean fewer retransmissions fit alongside the newest) */
+  constexpr static uint32_t max_frame_bytes = 1100;
+
   std::optional<uint32_t> greatest_sack_ {};
   uint32_t departure_adjudicated_until_seqno() const;
 
@@ -97,4 +101,7 @@ public:
   void summary( std::ostream& out ) const;
 
   const Statistics& stats() const { return stats_; }
+
+  /* has a frame been pushed since the last packet? */
+  bool has_new_frame() const { return need_immediate_send_; }
 };
@@ -1,15 +1,24 @@
 #include "cursor.hh"
 #include "ewma.hh"
 
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
 
-Cursor::Cursor( const uint32_t target_lag_samples, const uint32_t min_lag_samples, const uint32_t max_lag_samples )
+Cursor::Cursor( const uint32_t target_lag_samples,
+                const uint32_t min_lag_samples,
+                const uint32_t max_lag_samples,
+                const uint32_t frame_samples )
   : target_lag_samples_( target_lag_samples )
   , min_lag_samples_( min_lag_samples )
   , max_lag_samples_( max_lag_samples )
-{}
+  , frame_samples_( frame_samples )
+{
+  if ( not opus_frame::valid_num_samples( frame_samples_ ) ) {
+    throw runtime_error( "Cursor: invalid frame duration" );
+  }
+}
 
 void Cursor::miss()
 {
@@ -25,24 +34,16 @@ void Cursor::setup( const size_t global_sample_index, const size_t frontier_samp
 {
   /* initialize cursor if necessary */
   if ( not frame_cursor_.has_value() and frontier_sample_index > target_lag_samples_ ) {
-    frame_cursor_ = ( frontier_sample_index - target_lag_samples_ ) / opus_frame::NUM_SAMPLES;
+    frame_cursor_ = ( frontier_sample_index - target_lag_samples_ ) / frame_samples_;
     num_samples_output_ = global_sample_index;
     rate_ = Rate::Steady;
     stats_.resets++;
   }
 }
 
-void Cursor::sample( const PartialFrameStore<AudioFrame>& frames,
-                     const size_t frontier_sample_index,
-                     OpusDecoderProcess& decoder,
-                     RubberBand::RubberBandStretcher& stretcher,
-                     AudioSlice& output )
+bool Cursor::adjust( const size_t frontier_sample_index, TimeScaler& stretcher )
 {
-  bool fade_in_ {};
-
-  if ( not initialized() ) {
-    throw runtime_error( "Cursor::sample() called on uninitialized Cursor" );
-  }
+  bool fade_in = false;
 
   /* adjust cursor if necessary */
   if ( greatest_read_location() >= frontier_sample_index ) {
@@ -51,22 +52,19 @@ void Cursor::sample( const PartialFrameStore<AudioFrame>& frames,
       /* not enough audio? */
       frame_cursor_.reset();
       num_samples_output_.reset();
-      output.good = false;
-      return;
+      return false;
     }
 
-    frame_cursor_ = ( frontier_sample_index - target_lag_samples_ ) / opus_frame::NUM_SAMPLES;
+    frame_cursor_ = ( frontier_sample_index - target_lag_samples_ ) / frame_samples_;
     rate_ = Rate::Steady;
     if ( greatest_read_location() >= frontier_sample_index ) {
       throw runtime_error( "internal error" );
     }
     stats_.resets++;
-    fade_in_ = true;
+    fade_in = true;
   }
 
   /* sample statistics */
-  const uint64_t frame_cursor = frame_cursor_.value();
-
   const int64_t margin_to_frontier = frontier_sample_index - greatest_read_location();
   ewma_update( stats_.mean_margin_to_frontier, margin_to_frontier, ALPHA );
 
@@ -75,14 +73,14 @@ void Cursor::sample( const PartialFrameStore<AudioFrame>& frames,
   /* 1) should we stop compressing? */
   if ( rate_ == Rate::Compressing and ( margin_to_frontier <= target_lag_samples_ ) ) {
     rate_ = Rate::Steady;
-    stretcher.setTimeRatio( 1.00 );
+    stretcher.set_time_ratio( 1.00 );
     stats_.compress_stops++;
   }
 
   /* 2) should we stop expanding? */
   if ( rate_ == Rate::Expanding and ( margin_to_frontier >= target_lag_samples_ ) ) {
     rate_ = Rate::Steady;
-    stretcher.setTimeRatio( 1.00 );
+    stretcher.set_time_ratio( 1.00 );
     stats_.expand_stops++;
   }
 
@@ -90,79 +88,142 @@ void Cursor::sample( const PartialFrameStore<AudioFrame>& frames,
   if ( rate_ == Rate::Steady ) {
     if ( ( margin_to_frontier > max_lag_samples_ ) and ( stats_.mean_margin_to_frontier > max_lag_samples_ ) ) {
       rate_ = Rate::Compressing;
-      stretcher.setTimeRatio( 0.95 );
+      stretcher.set_time_ratio( 0.95 );
       stats_.compress_starts++;
     } else if ( ( margin_to_frontier < min_lag_samples_ )
                 and ( stats_.mean_margin_to_frontier < min_lag_samples_ ) ) {
       rate_ = Rate::Expanding;
-      stretcher.setTimeRatio( 1.05 );
+      stretcher.set_time_ratio( 1.05 );
       stats_.expand_starts++;
     }
   }
 
-  ewma_update( stats_.mean_time_ratio, stretcher.getTimeRatio(), ALPHA );
-
-  array<float, opus_frame::NUM_SAMPLES> ch1_scratch, ch2_scratch;
-  span<float> ch1_decoded { ch1_scratch.data(), opus_frame::NUM_SAMPLES };
-  span<float> ch2_decoded { ch2_scratch.data(), opus_frame::NUM_SAMPLES };
-
-  /* Do we have an Opus frame ready to decode? */
-  if ( not frames.has_value( frame_cursor ) ) {
-    /* no, so leave it as silence */
-    miss();
-    decoder.decode_missing( ch1_decoded, ch2_decoded );
-  } else {
-    /* decode a frame! */
-    hit();
-
-    if ( frames.at( frame_cursor ).value().separate_channels ) {
-      decoder.decode( frames.at( frame_cursor ).value().frame1,
-                      frames.at( frame_cursor ).value().frame2,
-                      ch1_decoded,
-                      ch2_decoded );
-    } else {
-      decoder.decode_stereo( frames.at( frame_cursor ).value().frame1, ch1_decoded, ch2_decoded );
-    }
-  }
+  return fade_in;
+}
 
-  if ( fade_in_ ) {
-    for ( uint16_t i = 0; i < opus_frame::NUM_SAMPLES; i++ ) {
-      ch1_decoded[i] *= double( i ) / double( opus_frame::NUM_SAMPLES );
-      ch2_decoded[i] *= double( i ) / double( opus_frame::NUM_SAMPLES );
-    }
-    stats_.fades_in++;
+/* would adjust() leave the rate alone for a frame with this margin? (the margin only shrinks within a batch) */
+bool Cursor::same_rate_at( const int64_t margin_to_frontier ) const
+{
+  switch ( rate_ ) {
+    case Rate::Steady:
+      return margin_to_frontier >= min_lag_samples_ and margin_to_frontier <= max_lag_samples_;
+    case Rate::Compressing:
+      return margin_to_frontier > target_lag_samples_;
+    case Rate::Expanding:
+      return true;
   }
 
-  /* time-stretch */
-  array<float*, 2> decoded_audio_for_stretcher = { ch1_scratch.data(), ch2_scratch.data() };
-  stretcher.process( decoded_audio_for_stretcher.data(), opus_frame::NUM_SAMPLES, false );
+  return false;
+}
 
-  const int samples_available = stretcher.available();
-  if ( samples_available < 0 ) {
-    throw runtime_error( "stretcher.available() < 0" );
+void Cursor::sample_into( const PartialFrameStore<AudioFrame>& frames,
+                          const size_t frontier_sample_index,
+                          OpusDecoderProcess& decoder,
+                          TimeScaler& stretcher,
+                          const size_t output_end,
+                          EndlessBuffer<float>& ch1,
+                          EndlessBuffer<float>& ch2 )
+{
+  if ( not initialized() ) {
+    throw runtime_error( "Cursor::sample_into() called on uninitialized Cursor" );
   }
-  const size_t samples_out = samples_available;
 
-  if ( samples_out > output.ch1.size() ) {
-    throw runtime_error( "stretcher output exceeds available output size" );
-  }
+  while ( num_samples_output_.value() < output_end ) {
+    const bool fade_in = adjust( frontier_sample_index, stretcher );
+    if ( not initialized() ) {
+      return;
+    }
 
-  array<float*, 2> stretched_audio_from_stretcher = { output.ch1.data(), output.ch2.data() };
-  if ( samples_out != stretcher.retrieve( stretched_audio_from_stretcher.data(), samples_out ) ) {
-    throw runtime_error( "unexpected output from stretcher.retrieve()" );
-  }
+    /* how many frames to decode in this batch: no more than output_end needs (at a ratio of 1), all before the
+       frontier, and either a run of frames that arrived or a single missing one */
+    const size_t frames_wanted = max( size_t( 1 ), ( output_end - num_samples_output_.value() ) / frame_samples_ );
+    const size_t frames_before_frontier = ( frontier_sample_index - cursor_location() ) / frame_samples_;
+    const size_t max_batch = min( { frames_wanted, frames_before_frontier, MAX_BATCH_SAMPLES / frame_samples_ } );
+
+    const uint64_t first_frame = frame_cursor_.value();
+    const bool present = frames.has_value( first_frame );
+    size_t batch = 1;
+    while ( present and batch < max_batch and frames.has_value( first_frame + batch )
+            and same_rate_at( frontier_sample_index - greatest_read_location() - batch * frame_samples_ ) ) {
+      batch++;
+    }
 
-  output.sample_index = num_samples_output_.value();
-  output.length = samples_out;
-  output.good = true;
+    for ( size_t i = 0; i < batch; i++ ) {
+      if ( i > 0 ) {
+        const int64_t margin_to_frontier = frontier_sample_index - greatest_read_location();
+        ewma_update( stats_.mean_margin_to_frontier, margin_to_frontier, ALPHA );
+      }
+      ewma_update( stats_.mean_time_ratio, stretcher.time_ratio(), ALPHA );
+
+      span<float> ch1_decoded { ch1_scratch_.data() + i * frame_samples_, frame_samples_ };
+      span<float> ch2_decoded { ch2_scratch_.data() + i * frame_samples_, frame_samples_ };
+
+      if ( not present ) {
+        miss();
+        previous_frame_dtx_ = false;
+
+        /* no frame to decode: reconstruct it from the next frame's FEC if that has arrived, else conceal */
+        const uint64_t next_frame = frame_cursor_.value() + 1;
+        if ( frames.has_value( next_frame )
+             and OpusDecoderProcess::may_carry_fec( frames.at( next_frame ).value() ) ) {
+          decoder.decode_fec( frames.at( next_frame ).value(), ch1_decoded, ch2_decoded );
+          stats_.fec_recoveries++;
+        } else {
+          decoder.decode_missing( ch1_decoded, ch2_decoded );
+          stats_.concealments++;
+        }
+      } else {
+        /* decode a frame! */
+        hit();
+
+        const AudioFrame& frame = frames.at( frame_cursor_.value() ).value();
+        const bool dtx = OpusDecoderProcess::is_dtx( frame );
+        if ( dtx and previous_frame_dtx_ ) {
+          /* the sender is idle and the decoder has already faded out: skip it */
+          fill( ch1_decoded.begin(), ch1_decoded.end(), 0 );
+          fill( ch2_decoded.begin(), ch2_decoded.end(), 0 );
+          stats_.dtx_skips++;
+        } else if ( frame.separate_channels ) {
+          decoder.decode( frame.frame1, frame.frame2, ch1_decoded, ch2_decoded );
+        } else {
+          decoder.decode_stereo( frame.frame1, ch1_decoded, ch2_decoded );
+        }
+        previous_frame_dtx_ = dtx;
+      }
+
+      ++frame_cursor_.value();
+    }
 
-  num_samples_output_.value() += samples_out;
-  ++frame_cursor_.value();
+    if ( fade_in ) {
+      for ( uint16_t i = 0; i < opus_frame::NUM_SAMPLES; i++ ) {
+        ch1_scratch_[i] *= double( i ) / double( opus_frame::NUM_SAMPLES );
+        ch2_scratch_[i] *= double( i ) / double( opus_frame::NUM_SAMPLES );
+      }
+      stats_.fades_in++;
+    }
+
+    /* time-stretch, straight into the destination */
+    const size_t samples_in = batch * frame_samples_;
+    stretcher.process( { ch1_scratch_.data(), samples_in }, { ch2_scratch_.data(), samples_in } );
+
+    const size_t samples_out = stretcher.available();
+    const size_t output_index = num_samples_output_.value();
+    if ( samples_out
+         != stretcher.retrieve( ch1.region( output_index, samples_out ), ch2.region( output_index, samples_out ) ) ) {
+      throw runtime_error( "unexpected output from stretcher.retrieve()" );
+    }
+
+    num_samples_output_.value() += samples_out;
+    stats_.batches++;
+  }
 }
 
 void Cursor::summary( ostream& out ) const
 {
   out << "Cursor: ";
+  if ( frame_samples_ != opus_frame::NUM_SAMPLES ) {
+    out << " frame samples=" << frame_samples_;
+  }
   out << " target lag=" << target_lag_samples_;
   out << " actual lag=" << stats_.mean_margin_to_frontier;
   out << " quality=" << fixed << setprecision( 5 ) << stats_.quality;
@@ -172,6 +233,11 @@ void Cursor::summary( ostream& out ) const
   out << " rate=" << int( rate_ );
   out << " resets=" << stats_.resets;
   out << " fades=" << stats_.fades_in;
+  out << " batches=" << stats_.batches;
+  out << " recovered=" << stats_.fec_recoveries << " concealed=" << stats_.concealments;
+  if ( stats_.dtx_skips ) {
+    out << " dtx skips=" << stats_.dtx_skips;
+  }
   out << "\n";
 }
 
@@ -185,6 +251,8 @@ void Cursor::json_summary( Json::Value& root ) const
   root["resets"] = stats_.resets;
   root["compressions"] = stats_.compress_starts;
   root["expansions"] = stats_.expand_starts;
+  root["recovered"] = stats_.fec_recoveries;
+  root["concealed"] = stats_.concealments;
 }
 
 void Cursor::default_json_summary( Json::Value& root )
@@ -197,6 +265,8 @@ void Cursor::default_json_summary( Json::Value& root )
   root["resets"] = 0;
   root["compressions"] = 0;
   root["expansions"] = 0;
+  root["recovered"] = 0;
+  root["concealed"] = 0;
 }
 
 size_t Cursor::ok_to_pop( const PartialFrameStore<AudioFrame>& frames ) const
@@ -3,9 +3,9 @@
 #include "connection.hh"
 #include "decoder_process.hh"
 #include "opus.hh"
+#include "time_scaler.hh"
 
 #include <json/json.h>
-#include <rubberband/RubberBandStretcher.h>
 
 class Cursor
 {
@@ -14,6 +14,8 @@ class Cursor
   uint32_t min_lag_samples_; /* if lag gets this small, start time-expansion */
   uint32_t max_lag_samples_; /* if lag gets this big, start time-compression */
 
+  uint32_t frame_samples_; /* the session's Opus frame duration */
+
   enum class Rate : uint8_t
   {
     Steady,
@@ -28,38 +30,46 @@ class Cursor
     unsigned int compress_starts, compress_stops;
     unsigned int expand_starts, expand_stops;
     unsigned int fades_in;
+    unsigned int batches;
+    unsigned int fec_recoveries, concealments; /* missing frames rebuilt from the next frame's FEC, or by PLC */
+    unsigned int dtx_skips;                    /* DTX frames after the first, written as silence undecoded */
   } stats_ {};
 
   std::optional<size_t> num_samples_output_ {};
   std::optional<uint64_t> frame_cursor_ {};
+  bool previous_frame_dtx_ {};
 
-  uint64_t cursor_location() const { return frame_cursor_.value() * opus_frame::NUM_SAMPLES; }
-  uint64_t greatest_read_location() const { return cursor_location() + opus_frame::NUM_SAMPLES - 1; }
+  uint64_t cursor_location() const { return frame_cursor_.value() * frame_samples_; }
+  uint64_t greatest_read_location() const { return cursor_location() + frame_samples_ - 1; }
 
   static constexpr float ALPHA = 0.01;
 
+  /* samples decoded at once when catching up (20 ms) */
+  static constexpr size_t MAX_BATCH_SAMPLES = 8 * opus_frame::NUM_SAMPLES;
+  std::array<float, MAX_BATCH_SAMPLES> ch1_scratch_ {}, ch2_scratch_ {};
+
   void miss();
   void hit();
 
-public:
-  Cursor( const uint32_t target_lag_samples, const uint32_t min_lag_samples, const uint32_t max_lag_samples );
+  /* resets the cursor on underflow (returns true if the audio should fade in) and picks the stretch ratio */
+  bool adjust( const size_t frontier_sample_index, TimeScaler& stretcher );
+  bool same_rate_at( const int64_t margin_to_frontier ) const;
 
-  struct AudioSlice
-  {
-    std::array<float, 1024> ch1, ch2;
-    size_t sample_index;
-    uint16_t length;
-    bool good;
-
-    span_view<float> ch1_span() const { return { ch1.data(), length }; }
-    span_view<float> ch2_span() const { return { ch2.data(), length }; }
-  };
-
-  void sample( const PartialFrameStore<AudioFrame>& frames,
-               const size_t frontier_sample_index,
-               OpusDecoderProcess& decoder,
-               RubberBand::RubberBandStretcher& stretcher,
-               AudioSlice& output );
+public:
+  Cursor( const uint32_t target_lag_samples,
+          const uint32_t min_lag_samples,
+          const uint32_t max_lag_samples,
+          const uint32_t frame_samples );
+
+  /* decodes runs of consecutive frames in batches and stretches them straight into ch1/ch2 (indexed by output
+     sample), until output_end samples have been output or the cursor resets for lack of audio */
+  void sample_into( const PartialFrameStore<AudioFrame>& frames,
+                    const size_t frontier_sample_index,
+                    OpusDecoderProcess& decoder,
+                    TimeScaler& stretcher,
+                    const size_t output_end,
+                    EndlessBuffer<float>& ch1,
+                    EndlessBuffer<float>& ch2 );
 
   void setup( const size_t global_sample_index, const size_t frontier_sample_index );
   bool initialized() const { return frame_cursor_.has_value(); }
@@ -85,4 +95,5 @@ public:
   uint32_t target_lag_samples() const { return target_lag_samples_; }
   uint32_t min_lag_samples() const { return min_lag_samples_; }
   uint32_t max_lag_samples() const { return max_lag_samples_; }
+  uint32_t frame_samples() const { return frame_samples_; }
 };
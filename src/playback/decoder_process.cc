@@ -34,3 +34,26 @@ void OpusDecoderProcess::decode_missing( span<float> ch1_out, span<float> ch2_ou
     dec1_.decode_missing_stereo( ch1_out, ch2_out );
   }
 }
+
+void OpusDecoderProcess::decode_fec( const AudioFrame& next, span<float> ch1_out, span<float> ch2_out )
+{
+  if ( next.separate_channels ) {
+    dec1_.decode_fec( next.frame1, ch1_out );
+    dec2_.value().decode_fec( next.frame2, ch2_out );
+  } else {
+    if ( dec2_.has_value() ) {
+      throw runtime_error( "OpusDecoderProcess::decode_fec: stereo frame on independent-channel decoder" );
+    }
+    dec1_.decode_fec_stereo( next.frame1, ch1_out, ch2_out );
+  }
+}
+
+bool OpusDecoderProcess::may_carry_fec( const AudioFrame& next )
+{
+  return next.frame1.may_carry_fec() and ( not next.separate_channels or next.frame2.may_carry_fec() );
+}
+
+bool OpusDecoderProcess::is_dtx( const AudioFrame& frame )
+{
+  return frame.frame1.is_dtx() and ( not frame.separate_channels or frame.frame2.is_dtx() );
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "formats.hh"
 #include "opus.hh"
 #include "spans.hh"
 
@@ -18,4 +19,9 @@ public:
   void decode_stereo( const opus_frame& frame, span<float> ch1_out, span<float> ch2_out );
 
   void decode_missing( span<float> ch1_out, span<float> ch2_out );
+
+  /* conceals a missing frame using the FEC carried by the frame after it */
+  void decode_fec( const AudioFrame& next, span<float> ch1_out, span<float> ch2_out );
+  static bool may_carry_fec( const AudioFrame& next );
+  static bool is_dtx( const AudioFrame& frame );
 };
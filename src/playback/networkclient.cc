@@ -4,19 +4,19 @@
 using namespace std;
 using namespace std::chrono;
 
-using Option = RubberBand::RubberBandStretcher::Option;
-
 NetworkClient::NetworkSession::NetworkSession( const uint8_t node_id,
                                                const KeyPair& session_key,
-                                               const Address& destination )
+                                               const Address& destination,
+                                               const uint16_t frame_samples )
   : connection( node_id, 0, CryptoSession( session_key.uplink, session_key.downlink ), destination )
-  , cursor( 960, 120, 1920 )
+  , cursor( 960, 120, 1920, frame_samples )
 {}
 
 void NetworkClient::NetworkSession::transmit_frame( OpusEncoderProcess& source, UDPSocket& socket )
 {
   connection.push_frame( source );
   connection.send_packet( socket );
+  source.adapt_to_loss( connection.sender_stats().packet_transmissions, connection.sender_stats().packet_losses() );
 }
 
 void NetworkClient::NetworkSession::network_receive( const Ciphertext& ciphertext )
@@ -26,23 +26,17 @@ void NetworkClient::NetworkSession::network_receive( const Ciphertext& ciphertex
 
 void NetworkClient::NetworkSession::decode( const size_t decode_cursor,
                                             OpusDecoderProcess& decoder,
-                                            RubberBand::RubberBandStretcher& stretcher,
+                                            TimeScaler& stretcher,
                                             ChannelPair& output )
 {
   /* decode server's Opus frames to playback buffer */
-  const size_t frontier_sample_index = connection.unreceived_beyond_this_frame_index() * opus_frame::NUM_SAMPLES;
+  const size_t frontier_sample_index = connection.unreceived_beyond_this_frame_index() * cursor.frame_samples();
 
   cursor.setup( decode_cursor, frontier_sample_index );
 
-  Cursor::AudioSlice audio;
-
-  while ( cursor.initialized() and decode_cursor > cursor.num_samples_output() ) {
-    cursor.sample( connection.frames(), frontier_sample_index, decoder, stretcher, audio );
-
-    if ( audio.good ) {
-      output.ch1().region( audio.sample_index, audio.length ).copy( audio.ch1_span() );
-      output.ch2().region( audio.sample_index, audio.length ).copy( audio.ch2_span() );
-    }
+  if ( cursor.initialized() ) {
+    cursor.sample_into(
+      connection.frames(), frontier_sample_index, decoder, stretcher, decode_cursor, output.ch1(), output.ch2() );
   }
 
   /* pop used Opus frames from server */
@@ -69,32 +63,48 @@ void NetworkClient::process_keyreply( const Ciphertext& ciphertext )
       p.clear_error();
       return;
     }
-    session_.emplace( keys.id, keys.key_pair, server_ );
+    /* the server's reply settles the frame duration for both directions */
+    source_->set_frame_samples( keys.frame_samples );
+    session_.emplace( keys.id, keys.key_pair, server_, keys.frame_samples );
     stats_.new_sessions++;
   } else {
     stats_.bad_packets++;
   }
 }
 
+uint16_t NetworkClient::frame_samples_from_ms( const string_view milliseconds )
+{
+  if ( milliseconds == "2.5" ) {
+    return opus_frame::NUM_SAMPLES;
+  } else if ( milliseconds == "5" ) {
+    return 2 * opus_frame::NUM_SAMPLES;
+  } else if ( milliseconds == "10" ) {
+    return opus_frame::MAX_SAMPLES;
+  }
+  throw runtime_error( "invalid frame duration " + string( milliseconds ) + " ms (expected 2.5, 5 or 10)" );
+}
+
 NetworkClient::NetworkClient( const Address& server,
                               const LongLivedKey& key,
                               shared_ptr<OpusEncoderProcess> source,
                               shared_ptr<AudioDeviceTask> dest,
-                              EventLoop& loop )
+                              EventLoop& loop,
+                              const TimeScaler::Kind scaler,
+                              const uint16_t frame_samples )
   : server_( server )
   , name_( key.name() )
   , long_lived_crypto_( key.key_pair().uplink, key.key_pair().downlink, true )
-  , stretcher_( 48000,
-                2,
-                Option::OptionProcessRealTime | Option::OptionThreadingNever | Option::OptionPitchHighConsistency
-                  | Option::OptionWindowShort )
+  , stretcher_( TimeScaler::make( scaler, true ) )
   , source_( source )
   , dest_( dest )
+  , requested_frame_samples_( frame_samples )
   , next_key_request_( steady_clock::now() )
 {
+  if ( not opus_frame::valid_num_samples( requested_frame_samples_ ) ) {
+    throw runtime_error( "NetworkClient: invalid frame duration" );
+  }
+
   socket_.set_blocking( false );
-  stretcher_.setMaxProcessSize( opus_frame::NUM_SAMPLES );
-  stretcher_.calculateStretch();
 
   loop.add_rule(
     "network transmit",
@@ -135,7 +145,7 @@ NetworkClient::NetworkClient( const Address& server,
   loop.add_rule(
     "decode",
     [&] {
-      session_->decode( decode_cursor_, decoder_, stretcher_, dest_->playback() );
+      session_->decode( decode_cursor_, decoder_, *stretcher_, dest_->playback() );
       decode_cursor_ += opus_frame::NUM_SAMPLES;
 
       if ( session_->connection.sender_stats().last_good_ack_ts + 4'000'000'000 < Timer::timestamp_ns() ) {
@@ -156,10 +166,15 @@ NetworkClient::NetworkClient( const Address& server,
     "key request",
     [&] {
       next_key_request_ = steady_clock::now() + milliseconds( 250 );
-      Plaintext empty;
-      empty.resize( 0 );
+      /* 2.5 ms is asked for with an empty request, which servers from before frame durations accept */
+      Plaintext request;
+      if ( requested_frame_samples_ != opus_frame::NUM_SAMPLES ) {
+        Serializer s { request.mutable_buffer() };
+        s.object( NetInteger<uint16_t> { requested_frame_samples_ } );
+        request.resize( s.bytes_written() );
+      }
       Ciphertext keyreq;
-      long_lived_crypto_.encrypt( { &KeyMessage::keyreq_id, 1 }, empty, keyreq );
+      long_lived_crypto_.encrypt( { &KeyMessage::keyreq_id, 1 }, request, keyreq );
       socket_.sendto( server_, keyreq );
       stats_.key_requests++;
     },
@@ -172,7 +187,13 @@ void NetworkClient::summary( ostream& out ) const
   out << " key_requests=" << stats_.key_requests;
   out << " sessions=" << stats_.new_sessions;
   out << " bad_packets=" << stats_.bad_packets;
-  out << " timeouts=" << stats_.timeouts << "\n";
+  out << " timeouts=" << stats_.timeouts;
+  out << " uplink_loss=" << source_->measured_loss_percent() << "%";
+  if ( source_->can_carry_fec() ) {
+    out << " fec=" << source_->expected_loss_percent() << "%\n";
+  } else {
+    out << " fec=none (CELT-only frames)\n";
+  }
   if ( session_.has_value() ) {
     session_->summary( out );
   }
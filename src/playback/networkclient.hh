@@ -6,8 +6,7 @@
 #include "cursor.hh"
 #include "encoder_task.hh"
 #include "keys.hh"
-
-#include <rubberband/RubberBandStretcher.h>
+#include "time_scaler.hh"
 
 class NetworkClient : public Summarizable
 {
@@ -17,13 +16,16 @@ public:
     AudioNetworkConnection connection;
     Cursor cursor;
 
-    NetworkSession( const uint8_t node_id, const KeyPair& session_key, const Address& destination );
+    NetworkSession( const uint8_t node_id,
+                    const KeyPair& session_key,
+                    const Address& destination,
+                    const uint16_t frame_samples );
 
     void transmit_frame( OpusEncoderProcess& source, UDPSocket& socket );
     void network_receive( const Ciphertext& ciphertext );
     void decode( const size_t decode_cursor,
                  OpusDecoderProcess& decoder,
-                 RubberBand::RubberBandStretcher& stretcher,
+                 TimeScaler& stretcher,
                  ChannelPair& output );
     void summary( std::ostream& out ) const;
     void json_summary( Json::Value& root ) const { cursor.json_summary( root ); }
@@ -38,13 +40,15 @@ private:
 
   std::optional<NetworkSession> session_ {};
   OpusDecoderProcess decoder_ { false };
-  RubberBand::RubberBandStretcher stretcher_;
+  std::unique_ptr<TimeScaler> stretcher_;
 
   std::shared_ptr<OpusEncoderProcess> source_;
 
   std::shared_ptr<AudioDeviceTask> dest_;
   size_t decode_cursor_ {};
 
+  uint16_t requested_frame_samples_; /* asked of the server in each key request */
+
   void process_keyreply( const Ciphertext& ciphertext );
   std::chrono::steady_clock::time_point next_key_request_;
 
@@ -58,7 +62,12 @@ public:
                  const LongLivedKey& key,
                  std::shared_ptr<OpusEncoderProcess> source,
                  std::shared_ptr<AudioDeviceTask> dest,
-                 EventLoop& loop );
+                 EventLoop& loop,
+                 const TimeScaler::Kind scaler = TimeScaler::Kind::RubberBand,
+                 const uint16_t frame_samples = opus_frame::NUM_SAMPLES );
+
+  /* a frame duration as given on a command line ("2.5", "5" or "10", in ms), in samples */
+  static uint16_t frame_samples_from_ms( const std::string_view milliseconds );
 
   void summary( std::ostream& out ) const override;
   void json_summary( Json::Value& root ) const;
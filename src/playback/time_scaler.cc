@@ -0,0 +1,178 @@
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "opus.hh"
+#include "time_scaler.hh"
+
+using namespace std;
+
+using Option = RubberBand::RubberBandStretcher::Option;
+
+unique_ptr<TimeScaler> TimeScaler::make( const Kind kind, const bool short_window )
+{
+  switch ( kind ) {
+    case Kind::RubberBand:
+      return make_unique<RubberBandScaler>( short_window );
+    case Kind::WSOLA:
+      return make_unique<WSOLAScaler>( short_window );
+  }
+
+  throw runtime_error( "unknown TimeScaler kind" );
+}
+
+RubberBandScaler::RubberBandScaler( const bool short_window )
+  : stretcher_( 48000,
+                2,
+                Option::OptionProcessRealTime | Option::OptionThreadingNever | Option::OptionPitchHighConsistency
+                  | ( short_window ? Option::OptionWindowShort : 0 ) )
+{
+  stretcher_.setMaxProcessSize( opus_frame::NUM_SAMPLES );
+  stretcher_.calculateStretch();
+}
+
+void RubberBandScaler::process( const span_view<float> ch1, const span_view<float> ch2 )
+{
+  const array<const float*, 2> input = { ch1.data(), ch2.data() };
+  stretcher_.process( input.data(), ch1.size(), false );
+}
+
+size_t RubberBandScaler::available() const
+{
+  const int samples_available = stretcher_.available();
+  if ( samples_available < 0 ) {
+    throw runtime_error( "stretcher.available() < 0" );
+  }
+  return samples_available;
+}
+
+size_t RubberBandScaler::retrieve( span<float> ch1, span<float> ch2 )
+{
+  const array<float*, 2> output = { ch1.mutable_data(), ch2.mutable_data() };
+  return stretcher_.retrieve( output.data(), min( ch1.size(), ch2.size() ) );
+}
+
+WSOLAScaler::WSOLAScaler( const bool short_window )
+  : min_period_( 48 ) /* 1 ms */
+  , max_period_( short_window ? LONGEST_PERIOD / 2 : LONGEST_PERIOD ) /* 2.5 or 5 ms */
+{
+  in1_.reserve( 4 * max_period_ );
+  in2_.reserve( 4 * max_period_ );
+}
+
+void WSOLAScaler::set_time_ratio( const double ratio )
+{
+  ratio_ = ratio;
+  if ( ratio_ == 1.0 ) {
+    debt_ = 0;
+  }
+}
+
+/* the period P in [min, max] for which the next P samples best match the P after them */
+uint16_t WSOLAScaler::best_period() const
+{
+  const size_t len = 2 * max_period_;
+
+  array<float, 2 * LONGEST_PERIOD> mono;
+  array<float, 2 * LONGEST_PERIOD + 1> energy_before; /* energy_before[i] = sum of mono[k]^2 for k < i */
+  energy_before[0] = 0;
+  for ( size_t i = 0; i < len; i++ ) {
+    mono[i] = in1_[i] + in2_[i];
+    energy_before[i + 1] = energy_before[i] + mono[i] * mono[i];
+  }
+
+  uint16_t best = max_period_;
+  float best_score = -1;
+
+  for ( uint16_t period = min_period_; period <= max_period_; period++ ) {
+    float correlation = 0;
+    for ( uint16_t k = 0; k < period; k++ ) {
+      correlation += mono[k] * mono[period + k];
+    }
+
+    const float energy_a = energy_before[period];
+    const float energy_b = energy_before[2 * period] - energy_before[period];
+    const float score = correlation / sqrt( energy_a * energy_b + 1e-12f );
+    if ( score > best_score ) {
+      best_score = score;
+      best = period;
+    }
+  }
+
+  return best;
+}
+
+/* passes the first `count` input samples through to the output */
+void WSOLAScaler::emit( const size_t count )
+{
+  out1_.insert( out1_.end(), in1_.begin(), in1_.begin() + count );
+  out2_.insert( out2_.end(), in2_.begin(), in2_.begin() + count );
+  in1_.erase( in1_.begin(), in1_.begin() + count );
+  in2_.erase( in2_.begin(), in2_.begin() + count );
+}
+
+void WSOLAScaler::splice( const bool compress )
+{
+  const uint16_t period = best_period();
+
+  if ( compress ) {
+    /* A B => (A fading into B) */
+    for ( uint16_t k = 0; k < period; k++ ) {
+      const float fade = ( k + 0.5f ) / period;
+      out1_.push_back( in1_[k] * ( 1 - fade ) + in1_[period + k] * fade );
+      out2_.push_back( in2_[k] * ( 1 - fade ) + in2_[period + k] * fade );
+    }
+    in1_.erase( in1_.begin(), in1_.begin() + 2 * period );
+    in2_.erase( in2_.begin(), in2_.begin() + 2 * period );
+    debt_ -= period;
+  } else {
+    /* A B => A (B fading into A) B */
+    for ( uint16_t k = 0; k < period; k++ ) {
+      out1_.push_back( in1_[k] );
+      out2_.push_back( in2_[k] );
+    }
+    for ( uint16_t k = 0; k < period; k++ ) {
+      const float fade = ( k + 0.5f ) / period;
+      out1_.push_back( in1_[period + k] * ( 1 - fade ) + in1_[k] * fade );
+      out2_.push_back( in2_[period + k] * ( 1 - fade ) + in2_[k] * fade );
+    }
+    in1_.erase( in1_.begin(), in1_.begin() + period );
+    in2_.erase( in2_.begin(), in2_.begin() + period );
+    debt_ += period;
+  }
+}
+
+void WSOLAScaler::process( const span_view<float> ch1, const span_view<float> ch2 )
+{
+  if ( ch1.size() != ch2.size() ) {
+    throw runtime_error( "WSOLAScaler::process: channel length mismatch" );
+  }
+
+  in1_.insert( in1_.end(), ch1.begin(), ch1.end() );
+  in2_.insert( in2_.end(), ch2.begin(), ch2.end() );
+  debt_ += ( 1.0 - ratio_ ) * ch1.size();
+
+  /* splice only once a whole period is owed, so the debt never overshoots into the other direction */
+  const size_t lookahead = 2 * max_period_;
+  while ( in1_.size() >= lookahead ) {
+    if ( debt_ >= max_period_ ) {
+      splice( true );
+    } else if ( debt_ <= -max_period_ ) {
+      splice( false );
+    } else {
+      emit( in1_.size() - lookahead );
+      break;
+    }
+  }
+}
+
+size_t WSOLAScaler::retrieve( span<float> ch1, span<float> ch2 )
+{
+  const size_t count = min( out1_.size(), min( ch1.size(), ch2.size() ) );
+  memcpy( ch1.mutable_data(), out1_.data(), count * sizeof( float ) );
+  memcpy( ch2.mutable_data(), out2_.data(), count * sizeof( float ) );
+  out1_.erase( out1_.begin(), out1_.begin() + count );
+  out2_.erase( out2_.begin(), out2_.begin() + count );
+  return count;
+}
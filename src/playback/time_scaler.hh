@@ -0,0 +1,85 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "spans.hh"
+
+#include <rubberband/RubberBandStretcher.h>
+
+/* changes the duration of stereo audio without changing its pitch, block by block (used by Cursor to catch up
+   or fall back by a few percent) */
+class TimeScaler
+{
+public:
+  enum class Kind : uint8_t
+  {
+    RubberBand, /* phase vocoder: an FFT per block over a long analysis window */
+    WSOLA       /* splices out or repeats one pitch period at a time: low CPU, a few ms of latency */
+  };
+
+  static std::unique_ptr<TimeScaler> make( const Kind kind, const bool short_window );
+
+  virtual void set_time_ratio( const double ratio ) = 0;
+  virtual double time_ratio() const = 0;
+
+  virtual void process( const span_view<float> ch1, const span_view<float> ch2 ) = 0;
+  virtual size_t available() const = 0;
+  virtual size_t retrieve( span<float> ch1, span<float> ch2 ) = 0;
+
+  /* samples of delay added at a ratio of 1 */
+  virtual size_t latency() const = 0;
+
+  virtual ~TimeScaler() {}
+};
+
+class RubberBandScaler : public TimeScaler
+{
+  RubberBand::RubberBandStretcher stretcher_;
+
+public:
+  RubberBandScaler( const bool short_window );
+
+  void set_time_ratio( const double ratio ) override { stretcher_.setTimeRatio( ratio ); }
+  double time_ratio() const override { return stretcher_.getTimeRatio(); }
+
+  void process( const span_view<float> ch1, const span_view<float> ch2 ) override;
+  size_t available() const override;
+  size_t retrieve( span<float> ch1, span<float> ch2 ) override;
+
+  size_t latency() const override { return stretcher_.getLatency(); }
+};
+
+/* waveform-similarity overlap-add, done the way a jitter buffer would: the audio passes through untouched
+   (behind a fixed lookahead) except that, while the ratio is off 1, one pitch period at a time is cross-faded
+   out (compression) or repeated (expansion), choosing the period that best matches the next one */
+class WSOLAScaler : public TimeScaler
+{
+  static constexpr uint16_t LONGEST_PERIOD = 240;
+
+  uint16_t min_period_, max_period_;
+
+  double ratio_ { 1.0 };
+
+  /* samples still to remove (positive) or insert (negative) to realize the ratio */
+  double debt_ {};
+
+  std::vector<float> in1_ {}, in2_ {}, out1_ {}, out2_ {};
+
+  uint16_t best_period() const;
+  void splice( const bool compress );
+  void emit( const size_t count );
+
+public:
+  /* short window: periods up to 2.5 ms (5 ms latency), else up to 5 ms (10 ms latency) */
+  WSOLAScaler( const bool short_window );
+
+  void set_time_ratio( const double ratio ) override;
+  double time_ratio() const override { return ratio_; }
+
+  void process( const span_view<float> ch1, const span_view<float> ch2 ) override;
+  size_t available() const override { return out1_.size(); }
+  size_t retrieve( span<float> ch1, span<float> ch2 ) override;
+
+  size_t latency() const override { return 2 * max_period_; }
+};
@@ -1,26 +1,201 @@
 #include "audioboard.hh"
-#include "ewma.hh"
+
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 using namespace std::chrono;
 
 AudioBoard::AudioBoard( const string_view name, const uint8_t num_channels )
   : name_( name )
+  , staged1_( size_t( num_channels ) * opus_frame::NUM_SAMPLES )
+  , staged2_( size_t( num_channels ) * opus_frame::NUM_SAMPLES )
+  , staged_audible_( num_channels )
 {
+  if ( num_channels == NO_CHANNEL ) {
+    throw runtime_error( "AudioBoard: too many channels" );
+  }
+
   channels_.reserve( num_channels );
-  gains_.reserve( num_channels );
   for ( uint8_t i = 0; i < num_channels; i++ ) {
     channels_.emplace_back( "Unknown " + to_string( i ), AudioChannel { 8192 } );
-    gains_.push_back( { 2.0, 2.0 } );
-    power_.push_back( 0.0 );
+    channel_indices_.emplace( channels_.back().first, i );
+    gains1_.push_back( 2.0 );
+    gains2_.push_back( 2.0 );
+    meters_.emplace_back();
+    activity_.push_back( {} );
+  }
+}
+
+void AudioBoard::set_channel_name( const uint8_t ch_num, const string_view name )
+{
+  channel_indices_.erase( channels_.at( ch_num ).first );
+  channels_.at( ch_num ).first = name;
+  channel_indices_.insert_or_assign( string( name ), ch_num );
+}
+
+optional<uint8_t> AudioBoard::channel_index( const string_view channel_name ) const
+{
+  const auto it = channel_indices_.find( channel_name );
+  if ( it == channel_indices_.end() ) {
+    return {};
   }
+  return it->second;
+}
+
+void AudioBoard::detect_activity( const uint64_t block )
+{
+  for ( uint8_t channel_i = 0; channel_i < num_channels(); channel_i++ ) {
+    Activity& activity = activity_.at( channel_i );
+    if ( block + opus_frame::NUM_SAMPLES <= activity.checked_until ) {
+      continue;
+    }
+
+    if ( block > activity.checked_until ) {
+      /* blocks that were never looked at count as active */
+      activity.active_until = max( activity.active_until, block );
+    }
+
+    float peak = 0;
+    for ( const float value : channel( channel_i ).region( block, opus_frame::NUM_SAMPLES ) ) {
+      peak = max( peak, abs( value ) );
+    }
+
+    if ( peak >= GATE_THRESHOLD ) {
+      activity.active_until = block + opus_frame::NUM_SAMPLES + GATE_HANGOVER_SAMPLES;
+    }
+    activity.checked_until = block + opus_frame::NUM_SAMPLES;
+  }
+}
+
+bool AudioBoard::audible( const uint8_t ch_num, const uint64_t sample_index, const size_t length ) const
+{
+  if ( gains1_.at( ch_num ) == 0.0f and gains2_.at( ch_num ) == 0.0f ) {
+    return false;
+  }
+
+  const Activity& activity = activity_.at( ch_num );
+  if ( sample_index + length > activity.checked_until ) {
+    return true;
+  }
+
+  return sample_index < activity.active_until;
 }
 
 void AudioBoard::set_gain( const string_view channel_name, const float gain1, const float gain2 )
 {
+  const auto ch_num = channel_index( channel_name );
+  if ( ch_num.has_value() ) {
+    set_gain( ch_num.value(), gain1, gain2 );
+  }
+}
+
+void AudioBoard::set_gain( const uint8_t ch_num, const float gain1, const float gain2 )
+{
+  gains1_.at( ch_num ) = gain1;
+  gains2_.at( ch_num ) = gain2;
+  staged_block_.reset();
+}
+
+void AudioBoard::stage_block( const uint64_t block )
+{
+  detect_activity( block );
+
+  full1_.fill( 0 );
+  full2_.fill( 0 );
+
+  for ( uint8_t channel_i = 0; channel_i < num_channels(); channel_i++ ) {
+    staged_audible_[channel_i] = audible( channel_i, block, opus_frame::NUM_SAMPLES );
+    if ( not staged_audible_[channel_i] ) {
+      continue;
+    }
+
+    const float* samples = channel( channel_i ).region( block, opus_frame::NUM_SAMPLES ).data();
+    float* row1 = staged1_.data() + channel_i * opus_frame::NUM_SAMPLES;
+    float* row2 = staged2_.data() + channel_i * opus_frame::NUM_SAMPLES;
+    const float gain1 = gains1_[channel_i], gain2 = gains2_[channel_i];
+    for ( size_t i = 0; i < opus_frame::NUM_SAMPLES; i++ ) {
+      row1[i] = gain1 * samples[i];
+      row2[i] = gain2 * samples[i];
+      full1_[i] += row1[i];
+      full2_[i] += row2[i];
+    }
+  }
+
+  staged_block_ = block;
+}
+
+void AudioBoard::mix_into( const uint64_t sample_index,
+                           span<float> ch1,
+                           span<float> ch2,
+                           const uint8_t exclude1,
+                           const uint8_t exclude2 ) const
+{
+  const size_t length = ch1.size();
+  if ( ch2.size() != length ) {
+    throw runtime_error( "AudioBoard::mix_into: channel length mismatch" );
+  }
+
+  float* out1 = ch1.mutable_data();
+  float* out2 = ch2.mutable_data();
+
+  if ( staged_block_ == sample_index and length == opus_frame::NUM_SAMPLES ) {
+    /* fast path: from the staged rows */
+    const auto add_row = [&]( const uint8_t channel_i, const float sign ) {
+      const float* row1 = staged1_.data() + channel_i * opus_frame::NUM_SAMPLES;
+      const float* row2 = staged2_.data() + channel_i * opus_frame::NUM_SAMPLES;
+      for ( size_t i = 0; i < opus_frame::NUM_SAMPLES; i++ ) {
+        out1[i] += sign * row1[i];
+        out2[i] += sign * row2[i];
+      }
+    };
+
+    unsigned int others_audible = 0, excluded_audible = 0;
+    for ( uint8_t channel_i = 0; channel_i < num_channels(); channel_i++ ) {
+      if ( not staged_audible_[channel_i] ) {
+        continue;
+      } else if ( channel_i == exclude1 or channel_i == exclude2 ) {
+        excluded_audible++;
+      } else {
+        others_audible++;
+      }
+    }
+
+    if ( others_audible <= excluded_audible + 1 ) {
+      /* no more work than the full mix minus the excluded rows, and exact: with nobody else audible the mix
+         stays all zeros (which the encoder needs to see to send DTX) */
+      for ( uint8_t channel_i = 0; channel_i < num_channels() and others_audible; channel_i++ ) {
+        if ( staged_audible_[channel_i] and channel_i != exclude1 and channel_i != exclude2 ) {
+          add_row( channel_i, 1 );
+          others_audible--;
+        }
+      }
+      return;
+    }
+
+    for ( size_t i = 0; i < opus_frame::NUM_SAMPLES; i++ ) {
+      out1[i] += full1_[i];
+      out2[i] += full2_[i];
+    }
+
+    for ( uint8_t channel_i = 0; channel_i < num_channels(); channel_i++ ) {
+      if ( staged_audible_[channel_i] and ( channel_i == exclude1 or channel_i == exclude2 ) ) {
+        add_row( channel_i, -1 );
+      }
+    }
+    return;
+  }
+
   for ( uint8_t channel_i = 0; channel_i < num_channels(); channel_i++ ) {
-    if ( channels_.at( channel_i ).first == channel_name ) {
-      gains_.at( channel_i ) = { gain1, gain2 };
+    if ( channel_i == exclude1 or channel_i == exclude2 or not audible( channel_i, sample_index, length ) ) {
+      continue;
+    }
+
+    const float* samples = channel( channel_i ).region( sample_index, length ).data();
+    const float gain1 = gains1_[channel_i], gain2 = gains2_[channel_i];
+    for ( size_t i = 0; i < length; i++ ) {
+      out1[i] += gain1 * samples[i];
+      out2[i] += gain2 * samples[i];
     }
   }
 }
@@ -30,9 +205,11 @@ void AudioBoard::pop_samples_until( const uint64_t sample )
   for ( uint8_t channel_i = 0; channel_i < num_channels(); channel_i++ ) {
     AudioChannel& channel = channels_.at( channel_i ).second;
 
-    for ( uint64_t index = channel.range_begin(); index < sample; index++ ) {
-      const float mixed_sample_val = channel.at( index ) * ( gain( channel_i ).first + gain( channel_i ).second );
-      ewma_update( power_.at( channel_i ), mixed_sample_val * mixed_sample_val, 0.0002 );
+    const uint64_t metered_until = min( sample, uint64_t( channel.range_end() ) );
+    if ( metered_until > channel.range_begin() ) {
+      meters_.at( channel_i )
+        .add( channel.region( channel.range_begin(), metered_until - channel.range_begin() ),
+              gains1_[channel_i] + gains2_[channel_i] );
     }
 
     channel.pop_before( sample );
@@ -46,10 +223,14 @@ void AudioBoard::json_summary( Json::Value& root, const bool include_second_chan
     if ( ( i % 2 ) and not include_second_channels ) {
       continue;
     }
-    root["channels"][channels_.at( i ).first]["amplitude"] = sqrt( power_.at( i ) );
-    const float gain_mean = ( gains_.at( i ).first + gains_.at( i ).second ) / 2.0;
+    root["channels"][channels_.at( i ).first]["amplitude"] = meters_.at( i ).amplitude();
+    root["channels"][channels_.at( i ).first]["peak"] = meters_.at( i ).peak();
+    root["channels"][channels_.at( i ).first]["loudness"] = meters_.at( i ).short_term_loudness();
+    const float gain_mean = ( gains1_.at( i ) + gains2_.at( i ) ) / 2.0;
     root["channels"][channels_.at( i ).first]["gain"] = gain_mean;
-    root["channels"][channels_.at( i ).first]["pan"] = 2 * ( ( gains_.at( i ).second / ( 2 * gain_mean ) ) - 0.5 );
+    root["channels"][channels_.at( i ).first]["pan"] = 2 * ( ( gains2_.at( i ) / ( 2 * gain_mean ) ) - 0.5 );
+    root["channels"][channels_.at( i ).first]["active"]
+      = activity_.at( i ).active_until >= activity_.at( i ).checked_until;
   }
 }
 
@@ -59,20 +240,7 @@ void AudioWriter::mix_and_write( const AudioBoard& board, const uint64_t cursor_
     span<float> ch1_target = mixed_audio_.ch1().region( mix_cursor_, big_opus_frame::NUM_SAMPLES );
     span<float> ch2_target = mixed_audio_.ch2().region( mix_cursor_, big_opus_frame::NUM_SAMPLES );
 
-    for ( uint8_t channel_i = 0; channel_i < board.num_channels(); channel_i++ ) {
-      const span_view<float> other_channel
-        = board.channel( channel_i ).region( mix_cursor_, big_opus_frame::NUM_SAMPLES );
-
-      const auto [gain_into_1, gain_into_2] = board.gain( channel_i );
-      for ( uint16_t sample_i = 0; sample_i < big_opus_frame::NUM_SAMPLES; sample_i++ ) {
-        const float value = other_channel[sample_i];
-        const float orig_1 = ch1_target[sample_i];
-        const float orig_2 = ch2_target[sample_i];
-
-        ch1_target[sample_i] = orig_1 + gain_into_1 * value;
-        ch2_target[sample_i] = orig_2 + gain_into_2 * value;
-      }
-    }
+    board.mix_into( mix_cursor_, ch1_target, ch2_target );
 
     big_opus_frame encoded_frame;
     encoder_.encode_stereo( ch1_target, ch2_target, encoded_frame );
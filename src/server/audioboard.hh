@@ -1,9 +1,13 @@
 #pragma once
 
+#include <array>
+#include <map>
+#include <optional>
 #include <vector>
 
 #include "audio_buffer.hh"
 #include "encoder_task.hh"
+#include "level_meter.hh"
 #include "networkclient.hh"
 #include "socket.hh"
 
@@ -13,20 +17,47 @@ class AudioBoard
 {
   std::string name_;
   std::vector<std::pair<std::string, AudioChannel>> channels_ {};
-  std::vector<std::pair<float, float>> gains_ {};
-  std::vector<float> power_ {};
+  std::map<std::string, uint8_t, std::less<>> channel_indices_ {};
+
+  /* gain of each channel into the left and right of a mix */
+  std::vector<float> gains1_ {}, gains2_ {};
+
+  std::vector<LevelMeter> meters_ {};
+
+  /* a channel is active from a block that peaks above the gate threshold until a hangover after it; silent
+     blocks are left out of every mix */
+  static constexpr float GATE_THRESHOLD = 0.001;           /* -60 dBFS */
+  static constexpr uint64_t GATE_HANGOVER_SAMPLES = 4800; /* 100 ms */
+
+  struct Activity
+  {
+    uint64_t checked_until, active_until;
+  };
+  std::vector<Activity> activity_ {};
+
+  /* the block being mixed this tick, as two planar matrices of post-gain samples (row c holds channel c times
+     its gain into the left or right) plus their sums, so that each mix-minus is the full mix minus a row or two
+     (or, when few others are audible, just their rows) */
+  std::optional<uint64_t> staged_block_ {};
+  std::vector<float> staged1_ {}, staged2_ {};
+  std::vector<uint8_t> staged_audible_ {};
+  std::array<float, opus_frame::NUM_SAMPLES> full1_ {}, full2_ {};
+
+  void detect_activity( const uint64_t block );
 
 public:
+  static constexpr uint8_t NO_CHANNEL = 0xFF;
+
   AudioBoard( const std::string_view name, const uint8_t num_channels );
 
   const std::string& name() const { return name_; }
 
+  std::optional<uint8_t> channel_index( const std::string_view channel_name ) const;
+
   void set_gain( const std::string_view channel_name, const float gain1, const float gain2 );
+  void set_gain( const uint8_t ch_num, const float gain1, const float gain2 );
 
-  void set_channel_name( const uint8_t ch_num, const std::string_view name )
-  {
-    channels_.at( ch_num ).first = name;
-  }
+  void set_channel_name( const uint8_t ch_num, const std::string_view name );
 
   const AudioChannel& channel( const uint8_t ch_num ) const { return channels_.at( ch_num ).second; }
   AudioChannel& channel( const uint8_t ch_num ) { return channels_.at( ch_num ).second; }
@@ -36,7 +67,22 @@ public:
   uint8_t num_channels() const { return channels_.size(); }
   const std::string& channel_name( const uint8_t num ) const { return channels_.at( num ).first; }
 
-  const std::pair<float, float>& gain( const uint8_t ch_num ) const { return gains_.at( ch_num ); }
+  std::pair<float, float> gain( const uint8_t ch_num ) const { return { gains1_.at( ch_num ), gains2_.at( ch_num ) }; }
+
+  /* once the block [block, block + 2.5 ms) has been decoded on every channel: classifies each channel as active
+     or silent there, and stages the block for mixing */
+  void stage_block( const uint64_t block );
+
+  /* adds every audible channel except the excluded ones into ch1/ch2, for the samples starting at sample_index
+     (from the staged matrix when that is the block asked for) */
+  void mix_into( const uint64_t sample_index,
+                 span<float> ch1,
+                 span<float> ch2,
+                 const uint8_t exclude1 = NO_CHANNEL,
+                 const uint8_t exclude2 = NO_CHANNEL ) const;
+
+  /* could this channel add anything to a mix of these samples? (false if muted or known to be silent) */
+  bool audible( const uint8_t ch_num, const uint64_t sample_index, const size_t length ) const;
 
   void json_summary( Json::Value& root, const bool include_second_channels ) const;
 };
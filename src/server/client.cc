@@ -1,10 +1,10 @@
+#include <algorithm>
+
 #include "client.hh"
 
 using namespace std;
 using namespace chrono;
 
-using Option = RubberBand::RubberBandStretcher::Option;
-
 uint64_t Client::client_mix_cursor() const
 {
   return mix_cursor_;
@@ -19,36 +19,38 @@ AudioFeed::AudioFeed( const string_view name,
                       const uint32_t target_lag_samples,
                       const uint32_t min_lag_samples,
                       const uint32_t max_lag_samples,
+                      const uint32_t frame_samples,
+                      const TimeScaler::Kind scaler,
                       const bool short_window )
   : name_( name )
-  , cursor_( target_lag_samples, min_lag_samples, max_lag_samples )
-  , stretcher_( 48000,
-                2,
-                Option::OptionProcessRealTime | Option::OptionThreadingNever | Option::OptionPitchHighConsistency
-                  | ( short_window ? Option::OptionWindowShort : 0 ) )
-{
-  stretcher_.setMaxProcessSize( opus_frame::NUM_SAMPLES );
-  stretcher_.calculateStretch();
-}
+  , cursor_( target_lag_samples, min_lag_samples, max_lag_samples, frame_samples )
+  , stretcher_( TimeScaler::make( scaler, short_window ) )
+{}
 
 Client::Client( const uint8_t node_id,
                 const uint8_t ch1_num,
                 const uint8_t ch2_num,
                 CryptoSession&& crypto,
-                const bool send_mono )
+                const bool send_mono,
+                const uint16_t frame_samples )
   : connection_( 0, node_id, move( crypto ) )
-  , internal_feed_( "internal", 960, 120, 1920, true )
-  , quality_feed_( "quality", 4800, 4800 - 240, 4800 + 240, false )
+  , internal_feed_( "internal", 960, 120, 1920, frame_samples, TimeScaler::Kind::RubberBand, true )
+  , quality_feed_( "quality", 4800, 4800 - 240, 4800 + 240, frame_samples, TimeScaler::Kind::RubberBand, false )
   , encoder_( send_mono ? OpusEncoderProcess { 96000, 96000, 48000 } : OpusEncoderProcess { 96000, 48000 } )
   , ch1_num_( ch1_num )
   , ch2_num_( ch2_num )
-{}
+{
+  encoder_.set_frame_samples( frame_samples );
+}
 
 bool Client::receive_packet( const Address& source, const Ciphertext& ciphertext, const uint64_t clock_sample )
 {
   if ( connection_.receive_packet( ciphertext, source ) ) {
     if ( ( not outbound_frame_offset_.has_value() ) and connection_.has_destination() ) {
-      outbound_frame_offset_ = clock_sample / opus_frame::NUM_SAMPLES;
+      /* start on a boundary of the session's frame duration, where the board's shared mix has its frames */
+      const uint32_t blocks_per_frame = encoder_.frame_samples() / opus_frame::NUM_SAMPLES;
+      outbound_frame_offset_
+        = ( clock_sample / opus_frame::NUM_SAMPLES + blocks_per_frame - 1 ) / blocks_per_frame * blocks_per_frame;
     }
 
     if ( connection_.has_inbound_unreliable_data() ) {
@@ -73,15 +75,8 @@ void AudioFeed::decode_into( const PartialFrameStore<AudioFrame>& frames,
 {
   cursor_.setup( cursor_sample, frontier_sample_index );
 
-  Cursor::AudioSlice audio;
-
-  while ( cursor_.initialized() and cursor_sample > cursor_.num_samples_output() ) {
-    cursor_.sample( frames, frontier_sample_index, decoder_, stretcher_, audio );
-
-    if ( audio.good ) {
-      ch1.region( audio.sample_index, audio.length ).copy( audio.ch1_span() );
-      ch2.region( audio.sample_index, audio.length ).copy( audio.ch2_span() );
-    }
+  if ( cursor_.initialized() ) {
+    cursor_.sample_into( frames, frontier_sample_index, decoder_, *stretcher_, cursor_sample, ch1, ch2 );
   }
 }
 
@@ -89,13 +84,13 @@ void Client::decode_audio( const uint64_t cursor_sample, AudioBoard& internal_bo
 {
   internal_feed_.decode_into( connection_.frames(),
                               cursor_sample,
-                              connection_.unreceived_beyond_this_frame_index() * opus_frame::NUM_SAMPLES,
+                              connection_.unreceived_beyond_this_frame_index() * encoder_.frame_samples(),
                               internal_board.channel( ch1_num_ ),
                               internal_board.channel( ch2_num_ ) );
 
   quality_feed_.decode_into( connection_.frames(),
                              cursor_sample,
-                             connection_.unreceived_beyond_this_frame_index() * opus_frame::NUM_SAMPLES,
+                             connection_.unreceived_beyond_this_frame_index() * encoder_.frame_samples(),
                              quality_board.channel( ch1_num_ ),
                              quality_board.channel( ch2_num_ ) );
 
@@ -104,51 +99,108 @@ void Client::decode_audio( const uint64_t cursor_sample, AudioBoard& internal_bo
          connection_.next_frame_needed() - connection_.frames().range_begin() ) );
 }
 
-void Client::mix_and_encode( const AudioBoard& board, const uint64_t cursor_sample )
+bool Client::own_channels_silent( const AudioBoard& board, const uint64_t block ) const
+{
+  return not board.audible( ch1_num_, block, encoder_.frame_samples() )
+         and not board.audible( ch2_num_, block, encoder_.frame_samples() );
+}
+
+void Client::mix_and_encode( const AudioBoard& board, const uint64_t cursor_sample, SharedMix* shared_mix )
 {
   if ( not outbound_frame_offset_.has_value() ) {
     return;
   }
 
-  while ( server_mix_cursor() + opus_frame::NUM_SAMPLES <= cursor_sample ) {
-    span<float> ch1_target = mixed_audio_.ch1().region( client_mix_cursor(), opus_frame::NUM_SAMPLES );
-    span<float> ch2_target = mixed_audio_.ch2().region( client_mix_cursor(), opus_frame::NUM_SAMPLES );
-
-    for ( uint8_t channel_i = 0; channel_i < board.num_channels(); channel_i++ ) {
-      if ( channel_i == ch1_num_ or channel_i == ch2_num_ ) {
-        continue;
-      }
+  /* one frame of the session's duration, once its last 2.5 ms block is on the board */
+  const size_t frame_samples = encoder_.frame_samples();
+
+  while ( server_mix_cursor() + frame_samples <= cursor_sample ) {
+    quiet_samples_ = own_channels_silent( board, server_mix_cursor() ) ? quiet_samples_ + frame_samples : 0;
+
+    /* listen-only? then the mix-minus is the board's full mix, which may already be encoded */
+    if ( shared_mix and quiet_samples_ >= LISTEN_ONLY_SAMPLES
+         and shared_mix->frame( server_mix_cursor(), encoder_.measured_loss_percent(), shared_frame_.frame ) ) {
+      connection_.push_frame( shared_frame_ );
+      encoder_.skip_one_frame();
+      downlink_.shared_frames++;
+      sent_shared_frame_ = true;
+      mix_cursor_ += frame_samples;
+      continue;
+    }
 
-      const span_view<float> other_channel
-        = board.channel( channel_i ).region( server_mix_cursor(), opus_frame::NUM_SAMPLES );
+    if ( sent_shared_frame_ ) {
+      /* back from the shared mix: restart the encoder from the last 10 ms of the mix-minus (still on the board) */
+      array<float, opus_frame::MAX_SAMPLES> prime1 {}, prime2 {};
+      board.mix_into( server_mix_cursor() - opus_frame::MAX_SAMPLES,
+                      { prime1.data(), prime1.size() },
+                      { prime2.data(), prime2.size() },
+                      ch1_num_,
+                      ch2_num_ );
+      encoder_.resume( { prime1.data(), prime1.size() }, { prime2.data(), prime2.size() } );
+      sent_shared_frame_ = false;
+    }
 
-      const auto [gain_into_1, gain_into_2] = board.gain( channel_i );
-      for ( uint8_t sample_i = 0; sample_i < opus_frame::NUM_SAMPLES; sample_i++ ) {
-        const float value = other_channel[sample_i];
-        const float orig_1 = ch1_target[sample_i];
-        const float orig_2 = ch2_target[sample_i];
+    span<float> ch1_target = mixed_audio_.ch1().region( client_mix_cursor(), frame_samples );
+    span<float> ch2_target = mixed_audio_.ch2().region( client_mix_cursor(), frame_samples );
 
-        ch1_target[sample_i] = orig_1 + gain_into_1 * value;
-        ch2_target[sample_i] = orig_2 + gain_into_2 * value;
-      }
-    }
+    board.mix_into( server_mix_cursor(), ch1_target, ch2_target, ch1_num_, ch2_num_ );
 
-    mix_cursor_ += opus_frame::NUM_SAMPLES;
-  }
+    mix_cursor_ += frame_samples;
 
-  /* encode audio */
-  while ( encoder_.min_encode_cursor() + opus_frame::NUM_SAMPLES <= client_mix_cursor() ) {
+    /* encode audio */
     encoder_.encode_one_frame( mixed_audio_.ch1(), mixed_audio_.ch2() );
     connection_.push_frame( encoder_ );
   }
+  encoder_.adapt_to_loss( connection_.sender_stats().packet_transmissions,
+                          connection_.sender_stats().packet_losses() );
 
   /* pop used mixed audio */
   mixed_audio_.pop_before( encoder_.min_encode_cursor() );
 }
 
+void Client::adapt_encoder( const int complexity )
+{
+  encoder_.set_complexity( complexity );
+
+  if ( ++downlink_.ticks < DOWNLINK_WINDOW_TICKS ) {
+    return;
+  }
+  downlink_.ticks = 0;
+
+  const auto& sender = connection_.sender_stats();
+  if ( sender.smoothed_rtt > 0 ) {
+    downlink_.rtt_samples[downlink_.rtt_sample_count++ % MIN_RTT_WINDOWS] = sender.smoothed_rtt;
+  }
+
+  const auto recent_rtts = downlink_.rtt_samples.begin() + min( downlink_.rtt_sample_count, MIN_RTT_WINDOWS );
+  const bool queueing = downlink_.rtt_sample_count
+                        and sender.smoothed_rtt
+                              > *min_element( downlink_.rtt_samples.begin(), recent_rtts ) + QUEUEING_DELAY_NS;
+  const int loss_percent = encoder_.measured_loss_percent();
+
+  if ( queueing or loss_percent >= CONGESTED_LOSS_PERCENT ) {
+    downlink_.clean_windows = 0;
+    if ( downlink_.rung + 1u < BIT_RATES.size() ) {
+      downlink_.rung++;
+      downlink_.steps_down++;
+    }
+  } else if ( loss_percent == 0 ) {
+    if ( ++downlink_.clean_windows >= CLEAN_WINDOWS_BEFORE_STEP_UP and downlink_.rung > 0 ) {
+      downlink_.rung--;
+      downlink_.steps_up++;
+      downlink_.clean_windows = 0;
+    }
+  } else {
+    downlink_.clean_windows = 0;
+  }
+
+  encoder_.set_bit_rate( BIT_RATES.at( downlink_.rung ) );
+}
+
 void Client::send_packet( UDPSocket& socket )
 {
-  if ( connection_.has_destination() ) {
+  /* one packet per frame (not per tick) when frames are longer than 2.5 ms */
+  if ( connection_.has_destination() and connection_.has_new_frame() ) {
     connection_.send_packet( socket );
   }
 }
@@ -175,6 +227,17 @@ void Client::json_summary( Json::Value& root ) const
   root["client"]["actual_lag"] = last_client_report_.actual_lag;
   root["client"]["quality"] = last_client_report_.quality;
   root["client"]["self_gain"] = last_client_report_.self_gain;
+
+  root["downlink"]["bit_rate"] = encoder_.bit_rate();
+  root["downlink"]["complexity"] = encoder_.complexity().value_or( -1 );
+  root["downlink"]["measured_loss"] = encoder_.measured_loss_percent();
+  root["downlink"]["expected_loss"] = encoder_.expected_loss_percent(); /* 0 unless fec_possible */
+  root["downlink"]["fec_possible"] = encoder_.can_carry_fec();
+  root["downlink"]["rtt_ms"] = connection_.sender_stats().smoothed_rtt / 1'000'000;
+  root["downlink"]["steps_down"] = downlink_.steps_down;
+  root["downlink"]["steps_up"] = downlink_.steps_up;
+  root["downlink"]["shared_frames"] = downlink_.shared_frames;
+  root["downlink"]["frame_ms"] = encoder_.frame_samples() / 48.0;
 }
 
 void Client::default_json_summary( Json::Value& root )
@@ -189,6 +252,17 @@ void Client::default_json_summary( Json::Value& root )
   root["client"]["actual_lag"] = 0;
   root["client"]["quality"] = 0;
   root["client"]["self_gain"] = 0;
+
+  root["downlink"]["bit_rate"] = 0;
+  root["downlink"]["complexity"] = 0;
+  root["downlink"]["measured_loss"] = 0;
+  root["downlink"]["expected_loss"] = 0;
+  root["downlink"]["fec_possible"] = false;
+  root["downlink"]["rtt_ms"] = 0;
+  root["downlink"]["steps_down"] = 0;
+  root["downlink"]["steps_up"] = 0;
+  root["downlink"]["shared_frames"] = 0;
+  root["downlink"]["frame_ms"] = 0;
 }
 
 void KnownClient::summary( ostream& out ) const
@@ -205,18 +279,29 @@ void KnownClient::summary( ostream& out ) const
 bool KnownClient::try_keyrequest( const Address& src, const Ciphertext& ciphertext, UDPSocket& socket )
 {
   Plaintext plaintext;
-  if ( long_lived_crypto_.decrypt( ciphertext, { &KeyMessage::keyreq_id, 1 }, plaintext )
-       and ( plaintext.length() == 0 ) ) {
+  if ( long_lived_crypto_.decrypt( ciphertext, { &KeyMessage::keyreq_id, 1 }, plaintext ) ) {
+    /* the client's preferred frame duration, if it states one */
+    NetInteger<uint16_t> requested_frame_samples { opus_frame::NUM_SAMPLES };
+    if ( plaintext.length() > 0 ) {
+      Parser p { plaintext };
+      p.object( requested_frame_samples );
+      if ( p.error() or not opus_frame::valid_num_samples( requested_frame_samples ) ) {
+        return false;
+      }
+    }
+
     stats_.key_requests++;
     if ( steady_clock::now() < next_reply_allowed_ ) {
       return true;
     }
 
+    next_frame_samples_ = requested_frame_samples;
+
     /* reply with keys to next session */
     Plaintext outgoing_keys;
     {
       Serializer s { outgoing_keys.mutable_buffer() };
-      s.object( KeyMessage { id_, next_keys_ } );
+      s.object( KeyMessage { id_, next_keys_, next_frame_samples_ } );
       outgoing_keys.resize( s.bytes_written() );
     }
     Ciphertext outgoing_ciphertext;
@@ -254,7 +339,8 @@ void KnownClient::receive_packet( const Address& src, const Ciphertext& cipherte
   Plaintext throwaway_plaintext;
   if ( next_session_.value().decrypt( ciphertext, { &id_, 1 }, throwaway_plaintext ) ) {
     /* new session established */
-    current_session_.emplace( id_, ch1_num_, ch2_num_, move( next_session_.value() ), takes_program_audio_ );
+    current_session_.emplace(
+      id_, ch1_num_, ch2_num_, move( next_session_.value() ), takes_program_audio_, next_frame_samples_ );
 
     next_keys_ = KeyPair {};
     next_session_.emplace( next_keys_.downlink, next_keys_.uplink );
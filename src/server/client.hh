@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <ostream>
 #include <vector>
@@ -9,21 +10,23 @@
 #include "control_messages.hh"
 #include "cursor.hh"
 #include "keys.hh"
-
-#include <rubberband/RubberBandStretcher.h>
+#include "shared_mix.hh"
+#include "time_scaler.hh"
 
 class AudioFeed
 {
   std::string name_;
   Cursor cursor_;
   OpusDecoderProcess decoder_ { true };
-  RubberBand::RubberBandStretcher stretcher_;
+  std::unique_ptr<TimeScaler> stretcher_;
 
 public:
   AudioFeed( const std::string_view name,
              const uint32_t target_lag_samples,
              const uint32_t min_lag_samples,
              const uint32_t max_lag_samples,
+             const uint32_t frame_samples,
+             const TimeScaler::Kind scaler,
              const bool short_window );
 
   void summary( std::ostream& out ) const { cursor_.summary( out ); }
@@ -65,6 +68,32 @@ class Client
 
   OpusEncoderProcess encoder_;
 
+  /* downlink bit rate: a step down whenever the link shows loss or queueing, a step up after a clean spell */
+  static constexpr std::array<int, 4> BIT_RATES { 96000, 64000, 48000, 32000 };
+  static constexpr unsigned int DOWNLINK_WINDOW_TICKS = 400;  /* 1 s */
+  static constexpr float QUEUEING_DELAY_NS = 30'000'000;      /* RTT this far above its recent minimum */
+  static constexpr unsigned int MIN_RTT_WINDOWS = 10;         /* 10 s, so a route with a longer RTT is adopted */
+  static constexpr int CONGESTED_LOSS_PERCENT = 5;
+  static constexpr unsigned int CLEAN_WINDOWS_BEFORE_STEP_UP = 5;
+
+  struct DownlinkControl
+  {
+    uint8_t rung;
+    unsigned int ticks, clean_windows;
+    std::array<float, MIN_RTT_WINDOWS> rtt_samples; /* one per window, oldest overwritten */
+    unsigned int rtt_sample_count;
+    unsigned int steps_down, steps_up;
+    unsigned int shared_frames;
+  } downlink_ {};
+
+  /* a client whose own channels have been silent this long gets the board's shared full mix */
+  static constexpr size_t LISTEN_ONLY_SAMPLES = 48000; /* 1 s */
+  size_t quiet_samples_ {};
+  SharedFrameSource shared_frame_ {};
+  bool sent_shared_frame_ {}; /* the last frame came from the shared mix (the encoder sat it out) */
+
+  bool own_channels_silent( const AudioBoard& board, const uint64_t block ) const;
+
   uint8_t ch1_num_, ch2_num_;
 
   client_report last_client_report_ {};
@@ -74,11 +103,19 @@ public:
           const uint8_t ch1,
           const uint8_t ch2,
           CryptoSession&& crypto,
-          const bool send_stereo );
+          const bool send_stereo,
+          const uint16_t frame_samples );
 
   bool receive_packet( const Address& source, const Ciphertext& ciphertext, const uint64_t clock_sample );
   void decode_audio( const uint64_t cursor_sample, AudioBoard& internal_board, AudioBoard& quality_board );
-  void mix_and_encode( const AudioBoard& board, const uint64_t cursor_sample );
+  void mix_and_encode( const AudioBoard& board, const uint64_t cursor_sample, SharedMix* shared_mix = nullptr );
+
+  /* called every tick with the server-wide complexity; revisits the bit rate once per window */
+  void adapt_encoder( const int complexity );
+
+  bool separate_channels() const { return encoder_.separate_channels(); }
+  int bit_rate() const { return encoder_.bit_rate(); }
+  size_t frame_samples() const { return encoder_.frame_samples(); }
   void send_packet( UDPSocket& socket );
 
   void summary( std::ostream& out ) const;
@@ -108,6 +145,7 @@ class KnownClient
 
   KeyPair next_keys_ {};
   std::optional<CryptoSession> next_session_;
+  uint16_t next_frame_samples_ { opus_frame::NUM_SAMPLES }; /* as last offered to the client */
 
   struct Statistics
   {
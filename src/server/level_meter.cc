@@ -0,0 +1,82 @@
+#include "level_meter.hh"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+const LevelMeter::Tables& LevelMeter::tables()
+{
+  static const Tables tables = [] {
+    Tables ret;
+    ret.decays[0] = 1;
+    for ( size_t n = 1; n <= MAX_BLOCK; n++ ) {
+      ret.decays[n] = ret.decays[n - 1] * ( 1 - ALPHA );
+    }
+    for ( size_t i = 0; i < MAX_BLOCK; i++ ) {
+      ret.weights[i] = ALPHA * ret.decays[MAX_BLOCK - 1 - i];
+    }
+    return ret;
+  }();
+
+  return tables;
+}
+
+void LevelMeter::add( const span_view<float> samples, const float gain )
+{
+  for ( size_t i = 0; i < samples.size(); i += MAX_BLOCK ) {
+    add_block( samples.substr( i, MAX_BLOCK ), gain );
+  }
+}
+
+void LevelMeter::add_block( const span_view<float> samples, const float gain )
+{
+  const size_t n = samples.size();
+  const float* weights = tables().weights.data() + MAX_BLOCK - n;
+  const float* x = samples.data();
+
+  /* plain loops over contiguous memory, so the compiler vectorizes them */
+  float weighted_energy = 0, energy = 0, peak = 0;
+  for ( size_t k = 0; k < n; k++ ) {
+    const float square = x[k] * x[k];
+    weighted_energy += weights[k] * square;
+    energy += square;
+    peak = max( peak, abs( x[k] ) );
+  }
+
+  const float gain_squared = gain * gain;
+  power_ = tables().decays[n] * power_ + gain_squared * weighted_energy;
+
+  peak *= abs( gain );
+  if ( peak >= peak_hold_ or peak_hold_remaining_ <= n ) {
+    peak_hold_ = peak;
+    peak_hold_remaining_ = PEAK_HOLD_SAMPLES;
+  } else {
+    peak_hold_remaining_ -= n;
+  }
+
+  bucket_energy_ += gain_squared * energy;
+  bucket_samples_ += n;
+  if ( bucket_samples_ >= LOUDNESS_BUCKET_SAMPLES ) {
+    loudness_buckets_[next_bucket_] = bucket_energy_ / bucket_samples_;
+    next_bucket_ = ( next_bucket_ + 1 ) % LOUDNESS_BUCKETS;
+    bucket_energy_ = 0;
+    bucket_samples_ = 0;
+  }
+}
+
+float LevelMeter::amplitude() const
+{
+  return sqrt( power_ );
+}
+
+float LevelMeter::short_term_loudness() const
+{
+  float mean_square = 0;
+  for ( const float bucket : loudness_buckets_ ) {
+    mean_square += bucket;
+  }
+  mean_square /= LOUDNESS_BUCKETS;
+
+  return max( -70.0f, -0.691f + 10 * log10( mean_square + 1e-12f ) );
+}
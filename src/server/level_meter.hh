@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "spans.hh"
+
+/* one channel's meter, fed a block at a time: power (the same exponentially weighted mean square that a
+   per-sample ewma_update with ALPHA gives), peak hold, and short-term loudness over the last 3 s */
+class LevelMeter
+{
+public:
+  static constexpr float ALPHA = 0.0002;
+
+private:
+  static constexpr size_t MAX_BLOCK = 480;
+
+  /* weights[MAX_BLOCK - n + k] = ALPHA (1 - ALPHA)^(n - 1 - k) for the k-th of n samples, decays[n] = (1 - ALPHA)^n */
+  struct Tables
+  {
+    std::array<float, MAX_BLOCK> weights {};
+    std::array<float, MAX_BLOCK + 1> decays {};
+  };
+  static const Tables& tables();
+
+  float power_ {};
+
+  static constexpr uint64_t PEAK_HOLD_SAMPLES = 96000; /* 2 s */
+  float peak_hold_ {};
+  uint64_t peak_hold_remaining_ {};
+
+  /* 30 buckets of 100 ms, like the EBU R128 short-term window */
+  static constexpr size_t LOUDNESS_BUCKET_SAMPLES = 4800;
+  static constexpr size_t LOUDNESS_BUCKETS = 30;
+  std::array<float, LOUDNESS_BUCKETS> loudness_buckets_ {};
+  size_t next_bucket_ {}, bucket_samples_ {};
+  float bucket_energy_ {};
+
+  void add_block( const span_view<float> samples, const float gain );
+
+public:
+  void add( const span_view<float> samples, const float gain );
+
+  float amplitude() const;
+  float peak() const { return peak_hold_; }
+
+  /* mean square over the last 3 s on the LUFS scale (no K-weighting), floored at -70 */
+  float short_term_loudness() const;
+};
@@ -81,6 +81,10 @@ NetworkMultiServer::NetworkMultiServer( const uint8_t num_clients, EventLoop& lo
     [&] {
       const uint64_t ts_now = Timer::timestamp_ns();
 
+      if ( server_clock() >= next_cursor_sample_ + opus_frame::NUM_SAMPLES ) {
+        load_.late_ticks++;
+      }
+
       /* decode all audio */
       for ( auto& client : clients_ ) {
         if ( client ) {
@@ -91,17 +95,22 @@ NetworkMultiServer::NetworkMultiServer( const uint8_t num_clients, EventLoop& lo
         }
       }
 
+      internal_board_.stage_block( next_cursor_sample_ - opus_frame::NUM_SAMPLES );
+      program_board_.stage_block( next_cursor_sample_ - opus_frame::NUM_SAMPLES );
+
       /* mix all audio */
       for ( auto& client : clients_ ) {
         if ( client ) {
-          if ( client.takes_program_audio() ) {
-            client.client().mix_and_encode( program_board_, next_cursor_sample_ );
-          } else {
-            client.client().mix_and_encode( internal_board_, next_cursor_sample_ );
-          }
+          client.client().adapt_encoder( load_.complexity );
+          const AudioBoard& board = client.takes_program_audio() ? program_board_ : internal_board_;
+          client.client().mix_and_encode( board, next_cursor_sample_, &shared_mix( board, client.client() ) );
         }
       }
 
+      for ( auto& mix : shared_mixes_ ) {
+        mix.set_complexity( load_.complexity );
+      }
+
       internal_audio_.mix_and_write( internal_board_, next_cursor_sample_ );
       program_audio_.mix_and_write( program_board_, next_cursor_sample_ );
 
@@ -118,13 +127,66 @@ NetworkMultiServer::NetworkMultiServer( const uint8_t num_clients, EventLoop& lo
       }
 
       next_cursor_sample_ += opus_frame::NUM_SAMPLES;
+
+      adapt_complexity( Timer::timestamp_ns() - ts_now );
     },
     [&] { return server_clock() >= next_cursor_sample_; } );
 }
 
+SharedMix& NetworkMultiServer::shared_mix( const AudioBoard& board, const Client& client )
+{
+  for ( auto& mix : shared_mixes_ ) {
+    if ( mix.matches( board, client.separate_channels(), client.bit_rate(), client.frame_samples() ) ) {
+      return mix;
+    }
+  }
+
+  return shared_mixes_.emplace_back( board, client.separate_channels(), client.bit_rate(), client.frame_samples() );
+}
+
+void NetworkMultiServer::adapt_complexity( const uint64_t tick_ns )
+{
+  load_.worst_tick_ns = max( load_.worst_tick_ns, tick_ns );
+
+  if ( tick_ns > TICK_BUDGET_NS * 6 / 10 ) {
+    load_.slow_ticks++;
+  }
+
+  load_.ticks_since_drop = min( load_.ticks_since_drop + 1, LOAD_WINDOW_TICKS );
+  if ( load_.slow_ticks >= SLOW_TICKS_TO_DROP and load_.ticks_since_drop == LOAD_WINDOW_TICKS
+       and load_.complexity > 0 ) {
+    load_.complexity = max( 0, load_.complexity - 2 );
+    load_.complexity_drops++;
+    load_.slow_ticks = 0;
+    load_.ticks_since_drop = 0;
+  }
+
+  if ( ++load_.ticks < LOAD_WINDOW_TICKS ) {
+    return;
+  }
+
+  if ( load_.worst_tick_ns < TICK_BUDGET_NS * 3 / 10 and load_.complexity < MAX_COMPLEXITY ) {
+    load_.complexity++;
+    load_.complexity_raises++;
+  }
+
+  load_.last_window_worst_tick_ns = load_.worst_tick_ns;
+  load_.worst_tick_ns = 0;
+  load_.ticks = 0;
+  load_.slow_ticks = 0;
+}
+
 void NetworkMultiServer::summary( ostream& out ) const
 {
-  out << "bad packets: " << stats_.bad_packets << "\n";
+  out << "bad packets: " << stats_.bad_packets;
+  out << " complexity=" << load_.complexity << " (-" << load_.complexity_drops << " +" << load_.complexity_raises
+      << ")";
+  out << " worst tick=";
+  Timer::pp_ns( out, load_.last_window_worst_tick_ns );
+  if ( load_.late_ticks ) {
+    out << " late ticks=" << load_.late_ticks << "!";
+  }
+  out << "\n";
   for ( const auto& client : clients_ ) {
     if ( client ) {
       out << "#" << int( client.client().peer_id() ) << ": ";
@@ -138,6 +200,21 @@ void NetworkMultiServer::json_summary( Json::Value& root, const bool include_sec
   internal_board_.json_summary( root["board"][internal_board_.name()], include_second_channels );
   program_board_.json_summary( root["board"][program_board_.name()], include_second_channels );
 
+  root["encoder"]["complexity"] = load_.complexity;
+  root["encoder"]["complexity_drops"] = load_.complexity_drops;
+  root["encoder"]["complexity_raises"] = load_.complexity_raises;
+  root["encoder"]["worst_tick_us"] = Json::UInt64( load_.last_window_worst_tick_ns / 1000 );
+  root["encoder"]["late_ticks"] = load_.late_ticks;
+
+  unsigned int shared_frames_encoded = 0, shared_frames_sent = 0;
+  for ( const auto& mix : shared_mixes_ ) {
+    shared_frames_encoded += mix.stats().frames_encoded;
+    shared_frames_sent += mix.stats().frames_shared;
+  }
+  root["encoder"]["shared_mixes"] = Json::UInt( shared_mixes_.size() );
+  root["encoder"]["shared_frames_encoded"] = shared_frames_encoded;
+  root["encoder"]["shared_frames_sent"] = shared_frames_sent;
+
   for ( const auto& client : clients_ ) {
     if ( client ) {
       client.client().json_summary( root["client"][client.name()] );
@@ -23,11 +23,33 @@ class NetworkMultiServer : public Summarizable
   AudioBoard internal_board_, program_board_;
   std::vector<KnownClient> clients_ {};
 
+  /* one per (board, channel layout, bit rate, frame duration) that a listen-only client has needed */
+  std::vector<SharedMix> shared_mixes_ {};
+  SharedMix& shared_mix( const AudioBoard& board, const Client& client );
+
   struct Stats
   {
     unsigned int bad_packets;
   } stats_ {};
 
+  /* Opus complexity for every client's encoder: cut when ticks keep using too much of their 2.5 ms (at most once
+     a second, so a brief hiccup can't take it to 0), and raised one step at a time after a second of ticks with
+     plenty of headroom */
+  static constexpr uint64_t TICK_BUDGET_NS = 2'500'000;
+  static constexpr int MAX_COMPLEXITY = 10;
+  static constexpr unsigned int LOAD_WINDOW_TICKS = 400; /* 1 s */
+  static constexpr unsigned int SLOW_TICKS_TO_DROP = 8;
+
+  struct TickLoad
+  {
+    int complexity { MAX_COMPLEXITY };
+    unsigned int ticks, slow_ticks, late_ticks, complexity_drops, complexity_raises;
+    unsigned int ticks_since_drop { LOAD_WINDOW_TICKS };
+    uint64_t worst_tick_ns, last_window_worst_tick_ns;
+  } load_ {};
+
+  void adapt_complexity( const uint64_t tick_ns );
+
   AudioWriter internal_audio_ { "stagecast-internal-audio", "stagecast-internal-audio-filmout" };
   AudioWriter program_audio_ { "stagecast-program-audio", "stagecast-program-audio-filmout" };
 
@@ -0,0 +1,63 @@
+#include "shared_mix.hh"
+
+using namespace std;
+
+SharedMix::SharedMix( const AudioBoard& board,
+                      const bool separate_channels,
+                      const int bit_rate,
+                      const size_t frame_samples )
+  : board_( board )
+  , separate_channels_( separate_channels )
+  , bit_rate_( bit_rate )
+  , frame_samples_( frame_samples )
+  , encoder_( separate_channels ? OpusEncoderProcess { bit_rate, bit_rate, 48000 }
+                                : OpusEncoderProcess { bit_rate, 48000 } )
+{
+  encoder_.set_frame_samples( frame_samples_ );
+}
+
+bool SharedMix::frame( const uint64_t block, const int expected_loss_percent, AudioFrame& out )
+{
+  pending_loss_percent_ = max( pending_loss_percent_, expected_loss_percent );
+
+  const uint64_t encode_cursor = encoder_.min_encode_cursor();
+
+  if ( not origin_.has_value() or block > origin_.value() + encode_cursor ) {
+    /* nobody has listened since the last frame encoded: carry on from here */
+    origin_ = block - encode_cursor;
+  }
+
+  if ( block == origin_.value() + encode_cursor ) {
+    encode_next();
+  }
+
+  const auto& [recent_block, recent_frame] = recent_.at( ( block / frame_samples_ ) % RECENT_FRAMES );
+  if ( recent_block != block ) {
+    return false;
+  }
+
+  out = recent_frame;
+  stats_.frames_shared++;
+  return true;
+}
+
+void SharedMix::encode_next()
+{
+  const uint64_t local_cursor = encoder_.min_encode_cursor();
+  const uint64_t block = origin_.value() + local_cursor;
+
+  span<float> ch1_target = mixed_audio_.ch1().region( local_cursor, frame_samples_ );
+  span<float> ch2_target = mixed_audio_.ch2().region( local_cursor, frame_samples_ );
+
+  board_.mix_into( block, ch1_target, ch2_target );
+
+  encoder_.set_expected_loss( pending_loss_percent_ );
+  pending_loss_percent_ = 0;
+
+  encoder_.encode_one_frame( mixed_audio_.ch1(), mixed_audio_.ch2() );
+  recent_.at( ( block / frame_samples_ ) % RECENT_FRAMES ) = { block, encoder_.front( 0 ) };
+  encoder_.pop_frame();
+  stats_.frames_encoded++;
+
+  mixed_audio_.pop_before( encoder_.min_encode_cursor() );
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <optional>
+
+#include "audioboard.hh"
+#include "encoder_task.hh"
+
+/* the full mix of one board, encoded once for all the listen-only clients that receive that board (a client
+   whose own channels are silent or muted gets exactly this mix as its mix-minus) */
+class SharedMix
+{
+  const AudioBoard& board_;
+  bool separate_channels_;
+  int bit_rate_;
+  size_t frame_samples_;
+
+  ChannelPair mixed_audio_ { 8192 };
+  OpusEncoderProcess encoder_;
+
+  /* server sample index of the encoder's sample 0 (moved forward after a spell without listeners) */
+  std::optional<uint64_t> origin_ {};
+
+  /* frames already encoded, for the listeners that ask after the first one this tick */
+  static constexpr size_t RECENT_FRAMES = 16;
+  std::array<std::pair<uint64_t, AudioFrame>, RECENT_FRAMES> recent_ {};
+
+  /* FEC is sized for the lossiest listener */
+  int pending_loss_percent_ {};
+
+  struct Statistics
+  {
+    unsigned int frames_encoded, frames_shared;
+  } stats_ {};
+
+  void encode_next();
+
+public:
+  SharedMix( const AudioBoard& board, const bool separate_channels, const int bit_rate, const size_t frame_samples );
+
+  bool matches( const AudioBoard& board,
+                const bool separate_channels,
+                const int bit_rate,
+                const size_t frame_samples ) const
+  {
+    return &board == &board_ and separate_channels == separate_channels_ and bit_rate == bit_rate_
+           and frame_samples == frame_samples_;
+  }
+
+  /* the encoded mix for the frame starting at server sample `block` (a multiple of the frame duration), unless it
+     is too old to be had */
+  bool frame( const uint64_t block, const int expected_loss_percent, AudioFrame& out );
+
+  void set_complexity( const int complexity ) { encoder_.set_complexity( complexity ); }
+
+  const Statistics& stats() const { return stats_; }
+};
+
+/* hands a shared frame to a NetworkSender as if it came from the client's own encoder */
+struct SharedFrameSource
+{
+  AudioFrame frame {};
+
+  AudioFrame front( const uint32_t frame_index ) const
+  {
+    AudioFrame ret = frame;
+    ret.frame_index = frame_index;
+    return ret;
+  }
+
+  void pop_frame() {}
+};
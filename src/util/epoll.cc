@@ -0,0 +1,43 @@
+#include "epoll.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+EpollSet::EpollSet()
+  : FileDescriptor( ::CheckSystemCall( "epoll_create1", epoll_create1( EPOLL_CLOEXEC ) ) )
+{}
+
+void EpollSet::control( const int op, const FileDescriptor& fd, const uint32_t events, const uint64_t data )
+{
+  epoll_event event {};
+  event.events = events;
+  event.data.u64 = data;
+  CheckSystemCall( "epoll_ctl", epoll_ctl( fd_num(), op, fd.fd_num(), &event ) );
+}
+
+void EpollSet::add( const FileDescriptor& fd, const uint32_t events, const uint64_t data )
+{
+  control( EPOLL_CTL_ADD, fd, events, data );
+}
+
+void EpollSet::modify( const FileDescriptor& fd, const uint32_t events, const uint64_t data )
+{
+  control( EPOLL_CTL_MOD, fd, events, data );
+}
+
+void EpollSet::remove( const FileDescriptor& fd )
+{
+  control( EPOLL_CTL_DEL, fd, 0, 0 );
+}
+
+//! \param[out] events is resized to hold the ready events
+void EpollSet::wait( vector<epoll_event>& events )
+{
+  events.resize( max( events.capacity(), size_t( 1 ) ) );
+  const int count = CheckSystemCall( "epoll_wait", epoll_wait( fd_num(), events.data(), events.size(), 0 ) );
+  events.resize( count );
+  register_read();
+}
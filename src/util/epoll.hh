@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <sys/epoll.h>
+#include <vector>
+
+#include "file_descriptor.hh"
+
+//! \brief A set of file descriptors watched with [epoll(7)](\ref man7::epoll)
+//! \details The set is itself a FileDescriptor that becomes readable when any member is ready,
+//! so one EventLoop rule can stand in for thousands of sockets.
+class EpollSet : public FileDescriptor
+{
+  void control( const int op, const FileDescriptor& fd, const uint32_t events, const uint64_t data );
+
+public:
+  //! Create an empty set
+  EpollSet();
+
+  //! Start watching `fd` for `events` (e.g. EPOLLIN | EPOLLOUT), reported with `data`
+  void add( const FileDescriptor& fd, const uint32_t events, const uint64_t data );
+
+  //! Change the events watched on `fd`
+  void modify( const FileDescriptor& fd, const uint32_t events, const uint64_t data );
+
+  //! Stop watching `fd`
+  void remove( const FileDescriptor& fd );
+
+  //! Collect ready events without blocking (up to events.capacity(), at least one slot)
+  void wait( std::vector<epoll_event>& events );
+};
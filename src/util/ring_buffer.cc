@@ -65,6 +65,11 @@ std::string_view RingBuffer::readable_region() const
   return storage( next_index_to_read() ).substr( 0, bytes_stored() );
 }
 
+string_span RingBuffer::mutable_readable_region()
+{
+  return mutable_storage( next_index_to_read() ).substr( 0, bytes_stored() );
+}
+
 void RingBuffer::pop( const size_t num_bytes )
 {
   if ( num_bytes > readable_region().length() ) {
@@ -43,6 +43,7 @@ public:
   void push( const size_t num_bytes );
 
   std::string_view readable_region() const;
+  string_span mutable_readable_region();
   void pop( const size_t num_bytes );
 
   void push_from_fd( FileDescriptor& fd ) { push( fd.read( writable_region() ) ); }
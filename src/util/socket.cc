@@ -3,6 +3,7 @@
 #include "exception.hh"
 
 #include <cstddef>
+#include <linux/tls.h>
 #include <netinet/tcp.h>
 #include <stdexcept>
 #include <unistd.h>
@@ -171,6 +172,18 @@ TCPSocket TCPSocket::accept()
   return TCPSocket( FileDescriptor( CheckSystemCall( "accept", ::accept( fd_num(), nullptr, nullptr ) ) ) );
 }
 
+// accept a pending connection if there is one
+//! \returns a new non-blocking TCPSocket connected to the peer, or nothing if no connection was waiting
+optional<TCPSocket> TCPSocket::try_accept()
+{
+  register_read();
+  const int fd = ::accept4( fd_num(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC );
+  if ( fd < 0 and ( errno == EAGAIN or errno == EWOULDBLOCK or errno == ECONNABORTED ) ) {
+    return {};
+  }
+  return TCPSocket( FileDescriptor( CheckSystemCall( "accept4", fd ) ) );
+}
+
 // get socket option
 template<typename option_type>
 socklen_t Socket::getsockopt( const int level, const int option, option_type& option_value ) const
@@ -198,6 +211,12 @@ void Socket::set_reuseaddr()
   setsockopt( SOL_SOCKET, SO_REUSEADDR, int( true ) );
 }
 
+// let several sockets (e.g. one per thread) listen on the same port
+void Socket::set_reuseport()
+{
+  setsockopt( SOL_SOCKET, SO_REUSEPORT, int( true ) );
+}
+
 void Socket::throw_if_error() const
 {
   int socket_error = 0;
@@ -215,3 +234,13 @@ void TCPSocket::set_tcp_nodelay( const bool tcp_nodelay )
 {
   setsockopt( IPPROTO_TCP, TCP_NODELAY, int( tcp_nodelay ) );
 }
+
+//! \details Attaches the kernel TLS upper-layer protocol, then installs the transmit keys,
+//! so later writes of plaintext go out as TLS records (see [tls](\ref man7::tls)).
+//! \param[in] crypto_info is one of the `tls12_crypto_info_*` structures from <linux/tls.h>
+void TCPSocket::set_kernel_tls_tx( const std::string_view crypto_info )
+{
+  setsockopt( SOL_TCP, TCP_ULP, "tls" );
+  CheckSystemCall( "setsockopt(SOL_TLS, TLS_TX)",
+                   ::setsockopt( fd_num(), SOL_TLS, TLS_TX, crypto_info.data(), crypto_info.size() ) );
+}
@@ -6,6 +6,7 @@
 
 #include <cstdint>
 #include <functional>
+#include <optional>
 #include <sys/socket.h>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
@@ -50,6 +51,10 @@ public:
   //! Allow local address to be reused sooner via [SO_REUSEADDR](\ref man7::socket)
   void set_reuseaddr();
 
+  //! Let several sockets bind the same address, with the kernel spreading connections across them,
+  //! via [SO_REUSEPORT](\ref man7::socket)
+  void set_reuseport();
+
   //! Check for errors (will be seen on non-blocking sockets)
   void throw_if_error() const;
 };
@@ -113,6 +118,12 @@ public:
   //! Accept a new incoming connection
   TCPSocket accept();
 
+  //! Accept a pending connection (as a non-blocking socket) if there is one, without blocking
+  std::optional<TCPSocket> try_accept();
+
   //! Set the TCP_NODELAY option to disable the Nagle algorithm
   void set_tcp_nodelay( const bool tcp_nodelay );
+
+  //! Hand TLS record encryption for outgoing data to the kernel
+  void set_kernel_tls_tx( const std::string_view crypto_info );
 };
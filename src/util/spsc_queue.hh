@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+/* bounded queue between one producer thread and one consumer thread; push and pop never lock or block */
+template<typename T>
+class SPSCQueue
+{
+  std::vector<T> slots_;
+
+  /* head: next to pop (written only by the consumer), tail: next to push (written only by the producer) */
+  alignas( 64 ) std::atomic<size_t> head_ { 0 };
+  alignas( 64 ) std::atomic<size_t> tail_ { 0 };
+
+public:
+  explicit SPSCQueue( const size_t capacity )
+    : slots_( capacity )
+  {
+    if ( capacity == 0 ) {
+      throw std::runtime_error( "SPSCQueue: capacity must be nonzero" );
+    }
+  }
+
+  /* false if the queue is full */
+  bool push( T&& value )
+  {
+    const size_t tail = tail_.load( std::memory_order_relaxed );
+    if ( tail - head_.load( std::memory_order_acquire ) == slots_.size() ) {
+      return false;
+    }
+
+    slots_[tail % slots_.size()] = std::move( value );
+    tail_.store( tail + 1, std::memory_order_release );
+    return true;
+  }
+
+  /* false if the queue is empty */
+  bool pop( T& out )
+  {
+    const size_t head = head_.load( std::memory_order_relaxed );
+    if ( head == tail_.load( std::memory_order_acquire ) ) {
+      return false;
+    }
+
+    out = std::move( slots_[head % slots_.size()] );
+    head_.store( head + 1, std::memory_order_release );
+    return true;
+  }
+
+  size_t capacity() const { return slots_.size(); }
+};
@@ -35,8 +35,10 @@
 
 #include <iostream>
 
+#include "deinterleave.hh"
 #include "exception.hh"
 #include "jpeg.hh"
+#include "timer.hh"
 
 using namespace std;
 
@@ -45,10 +47,12 @@ static constexpr int capture_type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 Camera::Camera( const uint16_t width,
                 const uint16_t height,
                 const string& device_name,
-                const uint32_t pixel_format )
+                const uint32_t pixel_format,
+                const uint32_t memory )
   : width_( width )
   , height_( height )
   , pixel_format_( pixel_format )
+  , memory_( memory )
   , device_name_( device_name )
   , camera_fd_( CheckSystemCall( "open camera", open( device_name.c_str(), O_RDWR ) ) )
   , kernel_v4l2_buffers_()
@@ -76,6 +80,29 @@ Camera::Camera( const uint16_t width,
     throw runtime_error( "couldn't configure the camera with the given format" );
   }
 
+  bytes_per_line_ = format.fmt.pix.bytesperline;
+
+  if ( memory_ == V4L2_MEMORY_USERPTR ) {
+    /* the driver has to produce exactly the RasterYUV420 layout */
+    if ( pixel_format_ != V4L2_PIX_FMT_YUV420 ) {
+      throw runtime_error( "USERPTR capture requires V4L2_PIX_FMT_YUV420" );
+    }
+
+    if ( padded_stride( width_ ) != width_ or padded_stride( width_ / 2 ) != width_ / 2 ) {
+      throw runtime_error( "USERPTR capture: width must be a multiple of 128" );
+    }
+
+    if ( bytes_per_line_ != width_ or format.fmt.pix.sizeimage != size_t( width_ ) * height_ * 3 / 2 ) {
+      throw runtime_error( "USERPTR capture: driver wants padded rows" );
+    }
+
+    if ( not( cap.capabilities & V4L2_CAP_STREAMING ) ) {
+      throw runtime_error( "this device does not support streaming I/O" );
+    }
+  } else if ( memory_ != V4L2_MEMORY_MMAP ) {
+    throw runtime_error( "unsupported V4L2 memory type" );
+  }
+
   /* setting capture parameters */
   v4l2_streamparm params {};
   params.type = capture_type;
@@ -99,11 +126,13 @@ Camera::Camera( const uint16_t width,
 void Camera::init()
 {
   kernel_v4l2_buffers_.clear();
+  userptr_frames_.clear();
+  acquired_buffer_.reset();
 
   /* tell the v4l2 about our buffers */
   v4l2_requestbuffers buf_request {};
   buf_request.type = capture_type;
-  buf_request.memory = V4L2_MEMORY_MMAP;
+  buf_request.memory = memory_;
   buf_request.count = NUM_BUFFERS;
 
   CheckSystemCall( "buffer request", ioctl( camera_fd_.fd_num(), VIDIOC_REQBUFS, &buf_request ) );
@@ -112,6 +141,28 @@ void Camera::init()
     throw runtime_error( "couldn't get enough video4linux2 buffers" );
   }
 
+  if ( memory_ == V4L2_MEMORY_USERPTR ) {
+    userptr_frames_.reserve( NUM_BUFFERS );
+
+    for ( unsigned int i = 0; i < NUM_BUFFERS; i++ ) {
+      string_span frame = userptr_frames_.emplace_back( width_, height_ ).frame();
+
+      v4l2_buffer buffer_info {};
+      buffer_info.type = capture_type;
+      buffer_info.memory = V4L2_MEMORY_USERPTR;
+      buffer_info.index = i;
+      buffer_info.m.userptr = reinterpret_cast<unsigned long>( frame.mutable_data() );
+      buffer_info.length = frame.size();
+
+      CheckSystemCall( "enqueue buffer", ioctl( camera_fd_.fd_num(), VIDIOC_QBUF, &buffer_info ) );
+    }
+
+    CheckSystemCall( "stream on", ioctl( camera_fd_.fd_num(), VIDIOC_STREAMON, &capture_type ) );
+
+    frame_count_ = 0;
+    return;
+  }
+
   /* allocate buffers */
   for ( unsigned int i = 0; i < NUM_BUFFERS; i++ ) {
     v4l2_buffer buffer_info;
@@ -195,6 +246,17 @@ void Camera::get_next_frame( RasterYUV420& raster )
     throw runtime_error( "Camera::get_next_frame: mismatched raster size" );
   }
 
+  if ( memory_ == V4L2_MEMORY_USERPTR ) {
+    const RasterYUV420* frame = acquire_frame();
+    if ( frame ) {
+      raster.Y().copy( frame->Y() );
+      raster.Cb().copy( frame->Cb() );
+      raster.Cr().copy( frame->Cr() );
+    }
+    release_frame();
+    return;
+  }
+
   v4l2_buffer buffer_info;
   buffer_info.type = capture_type;
   buffer_info.memory = V4L2_MEMORY_MMAP;
@@ -204,59 +266,42 @@ void Camera::get_next_frame( RasterYUV420& raster )
   CheckSystemCall( "dequeue buffer", ioctl( camera_fd_.fd_num(), VIDIOC_DQBUF, &buffer_info ) );
   camera_fd_.buffer_dequeued();
 
-  i_++;
-  if ( i_ == 60 ) {
-    cerr << "triggered" << endl;
-    CheckSystemCall( "stop clock", system( "kill -TSTP 185850" ) );
-  }
-
   if ( buffer_info.bytesused > 0 and not( buffer_info.flags & V4L2_BUF_FLAG_ERROR ) ) {
     const MMap_Region& mmap_region = kernel_v4l2_buffers_.at( next_buffer_index );
+    const uint8_t* src = reinterpret_cast<const uint8_t*>( static_cast<string_view>( mmap_region ).data() );
 
     switch ( pixel_format_ ) {
       case V4L2_PIX_FMT_YUYV: {
-        char* src = mmap_region.addr();
-        uint8_t* dst_y_start = raster.Y_row( 0 );
-        uint8_t* dst_cb_start = raster.Cb_row( 0 );
-        uint8_t* dst_cr_start = raster.Cr_row( 0 );
-
-        const size_t y_plane_length = width_ * height_;
-
-        for ( size_t i = 0; i < y_plane_length; i++ ) {
-          dst_y_start[i] = src[i << 1];
-        }
-
-        size_t i = 0;
+        for ( uint16_t row = 0; row < height_; row++ ) {
+          const uint8_t* src_row = src + size_t( row ) * bytes_per_line_;
+          yuyv_luma( src_row, raster.Y_row( row ), width_ );
 
-        for ( size_t row = 0; row < height_; row++ ) {
-          if ( row % 2 == 1 ) {
-            continue;
-          }
-
-          for ( size_t column = 0; column < width_ / 2; column++ ) {
-            dst_cb_start[i] = src[row * width_ * 2 + column * 4 + 1];
-            dst_cr_start[i] = src[row * width_ * 2 + column * 4 + 3];
-            i++;
+          /* 4:2:2 => 4:2:0 by taking chroma from the even rows */
+          if ( row % 2 == 0 ) {
+            yuyv_chroma( src_row, raster.Cb_row( row / 2 ), raster.Cr_row( row / 2 ), width_ / 2 );
           }
         }
-
       } break;
 
       case V4L2_PIX_FMT_NV12: {
-        memcpy( raster.Y_row( 0 ), mmap_region.addr(), width_ * height_ );
-
-        uint8_t* src_chroma_start = reinterpret_cast<uint8_t*>(mmap_region.addr()) + width_ * height_;
-        uint8_t* dst_cb_start = raster.Cb_row( 0 );
-        uint8_t* dst_cr_start = raster.Cr_row( 0 );
-
-        size_t chroma_length = width_ * height_ / 4;
+        for ( uint16_t row = 0; row < height_; row++ ) {
+          memcpy( raster.Y_row( row ), src + size_t( row ) * bytes_per_line_, width_ );
+        }
 
-        for ( size_t i = 0; i < chroma_length; i++ ) {
-          dst_cb_start[i] = src_chroma_start[2 * i];
-          dst_cr_start[i] = src_chroma_start[2 * i + 1];
+        const uint8_t* src_chroma = src + size_t( height_ ) * bytes_per_line_;
+        for ( uint16_t row = 0; row < height_ / 2; row++ ) {
+          deinterleave_pairs(
+            src_chroma + size_t( row ) * bytes_per_line_, raster.Cb_row( row ), raster.Cr_row( row ), width_ / 2 );
         }
       } break;
 
+      case V4L2_PIX_FMT_YUV420:
+        if ( bytes_per_line_ != raster.Y_stride() or not raster.is_packed() ) {
+          throw runtime_error( "Camera::get_next_frame: YUV420 row padding doesn't match raster" );
+        }
+        raster.frame().copy( mmap_region );
+        break;
+
       case V4L2_PIX_FMT_MJPEG:
         throw runtime_error( "invalid" );
         break;
@@ -269,3 +314,77 @@ void Camera::get_next_frame( RasterYUV420& raster )
 
   next_buffer_index = ( next_buffer_index + 1 ) % NUM_BUFFERS;
 }
+
+RasterYUV420* Camera::acquire_frame()
+{
+  if ( memory_ != V4L2_MEMORY_USERPTR ) {
+    throw runtime_error( "Camera::acquire_frame: camera is not in USERPTR mode" );
+  }
+
+  if ( acquired_buffer_.has_value() ) {
+    throw runtime_error( "Camera::acquire_frame: previous frame was not released" );
+  }
+
+  v4l2_buffer buffer_info {};
+  buffer_info.type = capture_type;
+  buffer_info.memory = V4L2_MEMORY_USERPTR;
+
+  CheckSystemCall( "dequeue buffer", ioctl( camera_fd_.fd_num(), VIDIOC_DQBUF, &buffer_info ) );
+  camera_fd_.buffer_dequeued();
+
+  acquired_buffer_ = buffer_info;
+
+  RasterYUV420& frame = userptr_frames_.at( buffer_info.index );
+  if ( buffer_info.bytesused < frame.frame().size() or ( buffer_info.flags & V4L2_BUF_FLAG_ERROR ) ) {
+    release_frame();
+    return nullptr;
+  }
+
+  frame_count_++;
+  return &frame;
+}
+
+void Camera::release_frame()
+{
+  if ( not acquired_buffer_.has_value() ) {
+    return;
+  }
+
+  CheckSystemCall( "enqueue buffer", ioctl( camera_fd_.fd_num(), VIDIOC_QBUF, &acquired_buffer_.value() ) );
+  acquired_buffer_.reset();
+}
+
+void Camera::get_next_frame( MJPEGDecodePool& pool )
+{
+  if ( pixel_format_ != V4L2_PIX_FMT_MJPEG ) {
+    throw runtime_error( "Camera::get_next_frame: decode pool requires MJPEG" );
+  }
+
+  v4l2_buffer buffer_info;
+  buffer_info.type = capture_type;
+  buffer_info.memory = V4L2_MEMORY_MMAP;
+  buffer_info.index = next_buffer_index;
+  buffer_info.bytesused = 0;
+
+  CheckSystemCall( "dequeue buffer", ioctl( camera_fd_.fd_num(), VIDIOC_DQBUF, &buffer_info ) );
+  camera_fd_.buffer_dequeued();
+
+  if ( buffer_info.bytesused > 0 and not( buffer_info.flags & V4L2_BUF_FLAG_ERROR ) ) {
+    /* monotonic driver timestamps share a clock with Timer::timestamp_ns() */
+    const uint64_t capture_timestamp
+      = ( buffer_info.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK ) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC
+          ? buffer_info.timestamp.tv_sec * 1'000'000'000ULL + buffer_info.timestamp.tv_usec * 1000ULL
+          : Timer::timestamp_ns();
+
+    if ( frame_count_ > 5 ) {
+      const MMap_Region& mmap_region = kernel_v4l2_buffers_.at( next_buffer_index );
+      pool.push( static_cast<string_view>( mmap_region ).substr( 0, buffer_info.bytesused ), capture_timestamp );
+    }
+
+    frame_count_++;
+  }
+
+  CheckSystemCall( "enqueue buffer", ioctl( camera_fd_.fd_num(), VIDIOC_QBUF, &buffer_info ) );
+
+  next_buffer_index = ( next_buffer_index + 1 ) % NUM_BUFFERS;
+}
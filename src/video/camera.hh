@@ -28,6 +28,7 @@
 
 #include "file_descriptor.hh"
 #include "jpeg.hh"
+#include "jpeg_pool.hh"
 #include "mmap.hh"
 #include "raster.hh"
 
@@ -48,16 +49,21 @@ class Camera
 private:
   static constexpr unsigned int NUM_BUFFERS = 4;
   static constexpr unsigned int FRAME_RATE = 60;
-  int i_ = 0;
 
   uint16_t width_;
   uint16_t height_;
   uint32_t pixel_format_;
+  uint32_t memory_;
   std::string device_name_;
+  uint32_t bytes_per_line_ {};
 
   CameraFD camera_fd_;
   std::vector<MMap_Region> kernel_v4l2_buffers_;
   unsigned int next_buffer_index = 0;
+
+  /* V4L2_MEMORY_USERPTR: the driver captures straight into these */
+  std::vector<RasterYUV420> userptr_frames_ {};
+  std::optional<v4l2_buffer> acquired_buffer_ {};
   JPEGDecompresser jpegdec_ {};
 
   void init();
@@ -68,12 +74,21 @@ public:
   Camera( const uint16_t width,
           const uint16_t height,
           const std::string& device_name,
-          const uint32_t pixel_format = V4L2_PIX_FMT_MJPEG );
+          const uint32_t pixel_format = V4L2_PIX_FMT_MJPEG,
+          const uint32_t memory = V4L2_MEMORY_MMAP );
 
   ~Camera();
 
   void get_next_frame( RasterYUV422& raster );
   void get_next_frame( RasterYUV420& raster );
 
+  /* pipelined MJPEG capture: hands the compressed frame to the pool and requeues the buffer immediately */
+  void get_next_frame( MJPEGDecodePool& pool );
+
+  /* zero-copy capture (V4L2_MEMORY_USERPTR + V4L2_PIX_FMT_YUV420): borrow the frame the driver
+     filled, and hand it back with release_frame(). Returns nullptr if the driver flagged an error. */
+  RasterYUV420* acquire_frame();
+  void release_frame();
+
   FileDescriptor& fd() { return camera_fd_; }
 };
@@ -0,0 +1,399 @@
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "cmaf_writer.hh"
+#include "mp4writer.hh"
+
+using namespace std;
+
+namespace {
+
+/* appends ISO BMFF boxes to a string; each box's size is filled in when it is closed */
+class BoxWriter
+{
+  string& out_;
+  vector<size_t> open_boxes_ {};
+
+public:
+  explicit BoxWriter( string& out )
+    : out_( out )
+  {}
+
+  template<typename T>
+  void integer( const T val )
+  {
+    for ( size_t i = 0; i < sizeof( T ); i++ ) {
+      out_.push_back( char( ( val >> ( ( sizeof( T ) - i - 1 ) * 8 ) ) & 0xff ) );
+    }
+  }
+
+  void bytes( const string_view str ) { out_.append( str ); }
+  void zeros( const size_t count ) { out_.append( count, 0 ); }
+
+  void begin( const string_view type )
+  {
+    open_boxes_.push_back( out_.size() );
+    integer<uint32_t>( 0 );
+    bytes( type );
+  }
+
+  void begin_full( const string_view type, const uint8_t version, const uint32_t flags )
+  {
+    begin( type );
+    integer<uint32_t>( ( uint32_t( version ) << 24 ) | flags );
+  }
+
+  void end()
+  {
+    const size_t start = open_boxes_.back();
+    open_boxes_.pop_back();
+
+    const uint32_t size = out_.size() - start;
+    for ( size_t i = 0; i < 4; i++ ) {
+      out_[start + i] = char( ( size >> ( ( 3 - i ) * 8 ) ) & 0xff );
+    }
+  }
+
+  size_t position() const { return out_.size(); }
+
+  void matrix()
+  {
+    for ( const uint32_t x : { 0x00010000u, 0u, 0u, 0u, 0x00010000u, 0u, 0u, 0u, 0x40000000u } ) {
+      integer( x );
+    }
+  }
+};
+
+void write_u32( char* out, const uint32_t val )
+{
+  out[0] = char( val >> 24 );
+  out[1] = char( val >> 16 );
+  out[2] = char( val >> 8 );
+  out[3] = char( val );
+}
+
+void write_u64( char* out, const uint64_t val )
+{
+  write_u32( out, val >> 32 );
+  write_u32( out + 4, val & 0xffffffff );
+}
+
+/* calls f( nal ) for each NAL unit in an Annex B byte stream, without its start code or trailing zeros */
+template<typename F>
+void for_each_nal( const string_view stream, F&& f )
+{
+  size_t nal_start = string_view::npos;
+  size_t pos = 0;
+
+  while ( pos + 3 <= stream.size() ) {
+    const void* one = memchr( stream.data() + pos + 2, 1, stream.size() - pos - 2 );
+    if ( not one ) {
+      break;
+    }
+
+    const size_t i = static_cast<const char*>( one ) - stream.data();
+    if ( stream[i - 1] == 0 and stream[i - 2] == 0 ) {
+      if ( nal_start != string_view::npos ) {
+        size_t nal_end = i - 2;
+        while ( nal_end > nal_start and stream[nal_end - 1] == 0 ) {
+          nal_end--;
+        }
+        f( stream.substr( nal_start, nal_end - nal_start ) );
+      }
+      nal_start = i + 1;
+    }
+
+    pos = i - 1;
+  }
+
+  if ( nal_start != string_view::npos and nal_start < stream.size() ) {
+    f( stream.substr( nal_start ) );
+  }
+}
+
+/* sample flags (ISO/IEC 14496-12 8.8.3.1): sync samples depend on nothing, others are non-sync */
+constexpr uint32_t SYNC_SAMPLE_FLAGS = 0x02000000;
+constexpr uint32_t NON_SYNC_SAMPLE_FLAGS = 0x01010000;
+
+}
+
+CMAFWriter::CMAFWriter( const unsigned int frame_rate, const unsigned int width, const unsigned int height )
+  : frame_rate_( frame_rate )
+  , width_( width )
+  , height_( height )
+{
+  if ( frame_rate_ == 0 ) {
+    throw runtime_error( "CMAFWriter: frame rate must be nonzero" );
+  }
+
+  idr_template_ = build_template( true );
+  frame_template_ = build_template( false );
+}
+
+CMAFWriter::Template CMAFWriter::build_template( const bool idr ) const
+{
+  Template ret;
+  BoxWriter box { ret.moof };
+
+  box.begin( "moof" );
+
+  box.begin_full( "mfhd", 0, 0 );
+  ret.sequence_number_offset = box.position();
+  box.integer<uint32_t>( 0 );
+  box.end();
+
+  box.begin( "traf" );
+
+  /* default-base-is-moof; duration and (non-sync) flags come from trex */
+  box.begin_full( "tfhd", 0, 0x020000 );
+  box.integer<uint32_t>( 1 ); /* track ID */
+  box.end();
+
+  box.begin_full( "tfdt", 1, 0 );
+  ret.decode_time_offset = box.position();
+  box.integer<uint64_t>( 0 );
+  box.end();
+
+  /* data-offset and sample-size present; IDR frames also override the sample flags */
+  box.begin_full( "trun", 0, idr ? 0x000205 : 0x000201 );
+  box.integer<uint32_t>( 1 ); /* sample count */
+  const size_t data_offset_offset = box.position();
+  box.integer<uint32_t>( 0 );
+  if ( idr ) {
+    box.integer<uint32_t>( SYNC_SAMPLE_FLAGS );
+  }
+  ret.sample_size_offset = box.position();
+  box.integer<uint32_t>( 0 );
+  box.end();
+
+  box.end(); /* traf */
+  box.end(); /* moof */
+
+  /* the sample starts right after the mdat header, which follows the moof */
+  write_u32( ret.moof.data() + data_offset_offset, ret.moof.size() + 8 );
+
+  return ret;
+}
+
+void CMAFWriter::update_parameter_sets( const string_view access_unit )
+{
+  string_view sps, pps;
+  for_each_nal( access_unit, [&]( const string_view nal ) {
+    if ( nal.empty() ) {
+      return;
+    }
+    const uint8_t type = nal.front() & 0x1f;
+    if ( type == 7 and sps.empty() ) {
+      sps = nal;
+    } else if ( type == 8 and pps.empty() ) {
+      pps = nal;
+    }
+  } );
+
+  if ( sps.size() < 4 or pps.empty() ) {
+    throw runtime_error( "CMAFWriter: IDR access unit without SPS and PPS" );
+  }
+
+  if ( sps == sps_ and pps == pps_ ) {
+    return;
+  }
+
+  sps_ = sps;
+  pps_ = pps;
+  build_init_segment();
+}
+
+void CMAFWriter::build_init_segment()
+{
+  const uint32_t timebase = MP4Writer::MP4_TIMEBASE;
+
+  init_segment_.clear();
+  BoxWriter box { init_segment_ };
+
+  box.begin( "ftyp" );
+  box.bytes( "iso6" );
+  box.integer<uint32_t>( 0 );
+  box.bytes( "iso6cmfcavc1mp41" );
+  box.end();
+
+  box.begin( "moov" );
+
+  box.begin_full( "mvhd", 0, 0 );
+  box.zeros( 8 ); /* creation and modification times */
+  box.integer<uint32_t>( timebase );
+  box.integer<uint32_t>( 0 ); /* duration */
+  box.integer<uint32_t>( 0x00010000 );
+  box.integer<uint16_t>( 0x0100 );
+  box.zeros( 10 );
+  box.matrix();
+  box.zeros( 24 );
+  box.integer<uint32_t>( 2 ); /* next track ID */
+  box.end();
+
+  box.begin( "trak" );
+
+  box.begin_full( "tkhd", 0, 0x000003 ); /* enabled, in movie */
+  box.zeros( 8 );
+  box.integer<uint32_t>( 1 ); /* track ID */
+  box.zeros( 4 );
+  box.integer<uint32_t>( 0 ); /* duration */
+  box.zeros( 8 + 2 + 2 + 2 + 2 ); /* reserved, layer, alternate group, volume, reserved */
+  box.matrix();
+  box.integer<uint32_t>( width_ << 16 );
+  box.integer<uint32_t>( height_ << 16 );
+  box.end();
+
+  box.begin( "mdia" );
+
+  box.begin_full( "mdhd", 0, 0 );
+  box.zeros( 8 );
+  box.integer<uint32_t>( timebase );
+  box.integer<uint32_t>( 0 );
+  box.integer<uint16_t>( 0x55c4 ); /* "und" */
+  box.integer<uint16_t>( 0 );
+  box.end();
+
+  box.begin_full( "hdlr", 0, 0 );
+  box.integer<uint32_t>( 0 );
+  box.bytes( "vide" );
+  box.zeros( 12 );
+  box.bytes( { "VideoHandler", 13 } );
+  box.end();
+
+  box.begin( "minf" );
+
+  box.begin_full( "vmhd", 0, 1 );
+  box.zeros( 8 );
+  box.end();
+
+  box.begin( "dinf" );
+  box.begin_full( "dref", 0, 0 );
+  box.integer<uint32_t>( 1 );
+  box.begin_full( "url ", 0, 1 ); /* media is in this file */
+  box.end();
+  box.end();
+  box.end();
+
+  box.begin( "stbl" );
+
+  box.begin_full( "stsd", 0, 0 );
+  box.integer<uint32_t>( 1 );
+
+  box.begin( "avc1" );
+  box.zeros( 6 );
+  box.integer<uint16_t>( 1 ); /* data reference index */
+  box.zeros( 16 );
+  box.integer<uint16_t>( width_ );
+  box.integer<uint16_t>( height_ );
+  box.integer<uint32_t>( 0x00480000 ); /* 72 dpi */
+  box.integer<uint32_t>( 0x00480000 );
+  box.zeros( 4 );
+  box.integer<uint16_t>( 1 ); /* frame count */
+  box.zeros( 32 );            /* compressor name */
+  box.integer<uint16_t>( 0x0018 );
+  box.integer<uint16_t>( 0xffff );
+
+  box.begin( "avcC" );
+  box.integer<uint8_t>( 1 );
+  box.bytes( sps_.substr( 1, 3 ) ); /* profile, compatibility, level */
+  box.integer<uint8_t>( 0xff );     /* 4-byte NAL lengths */
+  box.integer<uint8_t>( 0xe1 );     /* one SPS */
+  box.integer<uint16_t>( sps_.size() );
+  box.bytes( sps_ );
+  box.integer<uint8_t>( 1 ); /* one PPS */
+  box.integer<uint16_t>( pps_.size() );
+  box.bytes( pps_ );
+  box.end();
+
+  box.end(); /* avc1 */
+  box.end(); /* stsd */
+
+  /* no samples in the moov; they are all in fragments */
+  for ( const auto type : { "stts", "stsc", "stco" } ) {
+    box.begin_full( type, 0, 0 );
+    box.integer<uint32_t>( 0 );
+    box.end();
+  }
+
+  box.begin_full( "stsz", 0, 0 );
+  box.integer<uint32_t>( 0 );
+  box.integer<uint32_t>( 0 );
+  box.end();
+
+  box.end(); /* stbl */
+  box.end(); /* minf */
+  box.end(); /* mdia */
+  box.end(); /* trak */
+
+  box.begin( "mvex" );
+  box.begin_full( "trex", 0, 0 );
+  box.integer<uint32_t>( 1 ); /* track ID */
+  box.integer<uint32_t>( 1 ); /* sample description index */
+  box.integer<uint32_t>( timebase / frame_rate_ );
+  box.integer<uint32_t>( 0 );
+  box.integer<uint32_t>( NON_SYNC_SAMPLE_FLAGS );
+  box.end();
+  box.end();
+
+  box.end(); /* moov */
+
+  init_generation_++;
+}
+
+uint64_t CMAFWriter::decode_time( const uint32_t frame_no ) const
+{
+  return uint64_t( frame_no ) * uint64_t( MP4Writer::MP4_TIMEBASE ) / uint64_t( frame_rate_ );
+}
+
+void CMAFWriter::write( const string_view access_unit, const uint32_t frame_no )
+{
+  const bool idr = MP4Writer::is_idr( access_unit );
+
+  if ( idr ) {
+    update_parameter_sets( access_unit );
+    idr_hit_ = true;
+  }
+
+  if ( not idr_hit_ ) {
+    return;
+  }
+
+  const Template& moof = idr ? idr_template_ : frame_template_;
+  string_span out = buf_.writable_region();
+  const size_t header_length = moof.moof.size() + 8;
+
+  /* convert to length-prefixed NAL units straight into the output, after room for the headers */
+  size_t sample_size = 0;
+  bool fits = out.size() >= header_length;
+  if ( fits ) {
+    for_each_nal( access_unit, [&]( const string_view nal ) {
+      if ( not fits or header_length + sample_size + 4 + nal.size() > out.size() ) {
+        fits = false;
+        return;
+      }
+      char* dest = out.mutable_data() + header_length + sample_size;
+      write_u32( dest, nal.size() );
+      memcpy( dest + 4, nal.data(), nal.size() );
+      sample_size += 4 + nal.size();
+    } );
+  }
+
+  if ( not fits ) {
+    cerr << "Pausing CMAF output\n";
+    idr_hit_ = false;
+    return;
+  }
+
+  char* dest = out.mutable_data();
+  memcpy( dest, moof.moof.data(), moof.moof.size() );
+  write_u32( dest + moof.sequence_number_offset, ++sequence_number_ );
+  write_u64( dest + moof.decode_time_offset, decode_time( frame_no ) );
+  write_u32( dest + moof.sample_size_offset, sample_size );
+
+  write_u32( dest + moof.moof.size(), 8 + sample_size );
+  memcpy( dest + moof.moof.size() + 4, "mdat", 4 );
+
+  buf_.push( header_length + sample_size );
+}
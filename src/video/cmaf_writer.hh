@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "ring_buffer.hh"
+
+/* fragmented MP4 (CMAF) writer for H.264 that needs no libavformat: one small chunk (moof + mdat) per access
+   unit, stamped out from a precomputed moof, and an init segment (ftyp + moov) that is rebuilt only when the
+   SPS/PPS change, so late joiners can be handed it on demand */
+class CMAFWriter
+{
+  unsigned int frame_rate_, width_, height_;
+
+  /* from the latest IDR access unit (without start codes) */
+  std::string sps_ {}, pps_ {};
+
+  std::string init_segment_ {};
+  unsigned int init_generation_ {};
+
+  /* moof templates for IDR and non-IDR frames; each frame patches in its sequence number, decode time and size */
+  struct Template
+  {
+    std::string moof {};
+    size_t sequence_number_offset {}, decode_time_offset {}, sample_size_offset {};
+  } idr_template_ {}, frame_template_ {};
+
+  uint32_t sequence_number_ {};
+  bool idr_hit_ {};
+
+  static constexpr unsigned int BUF_SIZE = 1048576;
+  RingBuffer buf_ { BUF_SIZE };
+
+  void update_parameter_sets( const std::string_view access_unit );
+  void build_init_segment();
+  Template build_template( const bool idr ) const;
+
+public:
+  CMAFWriter( const unsigned int frame_rate, const unsigned int width, const unsigned int height );
+
+  /* appends one chunk for this access unit (Annex B) to output(); frames before the first IDR are dropped */
+  void write( const std::string_view access_unit, const uint32_t frame_no );
+
+  RingBuffer& output() { return buf_; }
+
+  /* ftyp + moov for the latest parameter sets; the generation changes whenever it is rebuilt */
+  const std::string& init_segment() const { return init_segment_; }
+  unsigned int init_generation() const { return init_generation_; }
+
+  /* bytes of box headers in each chunk (the rest is the access unit with length prefixes) */
+  size_t chunk_overhead( const bool idr ) const { return ( idr ? idr_template_ : frame_template_ ).moof.size() + 8; }
+
+  uint64_t decode_time( const uint32_t frame_no ) const;
+
+  CMAFWriter( const CMAFWriter& other ) = delete;
+  CMAFWriter& operator=( const CMAFWriter& other ) = delete;
+};
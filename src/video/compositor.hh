@@ -1,6 +1,7 @@
 #pragma once
 
 #include "raster.hh"
+#include "raster_pool.hh"
 #include "scale.hh"
 #include "videofile.hh"
 #include "vsclient.hh"
@@ -23,7 +24,7 @@ struct Layer
   uint16_t width {};
   uint16_t z {};
   std::shared_ptr<VideoFile> video {};
-  std::shared_ptr<RasterRGBA> decoded_video_frame_ = std::make_shared<RasterRGBA>( 1280, 720 );
+  std::shared_ptr<RasterRGBA> decoded_video_frame_ = global_raster_pool<RasterRGBA>( 1280, 720 ).get();
   std::shared_ptr<RasterRGBA> image {};
   ColorspaceConverter converter { 1280, 720 };
 
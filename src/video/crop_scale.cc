@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstring>
+
+#if defined( __SSE2__ )
+#include <immintrin.h>
+#elif defined( __ARM_NEON )
+#include <arm_neon.h>
+#endif
+
+#include "crop_scale.hh"
+
+using namespace std;
+
+/* fill colour for cropped-out regions (matches Cropper) */
+static constexpr uint8_t Y_fill = 111, Cb_fill = 101, Cr_fill = 48;
+
+/* out[i] = ( a[i] + b[i] + 1 ) / 2, i.e. the vertical 2:1 chroma decimation */
+static void average_rows( const uint8_t* a, const uint8_t* b, uint8_t* out, const size_t len )
+{
+  size_t i = 0;
+
+#if defined( __AVX2__ )
+  for ( ; i + 32 <= len; i += 32 ) {
+    const __m256i x = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( a + i ) );
+    const __m256i y = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( b + i ) );
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( out + i ), _mm256_avg_epu8( x, y ) );
+  }
+#endif
+
+#if defined( __SSE2__ )
+  for ( ; i + 16 <= len; i += 16 ) {
+    const __m128i x = _mm_loadu_si128( reinterpret_cast<const __m128i*>( a + i ) );
+    const __m128i y = _mm_loadu_si128( reinterpret_cast<const __m128i*>( b + i ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( out + i ), _mm_avg_epu8( x, y ) );
+  }
+#elif defined( __ARM_NEON )
+  for ( ; i + 16 <= len; i += 16 ) {
+    vst1q_u8( out + i, vrhaddq_u8( vld1q_u8( a + i ), vld1q_u8( b + i ) ) );
+  }
+#endif
+
+  for ( ; i < len; i++ ) {
+    out[i] = ( a[i] + b[i] + 1 ) >> 1;
+  }
+}
+
+void CropScaler::setup_crop( const uint16_t left, const uint16_t right, const uint16_t top, const uint16_t bottom )
+{
+  left_ = left;
+  right_ = right;
+  top_ = top;
+  bottom_ = bottom;
+}
+
+void CropScaler::setup_zoom( const uint16_t x, const uint16_t y, const uint16_t width, const uint16_t height )
+{
+  scaler_.setup( x, y, width, height );
+}
+
+CropScaler::Rectangle CropScaler::visible_region() const
+{
+  auto map = []( const int source_coord, const int window_start, const int window_size, const int output_size ) {
+    return uint16_t( clamp( ( source_coord - window_start ) * output_size / window_size, 0, output_size ) );
+  };
+
+  const int W = input_width_, H = input_height_;
+  const int sx = scaler_.source_x(), sy = scaler_.source_y();
+  const int sw = scaler_.source_width(), sh = scaler_.source_height();
+
+  Rectangle ret;
+  ret.left = map( left_, sx, sw, Scaler::width() );
+  ret.right = map( W - min( int( right_ ), W ), sx, sw, Scaler::width() );
+  ret.top = map( top_, sy, sh, Scaler::height() );
+  ret.bottom = map( H - min( int( bottom_ ), H ), sy, sh, Scaler::height() );
+
+  if ( ret.right <= ret.left or ret.bottom <= ret.top ) {
+    ret = { 0, 0, 0, 0 };
+  }
+
+  return ret;
+}
+
+CropScaler::Rectangle CropScaler::chroma_region( const Rectangle& luma )
+{
+  return { uint16_t( luma.left / 2 ),
+           uint16_t( ( luma.right + 1 ) / 2 ),
+           uint16_t( luma.top / 2 ),
+           uint16_t( ( luma.bottom + 1 ) / 2 ) };
+}
+
+void CropScaler::copy_unscaled( const RasterYUV422& source, RasterYUV420& dest, const Rectangle& region ) const
+{
+  const uint16_t sx = scaler_.source_x(), sy = scaler_.source_y();
+
+  /* luma: straight copy of the visible window */
+  for ( uint16_t row = region.top; row < region.bottom; row++ ) {
+    memcpy( dest.Y_row( row ) + region.left, source.Y_row( sy + row ) + sx + region.left, region.right - region.left );
+  }
+
+  /* chroma: horizontal resolution already matches, so just average pairs of rows */
+  const Rectangle chroma = chroma_region( region );
+  const uint16_t chroma_sx = sx / 2;
+  const size_t length = chroma.right - chroma.left;
+
+  for ( uint16_t row = chroma.top; row < chroma.bottom; row++ ) {
+    /* don't pull in cropped-out rows at an odd edge */
+    const uint16_t row_a = sy + max( uint16_t( 2 * row ), region.top );
+    const uint16_t row_b = sy + min( uint16_t( 2 * row + 1 ), uint16_t( region.bottom - 1 ) );
+
+    average_rows( source.Cb_row( row_a ) + chroma_sx + chroma.left,
+                  source.Cb_row( row_b ) + chroma_sx + chroma.left,
+                  dest.Cb_row( row ) + chroma.left,
+                  length );
+    average_rows( source.Cr_row( row_a ) + chroma_sx + chroma.left,
+                  source.Cr_row( row_b ) + chroma_sx + chroma.left,
+                  dest.Cr_row( row ) + chroma.left,
+                  length );
+  }
+}
+
+void CropScaler::fill_borders( RasterYUV420& dest, const Rectangle& region ) const
+{
+  for ( uint16_t row = 0; row < dest.height(); row++ ) {
+    if ( row < region.top or row >= region.bottom ) {
+      memset( dest.Y_row( row ), Y_fill, dest.width() );
+    } else {
+      memset( dest.Y_row( row ), Y_fill, region.left );
+      memset( dest.Y_row( row ) + region.right, Y_fill, dest.width() - region.right );
+    }
+  }
+
+  const Rectangle chroma = chroma_region( region );
+  for ( uint16_t row = 0; row < dest.chroma_height(); row++ ) {
+    if ( row < chroma.top or row >= chroma.bottom ) {
+      memset( dest.Cb_row( row ), Cb_fill, dest.chroma_width() );
+      memset( dest.Cr_row( row ), Cr_fill, dest.chroma_width() );
+    } else {
+      memset( dest.Cb_row( row ), Cb_fill, chroma.left );
+      memset( dest.Cr_row( row ), Cr_fill, chroma.left );
+      memset( dest.Cb_row( row ) + chroma.right, Cb_fill, dest.chroma_width() - chroma.right );
+      memset( dest.Cr_row( row ) + chroma.right, Cr_fill, dest.chroma_width() - chroma.right );
+    }
+  }
+}
+
+void CropScaler::process( const RasterYUV422& source, RasterYUV420& dest )
+{
+  if ( source.width() != input_width_ or source.height() != input_height_ ) {
+    throw runtime_error( "CropScaler: source size mismatch" );
+  }
+
+  if ( dest.width() != Scaler::width() or dest.height() != Scaler::height() ) {
+    throw runtime_error( "CropScaler: dest size mismatch" );
+  }
+
+  const Rectangle region = visible_region();
+
+  if ( scaler_.is_unscaled() ) {
+    copy_unscaled( source, dest, region );
+  } else {
+    /* zoomed: resample the window, then paint the crop over the (scaled) margins */
+    scaler_.scale( source, dest );
+  }
+
+  fill_borders( dest, region );
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#include "raster.hh"
+#include "scale.hh"
+
+/* crop + zoom + 4:2:2 => 4:2:0 in one pass over the output, without modifying the source */
+class CropScaler
+{
+  uint16_t input_width_, input_height_;
+  Scaler scaler_;
+
+  /* crop margins, in source coordinates (same meaning as Cropper) */
+  uint16_t left_ {}, right_ {}, top_ {}, bottom_ {};
+
+  struct Rectangle
+  {
+    uint16_t left, right, top, bottom;
+  };
+
+  /* region of the output that shows uncropped source pixels */
+  Rectangle visible_region() const;
+  static Rectangle chroma_region( const Rectangle& luma );
+
+  void copy_unscaled( const RasterYUV422& source, RasterYUV420& dest, const Rectangle& region ) const;
+  void fill_borders( RasterYUV420& dest, const Rectangle& region ) const;
+
+public:
+  CropScaler( const uint16_t input_width = 1280, const uint16_t input_height = 720 )
+    : input_width_( input_width )
+    , input_height_( input_height )
+    , scaler_( input_width, input_height )
+  {}
+
+  void setup_crop( const uint16_t left, const uint16_t right, const uint16_t top, const uint16_t bottom );
+  void setup_zoom( const uint16_t x, const uint16_t y, const uint16_t width, const uint16_t height );
+
+  void process( const RasterYUV422& source, RasterYUV420& dest );
+};
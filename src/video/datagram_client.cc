@@ -0,0 +1,241 @@
+#include <cstring>
+#include <iostream>
+
+#include "datagram_client.hh"
+#include "mp4writer.hh"
+#include "timer.hh"
+
+using namespace std;
+using namespace std::chrono;
+
+DatagramViewerClient::DatagramViewerClient( const Address& server,
+                                            const LongLivedKey& key,
+                                            EventLoop& loop,
+                                            NALCallback&& on_NAL,
+                                            const uint64_t max_delay_ns,
+                                            const float simulated_loss )
+  : server_( server )
+  , name_( key.name() )
+  , long_lived_crypto_( key.key_pair().uplink, key.key_pair().downlink, true )
+  , next_key_request_( steady_clock::now() )
+  , max_delay_ns_( max_delay_ns )
+  , on_NAL_( move( on_NAL ) )
+  , simulated_loss_( simulated_loss )
+{
+  socket_.set_blocking( false );
+
+  loop.add_rule( "datagram receive", socket_, Direction::In, [&] {
+    Address src { nullptr, 0 };
+    Ciphertext ciphertext;
+    ciphertext.resize( socket_.recv( src, ciphertext.mutable_buffer() ) );
+
+    if ( simulated_loss_ > 0 and uniform_real_distribution<float> { 0, 1 }( prng_ ) < simulated_loss_ ) {
+      stats_.simulated_losses++;
+      return;
+    }
+
+    if ( ciphertext.length() > 24 ) {
+      const uint8_t node_id = ciphertext.as_string_view().back();
+      switch ( node_id ) {
+        case uint8_t( KeyMessage::keyreq_server_id ):
+          if ( not session_.has_value() ) {
+            process_keyreply( ciphertext );
+          }
+          break;
+        case 0:
+          if ( session_.has_value() and session_->receive_packet( ciphertext ) ) {
+            deliver();
+          }
+          break;
+        default:
+          stats_.bad_packets++;
+          break;
+      }
+    } else {
+      stats_.bad_packets++;
+    }
+  } );
+
+  loop.add_rule(
+    "key request",
+    [&] {
+      next_key_request_ = steady_clock::now() + milliseconds( 250 );
+      Plaintext empty;
+      empty.resize( 0 );
+      Ciphertext keyreq;
+      long_lived_crypto_.encrypt( { &KeyMessage::keyreq_id, 1 }, empty, keyreq );
+      socket_.sendto( server_, keyreq );
+      stats_.key_requests++;
+    },
+    [&] { return ( not session_.has_value() ) and ( next_key_request_ < steady_clock::now() ); } );
+
+  loop.add_rule(
+    "datagram ack",
+    [&] {
+      const uint64_t now = Timer::timestamp_ns();
+      next_ack_ts_ = now + 5'000'000;
+
+      const auto& last_frame = session_->receiver_stats().last_new_frame_received;
+      if ( last_frame.value_or( session_start_ts_ ) + 4'000'000'000 < now ) {
+        stats_.timeouts++;
+        session_.reset();
+        return;
+      }
+
+      skip_late_chunks( now );
+      session_->send_packet( socket_ );
+    },
+    [&] { return session_.has_value() and next_ack_ts_ <= Timer::timestamp_ns(); } );
+}
+
+void DatagramViewerClient::process_keyreply( const Ciphertext& ciphertext )
+{
+  Plaintext plaintext;
+  if ( long_lived_crypto_.decrypt( ciphertext, { &KeyMessage::keyreq_server_id, 1 }, plaintext ) ) {
+    Parser p { plaintext };
+    KeyMessage keys;
+    p.object( keys );
+    if ( p.error() ) {
+      stats_.bad_packets++;
+      p.clear_error();
+      return;
+    }
+
+    session_.emplace( keys.id, 0, CryptoSession( keys.key_pair.uplink, keys.key_pair.downlink ), server_ );
+    stats_.new_sessions++;
+    session_start_ts_ = Timer::timestamp_ns();
+
+    /* the server starts each session at an IDR */
+    current_nal_.resize( 0 );
+    at_nal_boundary_ = true;
+    need_idr_ = true;
+    last_nal_index_.reset();
+    stalled_since_.reset();
+    next_ack_ts_ = 0;
+  } else {
+    stats_.bad_packets++;
+  }
+}
+
+void DatagramViewerClient::deliver()
+{
+  VideoNetworkConnection& connection = session_.value();
+
+  while ( connection.next_frame_needed() > connection.frames().range_begin() ) {
+    const VideoChunk& chunk = connection.frames().at( connection.frames().range_begin() ).value();
+
+    if ( at_nal_boundary_ ) {
+      const size_t new_size = current_nal_.length() + chunk.data.length();
+      if ( new_size > current_nal_.capacity() ) {
+        throw runtime_error( "NAL too big" );
+      }
+
+      memcpy( current_nal_.mutable_data_ptr() + current_nal_.length(), chunk.data.data_ptr(), chunk.data.length() );
+      current_nal_.resize( new_size );
+
+      if ( chunk.end_of_nal ) {
+        if ( need_idr_ and not MP4Writer::is_idr( current_nal_.as_string_view() ) ) {
+          stats_.NALs_discarded++;
+        } else {
+          need_idr_ = false;
+          on_NAL_( current_nal_.as_string_view() );
+          stats_.NALs_delivered++;
+        }
+        current_nal_.resize( 0 );
+      }
+    } else if ( chunk.end_of_nal ) {
+      /* end of the access unit that lost chunks */
+      at_nal_boundary_ = true;
+      stats_.NALs_discarded++;
+    }
+
+    last_nal_index_ = chunk.nal_index;
+    last_chunk_ended_nal_ = chunk.end_of_nal;
+    connection.pop_frames( 1 );
+  }
+
+  if ( connection.next_frame_needed() >= connection.unreceived_beyond_this_frame_index() ) {
+    stalled_since_.reset();
+  } else if ( not stalled_since_.has_value() ) {
+    stalled_since_ = Timer::timestamp_ns();
+  }
+}
+
+void DatagramViewerClient::skip_late_chunks( const uint64_t now )
+{
+  if ( not stalled_since_.has_value() or stalled_since_.value() + max_delay_ns_ > now ) {
+    return;
+  }
+
+  VideoNetworkConnection& connection = session_.value();
+
+  /* give up on the hole: resume at the next chunk that did arrive */
+  uint32_t resume = connection.next_frame_needed();
+  while ( resume < connection.unreceived_beyond_this_frame_index() and not connection.frames().has_value( resume ) ) {
+    resume++;
+  }
+
+  connection.skip_to( resume );
+  stats_.holes_skipped++;
+
+  /* the chunk we resume at may be in the middle of a NAL, and later frames may refer to the lost one */
+  const bool resume_at_boundary
+    = connection.frames().has_value( resume ) and starts_nal( connection.frames().at( resume ).value() );
+  if ( resume_at_boundary and last_nal_index_.has_value() and not last_chunk_ended_nal_ ) {
+    stats_.NALs_discarded++; /* the NAL cut short by the hole */
+  }
+  current_nal_.resize( 0 );
+  at_nal_boundary_ = resume_at_boundary;
+  need_idr_ = true;
+
+  stalled_since_.reset();
+  deliver();
+}
+
+/* whether the first chunk to arrive after a hole begins a NAL */
+bool DatagramViewerClient::starts_nal( const VideoChunk& chunk_after_hole ) const
+{
+  /* a NAL's chunks are consecutive, so when the lost chunks can only belong to this chunk's NAL (the one the last
+     chunk was in, or the one after it if the last chunk ended its NAL), its start was lost */
+  if ( last_nal_index_.has_value()
+       and ( chunk_after_hole.nal_index == last_nal_index_.value()
+             or ( last_chunk_ended_nal_ and chunk_after_hole.nal_index == last_nal_index_.value() + 1 ) ) ) {
+    return false;
+  }
+
+  /* otherwise the hole crossed into another NAL: emulation prevention keeps a start code out of any NAL's
+     payload, so one at the front of the chunk means it is the first chunk of its NAL */
+  return chunk_after_hole.data.as_string_view().substr( 0, 4 ) == "\0\0\0\1"sv;
+}
+
+uint64_t DatagramViewerClient::wait_time_ms( const uint64_t now ) const
+{
+  if ( not session_.has_value() ) {
+    return 250;
+  }
+
+  return next_ack_ts_ > now ? ( next_ack_ts_ - now ) / 1'000'000 : 0;
+}
+
+void DatagramViewerClient::summary( ostream& out ) const
+{
+  out << "Datagram viewer [" << name_ << "]:";
+  out << " key_requests=" << stats_.key_requests;
+  out << " sessions=" << stats_.new_sessions;
+  out << " bad_packets=" << stats_.bad_packets;
+  out << " timeouts=" << stats_.timeouts;
+  out << " NALs delivered=" << stats_.NALs_delivered;
+  if ( stats_.NALs_discarded ) {
+    out << " discarded=" << stats_.NALs_discarded;
+  }
+  if ( stats_.holes_skipped ) {
+    out << " holes skipped=" << stats_.holes_skipped;
+  }
+  if ( stats_.simulated_losses ) {
+    out << " simulated losses=" << stats_.simulated_losses;
+  }
+  out << "\n";
+  if ( session_.has_value() ) {
+    session_->summary( out );
+  }
+}
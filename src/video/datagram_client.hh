@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "crypto.hh"
+#include "eventloop.hh"
+#include "keys.hh"
+#include "socket.hh"
+#include "summarize.hh"
+#include "videoclient.hh"
+
+/* receives the camera feed from a DatagramViewerServer: reassembles access units from the VideoChunks and
+   hands them to a callback in order, giving up on a missing chunk after a deadline (the rest of that access
+   unit is dropped, and everything until the next IDR) rather than waiting for the retransmission */
+class DatagramViewerClient : public Summarizable
+{
+public:
+  using NALCallback = std::function<void( const std::string_view )>;
+
+private:
+  UDPSocket socket_ {};
+  Address server_;
+
+  std::string name_;
+  CryptoSession long_lived_crypto_;
+
+  std::optional<VideoNetworkConnection> session_ {};
+  std::chrono::steady_clock::time_point next_key_request_;
+  uint64_t session_start_ts_ {}, next_ack_ts_ {};
+
+  /* how long to wait for a missing chunk while later ones have arrived */
+  uint64_t max_delay_ns_;
+  std::optional<uint64_t> stalled_since_ {};
+
+  StackBuffer<0, uint32_t, 1048576> current_nal_ {};
+
+  /* after skipping a hole, the chunks up to the next NAL boundary belong to a broken access unit */
+  bool at_nal_boundary_ { true };
+  bool need_idr_ { true };
+
+  /* the NAL of the last chunk taken from the connection, and whether that chunk ended it */
+  std::optional<uint32_t> last_nal_index_ {};
+  bool last_chunk_ended_nal_ {};
+
+  NALCallback on_NAL_;
+
+  /* for testing: fraction of incoming datagrams to drop */
+  float simulated_loss_;
+  std::minstd_rand prng_ {};
+
+  struct Statistics
+  {
+    unsigned int key_requests, new_sessions, bad_packets, timeouts, simulated_losses;
+    unsigned int NALs_delivered, NALs_discarded, holes_skipped;
+  } stats_ {};
+
+  void process_keyreply( const Ciphertext& ciphertext );
+  void deliver();
+  void skip_late_chunks( const uint64_t now );
+  bool starts_nal( const VideoChunk& chunk_after_hole ) const;
+
+public:
+  DatagramViewerClient( const Address& server,
+                        const LongLivedKey& key,
+                        EventLoop& loop,
+                        NALCallback&& on_NAL,
+                        const uint64_t max_delay_ns = 100'000'000,
+                        const float simulated_loss = 0 );
+
+  /* until the next ack or skip deadline */
+  uint64_t wait_time_ms( const uint64_t now ) const;
+
+  void summary( std::ostream& out ) const override;
+  void reset_summary() override { stats_ = {}; }
+};
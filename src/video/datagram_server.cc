@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <iostream>
+
+#include "datagram_server.hh"
+#include "mp4writer.hh"
+#include "timer.hh"
+
+using namespace std;
+using namespace std::chrono;
+
+DatagramViewer::Session::Session( const uint8_t node_id, CryptoSession&& crypto )
+  : connection( 0, node_id, move( crypto ) )
+{}
+
+DatagramViewer::DatagramViewer( const uint8_t node_id, const LongLivedKey& key )
+  : id_( node_id )
+  , name_( key.name() )
+  , long_lived_crypto_( key.key_pair().downlink, key.key_pair().uplink, true )
+  , next_reply_allowed_( steady_clock::now() )
+  , next_session_( CryptoSession { next_keys_.downlink, next_keys_.uplink } )
+{}
+
+bool DatagramViewer::try_keyrequest( const Address& src, const Ciphertext& ciphertext, UDPSocket& socket )
+{
+  Plaintext plaintext;
+  if ( long_lived_crypto_.decrypt( ciphertext, { &KeyMessage::keyreq_id, 1 }, plaintext )
+       and ( plaintext.length() == 0 ) ) {
+    stats_.key_requests++;
+    if ( steady_clock::now() < next_reply_allowed_ ) {
+      return true;
+    }
+
+    /* reply with keys to next session */
+    Plaintext outgoing_keys;
+    {
+      Serializer s { outgoing_keys.mutable_buffer() };
+      s.object( KeyMessage { id_, next_keys_ } );
+      outgoing_keys.resize( s.bytes_written() );
+    }
+    Ciphertext outgoing_ciphertext;
+    long_lived_crypto_.encrypt( { &KeyMessage::keyreq_server_id, 1 }, outgoing_keys, outgoing_ciphertext );
+    socket.sendto( src, outgoing_ciphertext );
+    next_reply_allowed_ = steady_clock::now() + milliseconds( 250 );
+
+    stats_.key_responses++;
+    return true;
+  }
+  return false;
+}
+
+void DatagramViewer::receive_packet( const Address& src, const Ciphertext& ciphertext )
+{
+  if ( current_session_.has_value() and current_session_->connection.receive_packet( ciphertext, src ) ) {
+    return;
+  }
+
+  Plaintext throwaway_plaintext;
+  if ( next_session_.value().decrypt( ciphertext, { &id_, 1 }, throwaway_plaintext ) ) {
+    /* new session established */
+    current_session_.emplace( id_, move( next_session_.value() ) );
+
+    next_keys_ = KeyPair {};
+    next_session_.emplace( next_keys_.downlink, next_keys_.uplink );
+    stats_.new_sessions++;
+
+    /* actually use packet (it sets the viewer's address) */
+    current_session_->connection.receive_packet( ciphertext, src );
+  }
+}
+
+void DatagramViewer::push_NAL( const string_view nal, const uint64_t now )
+{
+  if ( not current_session_.has_value() ) {
+    return;
+  }
+
+  Session& session = current_session_.value();
+
+  if ( session.connection.sender_stats().last_good_ack_ts + CLIENT_TIMEOUT_NS < now ) {
+    stats_.timeouts++;
+    current_session_.reset();
+    return;
+  }
+
+  if ( not session.connection.has_destination() ) {
+    return;
+  }
+
+  if ( not session.idr_seen ) {
+    if ( not MP4Writer::is_idr( nal ) ) {
+      return;
+    }
+    session.idr_seen = true;
+  }
+
+  session.source.push( { nal, 0, 0 }, now );
+}
+
+bool DatagramViewer::ready( const uint64_t now ) const
+{
+  return current_session_.has_value() and current_session_->source.ready( now );
+}
+
+void DatagramViewer::transmit( UDPSocket& socket, const uint64_t now )
+{
+  Session& session = current_session_.value();
+
+  /* one chunk per datagram; the sender fills the rest of the packet with any retransmission that's due */
+  while ( session.source.ready( now ) ) {
+    session.connection.push_frame( session.source );
+    session.connection.send_packet( socket );
+  }
+}
+
+uint64_t DatagramViewer::wait_time_ms( const uint64_t now ) const
+{
+  return current_session_.has_value() ? current_session_->source.wait_time_ms( now ) : 60'000;
+}
+
+void DatagramViewer::summary( ostream& out ) const
+{
+  out << name_ << ":";
+  out << " requests=" << stats_.key_requests;
+  out << " responses=" << stats_.key_responses;
+  out << " new_sessions=" << stats_.new_sessions;
+  out << " timeouts=" << stats_.timeouts;
+  if ( current_session_.has_value() ) {
+    if ( current_session_->connection.has_destination() ) {
+      out << " (" << current_session_->connection.destination().to_string() << ")";
+    }
+    out << "\n";
+    current_session_->connection.summary( out );
+  } else {
+    out << "\n";
+  }
+}
+
+DatagramViewerServer::DatagramViewerServer( const Address& address, EventLoop& loop )
+{
+  socket_.set_blocking( false );
+  socket_.bind( address );
+
+  loop.add_rule( "datagram viewer receive", socket_, Direction::In, [&] {
+    Address src { nullptr, 0 };
+    Ciphertext ciphertext;
+    ciphertext.resize( socket_.recv( src, ciphertext.mutable_buffer() ) );
+    if ( ciphertext.length() > 24 ) {
+      const uint8_t node_id = ciphertext.as_string_view().back();
+      if ( node_id == uint8_t( KeyMessage::keyreq_id ) ) {
+        for ( auto& viewer : viewers_ ) {
+          if ( viewer.try_keyrequest( src, ciphertext, socket_ ) ) {
+            return;
+          }
+        }
+        stats_.bad_packets++;
+      } else if ( node_id > 0 and node_id <= viewers_.size() ) {
+        viewers_.at( node_id - 1 ).receive_packet( src, ciphertext );
+      } else {
+        stats_.bad_packets++;
+      }
+    } else {
+      stats_.bad_packets++;
+    }
+  } );
+
+  loop.add_rule(
+    "datagram viewer transmit",
+    [&] {
+      const uint64_t now = Timer::timestamp_ns();
+      for ( auto& viewer : viewers_ ) {
+        if ( viewer.ready( now ) ) {
+          viewer.transmit( socket_, now );
+        }
+      }
+    },
+    [&] {
+      const uint64_t now = Timer::timestamp_ns();
+      return any_of( viewers_.begin(), viewers_.end(), [&]( const auto& viewer ) { return viewer.ready( now ); } );
+    } );
+}
+
+void DatagramViewerServer::add_key( const LongLivedKey& key )
+{
+  if ( viewers_.size() >= 250 ) {
+    throw runtime_error( "too many datagram viewers" );
+  }
+
+  const uint8_t next_id = viewers_.size() + 1;
+  viewers_.emplace_back( next_id, key );
+  cerr << "Added datagram viewer #" << int( next_id ) << ": " << key.name() << "\n";
+}
+
+void DatagramViewerServer::push_NAL( const string_view nal )
+{
+  const uint64_t now = Timer::timestamp_ns();
+  for ( auto& viewer : viewers_ ) {
+    viewer.push_NAL( nal, now );
+  }
+}
+
+uint64_t DatagramViewerServer::wait_time_ms( const uint64_t now ) const
+{
+  uint64_t ret = 60'000;
+  for ( const auto& viewer : viewers_ ) {
+    ret = min( ret, viewer.wait_time_ms( now ) );
+  }
+  return ret;
+}
+
+void DatagramViewerServer::summary( ostream& out ) const
+{
+  if ( stats_.bad_packets ) {
+    out << "Datagram viewers: bad packets=" << stats_.bad_packets << "\n";
+  }
+
+  for ( const auto& viewer : viewers_ ) {
+    viewer.summary( out );
+  }
+}
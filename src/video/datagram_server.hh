@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "crypto.hh"
+#include "eventloop.hh"
+#include "keys.hh"
+#include "socket.hh"
+#include "summarize.hh"
+#include "videoclient.hh"
+
+/* one viewer allowed to receive the camera feed over UDP (the reverse of KnownVideoClient: here the server
+   sends the VideoChunks and the viewer acknowledges them) */
+class DatagramViewer
+{
+  static constexpr uint64_t CLIENT_TIMEOUT_NS = 4'000'000'000;
+
+  char id_;
+
+  std::string name_;
+  CryptoSession long_lived_crypto_;
+  std::chrono::steady_clock::time_point next_reply_allowed_;
+
+  struct Session
+  {
+    VideoNetworkConnection connection;
+    VideoSource source {};
+
+    /* each session starts at an IDR */
+    bool idr_seen {};
+
+    Session( const uint8_t node_id, CryptoSession&& crypto );
+  };
+
+  std::optional<Session> current_session_ {};
+
+  KeyPair next_keys_ {};
+  std::optional<CryptoSession> next_session_;
+
+  struct Statistics
+  {
+    unsigned int key_requests, key_responses, new_sessions, timeouts;
+  } stats_ {};
+
+public:
+  DatagramViewer( const uint8_t node_id, const LongLivedKey& key );
+
+  bool try_keyrequest( const Address& src, const Ciphertext& ciphertext, UDPSocket& socket );
+  void receive_packet( const Address& src, const Ciphertext& ciphertext );
+
+  void push_NAL( const std::string_view nal, const uint64_t now );
+  bool ready( const uint64_t now ) const;
+  void transmit( UDPSocket& socket, const uint64_t now );
+  uint64_t wait_time_ms( const uint64_t now ) const;
+
+  void summary( std::ostream& out ) const;
+};
+
+/* sends the camera feed to viewers over UDP, one VideoChunk-sized piece per datagram with its own sequence
+   number (the Packet<VideoChunk> framing), so a lost datagram holds up only its own access unit and the viewer
+   can give up on it after a deadline instead of stalling everything behind it, as on TCP */
+class DatagramViewerServer : public Summarizable
+{
+  UDPSocket socket_ {};
+  std::vector<DatagramViewer> viewers_ {};
+
+  struct Statistics
+  {
+    unsigned int bad_packets;
+  } stats_ {};
+
+public:
+  DatagramViewerServer( const Address& address, EventLoop& loop );
+
+  void add_key( const LongLivedKey& key );
+
+  /* an access unit of the feed (Annex B), for every viewer with a session */
+  void push_NAL( const std::string_view nal );
+
+  /* until the next chunk is due (chunks of a large access unit are paced out) */
+  uint64_t wait_time_ms( const uint64_t now ) const;
+
+  void summary( std::ostream& out ) const override;
+  void reset_summary() override { stats_ = {}; }
+};
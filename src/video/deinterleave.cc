@@ -0,0 +1,93 @@
+#if defined( __SSE2__ )
+#include <immintrin.h>
+#elif defined( __ARM_NEON )
+#include <arm_neon.h>
+#endif
+
+#include "deinterleave.hh"
+
+void deinterleave_pairs( const uint8_t* src, uint8_t* even, uint8_t* odd, const size_t pairs )
+{
+  size_t i = 0;
+
+#if defined( __SSE2__ )
+  const __m128i low_bytes = _mm_set1_epi16( 0x00ff );
+  for ( ; i + 16 <= pairs; i += 16 ) {
+    const __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + 2 * i ) );
+    const __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + 2 * i + 16 ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( even + i ),
+                      _mm_packus_epi16( _mm_and_si128( a, low_bytes ), _mm_and_si128( b, low_bytes ) ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( odd + i ),
+                      _mm_packus_epi16( _mm_srli_epi16( a, 8 ), _mm_srli_epi16( b, 8 ) ) );
+  }
+#elif defined( __ARM_NEON )
+  for ( ; i + 16 <= pairs; i += 16 ) {
+    const uint8x16x2_t x = vld2q_u8( src + 2 * i );
+    vst1q_u8( even + i, x.val[0] );
+    vst1q_u8( odd + i, x.val[1] );
+  }
+#endif
+
+  for ( ; i < pairs; i++ ) {
+    even[i] = src[2 * i];
+    odd[i] = src[2 * i + 1];
+  }
+}
+
+void yuyv_luma( const uint8_t* src, uint8_t* Y, const size_t pixels )
+{
+  size_t i = 0;
+
+#if defined( __SSE2__ )
+  const __m128i low_bytes = _mm_set1_epi16( 0x00ff );
+  for ( ; i + 16 <= pixels; i += 16 ) {
+    const __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + 2 * i ) );
+    const __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + 2 * i + 16 ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( Y + i ),
+                      _mm_packus_epi16( _mm_and_si128( a, low_bytes ), _mm_and_si128( b, low_bytes ) ) );
+  }
+#elif defined( __ARM_NEON )
+  for ( ; i + 16 <= pixels; i += 16 ) {
+    vst1q_u8( Y + i, vld2q_u8( src + 2 * i ).val[0] );
+  }
+#endif
+
+  for ( ; i < pixels; i++ ) {
+    Y[i] = src[2 * i];
+  }
+}
+
+void yuyv_chroma( const uint8_t* src, uint8_t* Cb, uint8_t* Cr, const size_t pairs )
+{
+  size_t i = 0;
+
+#if defined( __SSE2__ )
+  const __m128i low_bytes = _mm_set1_epi16( 0x00ff );
+  for ( ; i + 16 <= pairs; i += 16 ) {
+    const __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + 4 * i ) );
+    const __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + 4 * i + 16 ) );
+    const __m128i c = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + 4 * i + 32 ) );
+    const __m128i d = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + 4 * i + 48 ) );
+
+    /* odd bytes are U V U V ... */
+    const __m128i uv0 = _mm_packus_epi16( _mm_srli_epi16( a, 8 ), _mm_srli_epi16( b, 8 ) );
+    const __m128i uv1 = _mm_packus_epi16( _mm_srli_epi16( c, 8 ), _mm_srli_epi16( d, 8 ) );
+
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( Cb + i ),
+                      _mm_packus_epi16( _mm_and_si128( uv0, low_bytes ), _mm_and_si128( uv1, low_bytes ) ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( Cr + i ),
+                      _mm_packus_epi16( _mm_srli_epi16( uv0, 8 ), _mm_srli_epi16( uv1, 8 ) ) );
+  }
+#elif defined( __ARM_NEON )
+  for ( ; i + 16 <= pairs; i += 16 ) {
+    const uint8x16x4_t x = vld4q_u8( src + 4 * i );
+    vst1q_u8( Cb + i, x.val[1] );
+    vst1q_u8( Cr + i, x.val[3] );
+  }
+#endif
+
+  for ( ; i < pairs; i++ ) {
+    Cb[i] = src[4 * i + 1];
+    Cr[i] = src[4 * i + 3];
+  }
+}
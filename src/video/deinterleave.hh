@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* packed => planar conversions for camera formats (vectorized where the CPU allows) */
+
+/* NV12 chroma row: U0 V0 U1 V1 ... => U0 U1 ..., V0 V1 ... */
+void deinterleave_pairs( const uint8_t* src, uint8_t* even, uint8_t* odd, const size_t pairs );
+
+/* YUYV row: Y0 U0 Y1 V0 ... => Y0 Y1 ... */
+void yuyv_luma( const uint8_t* src, uint8_t* Y, const size_t pixels );
+
+/* YUYV row: Y0 U0 Y1 V0 ... => U0 ..., V0 ... */
+void yuyv_chroma( const uint8_t* src, uint8_t* Cb, uint8_t* Cr, const size_t pairs );
@@ -2,20 +2,98 @@
 #include "av_check.hh"
 #include "exception.hh"
 
+#include <array>
+#include <cstring>
 #include <iostream>
 #include <memory>
 
 using namespace std;
 
-H264Decoder::H264Decoder()
+H264Decoder::H264Decoder( const unsigned int threads )
   : codec_( notnull( "avcodec_find_decoder", avcodec_find_decoder( AV_CODEC_ID_H264 ) ) )
   , context_( notnull( "avcodec_alloc_context3", avcodec_alloc_context3( codec_ ) ) )
 {
   av_log_set_level( AV_LOG_QUIET );
+
+  context_->opaque = this;
+  context_->get_buffer2 = H264Decoder::get_buffer;
+
+  if ( threads > 1 ) {
+    context_->thread_count = threads;
+    context_->thread_type = FF_THREAD_SLICE;
+  }
+
   av_check( avcodec_open2( context_.get(), codec_, nullptr ) );
 }
 
-bool H264Decoder::decode( const span_view<uint8_t> nal, RasterYUV420& output )
+int H264Decoder::get_buffer( AVCodecContext* context, AVFrame* frame, int flags )
+{
+  return static_cast<H264Decoder*>( context->opaque )->get_raster_buffer( frame, flags );
+}
+
+int H264Decoder::get_raster_buffer( AVFrame* frame, int flags )
+{
+  if ( frame->format != AV_PIX_FMT_YUV420P ) {
+    return avcodec_default_get_buffer2( context_.get(), frame, flags );
+  }
+
+  /* libavcodec may write whole macroblock rows past the visible picture */
+  int aligned_width = frame->width, aligned_height = frame->height;
+  array<int, AV_NUM_DATA_POINTERS> linesize_align {};
+  avcodec_align_dimensions2( context_.get(), &aligned_width, &aligned_height, linesize_align.data() );
+
+  /* asked for the coded size (e.g. 1920x1088 for 1080p), but the picture comes back cropped to the context's
+     size: size the raster for that, with the rest of the coded rows as padding */
+  const int width = context_->width > 0 ? min( frame->width, context_->width ) : frame->width;
+  const int height = context_->height > 0 ? min( frame->height, context_->height ) : frame->height;
+
+  const PoolKey key { width, height, aligned_height - height };
+  if ( not pool_key_.has_value() or not( pool_key_.value() == key ) ) {
+    pool_key_ = key;
+    pool_.emplace( [key] { return make_unique<RasterYUV420>( key.width, key.height, key.padding_rows ); } );
+    our_buffers_.clear();
+  }
+
+  shared_ptr<RasterYUV420> raster = pool_->get();
+
+  auto misaligned = []( const int stride, const int alignment ) { return alignment > 0 and stride % alignment; };
+
+  if ( raster->Y_stride() < aligned_width or raster->chroma_stride() < ( aligned_width + 1 ) / 2
+       or misaligned( raster->Y_stride(), linesize_align[0] )
+       or misaligned( raster->chroma_stride(), linesize_align[1] )
+       or misaligned( raster->chroma_stride(), linesize_align[2] ) ) {
+    return avcodec_default_get_buffer2( context_.get(), frame, flags );
+  }
+
+  /* the AVBuffer holds a handle to the raster until libavcodec lets go of the picture */
+  string_span storage = raster->frame();
+  auto handle = new shared_ptr<RasterYUV420>( raster );
+  frame->buf[0] = av_buffer_create(
+    reinterpret_cast<uint8_t*>( storage.mutable_data() ),
+    storage.size(),
+    []( void* opaque, uint8_t* ) { delete static_cast<shared_ptr<RasterYUV420>*>( opaque ); },
+    handle,
+    0 );
+
+  if ( not frame->buf[0] ) {
+    delete handle;
+    return AVERROR( ENOMEM );
+  }
+
+  frame->data[0] = raster->Y_row( 0 );
+  frame->data[1] = raster->Cb_row( 0 );
+  frame->data[2] = raster->Cr_row( 0 );
+  frame->linesize[0] = raster->Y_stride();
+  frame->linesize[1] = raster->chroma_stride();
+  frame->linesize[2] = raster->chroma_stride();
+  frame->extended_data = frame->data;
+
+  our_buffers_[raster->Y_row( 0 )] = raster;
+
+  return 0;
+}
+
+bool H264Decoder::receive_frame( const span_view<uint8_t> nal )
 {
   AVPacket packet {};
   packet.data = const_cast<uint8_t*>( nal.data() );
@@ -34,21 +112,87 @@ bool H264Decoder::decode( const span_view<uint8_t> nal, RasterYUV420& output )
     return false;
   }
 
-  if ( frame_.frame->width != output.width() or frame_.frame->height != output.height()
-       or frame_.frame->format != AV_PIX_FMT_YUV420P ) {
+  if ( frame_.frame->format != AV_PIX_FMT_YUV420P ) {
+    cerr << "unexpected format\n";
+    av_frame_unref( frame_.frame );
+    return false;
+  }
+
+  return true;
+}
+
+static void copy_planes( const AVFrame* frame, RasterYUV420& output )
+{
+  for ( uint16_t row = 0; row < output.height(); row++ ) {
+    memcpy( output.Y_row( row ), frame->data[0] + row * frame->linesize[0], output.width() );
+  }
+
+  for ( uint16_t row = 0; row < output.chroma_height(); row++ ) {
+    memcpy( output.Cb_row( row ), frame->data[1] + row * frame->linesize[1], output.chroma_width() );
+    memcpy( output.Cr_row( row ), frame->data[2] + row * frame->linesize[2], output.chroma_width() );
+  }
+}
+
+bool H264Decoder::decode( const span_view<uint8_t> nal, RasterYUV420& output )
+{
+  if ( not receive_frame( nal ) ) {
+    return false;
+  }
+
+  if ( frame_.frame->width != output.width() or frame_.frame->height != output.height() ) {
     cerr << "unexpected format\n";
+    av_frame_unref( frame_.frame );
     return false;
   }
 
-  memcpy( output.Y_row( 0 ), frame_.frame->data[0], output.width() * output.height() );
-  memcpy( output.Cb_row( 0 ), frame_.frame->data[1], output.chroma_width() * output.chroma_height() );
-  memcpy( output.Cr_row( 0 ), frame_.frame->data[2], output.chroma_width() * output.chroma_height() );
+  copy_planes( frame_.frame, output );
+  av_frame_unref( frame_.frame );
 
   return true;
 }
 
+shared_ptr<RasterYUV420> H264Decoder::decode( const span_view<uint8_t> nal )
+{
+  if ( not receive_frame( nal ) ) {
+    return nullptr;
+  }
+
+  shared_ptr<RasterYUV420> ret;
+
+  const AVFrame* frame = frame_.frame;
+  const auto it = our_buffers_.find( frame->data[0] );
+  if ( it != our_buffers_.end() ) {
+    ret = it->second.lock();
+  }
+
+  /* cropping shrinks the picture and, from the top or left, moves the planes: the raster is only the picture
+     if it still starts where the planes do and has the cropped size */
+  if ( ret
+       and ( ret->width() != frame->width or ret->height() != frame->height or frame->data[1] != ret->Cb_row( 0 )
+             or frame->data[2] != ret->Cr_row( 0 ) ) ) {
+    ret = nullptr;
+  }
+
+  if ( not ret ) {
+    /* libavcodec used a buffer of its own (or cropped ours), so copy */
+    ret = global_raster_pool<RasterYUV420>( frame->width, frame->height ).get();
+    copy_planes( frame, *ret );
+  }
+
+  av_frame_unref( frame_.frame );
+
+  return ret;
+}
+
 H264Decoder::H264Decoder( H264Decoder&& other ) noexcept
   : codec_( other.codec_ )
   , context_( move( other.context_ ) )
   , frame_( move( other.frame_ ) )
-{}
+  , pool_key_( move( other.pool_key_ ) )
+  , pool_( move( other.pool_ ) )
+  , our_buffers_( move( other.our_buffers_ ) )
+{
+  if ( context_ ) {
+    context_->opaque = this;
+  }
+}
@@ -2,9 +2,12 @@
 
 #include "exception.hh"
 #include "raster.hh"
+#include "raster_pool.hh"
 #include "spans.hh"
 
 #include <memory>
+#include <optional>
+#include <unordered_map>
 
 extern "C"
 {
@@ -17,11 +20,7 @@ struct FrameWrapper
 
   FrameWrapper()
     : frame( notnull( "av_frame_alloc", av_frame_alloc() ) )
-  {
-    frame->buf[0] = av_buffer_alloc( 1024 * 1024 );
-    frame->buf[1] = av_buffer_alloc( 1024 * 1024 );
-    frame->buf[2] = av_buffer_alloc( 1024 * 1024 );
-  }
+  {}
 
   ~FrameWrapper()
   {
@@ -46,19 +45,44 @@ class H264Decoder
 
   struct avcodec_deleter
   {
-    void operator()( AVCodecContext* x ) const { av_free( x ); }
+    void operator()( AVCodecContext* x ) const { avcodec_free_context( &x ); }
   };
 
   std::unique_ptr<AVCodecContext, avcodec_deleter> context_;
   FrameWrapper frame_ {};
 
+  /* pictures are decoded straight into pooled rasters (see get_buffer) */
+  struct PoolKey
+  {
+    int width, height, padding_rows;
+    bool operator==( const PoolKey& other ) const
+    {
+      return width == other.width and height == other.height and padding_rows == other.padding_rows;
+    }
+  };
+  std::optional<PoolKey> pool_key_ {};
+  std::optional<RasterPool<RasterYUV420>> pool_ {};
+
+  /* Y plane address => raster, for buffers that libavcodec got from us */
+  std::unordered_map<const uint8_t*, std::weak_ptr<RasterYUV420>> our_buffers_ {};
+
+  static int get_buffer( AVCodecContext* context, AVFrame* frame, int flags );
+  int get_raster_buffer( AVFrame* frame, int flags );
+
+  bool receive_frame( const span_view<uint8_t> nal );
+
 public:
-  H264Decoder();
+  /* threads > 1 enables slice threading (frame threading would add a frame of latency per thread) */
+  H264Decoder( const unsigned int threads = 1 );
 
   H264Decoder( const H264Decoder& other ) = delete;
   H264Decoder& operator=( const H264Decoder& other ) = delete;
 
   H264Decoder( H264Decoder&& other ) noexcept;
 
+  /* copies the picture into `output` */
   bool decode( const span_view<uint8_t> nal, RasterYUV420& output );
+
+  /* zero-copy: returns the raster libavcodec decoded into (nullptr if no picture) */
+  std::shared_ptr<RasterYUV420> decode( const span_view<uint8_t> nal );
 };
@@ -0,0 +1,194 @@
+#include "jpeg_pool.hh"
+
+#include <iostream>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "exception.hh"
+#include "jpeg.hh"
+
+using namespace std;
+
+MJPEGDecodePool::MJPEGDecodePool( const uint16_t width, const uint16_t height, const unsigned int num_threads )
+  : width_( width )
+  , height_( height )
+  , ready_fd_( CheckSystemCall( "eventfd", eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) )
+{
+  if ( num_threads == 0 ) {
+    throw runtime_error( "MJPEGDecodePool: need at least one decoder thread" );
+  }
+
+  /* one frame in flight per worker, plus room for the consumer to hold one and one to queue */
+  for ( unsigned int i = 0; i < num_threads + 2; i++ ) {
+    slots_.push_back( make_unique<Slot>( width_, height_ ) );
+  }
+
+  for ( unsigned int i = 0; i < num_threads; i++ ) {
+    workers_.emplace_back( [&] { worker_loop(); } );
+  }
+}
+
+MJPEGDecodePool::~MJPEGDecodePool()
+{
+  {
+    unique_lock<mutex> lock { mutex_ };
+    shutting_down_ = true;
+  }
+  work_available_.notify_all();
+
+  for ( auto& x : workers_ ) {
+    x.join();
+  }
+}
+
+bool MJPEGDecodePool::push( const string_view jpeg, const uint64_t capture_timestamp )
+{
+  unique_lock<mutex> lock { mutex_ };
+
+  Slot& next = slot( next_submit_ );
+  if ( next.state != Slot::State::Free ) {
+    /* consumer is behind; drop the newest frame rather than stall the camera */
+    stats_.frames_dropped++;
+    return false;
+  }
+
+  next.jpeg.assign( jpeg );
+  next.capture_timestamp = capture_timestamp;
+  next.state = Slot::State::Pending;
+  next_submit_++;
+  stats_.frames_submitted++;
+
+  lock.unlock();
+  work_available_.notify_one();
+  return true;
+}
+
+void MJPEGDecodePool::worker_loop()
+{
+  JPEGDecompresser decompresser;
+
+  while ( true ) {
+    Slot* job;
+    {
+      unique_lock<mutex> lock { mutex_ };
+      work_available_.wait( lock, [&] { return shutting_down_ or next_decode_ < next_submit_; } );
+      if ( shutting_down_ ) {
+        return;
+      }
+
+      job = &slot( next_decode_ );
+      job->state = Slot::State::Decoding;
+      next_decode_++;
+    }
+
+    const uint64_t decode_start = Timer::timestamp_ns();
+    bool ok = true;
+    try {
+      decompresser.begin_decoding( job->jpeg );
+      decompresser.decode( job->raster );
+    } catch ( const exception& e ) {
+      cerr << "JPEG exception in MJPEGDecodePool: " << e.what() << "\n";
+      decompresser.reset();
+      ok = false;
+    }
+    const uint64_t decode_end = Timer::timestamp_ns();
+
+    {
+      unique_lock<mutex> lock { mutex_ };
+      job->state = ok ? Slot::State::Decoded : Slot::State::Failed;
+      stats_.decode_time.log( decode_end - decode_start );
+      if ( ok ) {
+        stats_.capture_to_raster.log( decode_end - job->capture_timestamp );
+      } else {
+        stats_.decode_errors++;
+      }
+    }
+
+    /* wake up the EventLoop (not through FileDescriptor::write, which isn't thread-safe) */
+    const uint64_t one = 1;
+    if ( ::write( ready_fd_.fd_num(), &one, sizeof( one ) ) < 0 and errno != EAGAIN ) {
+      cerr << "MJPEGDecodePool: eventfd write failed\n";
+    }
+  }
+}
+
+void MJPEGDecodePool::clear_ready()
+{
+  uint64_t count;
+  ready_fd_.read( { reinterpret_cast<char*>( &count ), sizeof( count ) } );
+}
+
+void MJPEGDecodePool::skip_failed_frames()
+{
+  while ( next_deliver_ < next_submit_ and slot( next_deliver_ ).state == Slot::State::Failed ) {
+    slot( next_deliver_ ).state = Slot::State::Free;
+    next_deliver_++;
+  }
+}
+
+bool MJPEGDecodePool::has_frame()
+{
+  unique_lock<mutex> lock { mutex_ };
+  skip_failed_frames();
+  return next_deliver_ < next_submit_ and slot( next_deliver_ ).state == Slot::State::Decoded;
+}
+
+RasterYUV422& MJPEGDecodePool::front()
+{
+  if ( not has_frame() ) {
+    throw runtime_error( "MJPEGDecodePool::front(): no frame ready" );
+  }
+
+  /* a Decoded slot is only touched by the consumer until it is popped */
+  return slot( next_deliver_ ).raster;
+}
+
+void MJPEGDecodePool::pop()
+{
+  unique_lock<mutex> lock { mutex_ };
+  skip_failed_frames();
+
+  Slot& delivered = slot( next_deliver_ );
+  if ( next_deliver_ >= next_submit_ or delivered.state != Slot::State::Decoded ) {
+    throw runtime_error( "MJPEGDecodePool::pop(): no frame ready" );
+  }
+
+  stats_.capture_to_delivery.log( Timer::timestamp_ns() - delivered.capture_timestamp );
+  stats_.frames_delivered++;
+
+  delivered.state = Slot::State::Free;
+  next_deliver_++;
+}
+
+void MJPEGDecodePool::summary( ostream& out ) const
+{
+  unique_lock<mutex> lock { mutex_ };
+
+  auto print_record = [&]( const string_view name, const Timer::Record& record ) {
+    out << "   " << name << ": ";
+    if ( record.count > 0 ) {
+      out << "mean=";
+      Timer::pp_ns( out, record.total_ns / record.count );
+      out << " min=";
+      Timer::pp_ns( out, record.min_ns );
+      out << " max=";
+      Timer::pp_ns( out, record.max_ns );
+    } else {
+      out << "none";
+    }
+    out << "\n";
+  };
+
+  out << "MJPEG decode (" << workers_.size() << " threads): submitted=" << stats_.frames_submitted
+      << " delivered=" << stats_.frames_delivered << " dropped=" << stats_.frames_dropped
+      << " errors=" << stats_.decode_errors << "\n";
+  print_record( "decode", stats_.decode_time );
+  print_record( "capture->raster", stats_.capture_to_raster );
+  print_record( "capture->delivery", stats_.capture_to_delivery );
+}
+
+void MJPEGDecodePool::reset_summary()
+{
+  unique_lock<mutex> lock { mutex_ };
+  stats_ = {};
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "file_descriptor.hh"
+#include "raster.hh"
+#include "summarize.hh"
+#include "timer.hh"
+
+/* decodes MJPEG frames on a pool of worker threads and hands them back in capture order */
+class MJPEGDecodePool : public Summarizable
+{
+  struct Slot
+  {
+    enum class State
+    {
+      Free,
+      Pending,
+      Decoding,
+      Decoded,
+      Failed
+    };
+
+    State state { State::Free };
+    std::string jpeg {};
+    RasterYUV422 raster;
+    uint64_t capture_timestamp {};
+
+    Slot( const uint16_t width, const uint16_t height )
+      : raster( width, height )
+    {}
+  };
+
+  uint16_t width_, height_;
+
+  std::vector<std::unique_ptr<Slot>> slots_ {};
+
+  /* frame sequence numbers: submitted >= claimed-by-a-worker >= delivered */
+  uint64_t next_submit_ {}, next_decode_ {}, next_deliver_ {};
+
+  mutable std::mutex mutex_ {};
+  std::condition_variable work_available_ {};
+  bool shutting_down_ {};
+
+  /* eventfd signalled by workers when a frame finishes decoding */
+  FileDescriptor ready_fd_;
+
+  std::vector<std::thread> workers_ {};
+
+  struct Statistics
+  {
+    unsigned int frames_submitted, frames_delivered, frames_dropped, decode_errors;
+    Timer::Record decode_time {}, capture_to_raster {}, capture_to_delivery {};
+  } stats_ {};
+
+  Slot& slot( const uint64_t sequence_number ) { return *slots_.at( sequence_number % slots_.size() ); }
+
+  void worker_loop();
+  void skip_failed_frames();
+
+public:
+  MJPEGDecodePool( const uint16_t width, const uint16_t height, const unsigned int num_threads = 3 );
+  ~MJPEGDecodePool();
+
+  /* copies the compressed frame, so the caller can give the camera buffer back right away */
+  bool push( const std::string_view jpeg, const uint64_t capture_timestamp );
+
+  bool has_frame();
+  RasterYUV422& front();
+  void pop();
+
+  /* readable when a decoded frame may be waiting */
+  FileDescriptor& fd() { return ready_fd_; }
+  void clear_ready();
+
+  void summary( std::ostream& out ) const override;
+  void reset_summary() override;
+
+  MJPEGDecodePool( const MJPEGDecodePool& other ) = delete;
+  MJPEGDecodePool& operator=( const MJPEGDecodePool& other ) = delete;
+};
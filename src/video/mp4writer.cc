@@ -68,7 +68,9 @@ MP4Writer::MP4Writer( const unsigned int frame_rate, const unsigned int width, c
   video_stream_->duration = 0;
 
   AVDictionary* flags = nullptr;
-  av_check( av_dict_set( &flags, "movflags", "default_base_moof+faststart+frag_custom", 0 ) );
+  /* an empty moov, written at the first flush (once the IDR's parameter sets are known), so the init segment
+     carries no frame of its own */
+  av_check( av_dict_set( &flags, "movflags", "empty_moov+delay_moov+default_base_moof+faststart+frag_custom", 0 ) );
 
   /* now write the header */
   av_check( avformat_write_header( context_.get(), &flags ) );
@@ -122,6 +124,11 @@ void MP4Writer::write( const string_view nal, const uint32_t presentation_no, co
   if ( idr_hit_ ) {
     av_check( av_write_frame( context_.get(), &packet ) );
     av_check( av_write_frame( context_.get(), nullptr ) );
+    if ( not moov_written_ ) {
+      /* that flush only wrote ftyp + moov: flush again for the frame's moof + mdat */
+      av_check( av_write_frame( context_.get(), nullptr ) );
+      moov_written_ = true;
+    }
     avio_flush( context_->pb );
   }
 }
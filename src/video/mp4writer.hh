@@ -27,22 +27,27 @@ class MP4Writer
   std::string extradata_ {};
   AVStream* video_stream_;
   bool idr_hit_ {};
+  bool moov_written_ {};
 
   static constexpr unsigned int BUF_SIZE = 1048576;
   RingBuffer buf_ { BUF_SIZE };
 
-  constexpr static unsigned int MP4_TIMEBASE = 90000;
-
   bool header_written_;
   unsigned int frame_rate_, width_, height_;
 
 public:
+  constexpr static unsigned int MP4_TIMEBASE = 90000;
+
   MP4Writer( const unsigned int frame_rate, const unsigned int width, const unsigned int height );
 
   void write( const std::string_view nal, const uint32_t presentation_no, const uint32_t display_no );
 
   RingBuffer& output() { return buf_; }
 
+  /* in MP4 timebase units */
+  unsigned int frame_duration() const { return MP4_TIMEBASE / frame_rate_; }
+  unsigned int frame_rate() const { return frame_rate_; }
+
   MP4Writer( const MP4Writer& other ) = delete;
   MP4Writer& operator=( const MP4Writer& other ) = delete;
 
@@ -2,12 +2,62 @@
 
 #include <array>
 #include <cstdint>
+#include <cstdlib>
+#include <new>
 #include <stdexcept>
 #include <vector>
 
+#include "spans.hh"
+
+/* 64-byte (cache line / AVX-512) aligned storage for pixel planes */
+template<typename T>
+struct RasterAllocator
+{
+  static constexpr size_t alignment = 64;
+
+  using value_type = T;
+
+  RasterAllocator() = default;
+  template<typename U>
+  RasterAllocator( const RasterAllocator<U>& )
+  {}
+
+  T* allocate( const size_t n )
+  {
+    const size_t bytes = ( n * sizeof( T ) + alignment - 1 ) / alignment * alignment;
+    void* ret = std::aligned_alloc( alignment, bytes );
+    if ( not ret ) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>( ret );
+  }
+
+  void deallocate( T* p, const size_t ) { std::free( p ); }
+
+  template<typename U>
+  bool operator==( const RasterAllocator<U>& ) const
+  {
+    return true;
+  }
+
+  template<typename U>
+  bool operator!=( const RasterAllocator<U>& ) const
+  {
+    return false;
+  }
+};
+
+/* row length rounded up so that every row starts on an aligned boundary */
+inline uint16_t padded_stride( const uint16_t bytes )
+{
+  return ( bytes + RasterAllocator<uint8_t>::alignment - 1 ) / RasterAllocator<uint8_t>::alignment
+         * RasterAllocator<uint8_t>::alignment;
+}
+
 class RasterRGBA
 {
   uint16_t width_, height_;
+  uint16_t stride_; /* in pixels */
 
 public:
   struct pixel
@@ -16,25 +66,29 @@ public:
   };
 
 private:
-  std::vector<pixel> rgba_;
+  std::vector<pixel, RasterAllocator<pixel>> rgba_;
 
 public:
   RasterRGBA( const uint16_t width, const uint16_t height )
     : width_( width )
     , height_( height )
-    , rgba_( width_ * height_ )
+    , stride_( padded_stride( width * sizeof( pixel ) ) / sizeof( pixel ) )
+    , rgba_( size_t( stride_ ) * height_ )
   {}
 
   uint16_t width() const { return width_; }
   uint16_t height() const { return height_; }
 
-  pixel& pel( const uint16_t x, const uint16_t y ) { return rgba_[y * width_ + x]; }
-  const pixel& pel( const uint16_t x, const uint16_t y ) const { return rgba_[y * width_ + x]; }
+  /* distance between rows, in bytes */
+  int stride() const { return stride_ * sizeof( pixel ); }
+
+  pixel& pel( const uint16_t x, const uint16_t y ) { return rgba_[y * stride_ + x]; }
+  const pixel& pel( const uint16_t x, const uint16_t y ) const { return rgba_[y * stride_ + x]; }
 
   uint8_t* data() { return &( rgba_.at( 0 ).red ); }
   const uint8_t* data() const { return &( rgba_.at( 0 ).red ); }
 
-  std::vector<pixel>& pixels() { return rgba_; }
+  std::vector<pixel, RasterAllocator<pixel>>& pixels() { return rgba_; }
 
   RasterRGBA( const RasterRGBA& other ) = delete;
   RasterRGBA& operator=( const RasterRGBA& other ) = delete;
@@ -47,69 +101,144 @@ class RasterYUV
 private:
   uint16_t width_, height_;
   uint16_t chroma_width_, chroma_height_;
+  uint16_t Y_stride_, chroma_stride_;
 
-  std::vector<uint8_t> Y_ {}, Cb_ {}, Cr_ {};
+  /* extra rows allocated below each plane (e.g. for a decoder that works in whole macroblock rows) */
+  uint16_t Y_padding_rows_, chroma_padding_rows_;
+
+  /* Y, Cb and Cr planes back-to-back (I420/I422 layout), so the whole frame can be handed to a device */
+  std::vector<uint8_t, RasterAllocator<uint8_t>> storage_ {};
   std::vector<uint8_t*> Y_rows_ {}, Cb_rows_ {}, Cr_rows_ {};
 
+  size_t Y_size() const { return size_t( Y_stride_ ) * ( height_ + Y_padding_rows_ ); }
+  size_t chroma_size() const { return size_t( chroma_stride_ ) * ( chroma_height_ + chroma_padding_rows_ ); }
+
+  uint8_t* Y_data() { return storage_.data(); }
+  uint8_t* Cb_data() { return storage_.data() + Y_size(); }
+  uint8_t* Cr_data() { return storage_.data() + Y_size() + chroma_size(); }
+
+  const uint8_t* Y_data() const { return storage_.data(); }
+  const uint8_t* Cb_data() const { return storage_.data() + Y_size(); }
+  const uint8_t* Cr_data() const { return storage_.data() + Y_size() + chroma_size(); }
+
+  void build_rows()
+  {
+    Y_rows_.clear();
+    Cb_rows_.clear();
+    Cr_rows_.clear();
+
+    Y_rows_.reserve( height_ );
+    Cb_rows_.reserve( chroma_height_ );
+    Cr_rows_.reserve( chroma_height_ );
+    for ( uint16_t y = 0; y < height_; y++ ) {
+      Y_rows_.push_back( Y_row( y ) );
+    }
+
+    for ( uint16_t y = 0; y < chroma_height_; y++ ) {
+      Cb_rows_.push_back( Cb_row( y ) );
+      Cr_rows_.push_back( Cr_row( y ) );
+    }
+  }
+
 protected:
   RasterYUV( const uint16_t width,
              const uint16_t height,
              const uint16_t chroma_width,
-             const uint16_t chroma_height )
+             const uint16_t chroma_height,
+             const uint16_t Y_padding_rows = 0,
+             const uint16_t chroma_padding_rows = 0 )
     : width_( width )
     , height_( height )
     , chroma_width_( chroma_width )
     , chroma_height_( chroma_height )
-    , Y_( width * height )
-    , Cb_( chroma_width * chroma_height )
-    , Cr_( chroma_width * chroma_height )
+    , Y_stride_( padded_stride( width ) )
+    , chroma_stride_( padded_stride( chroma_width ) )
+    , Y_padding_rows_( Y_padding_rows )
+    , chroma_padding_rows_( chroma_padding_rows )
+    , storage_( Y_size() + 2 * chroma_size() )
   {
-    Y_rows_.reserve( height );
-    Cb_rows_.reserve( chroma_height );
-    Cr_rows_.reserve( chroma_height );
-    for ( uint16_t y = 0; y < height; y++ ) {
-      Y_rows_.push_back( Y_row( y ) );
-    }
+    build_rows();
+  }
 
-    for ( uint16_t y = 0; y < chroma_height; y++ ) {
-      Cb_rows_.push_back( Cb_row( y ) );
-      Cr_rows_.push_back( Cr_row( y ) );
+public:
+  /* copies need their own row pointers */
+  RasterYUV( const RasterYUV& other )
+    : width_( other.width_ )
+    , height_( other.height_ )
+    , chroma_width_( other.chroma_width_ )
+    , chroma_height_( other.chroma_height_ )
+    , Y_stride_( other.Y_stride_ )
+    , chroma_stride_( other.chroma_stride_ )
+    , Y_padding_rows_( other.Y_padding_rows_ )
+    , chroma_padding_rows_( other.chroma_padding_rows_ )
+    , storage_( other.storage_ )
+  {
+    build_rows();
+  }
+
+  RasterYUV& operator=( const RasterYUV& other )
+  {
+    if ( width_ != other.width_ or height_ != other.height_ or chroma_width_ != other.chroma_width_
+         or chroma_height_ != other.chroma_height_ or storage_.size() != other.storage_.size() ) {
+      throw std::runtime_error( "RasterYUV: assignment between mismatched sizes" );
     }
+
+    storage_ = other.storage_;
+    return *this;
   }
 
-public:
+  RasterYUV( RasterYUV&& other ) = default;
+  RasterYUV& operator=( RasterYUV&& other ) = default;
+
   uint16_t width() const { return width_; }
   uint16_t height() const { return height_; }
   uint16_t chroma_width() const { return chroma_width_; }
   uint16_t chroma_height() const { return chroma_height_; }
 
-  std::string_view Y_view() const { return { reinterpret_cast<const char*>( Y_.data() ), Y_.size() }; }
-  std::string_view Cb_view() const { return { reinterpret_cast<const char*>( Cb_.data() ), Cb_.size() }; }
-  std::string_view Cr_view() const { return { reinterpret_cast<const char*>( Cr_.data() ), Cr_.size() }; }
+  /* distance between rows, in bytes (a multiple of 64) */
+  uint16_t Y_stride() const { return Y_stride_; }
+  uint16_t chroma_stride() const { return chroma_stride_; }
 
-  const std::vector<uint8_t>& Y() const { return Y_; }
-  const std::vector<uint8_t>& Cb() const { return Cb_; }
-  const std::vector<uint8_t>& Cr() const { return Cr_; }
+  uint16_t Y_padding_rows() const { return Y_padding_rows_; }
 
-  std::vector<uint8_t>& Y() { return Y_; }
-  std::vector<uint8_t>& Cb() { return Cb_; }
-  std::vector<uint8_t>& Cr() { return Cr_; }
+  /* no padding: each plane is exactly width x height */
+  bool is_packed() const
+  {
+    return Y_stride_ == width_ and chroma_stride_ == chroma_width_ and Y_padding_rows_ == 0
+           and chroma_padding_rows_ == 0;
+  }
+
+  std::string_view Y_view() const { return { reinterpret_cast<const char*>( Y_data() ), Y_size() }; }
+  std::string_view Cb_view() const { return { reinterpret_cast<const char*>( Cb_data() ), chroma_size() }; }
+  std::string_view Cr_view() const { return { reinterpret_cast<const char*>( Cr_data() ), chroma_size() }; }
+
+  /* whole planes, including any row padding */
+  span_view<uint8_t> Y() const { return { Y_data(), Y_size() }; }
+  span_view<uint8_t> Cb() const { return { Cb_data(), chroma_size() }; }
+  span_view<uint8_t> Cr() const { return { Cr_data(), chroma_size() }; }
 
-  uint8_t& Y( const uint16_t x, const uint16_t y ) { return Y_[y * width() + x]; }
-  uint8_t& Cb( const uint16_t x, const uint16_t y ) { return Cb_[y * chroma_width() + x]; }
-  uint8_t& Cr( const uint16_t x, const uint16_t y ) { return Cr_[y * chroma_width() + x]; }
+  span<uint8_t> Y() { return { Y_data(), Y_size() }; }
+  span<uint8_t> Cb() { return { Cb_data(), chroma_size() }; }
+  span<uint8_t> Cr() { return { Cr_data(), chroma_size() }; }
 
-  uint8_t Y( const uint16_t x, const uint16_t y ) const { return Y_[y * width() + x]; }
-  uint8_t Cb( const uint16_t x, const uint16_t y ) const { return Cb_[y * chroma_width() + x]; }
-  uint8_t Cr( const uint16_t x, const uint16_t y ) const { return Cr_[y * chroma_width() + x]; }
+  /* all three planes */
+  string_span frame() { return { reinterpret_cast<char*>( storage_.data() ), storage_.size() }; }
 
-  uint8_t* Y_row( const uint16_t y ) { return &Y_.at( y * width() ); }
-  uint8_t* Cb_row( const uint16_t y ) { return &Cb_.at( y * chroma_width() ); }
-  uint8_t* Cr_row( const uint16_t y ) { return &Cr_.at( y * chroma_width() ); }
+  uint8_t& Y( const uint16_t x, const uint16_t y ) { return Y_data()[y * Y_stride_ + x]; }
+  uint8_t& Cb( const uint16_t x, const uint16_t y ) { return Cb_data()[y * chroma_stride_ + x]; }
+  uint8_t& Cr( const uint16_t x, const uint16_t y ) { return Cr_data()[y * chroma_stride_ + x]; }
 
-  const uint8_t* Y_row( const uint16_t y ) const { return &Y_.at( y * width() ); }
-  const uint8_t* Cb_row( const uint16_t y ) const { return &Cb_.at( y * chroma_width() ); }
-  const uint8_t* Cr_row( const uint16_t y ) const { return &Cr_.at( y * chroma_width() ); }
+  uint8_t Y( const uint16_t x, const uint16_t y ) const { return Y_data()[y * Y_stride_ + x]; }
+  uint8_t Cb( const uint16_t x, const uint16_t y ) const { return Cb_data()[y * chroma_stride_ + x]; }
+  uint8_t Cr( const uint16_t x, const uint16_t y ) const { return Cr_data()[y * chroma_stride_ + x]; }
+
+  uint8_t* Y_row( const uint16_t y ) { return Y_data() + size_t( y ) * Y_stride_; }
+  uint8_t* Cb_row( const uint16_t y ) { return Cb_data() + size_t( y ) * chroma_stride_; }
+  uint8_t* Cr_row( const uint16_t y ) { return Cr_data() + size_t( y ) * chroma_stride_; }
+
+  const uint8_t* Y_row( const uint16_t y ) const { return Y_data() + size_t( y ) * Y_stride_; }
+  const uint8_t* Cb_row( const uint16_t y ) const { return Cb_data() + size_t( y ) * chroma_stride_; }
+  const uint8_t* Cr_row( const uint16_t y ) const { return Cr_data() + size_t( y ) * chroma_stride_; }
 
   std::array<uint8_t**, 3> rows( const uint16_t y )
   {
@@ -128,7 +257,7 @@ public:
 class RasterYUV420 : public RasterYUV
 {
 public:
-  RasterYUV420( const uint16_t width, const uint16_t height )
-    : RasterYUV( width, height, width / 2, height / 2 )
+  RasterYUV420( const uint16_t width, const uint16_t height, const uint16_t padding_rows = 0 )
+    : RasterYUV( width, height, width / 2, height / 2, padding_rows, ( padding_rows + 1 ) / 2 )
   {}
-};
\ No newline at end of file
+};
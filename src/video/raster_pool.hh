@@ -0,0 +1,80 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "raster.hh"
+
+/* recycles same-sized rasters; frames are handed out as reference-counted handles
+   and go back on the free list when the last handle is dropped (from any thread) */
+template<class RasterType>
+class RasterPool
+{
+  struct State
+  {
+    std::mutex mutex {};
+    std::vector<std::unique_ptr<RasterType>> free {};
+    unsigned int allocated {}, reused {};
+  };
+
+  std::function<std::unique_ptr<RasterType>()> make_;
+  std::shared_ptr<State> state_ { std::make_shared<State>() };
+
+public:
+  RasterPool( const uint16_t width, const uint16_t height )
+    : make_( [width, height] { return std::make_unique<RasterType>( width, height ); } )
+  {}
+
+  /* for rasters that need other constructor arguments (e.g. padding rows) */
+  explicit RasterPool( std::function<std::unique_ptr<RasterType>()> make )
+    : make_( std::move( make ) )
+  {}
+
+  std::shared_ptr<RasterType> get()
+  {
+    std::unique_ptr<RasterType> raster;
+
+    {
+      std::unique_lock<std::mutex> lock { state_->mutex };
+      if ( not state_->free.empty() ) {
+        raster = std::move( state_->free.back() );
+        state_->free.pop_back();
+        state_->reused++;
+      } else {
+        state_->allocated++;
+      }
+    }
+
+    if ( not raster ) {
+      raster = make_();
+    }
+
+    /* the deleter keeps the free list alive even if the pool goes away first */
+    return { raster.release(), [state = state_]( RasterType* r ) {
+              std::unique_lock<std::mutex> lock { state->mutex };
+              state->free.emplace_back( r );
+            } };
+  }
+
+  unsigned int allocated() const { return state_->allocated; }
+  unsigned int reused() const { return state_->reused; }
+};
+
+/* one process-wide pool per raster type and size */
+template<class RasterType>
+RasterPool<RasterType>& global_raster_pool( const uint16_t width, const uint16_t height )
+{
+  static std::mutex mutex;
+  static std::map<std::pair<uint16_t, uint16_t>, std::unique_ptr<RasterPool<RasterType>>> pools;
+
+  std::unique_lock<std::mutex> lock { mutex };
+  auto& pool = pools[{ width, height }];
+  if ( not pool ) {
+    pool = std::make_unique<RasterPool<RasterType>>( width, height );
+  }
+  return *pool;
+}
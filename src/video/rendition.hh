@@ -0,0 +1,26 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+/* simulcast ladder for the live camera feed; rung 0 is the full-quality stream */
+struct CameraRendition
+{
+  const char* name;
+  uint16_t width, height;
+  uint8_t fps;
+};
+
+inline constexpr std::array<CameraRendition, 3> camera_renditions {
+  { { "720p60", 1280, 720, 60 }, { "540p30", 960, 540, 30 }, { "360p30", 640, 360, 30 } }
+};
+
+/* where VideoServer sends each rendition's NALs */
+inline std::string camera_rendition_socket( const size_t rung )
+{
+  if ( rung == 0 ) {
+    return "stagecast-camera-video";
+  }
+  return "stagecast-camera-video-" + std::string( camera_renditions.at( rung ).name );
+}
@@ -63,14 +63,14 @@ void Scaler::scale( const RasterYUV422& source, RasterYUV420& dest )
     throw runtime_error( "dest size mismatch" );
   }
 
-  const array<const uint8_t*, 3> source_planes { source.Y().data() + source_y_ * input_width + source_x_,
-                                                 source.Cb().data() + source_y_ * input_width / 2 + source_x_ / 2,
-                                                 source.Cr().data() + source_y_ * input_width / 2 + source_x_ / 2 };
+  const array<const uint8_t*, 3> source_planes { source.Y_row( source_y_ ) + source_x_,
+                                                 source.Cb_row( source_y_ ) + source_x_ / 2,
+                                                 source.Cr_row( source_y_ ) + source_x_ / 2 };
 
   const array<uint8_t*, 3> dest_planes { dest.Y_row( 0 ), dest.Cb_row( 0 ), dest.Cr_row( 0 ) };
 
-  const array<const int, 3> source_strides { input_width, input_width / 2, input_width / 2 };
-  const array<const int, 3> dest_strides { output_width, output_width / 2, output_width / 2 };
+  const array<const int, 3> source_strides { source.Y_stride(), source.chroma_stride(), source.chroma_stride() };
+  const array<const int, 3> dest_strides { dest.Y_stride(), dest.chroma_stride(), dest.chroma_stride() };
 
   if ( not context_ ) {
     throw runtime_error( "null ptr!" );
@@ -132,10 +132,10 @@ ColorspaceConverter::~ColorspaceConverter()
 void ColorspaceConverter::convert( const RasterYUV420& yuv, RasterRGBA& output ) const
 {
   const array<const uint8_t*, 3> source_planes { yuv.Y_row( 0 ), yuv.Cb_row( 0 ), yuv.Cr_row( 0 ) };
-  const array<const int, 3> source_strides { yuv.width(), yuv.chroma_width(), yuv.chroma_width() };
+  const array<const int, 3> source_strides { yuv.Y_stride(), yuv.chroma_stride(), yuv.chroma_stride() };
 
   const array<uint8_t*, 3> dest_planes { output.data(), nullptr, nullptr };
-  const array<const int, 3> dest_strides { output.width() * 4, 0, 0 };
+  const array<const int, 3> dest_strides { output.stride(), 0, 0 };
 
   sws_scale( yuv2rgba_,
              source_planes.data(),
@@ -149,10 +149,10 @@ void ColorspaceConverter::convert( const RasterYUV420& yuv, RasterRGBA& output )
 void ColorspaceConverter::convert( const RasterRGBA& rgba, RasterYUV420& output ) const
 {
   const array<const uint8_t*, 3> source_planes { rgba.data(), nullptr, nullptr };
-  const array<const int, 3> source_strides { rgba.width() * 4, 0, 0 };
+  const array<const int, 3> source_strides { rgba.stride(), 0, 0 };
 
   const array<uint8_t*, 3> dest_planes { output.Y_row( 0 ), output.Cb_row( 0 ), output.Cr_row( 0 ) };
-  const array<const int, 3> dest_strides { output.width(), output.chroma_width(), output.chroma_width() };
+  const array<const int, 3> dest_strides { output.Y_stride(), output.chroma_stride(), output.chroma_stride() };
 
   sws_scale( rgba2yuv_,
              source_planes.data(),
@@ -162,3 +162,62 @@ void ColorspaceConverter::convert( const RasterRGBA& rgba, RasterYUV420& output
              dest_planes.data(),
              dest_strides.data() );
 }
+
+Downscaler::Downscaler( const uint16_t input_width,
+                        const uint16_t input_height,
+                        const uint16_t output_width,
+                        const uint16_t output_height )
+  : input_width_( input_width )
+  , input_height_( input_height )
+  , output_width_( output_width )
+  , output_height_( output_height )
+{
+  context_ = notnull( "sws_getCachedContext Y'CbCr resize",
+                      sws_getCachedContext( context_,
+                                            input_width_,
+                                            input_height_,
+                                            AV_PIX_FMT_YUV420P,
+                                            output_width_,
+                                            output_height_,
+                                            AV_PIX_FMT_YUV420P,
+                                            SWS_BICUBIC,
+                                            nullptr,
+                                            nullptr,
+                                            nullptr ) );
+}
+
+Downscaler::~Downscaler()
+{
+  if ( context_ ) {
+    sws_freeContext( context_ );
+  }
+}
+
+void Downscaler::scale( const RasterYUV420& source, RasterYUV420& dest ) const
+{
+  if ( source.width() != input_width_ or source.height() != input_height_ ) {
+    throw runtime_error( "Downscaler: source size mismatch" );
+  }
+
+  if ( dest.width() != output_width_ or dest.height() != output_height_ ) {
+    throw runtime_error( "Downscaler: dest size mismatch" );
+  }
+
+  const array<const uint8_t*, 3> source_planes { source.Y_row( 0 ), source.Cb_row( 0 ), source.Cr_row( 0 ) };
+  const array<const int, 3> source_strides { source.Y_stride(), source.chroma_stride(), source.chroma_stride() };
+
+  const array<uint8_t*, 3> dest_planes { dest.Y_row( 0 ), dest.Cb_row( 0 ), dest.Cr_row( 0 ) };
+  const array<const int, 3> dest_strides { dest.Y_stride(), dest.chroma_stride(), dest.chroma_stride() };
+
+  const int rows_written = sws_scale( context_,
+                                      source_planes.data(),
+                                      source_strides.data(),
+                                      0,
+                                      input_height_,
+                                      dest_planes.data(),
+                                      dest_strides.data() );
+
+  if ( rows_written != output_height_ ) {
+    throw runtime_error( "unexpected return value from sws_scale(): " + to_string( rows_written ) );
+  }
+}
@@ -42,6 +42,17 @@ public:
 
   void scale( const RasterYUV422& source, RasterYUV420& dest );
 
+  uint16_t source_x() const { return source_x_; }
+  uint16_t source_y() const { return source_y_; }
+  uint16_t source_width() const { return source_width_; }
+  uint16_t source_height() const { return source_height_; }
+
+  static constexpr uint16_t width() { return output_width; }
+  static constexpr uint16_t height() { return output_height; }
+
+  /* true when scale() would only be a window copy plus 4:2:2 => 4:2:0 conversion */
+  bool is_unscaled() const { return source_width_ == output_width and source_height_ == output_height; }
+
   Scaler( const Scaler& other ) = delete;
   Scaler& operator=( const Scaler& other ) = delete;
 };
@@ -70,3 +81,22 @@ public:
   ColorspaceConverter( const ColorspaceConverter& other ) = delete;
   ColorspaceConverter& operator=( const ColorspaceConverter& other ) = delete;
 };
+
+/* resizes a 4:2:0 raster, e.g. for the lower rungs of the camera rendition ladder */
+class Downscaler
+{
+  uint16_t input_width_, input_height_, output_width_, output_height_;
+  SwsContext* context_ { nullptr };
+
+public:
+  Downscaler( const uint16_t input_width,
+              const uint16_t input_height,
+              const uint16_t output_width,
+              const uint16_t output_height );
+  ~Downscaler();
+
+  void scale( const RasterYUV420& source, RasterYUV420& dest ) const;
+
+  Downscaler( const Downscaler& other ) = delete;
+  Downscaler& operator=( const Downscaler& other ) = delete;
+};
@@ -0,0 +1,216 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "segment_cache.hh"
+
+using namespace std;
+
+static uint32_t read_u32( const string_view s, const size_t pos )
+{
+  const auto* p = reinterpret_cast<const uint8_t*>( s.data() + pos );
+  return ( uint32_t( p[0] ) << 24 ) | ( uint32_t( p[1] ) << 16 ) | ( uint32_t( p[2] ) << 8 ) | uint32_t( p[3] );
+}
+
+/* find a child box by type within [begin, end) of an ISO BMFF buffer; returns offset of its payload */
+static optional<pair<size_t, size_t>> find_box( const string_view s,
+                                                const size_t begin,
+                                                const size_t end,
+                                                const string_view type )
+{
+  size_t pos = begin;
+  while ( pos + 8 <= end ) {
+    const size_t size = read_u32( s, pos );
+    if ( size < 8 or pos + size > end ) {
+      return {};
+    }
+    if ( s.substr( pos + 4, 4 ) == type ) {
+      return make_pair( pos + 8, pos + size );
+    }
+    pos += size;
+  }
+  return {};
+}
+
+void SegmentCache::Segment::copy_out( const size_t pos,
+                                      const size_t len,
+                                      const uint64_t time_offset,
+                                      char* out ) const
+{
+  memcpy( out, data.data() + pos, len );
+
+  if ( not tfdt_offset.has_value() or time_offset == 0 ) {
+    return;
+  }
+
+  /* patch whichever bytes of the (big-endian) decode time fall inside this chunk */
+  const size_t field_size = tfdt_64bit ? 8 : 4;
+  const uint64_t new_time = decode_time - time_offset;
+  for ( size_t i = 0; i < field_size; i++ ) {
+    const size_t field_pos = tfdt_offset.value() + i;
+    if ( field_pos >= pos and field_pos < pos + len ) {
+      out[field_pos - pos] = char( ( new_time >> ( 8 * ( field_size - 1 - i ) ) ) & 0xff );
+    }
+  }
+}
+
+SegmentCache::SegmentCache( const unsigned int frame_rate,
+                            const unsigned int width,
+                            const unsigned int height,
+                            const Muxer muxer,
+                            const size_t max_bytes )
+  : muxer_( muxer == Muxer::LibAV ? make_unique<MP4Writer>( frame_rate, width, height ) : nullptr )
+  , chunk_writer_( muxer == Muxer::CMAF ? make_unique<CMAFWriter>( frame_rate, width, height ) : nullptr )
+  , frame_rate_( frame_rate )
+  , max_bytes_( max_bytes )
+{}
+
+SegmentCache::SegmentCache( const unsigned int frame_rate, const size_t max_bytes )
+  : muxer_()
+  , chunk_writer_()
+  , frame_rate_( frame_rate )
+  , max_bytes_( max_bytes )
+{}
+
+shared_ptr<const SegmentCache::Segment> SegmentCache::push_NAL( const string_view nal )
+{
+  if ( not muxer_ and not chunk_writer_ ) {
+    throw runtime_error( "SegmentCache::push_NAL: no muxer (mirror)" );
+  }
+
+  const bool idr = MP4Writer::is_idr( nal );
+
+  const uint64_t start = Timer::timestamp_ns();
+  if ( muxer_ ) {
+    muxer_->write( nal, frame_count_, frame_count_ );
+  } else {
+    chunk_writer_->write( nal, frame_count_ );
+  }
+  stats_.mux_time.log( Timer::timestamp_ns() - start );
+  frame_count_++;
+  stats_.NALs_muxed++;
+
+  RingBuffer& output = muxer_ ? muxer_->output() : chunk_writer_->output();
+  if ( output.readable_region().empty() ) {
+    return {};
+  }
+
+  auto segment = make_shared<Segment>();
+  segment->data = output.readable_region();
+  segment->idr = idr;
+  output.pop( segment->data.size() );
+
+  if ( chunk_writer_ and chunk_writer_->init_generation() != init_generation_ ) {
+    /* new parameter sets: a new init segment, which this IDR (and later ones) must follow */
+    auto init = make_shared<Segment>();
+    init->data = chunk_writer_->init_segment();
+    init->is_init = true;
+    init_ = init;
+    init_generation_ = chunk_writer_->init_generation();
+  }
+
+  if ( muxer_ and not init_ ) {
+    /* libavformat: the first output is ftyp + (empty) moov, then the first IDR's moof + mdat; split them so the
+       init segment can be sent by itself (e.g. when a viewer switches to this stream) */
+    const auto moof = find_box( segment->data, 0, segment->data.size(), "moof" );
+    if ( not moof ) {
+      throw runtime_error( "SegmentCache: no fragment after the libavformat header" );
+    }
+
+    auto init = make_shared<Segment>();
+    init->data = segment->data.substr( 0, moof->first - 8 );
+    init->is_init = true;
+    init_ = init;
+    segment->data.erase( 0, moof->first - 8 );
+  }
+
+  /* moof -> traf -> tfdt */
+  const string_view data = segment->data;
+  const auto moof = find_box( data, 0, data.size(), "moof" );
+  const auto traf = moof ? find_box( data, moof->first, moof->second, "traf" ) : nullopt;
+  const auto tfdt = traf ? find_box( data, traf->first, traf->second, "tfdt" ) : nullopt;
+  if ( tfdt and tfdt->second - tfdt->first >= 8 ) {
+    segment->tfdt_64bit = data.at( tfdt->first ) == 1;
+    segment->tfdt_offset = tfdt->first + 4;
+    if ( segment->tfdt_64bit and tfdt->second - tfdt->first >= 12 ) {
+      segment->decode_time = ( uint64_t( read_u32( data, tfdt->first + 4 ) ) << 32 )
+                             | read_u32( data, tfdt->first + 8 );
+    } else {
+      segment->tfdt_64bit = false;
+      segment->decode_time = read_u32( data, tfdt->first + 4 );
+    }
+  }
+
+  segment->stream_offset = stream_bytes_;
+
+  if ( idr ) {
+    segment->init = init_;
+  }
+
+  add( segment );
+  return segment;
+}
+
+void SegmentCache::add( const shared_ptr<const Segment>& segment )
+{
+  if ( segment->is_init ) {
+    init_ = segment;
+    return;
+  }
+
+  if ( segment->init ) {
+    init_ = segment->init;
+  }
+
+  if ( not init_ ) {
+    return; /* nothing to play it with */
+  }
+
+  if ( end_index() == 0 ) {
+    init_end_time_ = segment->decode_time;
+  }
+
+  if ( segment->idr ) {
+    latest_idr_index_ = end_index();
+  }
+
+  stream_bytes_ = segment->stream_offset + segment->data.size();
+  bytes_stored_ += segment->data.size();
+  fragments_.push_back( segment );
+
+  evict();
+}
+
+void SegmentCache::evict()
+{
+  /* always keep the latest GOP, so a new viewer can start at its IDR */
+  while ( bytes_stored_ > max_bytes_ and latest_idr_index_.has_value() and first_index_ < latest_idr_index_.value() ) {
+    bytes_stored_ -= fragments_.front()->data.size();
+    fragments_.pop_front();
+    first_index_++;
+    stats_.fragments_evicted++;
+  }
+}
+
+const shared_ptr<const SegmentCache::Segment>& SegmentCache::at( const uint64_t index ) const
+{
+  if ( index < first_index_ or index >= end_index() ) {
+    throw out_of_range( "SegmentCache::at" );
+  }
+  return fragments_.at( index - first_index_ );
+}
+
+void SegmentCache::summary( ostream& out ) const
+{
+  out << "Segment cache: NALs muxed=" << stats_.NALs_muxed << " fragments=" << fragments_.size() << " ("
+      << bytes_stored_ / 1024 << " KiB) evicted=" << stats_.fragments_evicted << "\n";
+  out << "   mux: ";
+  if ( stats_.mux_time.count > 0 ) {
+    out << "mean=";
+    Timer::pp_ns( out, stats_.mux_time.total_ns / stats_.mux_time.count );
+    out << " max=";
+    Timer::pp_ns( out, stats_.mux_time.max_ns );
+  } else {
+    out << "none";
+  }
+  out << "\n";
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "cmaf_writer.hh"
+#include "mp4writer.hh"
+#include "summarize.hh"
+#include "timer.hh"
+
+/* muxes each NAL once and keeps the resulting fMP4 fragments for any number of viewers to read
+   (or, without a muxer, mirrors segments muxed by another cache, e.g. on another thread) */
+class SegmentCache : public Summarizable
+{
+public:
+  struct Segment
+  {
+    std::string data {};
+    bool idr {};
+
+    /* an init segment (ftyp + moov) rather than a fragment */
+    bool is_init {};
+
+    /* for IDR fragments: the init segment that must come before them */
+    std::shared_ptr<const Segment> init {};
+
+    /* bytes of fragments before this one in the stream */
+    uint64_t stream_offset {};
+
+    /* baseMediaDecodeTime from the tfdt box (fragments only), so readers can shift their timeline */
+    uint64_t decode_time {};
+    std::optional<size_t> tfdt_offset {};
+    bool tfdt_64bit {};
+
+    /* copy data[ pos, pos + len ) to out, rewriting the decode time as decode_time - time_offset */
+    void copy_out( const size_t pos, const size_t len, const uint64_t time_offset, char* out ) const;
+  };
+
+  enum class Muxer
+  {
+    LibAV, /* MP4Writer: libavformat, one fragment per frame */
+    CMAF   /* CMAFWriter: minimal per-frame chunks, init segment rebuilt when the SPS/PPS change */
+  };
+
+private:
+  std::unique_ptr<MP4Writer> muxer_;
+  std::unique_ptr<CMAFWriter> chunk_writer_;
+  unsigned int init_generation_ {};
+  unsigned int frame_rate_;
+
+  /* ftyp + moov, sent to each new viewer (and on a switch to this stream) before its first IDR */
+  std::shared_ptr<const Segment> init_ {};
+
+  /* decode time of the first fragment after the init segment */
+  uint64_t init_end_time_ {};
+
+  std::deque<std::shared_ptr<const Segment>> fragments_ {};
+  uint64_t first_index_ {};
+  std::optional<uint64_t> latest_idr_index_ {};
+  size_t bytes_stored_ {};
+  size_t max_bytes_;
+  uint64_t stream_bytes_ {};
+
+  uint32_t frame_count_ {};
+
+  struct Statistics
+  {
+    unsigned int NALs_muxed, fragments_evicted;
+    Timer::Record mux_time {};
+  } stats_ {};
+
+  void evict();
+
+public:
+  SegmentCache( const unsigned int frame_rate,
+                const unsigned int width,
+                const unsigned int height,
+                const Muxer muxer = Muxer::LibAV,
+                const size_t max_bytes = 1048576 );
+
+  /* mirror: segments arrive through add() */
+  SegmentCache( const unsigned int frame_rate, const size_t max_bytes = 1048576 );
+
+  /* returns the new segment (if the muxer produced one), already added */
+  std::shared_ptr<const Segment> push_NAL( const std::string_view nal );
+
+  /* init segments (flagged, or carried by IDR fragments) replace the current one; fragments arrive in stream order */
+  void add( const std::shared_ptr<const Segment>& segment );
+
+  const std::shared_ptr<const Segment>& init() const { return init_; }
+  uint64_t init_end_time() const { return init_end_time_; }
+
+  /* fragment indices: [first_index, end_index) are available */
+  uint64_t first_index() const { return first_index_; }
+  uint64_t end_index() const { return first_index_ + fragments_.size(); }
+  const std::shared_ptr<const Segment>& at( const uint64_t index ) const;
+
+  /* bytes of fragments from index to the end */
+  uint64_t bytes_after( const uint64_t index ) const { return stream_bytes_ - at( index )->stream_offset; }
+
+  /* where a viewer should start (or restart) reading after the init segment */
+  uint64_t start_index() const { return latest_idr_index_.value_or( first_index_ ); }
+
+  unsigned int frame_duration() const { return MP4Writer::MP4_TIMEBASE / frame_rate_; }
+  unsigned int frame_rate() const { return frame_rate_; }
+
+  void summary( std::ostream& out ) const override;
+  void reset_summary() override { stats_ = {}; }
+};
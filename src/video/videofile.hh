@@ -3,6 +3,7 @@
 #include "mmap.hh"
 #include "raster.hh"
 
+#include <cstring>
 #include <iostream>
 #include <optional>
 
@@ -21,23 +22,24 @@ public:
 
   void read_raster()
   {
-    static size_t rastersize = raster420_.Y().size() + raster420_.Cb().size() + raster420_.Cr().size();
-    if ( next_byte_ + rastersize <= file_.length() ) {
-      const std::string_view Y_view
-        = static_cast<std::string_view>( file_ ).substr( next_byte_, raster420_.Y().size() );
-      next_byte_ += raster420_.Y().size();
-
-      const std::string_view Cb_view
-        = static_cast<std::string_view>( file_ ).substr( next_byte_, raster420_.Y().size() );
-      next_byte_ += raster420_.Cb().size();
+    const size_t Y_size = size_t( raster420_.width() ) * raster420_.height();
+    const size_t chroma_size = size_t( raster420_.chroma_width() ) * raster420_.chroma_height();
+    const size_t rastersize = Y_size + 2 * chroma_size;
 
-      const std::string_view Cr_view
-        = static_cast<std::string_view>( file_ ).substr( next_byte_, raster420_.Y().size() );
-      next_byte_ += raster420_.Cr().size();
-
-      raster420_.Y().assign( Y_view.begin(), Y_view.end() );
-      raster420_.Cb().assign( Cb_view.begin(), Cb_view.end() );
-      raster420_.Cr().assign( Cr_view.begin(), Cr_view.end() );
+    if ( next_byte_ + rastersize <= file_.length() ) {
+      const std::string_view frame = static_cast<std::string_view>( file_ ).substr( next_byte_, rastersize );
+      next_byte_ += rastersize;
+
+      /* the file is tightly packed; the raster's rows may be padded */
+      for ( uint16_t row = 0; row < raster420_.height(); row++ ) {
+        memcpy( raster420_.Y_row( row ), frame.data() + row * raster420_.width(), raster420_.width() );
+      }
+
+      for ( uint16_t row = 0; row < raster420_.chroma_height(); row++ ) {
+        const size_t offset = row * raster420_.chroma_width();
+        memcpy( raster420_.Cb_row( row ), frame.data() + Y_size + offset, raster420_.chroma_width() );
+        memcpy( raster420_.Cr_row( row ), frame.data() + Y_size + chroma_size + offset, raster420_.chroma_width() );
+      }
     }
   }
 };
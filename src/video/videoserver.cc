@@ -50,6 +50,10 @@ VideoServer::VideoServer( const uint8_t num_clients, EventLoop& loop )
   camera_broadcast_socket_.set_blocking( false );
   socket_.bind( { "0", 9201 } );
 
+  for ( size_t rung = 1; rung < camera_renditions.size(); rung++ ) {
+    camera_renditions_.push_back( make_unique<CameraRenditionEncoder>( camera_renditions.at( rung ), rung ) );
+  }
+
   loop.add_rule( "network receive", socket_, Direction::In, [&] {
     Address src { nullptr, 0 };
     Ciphertext ciphertext;
@@ -92,6 +96,7 @@ VideoServer::VideoServer( const uint8_t num_clients, EventLoop& loop )
       RasterYUV420& output = clients_.at( camera_feed_live_no_ )
                                ? clients_.at( camera_feed_live_no_ ).client().raster()
                                : default_raster_;
+      const uint32_t frame_no = camera_feed_.frames_encoded();
       camera_feed_.encode( output );
       if ( camera_feed_.has_nal() ) {
         camera_broadcast_socket_.sendto_ignore_errors(
@@ -102,6 +107,13 @@ VideoServer::VideoServer( const uint8_t num_clients, EventLoop& loop )
           { reinterpret_cast<const char*>( camera_feed_.nal().NAL.data() ), camera_feed_.nal().NAL.size() } );
         camera_feed_.reset_nal();
       }
+
+      /* simulcast: lower rungs run at a divisor of the full frame rate */
+      for ( auto& rendition : camera_renditions_ ) {
+        if ( frame_no % ( camera_renditions.at( 0 ).fps / rendition->spec_.fps ) == 0 ) {
+          rendition->encode_and_send( output, camera_broadcast_socket_ );
+        }
+      }
     },
     [&] { return server_clock() >= camera_feed_.frames_encoded() and not camera_feed_.has_nal(); } );
 
@@ -137,6 +149,9 @@ void VideoServer::summary( ostream& out ) const
 {
   out << "bad packets: " << stats_.bad_packets;
   out << " camera frames encoded: " << camera_feed_.frames_encoded();
+  for ( const auto& rendition : camera_renditions_ ) {
+    out << " [" << rendition->spec_.name << ": " << rendition->encoder_.frames_encoded() << "]";
+  }
   out << " live now: "
       << ( clients_.at( camera_feed_live_no_ ) ? clients_.at( camera_feed_live_no_ ).name()
                                                : "none " + to_string( camera_feed_live_no_ ) );
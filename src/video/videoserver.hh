@@ -6,6 +6,7 @@
 #include "crypto.hh"
 #include "eventloop.hh"
 #include "keys.hh"
+#include "rendition.hh"
 #include "socket.hh"
 #include "summarize.hh"
 #include "videofile.hh"
@@ -46,6 +47,36 @@ struct CompositingGroup
   }
 };
 
+/* an extra, lower-resolution encoding of the live camera feed */
+struct CameraRenditionEncoder
+{
+  CameraRendition spec_;
+  Downscaler scaler_;
+  RasterYUV420 output_;
+  H264Encoder encoder_;
+  Address destination_;
+
+  CameraRenditionEncoder( const CameraRendition& spec, const size_t rung )
+    : spec_( spec )
+    , scaler_( 1280, 720, spec.width, spec.height )
+    , output_( spec.width, spec.height )
+    , encoder_( spec.width, spec.height, spec.fps, "veryfast", "zerolatency" )
+    , destination_( Address::abstract_unix( camera_rendition_socket( rung ) ) )
+  {}
+
+  void encode_and_send( const RasterYUV420& source, UnixDatagramSocket& socket )
+  {
+    scaler_.scale( source, output_ );
+    encoder_.encode( output_ );
+
+    if ( encoder_.has_nal() ) {
+      socket.sendto_ignore_errors(
+        destination_, { reinterpret_cast<const char*>( encoder_.nal().NAL.data() ), encoder_.nal().NAL.size() } );
+      encoder_.reset_nal();
+    }
+  }
+};
+
 class VideoServer : public Summarizable
 {
   static constexpr uint64_t CLIENT_TIMEOUT_NS = 4'000'000'000;
@@ -70,9 +101,10 @@ class VideoServer : public Summarizable
   std::shared_ptr<RasterRGBA> default_raster_keyed_ = std::make_shared<RasterRGBA>( 1280, 720 );
   H264Encoder camera_feed_ { 1280, 720, 60, "veryfast", "zerolatency" };
   uint8_t camera_feed_live_no_ {};
-  Address camera_destination_ { Address::abstract_unix( "stagecast-camera-video" ) };
+  Address camera_destination_ { Address::abstract_unix( camera_rendition_socket( 0 ) ) };
   Address camera_destination2_ { Address::abstract_unix( "stagecast-camera-video-filmout" ) };
   UnixDatagramSocket camera_broadcast_socket_ {};
+  std::vector<std::unique_ptr<CameraRenditionEncoder>> camera_renditions_ {};
 
   uint64_t output_frames_encoded_ {};
 
@@ -3,11 +3,10 @@
 using namespace std;
 using namespace chrono;
 
-using Option = RubberBand::RubberBandStretcher::Option;
-
 VSClient::VSClient( const uint8_t node_id, CryptoSession&& crypto )
   : connection_( 0, node_id, move( crypto ) )
-  , raster_keyed_( make_shared<RasterRGBA>( 1280, 720 ) )
+  , raster_( global_raster_pool<RasterYUV420>( 1280, 720 ).get() )
+  , raster_keyed_( global_raster_pool<RasterRGBA>( 1280, 720 ).get() )
 {
   zoom_.x = 0;
   zoom_.y = 0;
@@ -32,8 +31,13 @@ bool VSClient::receive_packet( const Address& source, const Ciphertext& cipherte
     current_nal_.resize( new_size );
 
     if ( chunk.end_of_nal ) {
-      decoder_.decode( current_nal_.as_string_view(), raster_ );
-      converter_.convert( raster_, *raster_keyed_ ); /* XXX do chroma key here */
+      auto decoded = decoder_.decode( current_nal_.as_string_view() );
+      if ( decoded and decoded->width() == 1280 and decoded->height() == 720 ) {
+        auto keyed = global_raster_pool<RasterRGBA>( 1280, 720 ).get();
+        converter_.convert( *decoded, *keyed ); /* XXX do chroma key here */
+        raster_ = move( decoded );
+        raster_keyed_ = move( keyed );
+      }
       NALs_decoded_++;
       current_nal_.resize( 0 );
     }
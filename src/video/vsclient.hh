@@ -12,6 +12,7 @@
 #include "h264_decoder.hh"
 #include "keys.hh"
 #include "raster.hh"
+#include "raster_pool.hh"
 #include "scale.hh"
 #include "videoclient.hh"
 
@@ -23,7 +24,9 @@ public:
   VSClient( const uint8_t node_id, CryptoSession&& crypto );
 
   H264Decoder decoder_ {};
-  RasterYUV420 raster_ { 1280, 720 };
+
+  /* latest decoded frame (shared with the decoder's reference pictures, never written after decoding) */
+  std::shared_ptr<RasterYUV420> raster_;
   std::shared_ptr<RasterRGBA> raster_keyed_;
   ColorspaceConverter converter_ { 1280, 720 };
 
@@ -41,7 +44,8 @@ public:
 
   const VideoNetworkConnection& connection() const { return connection_; }
 
-  RasterYUV420& raster() { return raster_; }
+  RasterYUV420& raster() { return *raster_; }
+  const std::shared_ptr<RasterYUV420>& raster_handle() const { return raster_; }
 
   video_control zoom_ {};
   uint64_t next_zoom_update_ = 0;